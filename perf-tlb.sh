@@ -0,0 +1,28 @@
+#!/bin/bash
+# Compares the dTLB misses of the simulation for the huge page policies of the
+# agent indexes (SimParam::huge_pages). Run from the build directory, e.g.
+#   ../perf-tlb.sh 5000000
+# with the initial population size as optional argument. For each policy, the
+# totals are written to perf-tlb-<policy>.txt and the misses per function to
+# perf-tlb-<policy>-symbols.txt. The casual mating phase is attributed to
+# MatingBehaviour::Run and the GetRandomAgent helper of the environment.
+#
+# The hugetlbfs policy requires a pool of huge pages, e.g.
+#   echo 8192 | sudo tee /proc/sys/vm/nr_hugepages
+
+POPULATION=${1:-5000000}
+EVENTS=dTLB-loads,dTLB-load-misses,dTLB-stores,dTLB-store-misses
+
+for POLICY in none transparent hugetlbfs; do
+  CONFIG="{\"bdm::hiv_malawi::SimParam\": {\"huge_pages\": \"$POLICY\", \
+\"initial_population_size\": $POPULATION}}"
+  perf stat -e $EVENTS -o perf-tlb-$POLICY.txt \
+    ./hiv_malawi --inline-config "$CONFIG"
+  perf record -e dTLB-load-misses -o perf-tlb-$POLICY.data \
+    ./hiv_malawi --inline-config "$CONFIG"
+  perf report -i perf-tlb-$POLICY.data --stdio --sort symbol \
+    > perf-tlb-$POLICY-symbols.txt
+  echo "== $POLICY"
+  grep -E "dTLB" perf-tlb-$POLICY.txt
+  grep -E "MatingBehaviour|GetRandomAgent" perf-tlb-$POLICY-symbols.txt
+done
@@ -10,9 +10,13 @@
 //
 // -----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <ctime>
 #include <iostream>
+#include <iterator>
 #include <numeric>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "TCanvas.h"
@@ -22,59 +26,142 @@
 
 #include "datatypes.h"
 
+#include "async-writer.h"
 #include "biodynamo.h"
+#include "categorical-environment.h"
 #include "core/util/log.h"
+#include "ensemble-aggregator.h"
 #include "person.h"
+#include "reductions.h"
 #include "sim-param.h"
+#include "statistics-pipeline.h"
 
 namespace bdm {
 namespace hiv_malawi {
 
 using experimental::Counter;
 using experimental::GenericReducer;
+using experimental::TimeSeries;
+
+// Returns the partnership statistics of the current year. Returns empty
+// statistics for environments without partnership history (e.g. in tests).
+static const PartnershipStatistics& GetPartnershipStatistics(Simulation* sim) {
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env == nullptr) {
+    static const PartnershipStatistics kEmpty;
+    return kEmpty;
+  }
+  int year = static_cast<int>(sim->GetParam()->Get<SimParam>()->start_year +
+                              sim->GetScheduler()->GetSimulatedSteps());
+  return env->GetPartnershipHistory().GetStatistics(year);
+}
+
+// Returns the household statistics computed when the households were built.
+// Returns empty statistics for environments without households.
+static const HouseholdStatistics& GetHouseholdStatistics(Simulation* sim) {
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env == nullptr) {
+    static const HouseholdStatistics kEmpty;
+    return kEmpty;
+  }
+  return env->GetHouseholdTable().GetStatistics();
+}
+
+// Define how to get the time values of the TimeSeries
+static double GetYear(Simulation* sim) {
+  // AM: Starting Year Variable set in sim_params
+  int start_year = sim->GetParam()->Get<SimParam>()->start_year;
+
+  return static_cast<double>(start_year +
+                             sim->GetScheduler()->GetSimulatedSteps());
+}
+
+// Ids of the collectors registered with the TimeSeries, in the order of
+// registration (see AddToAggregator)
+static std::vector<std::string>& GetCollectorIds() {
+  static std::vector<std::string> ids;
+  return ids;
+}
+
+// Register a collector with the TimeSeries, with the year as x value
+template <typename TCollector>
+static void AddCollector(TimeSeries* ts, const std::string& id,
+                         TCollector collector) {
+  GetCollectorIds().push_back(id);
+  ts->AddCollector(id, collector, GetYear);
+}
+
+// Counts the hot statistics of all agents in a single pass (see HotCounts)
+static HotCounts CountHotStatistics(Simulation* sim) {
+  SharedData<HotCounts> tl_counts;
+  tl_counts.resize(ThreadInfo::GetInstance()->GetMaxThreads());
+  auto count = L2F([&](Agent* agent) {
+    auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+    tl_counts[tid].Add(*bdm_static_cast<Person*>(agent));
+  });
+  sim->GetResourceManager()->ForEachAgentParallel(count);
+  HotCounts counts;
+  for (const auto& el : tl_counts) {
+    counts.Merge(el);
+  }
+  return counts;
+}
 
+// Collector of the hot statistic with the given index. All hot statistics of
+// a year share the counts of the environment's StatisticsPipeline; other
+// environments (e.g. in tests) count the agents for each statistic.
+template <size_t kStatistic>
+static double GetHotStatistic(Simulation* sim) {
+  const auto& statistic = GetHotStatistics()[kStatistic];
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env == nullptr) {
+    return statistic.get(CountHotStatistics(sim));
+  }
+  return statistic.get(env->GetStatisticsPipeline().GetCounts(
+      GetYear(sim), [sim]() { return CountHotStatistics(sim); }));
+}
+
+template <size_t... kStatistics>
+static void AddHotCollectors(TimeSeries* ts,
+                             std::index_sequence<kStatistics...>) {
+  (AddCollector(ts, GetHotStatistics()[kStatistics].id,
+                GetHotStatistic<kStatistics>),
+   ...);
+}
+
+// All collectors accumulate integer quantities (the thread-local counts of
+// the Counters are exact below 2^53), and ratios are only computed from the
+// reduced totals. The statistics are therefore bitwise reproducible for any
+// number of threads. New reducers should combine their partial results with
+// SumTlResults.
 void DefineAndRegisterCollectors() {
   // Get population statistics, i.e. extract data from simulation
   // Get the pointer to the TimeSeries
-  auto* ts = Simulation::GetActive()->GetTimeSeries();
-
-  // Define how to get the time values of the TimeSeries
-  auto get_year = [](Simulation* sim) {
-    // AM: Starting Year Variable set in sim_params
-    int start_year = sim->GetParam()->Get<SimParam>()->start_year;
-
-    return static_cast<double>(start_year +
-                               sim->GetScheduler()->GetSimulatedSteps());
-  };
+  auto* sim = Simulation::GetActive();
+  auto* ts = sim->GetTimeSeries();
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  GetCollectorIds().clear();
 
   // Define how to count the healthy individuals
   auto healthy = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsHealthy();
   };
-  ts->AddCollector("healthy_agents", new Counter<double>(healthy), get_year);
+  AddCollector(ts, "healthy_agents", new Counter<double>(healthy));
 
   // Define how to count the infected individuals
   auto infected = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return !(person->IsHealthy());
   };
-  ts->AddCollector("infected_agents", new Counter<double>(infected), get_year);
-
-  // AM: Define how to count the infected acute individuals
-  auto acute = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->IsAcute();
-  };
-  ts->AddCollector("acute_agents", new Counter<double>(acute), get_year);
+  AddCollector(ts, "infected_agents", new Counter<double>(infected));
 
   // AM: Define how to count the infected acute male individuals
   auto acute_male_agents = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsAcute() && person->IsMale();
   };
-  ts->AddCollector("acute_male_agents", new Counter<double>(acute_male_agents),
-                   get_year);
+  AddCollector(ts, "acute_male_agents", new Counter<double>(acute_male_agents));
 
   // AM: Define how to count the infected acute male individuals with low risk
   // behaviours
@@ -83,8 +170,8 @@ void DefineAndRegisterCollectors() {
     return person->IsAcute() && person->IsMale() &&
            person->HasLowRiskSocioBehav();
   };
-  ts->AddCollector("acute_male_low_sb_agents",
-                   new Counter<double>(acute_male_low_sb_agents), get_year);
+  AddCollector(ts, "acute_male_low_sb_agents",
+               new Counter<double>(acute_male_low_sb_agents));
 
   // AM: Define how to count the infected acute male individuals with high risk
   // behaviours
@@ -93,16 +180,16 @@ void DefineAndRegisterCollectors() {
     return person->IsAcute() && person->IsMale() &&
            person->HasHighRiskSocioBehav();
   };
-  ts->AddCollector("acute_male_high_sb_agents",
-                   new Counter<double>(acute_male_high_sb_agents), get_year);
+  AddCollector(ts, "acute_male_high_sb_agents",
+               new Counter<double>(acute_male_high_sb_agents));
 
   // AM: Define how to count the infected acute female individuals
   auto acute_female_agents = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsAcute() && person->IsFemale();
   };
-  ts->AddCollector("acute_female_agents",
-                   new Counter<double>(acute_female_agents), get_year);
+  AddCollector(ts, "acute_female_agents",
+               new Counter<double>(acute_female_agents));
 
   // AM: Define how to count the infected acute female individuals with low risk
   // sociobehaviours
@@ -111,8 +198,8 @@ void DefineAndRegisterCollectors() {
     return person->IsAcute() && person->IsFemale() &&
            person->HasLowRiskSocioBehav();
   };
-  ts->AddCollector("acute_female_low_sb_agents",
-                   new Counter<double>(acute_female_low_sb_agents), get_year);
+  AddCollector(ts, "acute_female_low_sb_agents",
+               new Counter<double>(acute_female_low_sb_agents));
 
   // AM: Define how to count the infected acute female individuals with high
   // risk sociobehaviours
@@ -121,102 +208,98 @@ void DefineAndRegisterCollectors() {
     return person->IsAcute() && person->IsFemale() &&
            person->HasHighRiskSocioBehav();
   };
-  ts->AddCollector("acute_female_high_sb_agents",
-                   new Counter<double>(acute_female_high_sb_agents), get_year);
+  AddCollector(ts, "acute_female_high_sb_agents",
+               new Counter<double>(acute_female_high_sb_agents));
 
   // AM: Define how to count the infected chronic individuals
   auto chronic = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsChronic();
   };
-  ts->AddCollector("chronic_agents", new Counter<double>(chronic), get_year);
+  AddCollector(ts, "chronic_agents", new Counter<double>(chronic));
 
   // AM: Define how to count the infected treated individuals
   auto treated = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsTreated();
   };
-  ts->AddCollector("treated_agents", new Counter<double>(treated), get_year);
+  AddCollector(ts, "treated_agents", new Counter<double>(treated));
 
   // AM: Define how to count the infected failing individuals
   auto failing = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsFailing();
   };
-  ts->AddCollector("failing_agents", new Counter<double>(failing), get_year);
+  AddCollector(ts, "failing_agents", new Counter<double>(failing));
 
   // AM: Define how to count the individuals infected at birth
   auto mtct = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->MTCTransmission();
   };
-  ts->AddCollector("mtct_agents", new Counter<double>(mtct), get_year);
+  AddCollector(ts, "mtct_agents", new Counter<double>(mtct));
 
   // AM: Define how to count the male individuals infected at birth
   auto mtct_transmission_to_male = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->MTCTransmission() && person->IsMale();
   };
-  ts->AddCollector("mtct_transmission_to_male",
-                   new Counter<double>(mtct_transmission_to_male), get_year);
+  AddCollector(ts, "mtct_transmission_to_male",
+               new Counter<double>(mtct_transmission_to_male));
 
   // AM: Define how to count the female individuals infected at birth
   auto mtct_transmission_to_female = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->MTCTransmission() && person->IsFemale();
   };
-  ts->AddCollector("mtct_transmission_to_female",
-                   new Counter<double>(mtct_transmission_to_female), get_year);
+  AddCollector(ts, "mtct_transmission_to_female",
+               new Counter<double>(mtct_transmission_to_female));
 
   // AM: Define how to count the individuals infected through casual mating
   auto casual = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->CasualTransmission();
   };
-  ts->AddCollector("casual_transmission_agents", new Counter<double>(casual),
-                   get_year);
+  AddCollector(ts, "casual_transmission_agents", new Counter<double>(casual));
 
   // AM: Define how to count the male individuals infected through casual mating
   auto casual_transmission_to_male = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->CasualTransmission() && person->IsMale();
   };
-  ts->AddCollector("casual_transmission_to_male",
-                   new Counter<double>(casual_transmission_to_male), get_year);
+  AddCollector(ts, "casual_transmission_to_male",
+               new Counter<double>(casual_transmission_to_male));
   // AM: Define how to count the female individuals infected through casual
   // mating
   auto casual_transmission_to_female = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->CasualTransmission() && person->IsFemale();
   };
-  ts->AddCollector("casual_transmission_to_female",
-                   new Counter<double>(casual_transmission_to_female),
-                   get_year);
+  AddCollector(ts, "casual_transmission_to_female",
+               new Counter<double>(casual_transmission_to_female));
 
   // AM: Define how to count the individuals infected through regular mating
   auto regular = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->RegularTransmission();
   };
-  ts->AddCollector("regular_transmission_agents", new Counter<double>(regular),
-                   get_year);
+  AddCollector(ts, "regular_transmission_agents", new Counter<double>(regular));
   // AM: Define how to count the male individuals infected through regular
   // mating
   auto regular_transmission_to_male = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->RegularTransmission() && person->IsMale();
   };
-  ts->AddCollector("regular_transmission_to_male",
-                   new Counter<double>(regular_transmission_to_male), get_year);
+  AddCollector(ts, "regular_transmission_to_male",
+               new Counter<double>(regular_transmission_to_male));
   // AM: Define how to count the female individuals infected through regular
   // mating
   auto regular_transmission_to_female = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->RegularTransmission() && person->IsFemale();
   };
-  ts->AddCollector("regular_transmission_to_female",
-                   new Counter<double>(regular_transmission_to_female),
-                   get_year);
+  AddCollector(ts, "regular_transmission_to_female",
+               new Counter<double>(regular_transmission_to_female));
 
   // AM: Define how to count the individuals that were infected by an Acute HIV
   // partner/Mother
@@ -224,8 +307,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->AcuteTransmission();
   };
-  ts->AddCollector("acute_transmission",
-                   new Counter<double>(acute_transmission), get_year);
+  AddCollector(ts, "acute_transmission",
+               new Counter<double>(acute_transmission));
 
   // AM: Define how to count the individuals that were infected by an Chronic
   // HIV partner/Mother
@@ -233,8 +316,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->ChronicTransmission();
   };
-  ts->AddCollector("chronic_transmission",
-                   new Counter<double>(chronic_transmission), get_year);
+  AddCollector(ts, "chronic_transmission",
+               new Counter<double>(chronic_transmission));
 
   // AM: Define how to count the individuals that were infected by an Treated
   // HIV partner/Mother
@@ -242,8 +325,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->TreatedTransmission();
   };
-  ts->AddCollector("treated_transmission",
-                   new Counter<double>(treated_transmission), get_year);
+  AddCollector(ts, "treated_transmission",
+               new Counter<double>(treated_transmission));
 
   // AM: Define how to count the individuals that were infected by an Failing
   // HIV partner/Mother
@@ -251,8 +334,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->FailingTransmission();
   };
-  ts->AddCollector("failing_transmission",
-                   new Counter<double>(failing_transmission), get_year);
+  AddCollector(ts, "failing_transmission",
+               new Counter<double>(failing_transmission));
 
   // AM: Define how to count the individuals that were infected by an low risk
   // HIV partner
@@ -260,8 +343,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->LowRiskTransmission();
   };
-  ts->AddCollector("low_sb_transmission",
-                   new Counter<double>(low_sb_transmission), get_year);
+  AddCollector(ts, "low_sb_transmission",
+               new Counter<double>(low_sb_transmission));
 
   // AM: Define how to count the individuals that were infected by a high risk
   // HIV partner
@@ -269,8 +352,8 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->HighRiskTransmission();
   };
-  ts->AddCollector("high_sb_transmission",
-                   new Counter<double>(high_sb_transmission), get_year);
+  AddCollector(ts, "high_sb_transmission",
+               new Counter<double>(high_sb_transmission));
 
   // Define how to compute mean number of casual partners for males with
   // low-risk sociobehaviours
@@ -282,25 +365,21 @@ void DefineAndRegisterCollectors() {
     return (person->IsMale() && person->IsAdult() && person->age_ < 50 &&
             person->HasLowRiskSocioBehav());
   };
-  ts->AddCollector("adult_male_age_lt50_low_sb",
-                   new Counter<double>(adult_male_age_lt50_low_sb), get_year);
+  AddCollector(ts, "adult_male_age_lt50_low_sb",
+               new Counter<double>(adult_male_age_lt50_low_sb));
 
   // Sum all casual partners for adult_male_age_lt50_low_sb
   auto sum_casual_partners = [](Agent* agent, uint64_t* tl_result) {
     *tl_result += bdm_static_cast<Person*>(agent)->no_casual_partners_;
   };
+  // Integer sums in a fixed order, i.e. independent of the number of threads
   auto sum_tl_results = [](const SharedData<uint64_t>& tl_results) {
-    uint64_t result = 0;
-    for (auto& el : tl_results) {
-      result += el;
-    }
-    return result;
+    return SumTlResults(tl_results);
   };
-  ts->AddCollector(
-      "total_nocas_men_low_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_male_age_lt50_low_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_men_low_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_male_age_lt50_low_sb));
 
   auto mean_nocas_men_low_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -308,7 +387,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_male_age_lt50_low_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_men_low_sb", mean_nocas_men_low_sb, get_year);
+  AddCollector(ts, "mean_nocas_men_low_sb", mean_nocas_men_low_sb);
 
   // Define how to compute mean number of casual partners for males with
   // high-risk sociobehaviours
@@ -320,15 +399,14 @@ void DefineAndRegisterCollectors() {
     return (person->IsMale() && person->IsAdult() && person->age_ < 50 &&
             person->HasHighRiskSocioBehav());
   };
-  ts->AddCollector("adult_male_age_lt50_high_sb",
-                   new Counter<double>(adult_male_age_lt50_high_sb), get_year);
+  AddCollector(ts, "adult_male_age_lt50_high_sb",
+               new Counter<double>(adult_male_age_lt50_high_sb));
 
   // Sum all casual partners for adult_male_age_lt50_high_sb
-  ts->AddCollector(
-      "total_nocas_men_high_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_male_age_lt50_high_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_men_high_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_male_age_lt50_high_sb));
 
   auto mean_nocas_men_high_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -336,7 +414,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_male_age_lt50_high_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_men_high_sb", mean_nocas_men_high_sb, get_year);
+  AddCollector(ts, "mean_nocas_men_high_sb", mean_nocas_men_high_sb);
 
   // Define how to compute mean number of casual partners for females with
   // low-risk sociobehaviours
@@ -348,15 +426,14 @@ void DefineAndRegisterCollectors() {
     return (person->IsFemale() && person->IsAdult() && person->age_ < 50 &&
             person->HasLowRiskSocioBehav());
   };
-  ts->AddCollector("adult_female_age_lt50_low_sb",
-                   new Counter<double>(adult_female_age_lt50_low_sb), get_year);
+  AddCollector(ts, "adult_female_age_lt50_low_sb",
+               new Counter<double>(adult_female_age_lt50_low_sb));
 
   // Sum all casual partners for adult_female_age_lt50_low_sb
-  ts->AddCollector(
-      "total_nocas_women_low_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_female_age_lt50_low_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_women_low_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_female_age_lt50_low_sb));
 
   auto mean_nocas_women_low_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -364,8 +441,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_female_age_lt50_low_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_women_low_sb", mean_nocas_women_low_sb,
-                   get_year);
+  AddCollector(ts, "mean_nocas_women_low_sb", mean_nocas_women_low_sb);
 
   // Define how to compute mean number of casual partners for females with
   // high-risk sociobehaviours
@@ -377,16 +453,14 @@ void DefineAndRegisterCollectors() {
     return (person->IsFemale() && person->IsAdult() && person->age_ < 50 &&
             person->HasHighRiskSocioBehav());
   };
-  ts->AddCollector("adult_female_age_lt50_high_sb",
-                   new Counter<double>(adult_female_age_lt50_high_sb),
-                   get_year);
+  AddCollector(ts, "adult_female_age_lt50_high_sb",
+               new Counter<double>(adult_female_age_lt50_high_sb));
 
   // Sum all casual partners for adult_female_age_lt50_high_sb
-  ts->AddCollector(
-      "total_nocas_women_high_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_female_age_lt50_high_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_women_high_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_female_age_lt50_high_sb));
 
   auto mean_nocas_women_high_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -394,8 +468,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_female_age_lt50_high_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_women_high_sb", mean_nocas_women_high_sb,
-                   get_year);
+  AddCollector(ts, "mean_nocas_women_high_sb", mean_nocas_women_high_sb);
 
   // AM: Define how to compute mean number of casual partners for HIV infected
   // females with high-risk sociobehaviours
@@ -407,16 +480,14 @@ void DefineAndRegisterCollectors() {
     return (!person->IsHealthy() && person->IsFemale() && person->IsAdult() &&
             person->age_ < 50 && person->HasHighRiskSocioBehav());
   };
-  ts->AddCollector("adult_hiv_female_age_lt50_high_sb",
-                   new Counter<double>(adult_hiv_female_age_lt50_high_sb),
-                   get_year);
+  AddCollector(ts, "adult_hiv_female_age_lt50_high_sb",
+               new Counter<double>(adult_hiv_female_age_lt50_high_sb));
 
   // Sum all casual partners for adult_hiv_female_age_lt50_high_sb
-  ts->AddCollector(
-      "total_nocas_hiv_women_high_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_hiv_female_age_lt50_high_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_hiv_women_high_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_hiv_female_age_lt50_high_sb));
 
   auto mean_nocas_hiv_women_high_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -424,8 +495,8 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_hiv_female_age_lt50_high_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_hiv_women_high_sb", mean_nocas_hiv_women_high_sb,
-                   get_year);
+  AddCollector(ts, "mean_nocas_hiv_women_high_sb",
+               mean_nocas_hiv_women_high_sb);
 
   // AM: Define how to compute mean number of casual partners for HIV infected
   // females with high-risk sociobehaviours
@@ -437,16 +508,14 @@ void DefineAndRegisterCollectors() {
     return (!person->IsHealthy() && person->IsFemale() && person->IsAdult() &&
             person->age_ < 50 && person->HasLowRiskSocioBehav());
   };
-  ts->AddCollector("adult_hiv_female_age_lt50_low_sb",
-                   new Counter<double>(adult_hiv_female_age_lt50_low_sb),
-                   get_year);
+  AddCollector(ts, "adult_hiv_female_age_lt50_low_sb",
+               new Counter<double>(adult_hiv_female_age_lt50_low_sb));
 
   // Sum all casual partners for adult_hiv_female_age_lt50_low_sb
-  ts->AddCollector(
-      "total_nocas_hiv_women_low_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_hiv_female_age_lt50_low_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_hiv_women_low_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_hiv_female_age_lt50_low_sb));
 
   auto mean_nocas_hiv_women_low_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -454,8 +523,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_hiv_female_age_lt50_low_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_hiv_women_low_sb", mean_nocas_hiv_women_low_sb,
-                   get_year);
+  AddCollector(ts, "mean_nocas_hiv_women_low_sb", mean_nocas_hiv_women_low_sb);
 
   // AM: Define how to compute mean number of casual partners for HIV infected
   // males with high-risk sociobehaviours
@@ -467,16 +535,14 @@ void DefineAndRegisterCollectors() {
     return (!person->IsHealthy() && person->IsMale() && person->IsAdult() &&
             person->age_ < 50 && person->HasHighRiskSocioBehav());
   };
-  ts->AddCollector("adult_hiv_male_age_lt50_high_sb",
-                   new Counter<double>(adult_hiv_male_age_lt50_high_sb),
-                   get_year);
+  AddCollector(ts, "adult_hiv_male_age_lt50_high_sb",
+               new Counter<double>(adult_hiv_male_age_lt50_high_sb));
 
   // Sum all casual partners for adult_hiv_male_age_lt50_high_sb
-  ts->AddCollector(
-      "total_nocas_hiv_men_high_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_hiv_male_age_lt50_high_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_hiv_men_high_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_hiv_male_age_lt50_high_sb));
 
   auto mean_nocas_hiv_men_high_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -484,8 +550,7 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_hiv_male_age_lt50_high_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_hiv_men_high_sb", mean_nocas_hiv_men_high_sb,
-                   get_year);
+  AddCollector(ts, "mean_nocas_hiv_men_high_sb", mean_nocas_hiv_men_high_sb);
 
   // AM: Define how to compute mean number of casual partners for HIV infected
   // males with low-risk sociobehaviours
@@ -497,16 +562,14 @@ void DefineAndRegisterCollectors() {
     return (!person->IsHealthy() && person->IsMale() && person->IsAdult() &&
             person->age_ < 50 && person->HasLowRiskSocioBehav());
   };
-  ts->AddCollector("adult_hiv_male_age_lt50_low_sb",
-                   new Counter<double>(adult_hiv_male_age_lt50_low_sb),
-                   get_year);
+  AddCollector(ts, "adult_hiv_male_age_lt50_low_sb",
+               new Counter<double>(adult_hiv_male_age_lt50_low_sb));
 
   // Sum all casual partners for adult_hiv_male_age_lt50_low_sb
-  ts->AddCollector(
-      "total_nocas_hiv_men_low_sb",
-      new GenericReducer<uint64_t, double>(sum_casual_partners, sum_tl_results,
-                                           adult_hiv_male_age_lt50_low_sb),
-      get_year);
+  AddCollector(ts, "total_nocas_hiv_men_low_sb",
+               new GenericReducer<uint64_t, double>(
+                   sum_casual_partners, sum_tl_results,
+                   adult_hiv_male_age_lt50_low_sb));
 
   auto mean_nocas_hiv_men_low_sb = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -514,137 +577,19 @@ void DefineAndRegisterCollectors() {
     auto agents = ts->GetYValues("adult_hiv_male_age_lt50_low_sb").back();
     return num_casual / agents;
   };
-  ts->AddCollector("mean_nocas_hiv_men_low_sb", mean_nocas_hiv_men_low_sb,
-                   get_year);
-
-  // AM: Define how to compute general prevalence
-  auto pct_prevalence = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_agents").back();
-    return infected / sim->GetResourceManager()->GetNumAgents();
-  };
-  ts->AddCollector("prevalence", pct_prevalence, get_year);
-
-  // AM: Define how to compute prevalence between 15 and 49 year olds
-  auto infected_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return !(person->IsHealthy()) && person->age_ >= 15 && person->age_ < 50;
-  };
-  ts->AddCollector("infected_15_49", new Counter<double>(infected_15_49),
-                   get_year);
-
-  auto all_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->age_ >= 15 && person->age_ < 50;
-  };
-  ts->AddCollector("all_15_49", new Counter<double>(all_15_49), get_year);
-
-  auto pct_prevalence_15_49 = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_15_49").back();
-    auto all = ts->GetYValues("all_15_49").back();
-    return infected / all;
-  };
-  ts->AddCollector("prevalence_15_49", pct_prevalence_15_49, get_year);
-
-  // AM: Define how to compute prevalence among women
-  auto infected_females = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return !(person->IsHealthy()) && person->IsFemale();
-  };
-  ts->AddCollector("infected_females", new Counter<double>(infected_females),
-                   get_year);
-
-  auto females = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->IsFemale();
-  };
-  ts->AddCollector("females", new Counter<double>(females), get_year);
-
-  auto pct_prevalence_females = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_females").back();
-    auto all = ts->GetYValues("females").back();
-    return infected / all;
-  };
-  ts->AddCollector("prevalence_females", pct_prevalence_females, get_year);
-
-  // AM: Define how to compute prevalence among women between 15 and 49
-  auto infected_women_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return !(person->IsHealthy()) && person->IsFemale() && person->age_ >= 15 &&
-           person->age_ < 50;
-  };
-  ts->AddCollector("infected_women_15_49",
-                   new Counter<double>(infected_women_15_49), get_year);
-
-  auto women_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->IsFemale() && person->age_ >= 15 && person->age_ < 50;
-  };
-  ts->AddCollector("women_15_49", new Counter<double>(women_15_49), get_year);
-
-  auto pct_prevalence_women_15_49 = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_women_15_49").back();
-    auto all = ts->GetYValues("women_15_49").back();
-    return infected / all;
-  };
-  ts->AddCollector("prevalence_women_15_49", pct_prevalence_women_15_49,
-                   get_year);
-
-  // AM: Define how to compute prevalence among men
-  auto infected_males = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return !(person->IsHealthy()) && person->IsMale();
-  };
-  ts->AddCollector("infected_males", new Counter<double>(infected_males),
-                   get_year);
-
-  auto males = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->IsMale();
-  };
-  ts->AddCollector("males", new Counter<double>(males), get_year);
-
-  auto pct_prevalence_males = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_males").back();
-    auto all = ts->GetYValues("males").back();
-    return infected / all;
-  };
-  ts->AddCollector("prevalence_males", pct_prevalence_males, get_year);
-
-  // AM: Define how to compute prevalence among men between 15 and 49
-  auto infected_men_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return !(person->IsHealthy()) && person->IsMale() && person->age_ >= 15 &&
-           person->age_ < 50;
-  };
-  ts->AddCollector("infected_men_15_49",
-                   new Counter<double>(infected_men_15_49), get_year);
-
-  auto men_15_49 = [](Agent* a) {
-    auto* person = bdm_static_cast<Person*>(a);
-    return person->IsMale() && person->age_ >= 15 && person->age_ < 50;
-  };
-  ts->AddCollector("men_15_49", new Counter<double>(men_15_49), get_year);
-
-  auto pct_prevalence_men_15_49 = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto infected = ts->GetYValues("infected_men_15_49").back();
-    auto all = ts->GetYValues("men_15_49").back();
-    return infected / all;
-  };
-  ts->AddCollector("prevalence_men_15_49", pct_prevalence_men_15_49, get_year);
+  AddCollector(ts, "mean_nocas_hiv_men_low_sb", mean_nocas_hiv_men_low_sb);
 
-  // AM: Define how to compute general incidence
-  auto pct_incidence = [](Simulation* sim) {
-    auto* ts = sim->GetTimeSeries();
-    auto acute = ts->GetYValues("acute_agents").back();
-    return acute / sim->GetResourceManager()->GetNumAgents();
-  };
-  ts->AddCollector("incidence", pct_incidence, get_year);
+  // AM: Prevalence and incidence. These hot statistics share a single pass
+  // over the agents (see GetHotStatistic). Pipelined, they are computed from
+  // the snapshots taken by the CaptureStatistics operation instead and added
+  // to the TimeSeries at the end of the simulation (see
+  // PlotAndSaveTimeseries).
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (sparam->pipelined_statistics && env != nullptr) {
+    env->GetStatisticsPipeline().Enable();
+  } else {
+    AddHotCollectors(ts, std::make_index_sequence<kNumHotStatistics>());
+  }
 
   // AM: Define how to compute proportion of people with high-risk
   // socio-beahviours among hiv+
@@ -652,8 +597,7 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->HasHighRiskSocioBehav() and !(person->IsHealthy());
   };
-  ts->AddCollector("high_risk_hiv", new Counter<double>(high_risk_hiv),
-                   get_year);
+  AddCollector(ts, "high_risk_hiv", new Counter<double>(high_risk_hiv));
 
   auto pct_high_risk_hiv = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -661,7 +605,7 @@ void DefineAndRegisterCollectors() {
     auto infected = ts->GetYValues("infected_agents").back();
     return high_risk_hiv / infected;
   };
-  ts->AddCollector("high_risk_sb_hiv", pct_high_risk_hiv, get_year);
+  AddCollector(ts, "high_risk_sb_hiv", pct_high_risk_hiv);
 
   // AM: Define how to compute proportion of people with low-risk
   // socio-beahviours among hiv+
@@ -669,7 +613,7 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->HasLowRiskSocioBehav() and !(person->IsHealthy());
   };
-  ts->AddCollector("low_risk_hiv", new Counter<double>(low_risk_hiv), get_year);
+  AddCollector(ts, "low_risk_hiv", new Counter<double>(low_risk_hiv));
 
   auto pct_low_risk_hiv = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -677,7 +621,7 @@ void DefineAndRegisterCollectors() {
     auto infected = ts->GetYValues("infected_agents").back();
     return low_risk_hiv / infected;
   };
-  ts->AddCollector("low_risk_sb_hiv", pct_low_risk_hiv, get_year);
+  AddCollector(ts, "low_risk_sb_hiv", pct_low_risk_hiv);
 
   // AM: Define how to compute proportion of people with high-risk
   // socio-beahviours among healthy
@@ -685,8 +629,7 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->HasHighRiskSocioBehav() and person->IsHealthy();
   };
-  ts->AddCollector("high_risk_healthy", new Counter<double>(high_risk_healthy),
-                   get_year);
+  AddCollector(ts, "high_risk_healthy", new Counter<double>(high_risk_healthy));
 
   auto pct_high_risk_healthy = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -694,7 +637,7 @@ void DefineAndRegisterCollectors() {
     auto healthy = ts->GetYValues("healthy_agents").back();
     return high_risk_healthy / healthy;
   };
-  ts->AddCollector("high_risk_sb_healthy", pct_high_risk_healthy, get_year);
+  AddCollector(ts, "high_risk_sb_healthy", pct_high_risk_healthy);
 
   // AM: Define how to compute proportion of people with low-risk
   // socio-beahviours among healthy
@@ -702,8 +645,7 @@ void DefineAndRegisterCollectors() {
     auto* person = bdm_static_cast<Person*>(a);
     return person->HasLowRiskSocioBehav() and person->IsHealthy();
   };
-  ts->AddCollector("low_risk_healthy", new Counter<double>(low_risk_healthy),
-                   get_year);
+  AddCollector(ts, "low_risk_healthy", new Counter<double>(low_risk_healthy));
 
   auto pct_low_risk_healthy = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
@@ -711,7 +653,7 @@ void DefineAndRegisterCollectors() {
     auto healthy = ts->GetYValues("healthy_agents").back();
     return low_risk_healthy / healthy;
   };
-  ts->AddCollector("low_risk_sb_healthy", pct_low_risk_healthy, get_year);
+  AddCollector(ts, "low_risk_sb_healthy", pct_low_risk_healthy);
 
   // AM: Define how to compute proportion of high-risk socio-beahviours among
   // hiv adult women
@@ -720,21 +662,21 @@ void DefineAndRegisterCollectors() {
     return person->HasHighRiskSocioBehav() and !(person->IsHealthy()) and
            person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("high_risk_hiv_women",
-                   new Counter<double>(high_risk_hiv_women), get_year);
+  AddCollector(ts, "high_risk_hiv_women",
+               new Counter<double>(high_risk_hiv_women));
 
   auto hiv_women = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return !(person->IsHealthy()) and person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("hiv_women", new Counter<double>(hiv_women), get_year);
+  AddCollector(ts, "hiv_women", new Counter<double>(hiv_women));
 
   auto pct_high_risk_hiv_women = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("high_risk_hiv_women").back() /
            ts->GetYValues("hiv_women").back();
   };
-  ts->AddCollector("high_risk_sb_hiv_women", pct_high_risk_hiv_women, get_year);
+  AddCollector(ts, "high_risk_sb_hiv_women", pct_high_risk_hiv_women);
 
   // AM: Define how to compute proportion of low-risk socio-beahviours among hiv
   // adult women
@@ -743,15 +685,15 @@ void DefineAndRegisterCollectors() {
     return person->HasLowRiskSocioBehav() and !(person->IsHealthy()) and
            person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("low_risk_hiv_women",
-                   new Counter<double>(low_risk_hiv_women), get_year);
+  AddCollector(ts, "low_risk_hiv_women",
+               new Counter<double>(low_risk_hiv_women));
 
   auto pct_low_risk_hiv_women = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("low_risk_hiv_women").back() /
            ts->GetYValues("hiv_women").back();
   };
-  ts->AddCollector("low_risk_sb_hiv_women", pct_low_risk_hiv_women, get_year);
+  AddCollector(ts, "low_risk_sb_hiv_women", pct_low_risk_hiv_women);
 
   // AM: Define how to compute proportion of high-risk socio-beahviours among
   // hiv adult men
@@ -760,21 +702,20 @@ void DefineAndRegisterCollectors() {
     return person->HasHighRiskSocioBehav() and !(person->IsHealthy()) and
            person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("high_risk_hiv_men", new Counter<double>(high_risk_hiv_men),
-                   get_year);
+  AddCollector(ts, "high_risk_hiv_men", new Counter<double>(high_risk_hiv_men));
 
   auto hiv_men = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return !(person->IsHealthy()) and person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("hiv_men", new Counter<double>(hiv_men), get_year);
+  AddCollector(ts, "hiv_men", new Counter<double>(hiv_men));
 
   auto pct_high_risk_hiv_men = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("high_risk_hiv_men").back() /
            ts->GetYValues("hiv_men").back();
   };
-  ts->AddCollector("high_risk_sb_hiv_men", pct_high_risk_hiv_men, get_year);
+  AddCollector(ts, "high_risk_sb_hiv_men", pct_high_risk_hiv_men);
 
   // AM: Define how to compute proportion of low-risk socio-beahviours among hiv
   // adult men
@@ -783,15 +724,14 @@ void DefineAndRegisterCollectors() {
     return person->HasLowRiskSocioBehav() and !(person->IsHealthy()) and
            person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("low_risk_hiv_men", new Counter<double>(low_risk_hiv_men),
-                   get_year);
+  AddCollector(ts, "low_risk_hiv_men", new Counter<double>(low_risk_hiv_men));
 
   auto pct_low_risk_hiv_men = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("low_risk_hiv_men").back() /
            ts->GetYValues("hiv_men").back();
   };
-  ts->AddCollector("low_risk_sb_hiv_men", pct_low_risk_hiv_men, get_year);
+  AddCollector(ts, "low_risk_sb_hiv_men", pct_low_risk_hiv_men);
 
   // AM: Define how to compute proportion of high-risk socio-beahviours among
   // healthy adult women
@@ -800,23 +740,21 @@ void DefineAndRegisterCollectors() {
     return person->HasHighRiskSocioBehav() and person->IsHealthy() and
            person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("high_risk_healthy_women",
-                   new Counter<double>(high_risk_healthy_women), get_year);
+  AddCollector(ts, "high_risk_healthy_women",
+               new Counter<double>(high_risk_healthy_women));
 
   auto healthy_women = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsHealthy() and person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("healthy_women", new Counter<double>(healthy_women),
-                   get_year);
+  AddCollector(ts, "healthy_women", new Counter<double>(healthy_women));
 
   auto pct_high_risk_healthy_women = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("high_risk_healthy_women").back() /
            ts->GetYValues("healthy_women").back();
   };
-  ts->AddCollector("high_risk_sb_healthy_women", pct_high_risk_healthy_women,
-                   get_year);
+  AddCollector(ts, "high_risk_sb_healthy_women", pct_high_risk_healthy_women);
 
   // AM: Define how to compute proportion of low-risk socio-beahviours among
   // healthy adult women
@@ -825,16 +763,15 @@ void DefineAndRegisterCollectors() {
     return person->HasLowRiskSocioBehav() and person->IsHealthy() and
            person->IsAdult() and person->IsFemale();
   };
-  ts->AddCollector("low_risk_healthy_women",
-                   new Counter<double>(low_risk_healthy_women), get_year);
+  AddCollector(ts, "low_risk_healthy_women",
+               new Counter<double>(low_risk_healthy_women));
 
   auto pct_low_risk_healthy_women = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("low_risk_healthy_women").back() /
            ts->GetYValues("healthy_women").back();
   };
-  ts->AddCollector("low_risk_sb_healthy_women", pct_low_risk_healthy_women,
-                   get_year);
+  AddCollector(ts, "low_risk_sb_healthy_women", pct_low_risk_healthy_women);
 
   // AM: Define how to compute proportion of high-risk socio-beahviours among
   // healthy adult men
@@ -843,22 +780,21 @@ void DefineAndRegisterCollectors() {
     return person->HasHighRiskSocioBehav() and person->IsHealthy() and
            person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("high_risk_healthy_men",
-                   new Counter<double>(high_risk_healthy_men), get_year);
+  AddCollector(ts, "high_risk_healthy_men",
+               new Counter<double>(high_risk_healthy_men));
 
   auto healthy_men = [](Agent* a) {
     auto* person = bdm_static_cast<Person*>(a);
     return person->IsHealthy() and person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("healthy_men", new Counter<double>(healthy_men), get_year);
+  AddCollector(ts, "healthy_men", new Counter<double>(healthy_men));
 
   auto pct_high_risk_healthy_men = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("high_risk_healthy_men").back() /
            ts->GetYValues("healthy_men").back();
   };
-  ts->AddCollector("high_risk_sb_healthy_men", pct_high_risk_healthy_men,
-                   get_year);
+  AddCollector(ts, "high_risk_sb_healthy_men", pct_high_risk_healthy_men);
 
   // AM: Define how to compute proportion of low-risk socio-beahviours among
   // healthy adult men
@@ -867,26 +803,124 @@ void DefineAndRegisterCollectors() {
     return person->HasLowRiskSocioBehav() and person->IsHealthy() and
            person->IsAdult() and person->IsMale();
   };
-  ts->AddCollector("low_risk_healthy_men",
-                   new Counter<double>(low_risk_healthy_men), get_year);
+  AddCollector(ts, "low_risk_healthy_men",
+               new Counter<double>(low_risk_healthy_men));
 
   auto pct_low_risk_healthy_men = [](Simulation* sim) {
     auto* ts = sim->GetTimeSeries();
     return ts->GetYValues("low_risk_healthy_men").back() /
            ts->GetYValues("healthy_men").back();
   };
-  ts->AddCollector("low_risk_sb_healthy_men", pct_low_risk_healthy_men,
-                   get_year);
+  AddCollector(ts, "low_risk_sb_healthy_men", pct_low_risk_healthy_men);
+
+  // Partnership history statistics. All three collectors share one pass over
+  // the partnership history per year (see GetPartnershipStatistics).
+  auto mean_lifetime_partners = [](Simulation* sim) {
+    return GetPartnershipStatistics(sim).mean_lifetime_partners;
+  };
+  AddCollector(ts, "mean_lifetime_partners", mean_lifetime_partners);
+
+  auto concurrency_prevalence = [](Simulation* sim) {
+    return GetPartnershipStatistics(sim).concurrency_prevalence;
+  };
+  AddCollector(ts, "concurrency_prevalence", concurrency_prevalence);
+
+  auto mean_regular_age_gap = [](Simulation* sim) {
+    return GetPartnershipStatistics(sim).mean_regular_age_gap;
+  };
+  AddCollector(ts, "mean_regular_age_gap", mean_regular_age_gap);
+
+  // Household statistics. The households are built (and the statistics
+  // computed in a single pass over all households) at the beginning of the
+  // year.
+  auto households = [](Simulation* sim) {
+    return static_cast<double>(GetHouseholdStatistics(sim).no_households);
+  };
+  AddCollector(ts, "households", households);
+
+  auto mean_household_size = [](Simulation* sim) {
+    return GetHouseholdStatistics(sim).mean_household_size;
+  };
+  AddCollector(ts, "mean_household_size", mean_household_size);
+
+  auto serodiscordant_households = [](Simulation* sim) {
+    return static_cast<double>(
+        GetHouseholdStatistics(sim).no_serodiscordant_households);
+  };
+  AddCollector(ts, "serodiscordant_households", serodiscordant_households);
+
+  auto orphans = [](Simulation* sim) {
+    return static_cast<double>(GetHouseholdStatistics(sim).no_orphans);
+  };
+  AddCollector(ts, "orphans", orphans);
+
+  // Children stored as ChildRecords with their mothers. These children are not
+  // included in the agent counters above.
+  if (sparam->compress_children) {
+    auto sum_child_records = [](Agent* agent, uint64_t* tl_result) {
+      *tl_result += bdm_static_cast<Person*>(agent)->child_records_.size();
+    };
+    auto is_female = [](Agent* agent) {
+      return bdm_static_cast<Person*>(agent)->IsFemale();
+    };
+    AddCollector(ts, "compressed_children",
+                 new GenericReducer<uint64_t, double>(
+                     sum_child_records, sum_tl_results, is_female));
+  }
+
+  // Number of births in the current year
+  auto births = [](Simulation* sim) {
+    auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+    return env == nullptr
+               ? 0.0
+               : static_cast<double>(env->GetBirths().GetNumBirths());
+  };
+  AddCollector(ts, "births", births);
+
+  // Assisted partner notification: partners notified and partners that started
+  // treatment in the current year
+  if (sparam->partner_notification) {
+    auto partners_notified = [](Simulation* sim) {
+      auto* env =
+          bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+      return static_cast<double>(
+          env->GetPartnerNotification().GetNumNotified());
+    };
+    AddCollector(ts, "partners_notified", partners_notified);
+
+    auto partners_treated = [](Simulation* sim) {
+      auto* env =
+          bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+      return static_cast<double>(env->GetPartnerNotification().GetNumTreated());
+    };
+    AddCollector(ts, "partners_treated_after_notification", partners_treated);
+  }
 }
 
+
 // -----------------------------------------------------------------------------
 int PlotAndSaveTimeseries() {
   // Get pointers for simulation and TimeSeries data
   auto sim = Simulation::GetActive();
   auto* ts = sim->GetTimeSeries();
 
-  // Save the TimeSeries Data as JSON to the folder <date_time>
-  ts->SaveJson(Concat(sim->GetOutputDir(), "/data.json"));
+  // Add the pipelined agent statistics once the last snapshot is evaluated
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env != nullptr && !env->GetStatisticsPipeline().IsEmpty()) {
+    env->GetAsyncWriter().Flush();
+    const auto& pipeline = env->GetStatisticsPipeline();
+    for (size_t i = 0; i < pipeline.GetNumStatistics(); i++) {
+      ts->Add(pipeline.GetId(i), pipeline.GetXValues(),
+              pipeline.GetYValues(i));
+    }
+  }
+
+  // Save the TimeSeries Data as JSON to the folder <date_time>. The JSON is
+  // written on an I/O thread while the graphs below are drawn; both only read
+  // the TimeSeries.
+  AsyncWriter writer;
+  std::string json_file = Concat(sim->GetOutputDir(), "/data.json");
+  writer.Submit([ts, json_file]() { ts->SaveJson(json_file); }, 0);
 
   // Create a bdm LineGraph that visualizes the TimeSeries data
   bdm::experimental::LineGraph g(ts, "Population - Healthy/Infected", "Time",
@@ -1079,6 +1113,8 @@ int PlotAndSaveTimeseries() {
   g6.SaveAs(Concat(sim->GetOutputDir(), "/simulation_casual_mating_total"),
             {".svg", ".png"});
 
+  writer.Flush();
+
   // Print info for user to let him/her know where to find simulation results
   std::string info =
       Concat("<PlotAndSaveTimeseries> ", "Results of simulation were saved to ",
@@ -1088,5 +1124,68 @@ int PlotAndSaveTimeseries() {
   return 0;
 }
 
+// -----------------------------------------------------------------------------
+void AddToAggregator(EnsembleAggregator* aggregator) {
+  auto* sim = Simulation::GetActive();
+  auto* ts = sim->GetTimeSeries();
+
+  for (const auto& id : GetCollectorIds()) {
+    aggregator->Add(id, ts->GetXValues(id), ts->GetYValues(id));
+  }
+  // Pipelined statistics, once the last snapshot is evaluated
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env != nullptr && !env->GetStatisticsPipeline().IsEmpty()) {
+    env->GetAsyncWriter().Flush();
+    const auto& pipeline = env->GetStatisticsPipeline();
+    for (size_t i = 0; i < pipeline.GetNumStatistics(); i++) {
+      aggregator->Add(pipeline.GetId(i), pipeline.GetXValues(),
+                      pipeline.GetYValues(i));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+bool GetCollectedValue(const std::string& id, double x, double* value) {
+  auto* sim = Simulation::GetActive();
+  auto find = [&](const std::vector<double>& x_values,
+                  const std::vector<double>& y_values) {
+    for (size_t i = x_values.size(); i-- > 0;) {
+      if (x_values[i] == x && i < y_values.size()) {
+        *value = y_values[i];
+        return true;
+      }
+    }
+    return false;
+  };
+
+  const auto& ids = GetCollectorIds();
+  if (std::find(ids.begin(), ids.end(), id) != ids.end()) {
+    auto* ts = sim->GetTimeSeries();
+    return find(ts->GetXValues(id), ts->GetYValues(id));
+  }
+  auto* env = dynamic_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  if (env == nullptr || env->GetStatisticsPipeline().IsEmpty()) {
+    return false;
+  }
+  env->GetAsyncWriter().Flush();
+  const auto& pipeline = env->GetStatisticsPipeline();
+  for (size_t i = 0; i < pipeline.GetNumStatistics(); i++) {
+    if (pipeline.GetId(i) == id) {
+      return find(pipeline.GetXValues(), pipeline.GetYValues(i));
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+void AddToEnsemble(const std::string& filename) {
+  EnsembleAggregator aggregator;
+  AddToAggregator(&aggregator);
+  if (!aggregator.AddToFile(filename)) {
+    Log::Warning("AddToEnsemble()", "Cannot add the time series to ",
+                 filename);
+  }
+}
+
 }  // namespace hiv_malawi
 }  // namespace bdm
@@ -13,8 +13,10 @@
 #ifndef VISUALIZE_H_
 #define VISUALIZE_H_
 
+#include <string>
 #include <vector>
 #include "datatypes.h"
+#include "ensemble-aggregator.h"
 
 namespace bdm {
 namespace hiv_malawi {
@@ -27,6 +29,18 @@ void DefineAndRegisterCollectors();
 // simulation, saves the results as a JSON file, and plots the results.
 int PlotAndSaveTimeseries();
 
+// Adds the collected time series of the active simulation to the aggregator
+void AddToAggregator(EnsembleAggregator* aggregator);
+
+// Retrieves the value of the collected series id (a collector of the
+// TimeSeries or a pipelined statistic) for the given x value (year). Returns
+// false if the series does not exist or has no value for x yet.
+bool GetCollectedValue(const std::string& id, double x, double* value);
+
+// Adds the collected time series of the active simulation to the ensemble
+// aggregate in the given file (see EnsembleAggregator).
+void AddToEnsemble(const std::string& filename);
+
 }  // namespace hiv_malawi
 }  // namespace bdm
 
@@ -0,0 +1,82 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "async-writer.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+AsyncWriter::~AsyncWriter() {
+  {
+    std::lock_guard<std::mutex> lock(sync_->mutex);
+    stop_ = true;
+  }
+  sync_->cv.notify_all();
+  if (sync_->thread.joinable()) {
+    sync_->thread.join();
+  }
+}
+
+void AsyncWriter::Submit(std::function<void()> job, uint64_t bytes) {
+  std::unique_lock<std::mutex> lock(sync_->mutex);
+  if (!sync_->thread.joinable()) {
+    sync_->thread = std::thread(&AsyncWriter::Run, this);
+  }
+  // Backpressure: wait until the I/O thread caught up
+  sync_->cv.wait(lock, [&]() {
+    return queue_.empty() || pending_bytes_ + bytes <= max_pending_bytes_;
+  });
+  queue_.emplace_back(std::move(job), bytes);
+  pending_bytes_ += bytes;
+  sync_->cv.notify_all();
+}
+
+void AsyncWriter::Flush() {
+  std::unique_lock<std::mutex> lock(sync_->mutex);
+  sync_->cv.wait(lock, [this]() { return queue_.empty(); });
+}
+
+void AsyncWriter::ResetAfterFork() {
+  // The handles refer to the thread and the waiters of the parent. Destroying
+  // a joinable thread terminates the process, and the mutex may be locked by
+  // a thread that does not exist in the child, hence they are leaked.
+  static_cast<void>(sync_.release());
+  sync_.reset(new Sync());
+  queue_.clear();
+  pending_bytes_ = 0;
+  stop_ = false;
+}
+
+uint64_t AsyncWriter::GetPendingBytes() {
+  std::lock_guard<std::mutex> lock(sync_->mutex);
+  return pending_bytes_;
+}
+
+void AsyncWriter::Run() {
+  std::unique_lock<std::mutex> lock(sync_->mutex);
+  while (true) {
+    sync_->cv.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    auto& job = queue_.front().first;
+    lock.unlock();
+    job();
+    lock.lock();
+    pending_bytes_ -= queue_.front().second;
+    queue_.pop_front();
+    sync_->cv.notify_all();
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
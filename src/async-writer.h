@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef ASYNC_WRITER_H_
+#define ASYNC_WRITER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Dedicated I/O thread for output that would otherwise stall the simulation
+// between iterations. The simulation hands over jobs that own their (filled)
+// buffers; the jobs encode and write them in submission order while the next
+// simulation step runs. The memory held by pending jobs is bounded: Submit()
+// blocks while the announced buffer sizes exceed max_pending_bytes, unless the
+// queue is empty (such that a single large buffer cannot dead-lock).
+class AsyncWriter {
+ public:
+  explicit AsyncWriter(uint64_t max_pending_bytes = uint64_t(1) << 30)
+      : max_pending_bytes_(max_pending_bytes), sync_(new Sync()) {}
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  // Queue a job that holds buffers of the given size. The thread is started
+  // at the first call.
+  void Submit(std::function<void()> job, uint64_t bytes);
+
+  // Wait until all submitted jobs are finished
+  void Flush();
+
+  // Memory held by jobs that are queued or running
+  uint64_t GetPendingBytes();
+
+  // Reset the writer in a process that was forked after the I/O thread was
+  // started. The thread does not exist in the child and is restarted at the
+  // next Submit. The parent must Flush before the fork. The thread handle and
+  // the synchronisation objects of the parent are abandoned (never destroyed)
+  // and replaced by new ones.
+  void ResetAfterFork();
+
+ private:
+  uint64_t max_pending_bytes_;
+  uint64_t pending_bytes_ = 0;
+  // Jobs and their sizes. The front job stays in the queue while it runs.
+  std::deque<std::pair<std::function<void()>, uint64_t>> queue_;
+  bool stop_ = false;
+  // The I/O thread and the objects it synchronises with. Held by pointer,
+  // such that a forked child can abandon those of the parent.
+  struct Sync {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  std::unique_ptr<Sync> sync_;
+
+  void Run();
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // ASYNC_WRITER_H_
@@ -13,8 +13,11 @@
 #ifndef BDM_SIMULAION_H_
 #define BDM_SIMULAION_H_
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "core/operation/operation_registry.h"
 #include "core/operation/reduction_op.h"
@@ -22,6 +25,7 @@
 #include "analyze.h"
 #include "categorical-environment.h"
 #include "custom-operations.h"
+#include "fork-replicates.h"
 #include "population-initialization.h"
 #include "sim-param.h"
 
@@ -41,6 +45,12 @@ inline int Simulate(int argc, const char** argv) {
     param->show_simulation_step = 1;
     param->remove_output_dir_contents = false;
     param->statistics = true;
+    // Agents only modify themselves during the behaviour loop (see
+    // PartnershipIntents), hence no locking is required.
+    param->thread_safety_mechanism = Param::ThreadSafetyMechanism::kNone;
+    // Replace the default tables by those of the parameter table file (if
+    // any). The configuration files were read at this point.
+    param->Get<SimParam>()->LoadParameterTables();
   };
   Simulation simulation(argc, argv, set_param);
 
@@ -49,6 +59,9 @@ inline int Simulate(int argc, const char** argv) {
   // Get a pointer to an instance of SimParam
   auto* sparam = param->Get<SimParam>();
 
+  // Select the pages of the agent indexes before they are filled
+  SetHugePagePolicy(sparam->huge_pages);
+
   // AM: Construct Environment with numbers of age and socio-behavioral
   // categories.
   auto* env = new CategoricalEnvironment(
@@ -57,6 +70,9 @@ inline int Simulate(int argc, const char** argv) {
 
   simulation.SetEnvironment(env);
 
+  // Validate the parameters before the population is initialized
+  env->CompileParams(sparam);
+
   // Randomly initialize a population
   {
     Timing timer_init("RUNTIME POPULATION INITIALIZATION: ");
@@ -79,6 +95,181 @@ inline int Simulate(int argc, const char** argv) {
   auto* reset_casual_partners = NewOperation("ResetCasualPartners");
   scheduler->ScheduleOp(reset_casual_partners, OpType::kPreSchedule);
 
+  // Add an operation that writes a snapshot of the population at the
+  // beginning of each year, i.e. before the births
+  if (!sparam->snapshot_file.empty()) {
+    OperationRegistry::GetInstance()->AddOperationImpl(
+        "WriteSnapshot", OpComputeTarget::kCpu, new WriteSnapshot());
+    auto* write_snapshot = NewOperation("WriteSnapshot");
+    scheduler->ScheduleOp(write_snapshot, OpType::kPreSchedule);
+  }
+
+  // Add an operation that generates the births of each year. It runs before
+  // the behaviours, such that mothers can be protected in the year of birth.
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "GiveBirths", OpComputeTarget::kCpu, new GiveBirths());
+  auto* give_births = NewOperation("GiveBirths");
+  scheduler->ScheduleOp(give_births, OpType::kPreSchedule);
+
+  // Add an operation that resolves the partnership intents after the
+  // behaviours were executed
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "ResolvePartnershipIntents", OpComputeTarget::kCpu,
+      new ResolvePartnershipIntents());
+  auto* resolve_intents = NewOperation("ResolvePartnershipIntents");
+  scheduler->ScheduleOp(resolve_intents, OpType::kSchedule);
+
+  // Add an operation that traces the partners of newly treated agents. It is
+  // scheduled after the resolution of the partnership intents, such that
+  // deceased partners are not traced.
+  if (sparam->partner_notification) {
+    OperationRegistry::GetInstance()->AddOperationImpl(
+        "TracePartners", OpComputeTarget::kCpu, new TracePartners());
+    auto* trace_partners = NewOperation("TracePartners");
+    scheduler->ScheduleOp(trace_partners, OpType::kSchedule);
+  }
+
+  // Add an operation that hands a snapshot of the agents to the statistics
+  // pipeline at the end of each year. The statistics of the year are then
+  // computed while the environment of the next year is updated.
+  if (sparam->pipelined_statistics) {
+    OperationRegistry::GetInstance()->AddOperationImpl(
+        "CaptureStatistics", OpComputeTarget::kCpu, new CaptureStatistics());
+    auto* capture_statistics = NewOperation("CaptureStatistics");
+    scheduler->ScheduleOp(capture_statistics, OpType::kPostSchedule);
+  }
+
+  // Add an operation that transmits HIV in serodiscordant regular
+  // partnerships
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "RegularPartnershipTransmission", OpComputeTarget::kCpu,
+      new RegularPartnershipTransmission());
+  auto* regular_transmission =
+      NewOperation("RegularPartnershipTransmission");
+  scheduler->ScheduleOp(regular_transmission, OpType::kPreSchedule);
+
+  bool forked = sparam->fork_replicates > 0 ||
+                !sparam->scenario_timeline_files.empty() ||
+                sparam->smc_particles > 0;
+  if (forked && (!sparam->snapshot_file.empty() ||
+                 sparam->cohort_fraction > 0 ||
+                 sparam->collect_contact_matrices ||
+                 !sparam->partnership_history_spill_file.empty())) {
+    Log::Warning("Simulate()",
+                 "The forked simulations write their snapshots, cohort "
+                 "events, contact matrices, and partnership history to the "
+                 "same files.");
+  }
+
+  // Fit the simulation to the survey observations with a particle filter.
+  // Only the time series of the resampled particles are written.
+  if (sparam->smc_particles > 0) {
+    if (sparam->fork_replicates > 0 ||
+        !sparam->scenario_timeline_files.empty()) {
+      Log::Fatal("Simulate()",
+                 "smc_particles cannot be combined with fork_replicates or "
+                 "scenario_timeline_files");
+    }
+    std::vector<SurveyObservation> observations;
+    if (!ReadSurveyObservations(sparam->smc_survey_file, &observations) ||
+        observations.empty()) {
+      Log::Fatal("Simulate()", "Cannot read the survey observations from ",
+                 sparam->smc_survey_file);
+    }
+    env->AssignMothers();
+    EnsembleAggregator aggregator;
+    std::vector<ParticleFilterStep> steps;
+    uint64_t no_lost;
+    {
+      Timing timer_sim("RUNTIME");
+      no_lost = RunParticleFilter(
+          observations, sparam->smc_particles, sparam->number_of_iterations,
+          Concat(simulation.GetOutputDir(), "/particle-filter-ensemble.bin"),
+          &aggregator, &steps);
+    }
+    std::string bands_file =
+        Concat(simulation.GetOutputDir(), "/particle-filter-bands.csv");
+    if (!aggregator.WriteBands(bands_file,
+                               EnsembleAggregator::GetBandQuantiles())) {
+      Log::Warning("Simulate()", "Cannot write ", bands_file);
+    }
+    std::ofstream steps_file(
+        Concat(simulation.GetOutputDir(), "/particle-filter.csv"));
+    steps_file << "year,ess,log_evidence\n";
+    for (const auto& step : steps) {
+      steps_file << step.year << "," << step.ess << "," << step.log_evidence
+                 << "\n";
+    }
+    if (!sparam->ensemble_file.empty() &&
+        !aggregator.AddToFile(sparam->ensemble_file)) {
+      Log::Warning("Simulate()", "Cannot add the particles to ",
+                   sparam->ensemble_file);
+    }
+    return no_lost == 0 ? 0 : 1;
+  }
+
+  // Simulate the years before scenario_year once and continue each scenario
+  // from there. Only the time series of the scenarios are written.
+  if (!sparam->scenario_timeline_files.empty()) {
+    if (sparam->fork_replicates > 0) {
+      Log::Fatal("Simulate()",
+                 "scenario_timeline_files and fork_replicates cannot be "
+                 "combined");
+    }
+    uint64_t no_shared_iterations = static_cast<uint64_t>(std::min(
+        std::max(sparam->scenario_year - sparam->start_year, 0),
+        static_cast<int>(sparam->number_of_iterations)));
+    std::vector<EnsembleAggregator> aggregators;
+    uint64_t no_failed;
+    {
+      Timing timer_sim("RUNTIME");
+      scheduler->Simulate(no_shared_iterations);
+      no_failed = ForkScenarios(
+          sparam->scenario_timeline_files, sparam->fork_workers,
+          sparam->number_of_iterations - no_shared_iterations, &aggregators);
+    }
+    for (size_t i = 0; i < aggregators.size(); i++) {
+      std::string bands_file = Concat(simulation.GetOutputDir(), "/scenario-",
+                                      i, "-bands.csv");
+      if (!aggregators[i].WriteBands(bands_file,
+                                     EnsembleAggregator::GetBandQuantiles())) {
+        Log::Warning("Simulate()", "Cannot write ", bands_file);
+      }
+      std::string ensemble_file = Concat(sparam->ensemble_file, ".", i);
+      if (!sparam->ensemble_file.empty() &&
+          !aggregators[i].AddToFile(ensemble_file)) {
+        Log::Warning("Simulate()", "Cannot add scenario ", i, " to ",
+                     ensemble_file);
+      }
+    }
+    return no_failed == 0 ? 0 : 1;
+  }
+
+  // Simulate a batch of replicates that share the initial population. Only
+  // their aggregated time series are written.
+  if (sparam->fork_replicates > 0) {
+    env->AssignMothers();
+    EnsembleAggregator aggregator;
+    uint64_t no_failed;
+    {
+      Timing timer_sim("RUNTIME");
+      no_failed = ForkReplicates(sparam->fork_replicates, sparam->fork_workers,
+                                 sparam->number_of_iterations, &aggregator);
+    }
+    std::string bands_file =
+        Concat(simulation.GetOutputDir(), "/ensemble-bands.csv");
+    if (!aggregator.WriteBands(bands_file,
+                               EnsembleAggregator::GetBandQuantiles())) {
+      Log::Warning("Simulate()", "Cannot write ", bands_file);
+    }
+    if (!sparam->ensemble_file.empty() &&
+        !aggregator.AddToFile(sparam->ensemble_file)) {
+      Log::Warning("Simulate()", "Cannot add the replicates to ",
+                   sparam->ensemble_file);
+    }
+    return no_failed == 0 ? 0 : 1;
+  }
+
   // Run simulation for <number_of_iterations> timesteps
   {
     Timing timer_sim("RUNTIME");
@@ -91,11 +282,12 @@ inline int Simulate(int argc, const char** argv) {
     // Generate ROOT plot to visualize the number of healthy and infected
     // individuals over time.
     PlotAndSaveTimeseries();
-  }
 
-  // DEBUG - AM - TO DO: Works only when selection depended soloely on locations
-  /*env->NormalizeMateLocationFrequencies();
-  env->PrintMateLocationFrequencies();*/
+    // Merge the time series into the aggregate of the ensemble
+    if (!sparam->ensemble_file.empty()) {
+      AddToEnsemble(sparam->ensemble_file);
+    }
+  }
 
   return 0;
 }
@@ -0,0 +1,227 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "births.h"
+
+#include <numeric>
+
+#include "categorical-environment.h"
+#include "person-behavior.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+int Births::GetAgeBand(float age, const SimParam* sparam) {
+  const auto& bands = sparam->fertility_age_bands;
+  if (age < sparam->min_age || age > sparam->max_age_birth || bands.empty() ||
+      age < bands[0]) {
+    return -1;
+  }
+  int band = 0;
+  while (band + 1 < static_cast<int>(bands.size()) && age >= bands[band + 1]) {
+    band++;
+  }
+  return band;
+}
+
+float Births::GetFertilityRate(int age_band, const SimParam* sparam) {
+  // Without fertility table, all women share the same probability
+  if (sparam->fertility_rates.empty()) {
+    return sparam->give_birth_probability;
+  }
+  return sparam->fertility_rates[age_band];
+}
+
+float Births::GetMTCTProbability(int mother_state,
+                                 const YearParams& year_params) {
+  if (mother_state == GemsState::kHealthy) {
+    return 0.0;
+  }
+  // AM: birth infection probability depends on whether mother is treated and
+  // current year
+  if (mother_state == GemsState::kTreated) {
+    return year_params.birth_infection_probability_treated;
+  }
+  if (year_params.art_era == 0 || mother_state == GemsState::kFailing) {
+    // AM: Mother is not healthy and not treated
+    return year_params.birth_infection_probability_untreated;
+  }
+  return year_params.birth_infection_probability_prophylaxis;
+}
+
+Person* Births::CreateChild(const Birth& birth, int year,
+                            const SimParam* sparam, Random* random) {
+  auto* mother = birth.mother;
+  Person* child = new Person();
+  child->cohort_id_ =
+      CohortTracker::GetChildId(mother->cohort_id_, year, mother->no_births_++);
+  child->sex_ = SampleSex(random->Uniform(), sparam->probability_male);
+  child->age_ = random->Uniform();
+  child->location_ = mother->location_;
+  child->social_behaviour_factor_ = 0;
+  child->biomedical_factor_ = 0;
+  child->state_ = GemsState::kHealthy;
+  if (birth.infected) {
+    child->BecomeInfected(TransmissionType::kMotherToChild, mother->state_,
+                          mother->social_behaviour_factor_);
+  }
+
+  AddBehaviours(child);
+  SelectForCohort(child, sparam);
+  if (birth.infected && child->tracked_) {
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(
+        Simulation::GetActive()->GetEnvironment());
+    env->GetCohortTracker().Record(child, CohortEventType::kEventInfection,
+                                   TransmissionType::kMotherToChild,
+                                   mother->state_);
+  }
+  return child;
+}
+
+void Births::SampleIndices(uint32_t no_items, uint32_t no_samples,
+                           Random* random, std::vector<uint32_t>* indices) {
+  indices->resize(no_items);
+  std::iota(indices->begin(), indices->end(), 0u);
+  for (uint32_t i = 0; i < no_samples; i++) {
+    // Integer(n) returns a value in [0, n - 1]
+    uint32_t j = i + random->Integer(no_items - i);
+    std::swap((*indices)[i], (*indices)[j]);
+  }
+}
+
+void Births::AddChildRecord(Person* mother, ChildRecord record) {
+  record.birth_order_ = static_cast<uint8_t>(mother->no_births_++);
+  mother->child_records_.push_back(record);
+}
+
+Person* Births::ExpandChildRecord(const ChildRecord& record,
+                                  uint64_t mother_cohort_id, int location,
+                                  int year, const SimParam* sparam,
+                                  Random* random) {
+  Person* child = new Person();
+  child->cohort_id_ = CohortTracker::GetChildId(
+      mother_cohort_id, record.birth_year_, record.birth_order_);
+  child->sex_ = record.sex_;
+  // The records store whole years, the fraction is drawn uniformly as for
+  // newborns.
+  child->age_ = (year - record.birth_year_) + random->Uniform();
+  child->location_ = location;
+  child->social_behaviour_factor_ = 0;
+  child->biomedical_factor_ = 0;
+  child->state_ = record.state_;
+  if (record.state_ != GemsState::kHealthy) {
+    child->transmission_type_ = TransmissionType::kMotherToChild;
+    child->infection_origin_state_ = record.infection_origin_state_;
+    child->infection_origin_sb_ = record.infection_origin_sb_;
+  }
+  // Children of compressed records can be older than min_age
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(
+      Simulation::GetActive()->GetEnvironment());
+  env->UpdateCompoundCategory(child);
+  AddBehaviours(child);
+  SelectForCohort(child, sparam);
+  return child;
+}
+
+void Births::AddBehaviours(Person* child) {
+  // BioDynaMo API: Add the behaviors to the Agent
+  child->AddBehavior(new RandomMigration());
+  if (child->sex_ == Sex::kMale) {
+    child->AddBehavior(new MatingBehaviour());
+    child->AddBehavior(new RegularPartnershipBehaviour());
+  }
+  child->AddBehavior(new GetOlder());
+}
+
+void Births::SelectForCohort(Person* child, const SimParam* sparam) {
+  if (sparam->cohort_fraction <= 0) {
+    return;
+  }
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(
+      Simulation::GetActive()->GetEnvironment());
+  env->GetCohortTracker().Select(child, sparam->cohort_fraction);
+}
+
+void Births::Generate(CategoricalEnvironment* env, const SimParam* sparam,
+                      Random* random, int year) {
+  // The sizes of fertility_rates and fertility_age_bands are validated by
+  // CompiledParams::Compile()
+  const size_t no_bands = sparam->fertility_age_bands.size();
+  const auto& year_params = env->GetCompiledParams().GetYearParams(year);
+
+  // Draw the number of births and infections at birth per stratum and select
+  // the mothers.
+  births_.clear();
+  for (size_t s = 0; s < env->GetNumMotherStrata(); s++) {
+    auto mothers = env->GetMothers(s);
+    uint32_t no_mothers = mothers.GetNumAgents();
+    if (no_mothers == 0) {
+      continue;
+    }
+    int age_band = (s / GemsState::kGemsLast) % no_bands;
+    int state = s % GemsState::kGemsLast;
+    uint32_t no_births =
+        random->Binomial(no_mothers, GetFertilityRate(age_band, sparam));
+    if (no_births == 0) {
+      continue;
+    }
+    float mtct_probability = GetMTCTProbability(state, year_params);
+    uint32_t no_infected = 0;
+    if (mtct_probability > 0) {
+      no_infected = random->Binomial(no_births, mtct_probability);
+    }
+
+    // Sample the mothers without replacement. The mothers are in random
+    // order, hence the first no_infected children are infected.
+    SampleIndices(no_mothers, no_births, random, &indices_);
+    for (uint32_t i = 0; i < no_births; i++) {
+      births_.push_back(
+          {mothers.GetAgentAtIndex(indices_[i]).Get(), i < no_infected});
+    }
+  }
+
+  // Create all newborns and link them to their mothers
+  auto* ctxt = Simulation::GetActive()->GetExecutionContext();
+  no_births_ = births_.size();
+  no_infected_ = 0;
+  for (const auto& birth : births_) {
+    // Protect mother from death.
+    if (sparam->protect_mothers_at_birth) {
+      birth.mother->LockProtection();
+    }
+    no_infected_ += birth.infected;
+    if (sparam->compress_children) {
+      auto* mother = birth.mother;
+      ChildRecord record{};
+      record.birth_year_ = year;
+      record.sex_ = SampleSex(random->Uniform(), sparam->probability_male);
+      record.state_ = GemsState::kHealthy;
+      record.infection_origin_state_ = 0;
+      record.infection_origin_sb_ = 0;
+      if (birth.infected) {
+        record.state_ = GemsState::kAcute;
+        record.infection_origin_state_ = mother->state_;
+        record.infection_origin_sb_ = mother->social_behaviour_factor_;
+      }
+      AddChildRecord(mother, record);
+      continue;
+    }
+    auto* child = CreateChild(birth, year, sparam, random);
+    // BioDynaMo API: The newborns join the simulation at the end of the step
+    ctxt->AddAgent(child);
+    child->mother_ = birth.mother->GetAgentPtr<Person>();
+    birth.mother->AddChild(child->GetAgentPtr<Person>());
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,106 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef BIRTHS_H_
+#define BIRTHS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "compiled-params.h"
+#include "person.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+class CategoricalEnvironment;
+
+// Category-level birth generation. Potential mothers are indexed by the
+// CategoricalEnvironment per (location, fertility age band, state) stratum.
+// Instead of one Bernoulli experiment per woman, the number of births per
+// stratum is drawn from a binomial distribution and the mothers are sampled
+// from the stratum without replacement. Since all mothers of a stratum share
+// the same state, the number of children infected at birth is also drawn
+// binomially per stratum. Finally, all newborns are created and linked to
+// their mothers in one batch. If sparam->compress_children is true, the
+// newborns are stored as ChildRecords with their mothers instead.
+class Births {
+ public:
+  // Returns the fertility age band of a woman of the given age, or -1 if she
+  // cannot give birth.
+  static int GetAgeBand(float age, const SimParam* sparam);
+
+  // Returns the annual probability to give birth for the given age band
+  static float GetFertilityRate(int age_band, const SimParam* sparam);
+
+  // Returns the probability that a mother in the given state infects her child
+  // at birth, given the parameters of the current year
+  static float GetMTCTProbability(int mother_state,
+                                  const YearParams& year_params);
+
+  // Sample no_samples of the indices 0 to no_items - 1 without replacement
+  // (partial Fisher-Yates shuffle). The sample is in random order and stored
+  // in the first no_samples entries of indices.
+  static void SampleIndices(uint32_t no_items, uint32_t no_samples,
+                            Random* random, std::vector<uint32_t>* indices);
+
+  // Store a child of the given mother as a ChildRecord. The birth order of
+  // the record is taken from the births of the mother (see
+  // Person::cohort_id_).
+  static void AddChildRecord(Person* mother, ChildRecord record);
+
+  // Create the Person agent of a compressed child in the given year. The
+  // caller adds the agent to the simulation and links it to its mother.
+  static Person* ExpandChildRecord(const ChildRecord& record,
+                                   uint64_t mother_cohort_id, int location,
+                                   int year, const SimParam* sparam,
+                                   Random* random);
+
+  // Generate the births of the current year. The newborns are added to the
+  // simulation at the end of the simulation step.
+  void Generate(CategoricalEnvironment* env, const SimParam* sparam,
+                Random* random, int year);
+
+  // Number of births and infections at birth in the last call of Generate()
+  uint64_t GetNumBirths() const { return no_births_; }
+  uint64_t GetNumInfectedAtBirth() const { return no_infected_; }
+
+ private:
+  // A selected mother and whether her child is infected at birth
+  struct Birth {
+    Person* mother;
+    bool infected;
+  };
+
+  // Buffers reused across the years to avoid reallocations
+  std::vector<Birth> births_;
+  std::vector<uint32_t> indices_;
+
+  uint64_t no_births_ = 0;
+  uint64_t no_infected_ = 0;
+
+  // Create a child of the given mother
+  static Person* CreateChild(const Birth& birth, int year,
+                             const SimParam* sparam, Random* random);
+
+  // Add the behaviours of a child agent
+  static void AddBehaviours(Person* child);
+
+  // Select the child for the cohort of the CohortTracker (if active)
+  static void SelectForCohort(Person* child, const SimParam* sparam);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // BIRTHS_H_
@@ -17,83 +17,21 @@
 namespace bdm {
 namespace hiv_malawi {
 
-////////////////////////////////////////////////////////////////////////////////
-// AgentVector
-////////////////////////////////////////////////////////////////////////////////
-AgentVector::AgentVector() {
-  auto* tinfo = ThreadInfo::GetInstance();
-  agents_.resize(tinfo->GetMaxThreads());
-  offsets_.resize(tinfo->GetMaxThreads() + 1);
-  size_ = 0;
-}
-
-AgentVector::AgentVector(const AgentVector& other)
-    : agents_(other.agents_),
-      offsets_(other.offsets_),
-      tinfo_(other.tinfo_),
-      size_(other.size_.load()),
-      dirty_(other.dirty_) {}
+namespace {
 
-AgentPointer<Person> AgentVector::GetRandomAgent() {
-  if (size_ == 0) {
-    Log::Fatal("AgentVector::GetRandomAgent()",
+// Random agent of a category of an index
+AgentPointer<Person> GetRandomAgent(AgentIndex::Category agents) {
+  if (agents.GetNumAgents() == 0) {
+    Log::Fatal("CategoricalEnvironment::GetRandomAgent()",
                "There are no agents available in one of your "
                "locations or compound categories. Consider increasing the "
                "number of Agents.");
   }
   auto* r = Simulation::GetActive()->GetRandom();
-  return GetAgentAtIndex(r->Integer(size_ - 1));
+  return agents.GetAgentAtIndex(r->Integer(agents.GetNumAgents() - 1));
 }
 
-AgentPointer<Person> AgentVector::GetAgentAtIndex(size_t i) {
-  if (i >= size_) {
-    Log::Fatal("AgentVector::GetAgentAtIndex()", "Given index ", i,
-               "; agents_.size() ", agents_.size(), ".");
-  }
-  if (dirty_) {
-    UpdateOffsets();
-  }
-  auto idx = BinarySearch(i, offsets_, 0u, offsets_.size() - 1);
-  auto offset = i - offsets_[idx];
-
-  assert(idx < agents_.size());
-  assert(offset < agents_[idx].size());
-  return agents_[idx][offset];
-}
-
-void AgentVector::AddAgent(AgentPointer<Person> agent) {
-  auto tid = tinfo_->GetMyThreadId();
-  if (agents_[tid].capacity() == agents_[tid].size()) {
-    auto new_cap = std::max(static_cast<uint64_t>(1000u),
-                            static_cast<uint64_t>(agents_[tid].size() * 1.2));
-    agents_[tid].reserve(new_cap);
-  }
-  agents_[tid].push_back(agent);
-  size_++;
-  dirty_ = true;
-}
-
-void AgentVector::Clear() {
-  for (auto& el : agents_) {
-    el.clear();
-  }
-  size_ = 0;
-  for (auto& el : offsets_) {
-    el = 0;
-  }
-  dirty_ = false;
-}
-
-void AgentVector::UpdateOffsets() {
-  std::lock_guard<Spinlock> guard(lock_);
-  if (dirty_) {
-    for (uint64_t i = 0; i < agents_.size(); ++i) {
-      offsets_[i] = agents_[i].size();
-    }
-    ExclusivePrefixSum(&offsets_, offsets_.size() - 1);
-    dirty_ = false;
-  }
-}
+}  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // CategoricalEnvironment
@@ -107,22 +45,54 @@ CategoricalEnvironment::CategoricalEnvironment(
       no_age_categories_(no_age_categories),
       no_locations_(no_locations),
       no_sociobehavioural_categories_(no_sociobehavioural_categories),
-      casual_female_agents_(no_age_categories * no_locations *
-                            no_sociobehavioural_categories),
-      regular_female_agents_(no_age_categories * no_locations *
-                             no_sociobehavioural_categories),
-      casual_male_agents_(no_age_categories * no_locations *
-                          no_sociobehavioural_categories),
-      regular_male_agents_(no_age_categories * no_locations *
-                           no_sociobehavioural_categories),
-      mothers_(no_locations),
-      adults_(no_locations),
-      mothers_are_assiged_(false) {}
+      mothers_are_assiged_(false) {
+  const size_t no_categories =
+      no_age_categories * no_locations * no_sociobehavioural_categories;
+  casual_female_agents_.Clear(no_categories);
+  regular_female_agents_.Clear(no_categories);
+  casual_male_agents_.Clear(no_categories);
+  casual_msm_agents_.Clear(no_categories);
+  regular_male_agents_.Clear(no_categories);
+  adults_.Clear(no_locations);
+  partnership_intents_.SetHistory(&partnership_history_);
+  partnership_intents_.SetHouseholds(&household_table_);
+  partnership_intents_.SetTracker(&cohort_tracker_);
+  partnership_intents_.SetEnvironment(this);
+  cohort_tracker_.SetWriter(&async_writer_);
+  contact_matrices_.SetWriter(&async_writer_);
+}
 
 // AM : Update probability to select a female mate from each location x age x sb
 // compound category. Depends on static mixing matrices and updated number of
 // female agents per category
 void CategoricalEnvironment::UpdateImplementation() {
+  auto* sim = Simulation::GetActive();  // AM: Needed to get current iteration
+  const auto* sparam =
+      sim->GetParam()->Get<SimParam>();  // AM : Needed to get mixing matrices
+  int year = static_cast<int>(
+      sparam->start_year +
+      sim->GetScheduler()->GetSimulatedSteps());  // Current year
+
+  if (!compiled_params_.IsCompiled()) {
+    compiled_params_.Compile(sparam);
+  }
+
+  // Write the cohort events of the previous year
+  if (sparam->cohort_fraction > 0) {
+    cohort_tracker_.Flush(
+        Concat(sim->GetOutputDir(), "/", sparam->cohort_file));
+  }
+
+  // Write the contacts of the previous year and count the contacts of this
+  // year
+  if (sparam->collect_contact_matrices) {
+    if (!contact_matrices_.IsEnabled()) {
+      contact_matrices_.Enable(no_locations_, no_age_categories_,
+                               no_sociobehavioural_categories_);
+    }
+    contact_matrices_.Flush(sparam->contact_matrix_file, year);
+  }
+
   // Debug
   /*uint64_t iter =
        Simulation::GetActive()->GetScheduler()->GetSimulatedSteps();
@@ -131,33 +101,17 @@ void CategoricalEnvironment::UpdateImplementation() {
      std::cout << "Before clearing section" << std::endl;
      DescribePopulation();
   }*/
-  for (auto& el : casual_female_agents_) {
-    el.Clear();
-  }
-  casual_female_agents_.resize(no_age_categories_ * no_locations_ *
-                               no_sociobehavioural_categories_);
-
-  for (auto& el : regular_female_agents_) {
-    el.Clear();
-  }
-  regular_female_agents_.resize(no_age_categories_ * no_locations_ *
-                                no_sociobehavioural_categories_);
-
-  for (auto& el : casual_male_agents_) {
-    el.Clear();
-  }
-  casual_male_agents_.resize(no_age_categories_ * no_locations_ *
-                             no_sociobehavioural_categories_);
-
-  for (auto& el : regular_male_agents_) {
-    el.Clear();
-  }
-  regular_male_agents_.resize(no_age_categories_ * no_locations_ *
-                              no_sociobehavioural_categories_);
-  for (auto& el : adults_) {
-    el.Clear();
-  }
-  adults_.resize(no_locations_);
+  const size_t no_categories =
+      no_age_categories_ * no_locations_ * no_sociobehavioural_categories_;
+  casual_female_agents_.Clear(no_categories);
+  regular_female_agents_.Clear(no_categories);
+  casual_male_agents_.Clear(no_categories);
+  casual_msm_agents_.Clear(no_categories);
+  regular_male_agents_.Clear(no_categories);
+  adults_.Clear(no_locations_);
+  mothers_.Clear(no_locations_ * sparam->fertility_age_bands.size() *
+                 GemsState::kGemsLast);
+  couple_table_.Clear();
   // DEBUG
   /*if (iter < 4) {
      std::cout << "After clearing section" << std::endl;
@@ -167,7 +121,7 @@ void CategoricalEnvironment::UpdateImplementation() {
   // Index females (by location x age x sociobehaviour for casual and regular
   // partnerships), and adults (by location for location attractivity)
   auto* rm = Simulation::GetActive()->GetResourceManager();
-  auto assign_to_indices = L2F([](Agent* agent) {
+  auto assign_to_indices = L2F([sparam](Agent* agent) {
     auto* env = bdm_static_cast<CategoricalEnvironment*>(
         Simulation::GetActive()->GetEnvironment());
     auto* person = bdm_static_cast<Person*>(agent);
@@ -179,6 +133,11 @@ void CategoricalEnvironment::UpdateImplementation() {
     // Reset number of casual partners at the beginning of every year
     // person->no_casual_partners_ = 0;
 
+    // The cached compound category is kept up to date where the location,
+    // age, or socio-behaviour change (population initialization,
+    // RandomMigration, GetOlder, and the relocation of households), hence the
+    // agent is indexed under the category of the current year.
+
     // Adults
     if (person->age_ >= env->GetMinAge()) {
       AgentPointer<Person> person_ptr = person->GetAgentPtr<Person>();
@@ -186,39 +145,42 @@ void CategoricalEnvironment::UpdateImplementation() {
         Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
                    "person_ptr is nullptr");
       }
+      // Compound category of the agent (location, age category and
+      // socio-behavioural category)
+      size_t compound_index = person->compound_category_;
       // Under max_age_
       if (person->age_ <= env->GetMaxAge()) {
-        // Compute age category of agent
-        size_t age_category =
-            person->GetAgeCategory(env->GetMinAge(), env->GetNoAgeCategories());
         // Adult women under max_age_ are potential casual partners
         if (person->sex_ == Sex::kFemale) {
-          // Add female agent to the right index, based on her location, age
-          // category and socio-behavioural category
-          env->AddCasualFemaleToIndex(person_ptr, person->location_,
-                                      age_category,
-                                      person->social_behaviour_factor_);
+          env->AddCasualFemaleToIndex(person_ptr, compound_index);
         } else {
           // Adult male under max_age_ are potential casual partners
-          // Add male agent to the right index, based on his location, age
-          // category and socio-behavioural category
-          env->AddCasualMaleToIndex(person_ptr, person->location_, age_category,
-                                    person->social_behaviour_factor_);
+          env->AddCasualMaleToIndex(person_ptr, compound_index);
+          // MSM are also potential casual partners of other MSM
+          if (person->msm_) {
+            env->AddCasualMsmToIndex(person_ptr, compound_index);
+          }
         }
       }
       // Adult single women are potential regular partners
       if (person->sex_ == Sex::kFemale && person->hasPartner() == false) {
-        // Compute age category of female agent
-        size_t age_category =
-            person->GetAgeCategory(env->GetMinAge(), env->GetNoAgeCategories());
-        // Add female agent to the right index, based on her location, age
-        // category and socio-behavioural category
-        env->AddRegularFemaleToIndex(person_ptr, person->location_,
-                                     age_category,
-                                     person->social_behaviour_factor_);
+        env->AddRegularFemaleToIndex(person_ptr, compound_index);
       }
       // Index adults by location (for location attractivity)
       env->AddAdultToLocation(person_ptr, person->location_);
+      // Women of reproductive age are potential mothers
+      if (person->sex_ == Sex::kFemale) {
+        int age_band = Births::GetAgeBand(person->age_, sparam);
+        if (age_band >= 0) {
+          env->AddMotherToIndex(person_ptr, person->location_, age_band,
+                                person->state_);
+        }
+      }
+      // Existing regular partnerships are registered by the male partner
+      if (person->sex_ == Sex::kMale && person->hasPartner()) {
+        env->GetCoupleTable().AddCouple(person_ptr, person->partner_,
+                                        person->partnership_year_);
+      }
     };
 
     // DEBUG: ARE NEW-BORN RECOGNIZED BY THEIR MOTHERS'
@@ -245,121 +207,35 @@ void CategoricalEnvironment::UpdateImplementation() {
       }*/
   });
   rm->ForEachAgentParallel(assign_to_indices);
+  casual_female_agents_.Finalize();
+  regular_female_agents_.Finalize();
+  casual_male_agents_.Finalize();
+  casual_msm_agents_.Finalize();
+  adults_.Finalize();
+  mothers_.Finalize();
 
   // During first iteration, assign mothers to children
   // Note: Ignore for parallelization because it is only executed once at the
   // beginning of the simulation -> setup cost.
-  if (!mothers_are_assiged_) {
-    mothers_are_assiged_ = true;
-    uint64_t iter =
-        Simulation::GetActive()->GetScheduler()->GetSimulatedSteps();
-    std::cout << "iter = " << iter << " ==> Assign mothers to children "
-              << std::endl;
-
-    // AM: Index Potential Mothers by location
-    mothers_.clear();
-    mothers_.resize(no_locations_);
-
-    rm->ForEachAgent([](Agent* agent) {
-      auto* env = bdm_static_cast<CategoricalEnvironment*>(
-          Simulation::GetActive()->GetEnvironment());
-      auto* person = bdm_static_cast<Person*>(agent);
-      if (person == nullptr) {
-        Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
-                   "person is nullptr");
-      }
-
-      // TO DO AM: Change to MaxAgeBirth
-      if (person->sex_ == Sex::kFemale && person->age_ >= env->GetMinAge() &&
-          person->age_ <= env->GetMaxAge()) {
-        AgentPointer<Person> person_ptr = person->GetAgentPtr<Person>();
-        if (person_ptr == nullptr) {
-          Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
-                     "person_ptr is nullptr");
-        }
-
-        // Add potential mother to the location index
-        env->AddMotherToLocation(person_ptr, person->location_);
-      };
-    });
-
-    // AM: Assign mothers to children
-    int cntr = 0;
-    rm->ForEachAgent([&](Agent* agent) {
-      auto* env = bdm_static_cast<CategoricalEnvironment*>(
-          Simulation::GetActive()->GetEnvironment());
-      auto* person = bdm_static_cast<Person*>(agent);
-      if (person == nullptr) {
-        Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
-                   "person is nullptr");
-      }
-
-      if (person->age_ < env->GetMinAge()) {
-        // std::cout << "I am a child (" << person->age_ << ") looking for a
-        // mother at location " << person->location_ << std::endl;
-        // Select a mother, at same location as child
-        // TO DO AM: ideally, mother is at least 15 and at most 40 years older
-        // than child
-        person->mother_ = env->GetRandomMotherFromLocation(person->location_);
-        if (!person->mother_) {
-          return;
-        }
-        // Check that mother and child have the same location
-        if (person->location_ != person->mother_->location_) {
-          Log::Warning("CategoricalEnvironment::UpdateImplementation()",
-                       "child assigned to mother with different location");
-        }
-        AgentPointer<Person> person_ptr = person->GetAgentPtr<Person>();
-        if (person_ptr == nullptr) {
-          Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
-                     "person_ptr is nullptr");
-        }
-        person->mother_->AddChild(person_ptr);
-        // std::cout << "Found a mother (age "<< person->mother_->age_ << ") at
-        // location " << person->mother_->location_ << std::endl;
-        cntr += 1;
-      };
-    });
-    std::cout << "Assigned " << cntr << " children to mothers." << std::endl;
-
-    // DEBUG: All agents' children are at the same location as their mothers
-    /*rm->ForEachAgent([](Agent* agent) {
-      auto* person = bdm_static_cast<Person*>(agent);
-      if (person == nullptr) {
-        Log::Fatal("CategoricalEnvironment::UpdateImplementation()",
-                   "person is nullptr");
-      }
-
-      for (int c = 0; c < person->GetNumberOfChildren(); c++) {
-        if (person->children_[c]->location_ != person->location_) {
-          Log::Warning("CategoricalEnvironment::UpdateImplementation()",
-                       "After child/mother assignment, child has different "
-                       "location from mother");
-        }
-      }
+  AssignMothers();
 
-      // Check that mothers recognise their children
-      if (person->age_ < 15) {
-        if (!person->mother_->IsParentOf(person->GetAgentPtr<Person>())) {
-          Log::Warning("CategoricalEnvironment::UpdateImplementation()",
-                       "After child/mother assignment, child points on mother, "
-                       "who does not recognise him/her.");
-        }
-      }
-    });*/
+  // The transmission probabilities do not change over time, hence we only
+  // compute them once.
+  if (!transmission_table_.IsBuilt()) {
+    transmission_table_.Build(sparam);
+  }
+  if (!partnership_history_.IsInitialized()) {
+    partnership_history_.Initialize(sparam->partnership_history_length,
+                                    sparam->partnership_history_spill_file);
   }
-
-  auto* sim = Simulation::GetActive();  // AM: Needed to get current iteration
-  const auto* sparam =
-      sim->GetParam()->Get<SimParam>();  // AM : Needed to get mixing matrices
-  auto* random = sim->GetRandom();       // : Needed for sampling
 
   // Regular Partnership Updates
   // AM : Update probability matrix to select regular female partner
   // given location, age and socio-behaviour of male agent
-  UpdateRegularPartnerCategoryDistribution(
-      sparam->reg_partner_age_mixing_matrix,
-      sparam->reg_partner_sociobehav_mixing_matrix);
+  UpdateRegularPartnerCategoryDistribution(compiled_params_);
+  // Seed of the partner categories and of the matching in this year
+  uint64_t matching_seed =
+      (sim->GetParam()->random_seed + replicate_) * 1000003 + year;
   // AM: Select potential regular partner's category for each adult single man
   auto choose_regular_partner_category = L2F([&](Agent* agent) {
     auto* env = bdm_static_cast<CategoricalEnvironment*>(
@@ -370,128 +246,261 @@ void CategoricalEnvironment::UpdateImplementation() {
                  "person is nullptr");
     }
     if (person->sex_ == Sex::kMale && person->IsAdult() &&
-        !person->hasPartner() && person->seek_regular_partnership_ == true) {
+        !person->hasPartner() && person->seek_regular_partnership_ == true &&
+        person->compound_category_ >= 0) {
       AgentPointer<Person> person_ptr = person->GetAgentPtr<Person>();
-      // Compute man's compound category
-      size_t age_category =
-          person->GetAgeCategory(env->GetMinAge(), env->GetNoAgeCategories());
-      size_t man_compound_index = ComputeCompoundIndex(
-          person->location_, age_category, person->social_behaviour_factor_);
       // Get man's partner category distribution
+      size_t man_compound_index = person->compound_category_;
       const auto& partner_category_distribution =
           reg_partner_compound_category_distribution_[man_compound_index];
-      // Sample regular partner's category
-      float rand_num = static_cast<float>(random->Uniform());
-      bool indexed = false;
-      for (size_t j = 0; j < partner_category_distribution.size(); j++) {
-        if (rand_num <= partner_category_distribution[j]) {
-          env->AddRegularMaleToIndex(person_ptr, j);
-          indexed = true;
-          break;
-        }
-      }
-      if (!indexed) {
-        // This line of code should never be reached
-        Log::Warning("UpdateImplementation()",
-                     "Could not sample the category of regular partner. "
-                     "Recieved inputs: ",
-                     rand_num);
+      // Sample regular partner's category. Men without single women in
+      // their location do not seek a partner this year. The number is drawn
+      // per agent such that it does not depend on the thread schedule.
+      double rand_num =
+          RegularMatching::GetUniform(matching_seed, person->cohort_id_);
+      if (partner_category_distribution.back() > 0) {
+        env->AddRegularMaleToIndex(
+            person_ptr, SampleCumulative(rand_num,
+                                         partner_category_distribution));
       }
     }
   });
 
   rm->ForEachAgentParallel(choose_regular_partner_category);
+  regular_male_agents_.Finalize();
 
-  // AM: Map regular partners for each compound category
+  // AM: Map regular partners. Men are first matched with women of the
+  // compound category they selected, then with women of their next preferred
+  // age categories (see RegularMatching).
+  matching_men_.resize(no_categories);
+  matching_women_.resize(no_categories);
 #pragma omp parallel for
-  for (size_t cat = 0; cat < regular_male_agents_.size(); cat++) {
-    size_t no_males = regular_male_agents_[cat].GetNumAgents();
-    size_t no_females = regular_female_agents_[cat].GetNumAgents();
-    /*std::cout << "Coumpound Category " << i << " - Number of male seeking
-    partner = " << no_males <<
-    ", Number of single females = " << no_females << std::endl;*/
-    if (no_males > 0 && no_females > 0) {
-      if (no_males < no_females) {
-        // Vector of ordered female indexes
-        std::vector<int> v(no_females);
-        std::iota(std::begin(v), std::end(v), 0);
-        // Shuffle female indexes
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(v.begin(), v.end(), g);
-        // Male select Females
-        for (size_t i = 0; i < no_males; i++) {
-          regular_male_agents_[cat].GetAgentAtIndex(i)->SetPartner(
-              regular_female_agents_[cat].GetAgentAtIndex(v[i]));
-          if (regular_male_agents_[cat]
-                  .GetAgentAtIndex(i)
-                  ->partner_->partner_ !=
-              regular_male_agents_[cat].GetAgentAtIndex(i)) {
-            Log::Warning(
-                "CategoricalEnvironment::UpdateImplementation()",
-                "Regular Partnership (male selects female) is ASYMMETRICAL");
-          }
-        }
-      } else {
-        // Vector of ordered male indexes
-        std::vector<int> v(no_males);
-        std::iota(std::begin(v), std::end(v), 0);
-        // Shuffle male indexes
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(v.begin(), v.end(), g);
-        // Females select Males
-        for (size_t i = 0; i < no_females; i++) {
-          regular_female_agents_[cat].GetAgentAtIndex(i)->SetPartner(
-              regular_male_agents_[cat].GetAgentAtIndex(v[i]));
-          // Check Symmetry
-          if (regular_female_agents_[cat]
-                  .GetAgentAtIndex(i)
-                  ->partner_->partner_ !=
-              regular_female_agents_[cat].GetAgentAtIndex(i)) {
-            Log::Warning(
-                "CategoricalEnvironment::UpdateImplementation()",
-                "Regular Partnership (female selects male) is ASYMMETRICAL");
-          }
-        }
-      }
+  for (size_t cat = 0; cat < no_categories; cat++) {
+    auto& men = matching_men_[cat];
+    men.resize(regular_male_agents_[cat].GetNumAgents());
+    for (size_t i = 0; i < men.size(); i++) {
+      auto man = regular_male_agents_[cat].GetAgentAtIndex(i);
+      men[i] = {man->cohort_id_, static_cast<uint32_t>(i),
+                static_cast<uint32_t>(
+                    ComputeAgeFromCompoundIndex(man->compound_category_))};
+    }
+    auto& women = matching_women_[cat];
+    women.resize(regular_female_agents_[cat].GetNumAgents());
+    for (size_t i = 0; i < women.size(); i++) {
+      auto woman = regular_female_agents_[cat].GetAgentAtIndex(i);
+      women[i] = {woman->cohort_id_, static_cast<uint32_t>(i),
+                  static_cast<uint32_t>(ComputeAgeFromCompoundIndex(cat))};
     }
   }
-
-  // AM: Probability of migration location depends on the current year
-  int year = static_cast<int>(
-      sparam->start_year +
-      sim->GetScheduler()->GetSimulatedSteps());  // Current year
-  // If no transition year is higher than current year, then use last
-  // transition year
-  int year_index = sparam->migration_year_transition.size() - 1;
-  for (size_t y = 0; y < sparam->migration_year_transition.size() - 1; y++) {
-    if (year < sparam->migration_year_transition[y + 1]) {
-      year_index = y;
-      break;
+  std::vector<float> age_preferences(no_age_categories_ * no_age_categories_);
+  for (size_t a_i = 0; a_i < no_age_categories_; a_i++) {
+    for (size_t a_j = 0; a_j < no_age_categories_; a_j++) {
+      age_preferences[a_i * no_age_categories_ + a_j] =
+          compiled_params_.GetRegPartnerAgeMixing(a_i, a_j);
     }
   }
+  regular_matching_.SetAgePreferences(no_age_categories_, age_preferences);
+  regular_matching_.Match(&matching_men_, &matching_women_,
+                          sparam->regular_matching_rounds, matching_seed,
+                          &matching_pairs_);
+  for (const auto& pair : matching_pairs_) {
+    auto man = regular_male_agents_[pair.man_category].GetAgentAtIndex(
+        pair.man_index);
+    partnership_intents_.AddFormation(
+        man,
+        regular_female_agents_[pair.woman_category].GetAgentAtIndex(
+            pair.woman_index),
+        year);
+    contact_matrices_.Record(ContactType::kRegularContactMixing,
+                             man->compound_category_, pair.woman_category);
+  }
+
+  // Link the new regular partners in a deterministic order and merge the
+  // existing and the new regular partnerships into the couple table
+  partnership_intents_.Resolve(&couple_table_);
+  couple_table_.Finalize();
+
+  // Group the agents into households once all partner and mother links of
+  // this step are known. Children under 15 belong to the household of their
+  // mother, men in a regular partnership to the household of their partner.
+  household_table_.Clear();
+  auto assign_to_households = L2F([](Agent* agent) {
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(
+        Simulation::GetActive()->GetEnvironment());
+    auto* person = bdm_static_cast<Person*>(agent);
+    Person* head = person;
+    if (person->age_ < 15 && person->mother_ != nullptr) {
+      head = person->mother_.Get();
+    } else if (person->sex_ == Sex::kMale && person->hasPartner()) {
+      head = person->partner_.Get();
+    }
+    env->GetHouseholdTable().AddMember(head, person);
+  });
+  rm->ForEachAgentParallel(assign_to_households);
+  household_table_.Build();
+
   // AM : Update probability matrix to select migration/relocation destination
   // given current year index and origin location
-  UpdateMigrationLocationProbability(year_index, sparam->migration_matrix);
+  UpdateMigrationLocationProbability(
+      compiled_params_.GetYearParams(year).migration_index, compiled_params_);
 
   // AM : Update probability matrix to select female mate
   // given location, age and socio-behaviour of male agent
-  UpdateCasualPartnerCategoryDistribution(sparam->location_mixing_matrix,
-                                          sparam->age_mixing_matrix,
-                                          sparam->sociobehav_mixing_matrix);
+  UpdateCasualPartnerCategoryDistribution(compiled_params_);
 };
 
+void CategoricalEnvironment::AssignMothers() {
+  if (mothers_are_assiged_) {
+    return;
+  }
+  mothers_are_assiged_ = true;
+  auto* sim = Simulation::GetActive();
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  auto* rm = sim->GetResourceManager();
+  uint64_t iter = sim->GetScheduler()->GetSimulatedSteps();
+  int year = static_cast<int>(sparam->start_year + iter);
+  std::cout << "iter = " << iter << " ==> Assign mothers to children "
+            << std::endl;
+
+  // The potential mothers (women of reproductive age) are indexed by
+  // UpdateImplementation. Index them here if the environment was not updated
+  // yet, i.e. if the mothers are assigned before the replicates are forked
+  // (see ForkReplicates).
+  if (mothers_.GetNumAgents() == 0) {
+    mothers_.Clear(no_locations_ * sparam->fertility_age_bands.size() *
+                   GemsState::kGemsLast);
+    rm->ForEachAgent([&](Agent* agent) {
+      auto* person = bdm_static_cast<Person*>(agent);
+      if (person->sex_ == Sex::kFemale && person->age_ >= min_age_) {
+        int age_band = Births::GetAgeBand(person->age_, sparam);
+        if (age_band >= 0) {
+          AddMotherToIndex(person->GetAgentPtr<Person>(), person->location_,
+                           age_band, person->state_);
+        }
+      }
+    });
+    mothers_.Finalize();
+  }
+
+  // AM: Assign mothers to children
+  int cntr = 0;
+  std::vector<AgentUid> compressed;
+  rm->ForEachAgent([&](Agent* agent) {
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(
+        Simulation::GetActive()->GetEnvironment());
+    auto* person = bdm_static_cast<Person*>(agent);
+    if (person == nullptr) {
+      Log::Fatal("CategoricalEnvironment::AssignMothers()",
+                 "person is nullptr");
+    }
+
+    if (person->age_ < env->GetMinAge()) {
+      // std::cout << "I am a child (" << person->age_ << ") looking for a
+      // mother at location " << person->location_ << std::endl;
+      // Select a mother, at same location as child
+      // TO DO AM: ideally, mother is at least 15 and at most 40 years older
+      // than child
+      person->mother_ = env->GetRandomMotherFromLocation(person->location_);
+      if (!person->mother_) {
+        return;
+      }
+      // Check that mother and child have the same location
+      if (person->location_ != person->mother_->location_) {
+        Log::Warning("CategoricalEnvironment::AssignMothers()",
+                     "child assigned to mother with different location");
+      }
+      AgentPointer<Person> person_ptr = person->GetAgentPtr<Person>();
+      if (person_ptr == nullptr) {
+        Log::Fatal("CategoricalEnvironment::AssignMothers()",
+                   "person_ptr is nullptr");
+      }
+      cntr += 1;
+      // Compressed children are stored with their mother and removed from
+      // the simulation below
+      if (sparam->compress_children) {
+        ChildRecord record{};
+        record.birth_year_ = year - static_cast<int>(person->age_) - 1;
+        record.sex_ = person->sex_;
+        record.state_ = person->state_;
+        record.infection_origin_state_ = person->infection_origin_state_;
+        record.infection_origin_sb_ = person->infection_origin_sb_;
+        Births::AddChildRecord(person->mother_.Get(), record);
+        compressed.push_back(person->GetUid());
+        return;
+      }
+      person->mother_->AddChild(person_ptr);
+      // std::cout << "Found a mother (age "<< person->mother_->age_ << ") at
+      // location " << person->mother_->location_ << std::endl;
+    };
+  });
+  std::cout << "Assigned " << cntr << " children to mothers." << std::endl;
+  for (const auto& uid : compressed) {
+    rm->RemoveAgent(uid);
+  }
+
+  // DEBUG: All agents' children are at the same location as their mothers
+  /*rm->ForEachAgent([](Agent* agent) {
+    auto* person = bdm_static_cast<Person*>(agent);
+    if (person == nullptr) {
+      Log::Fatal("CategoricalEnvironment::AssignMothers()",
+                 "person is nullptr");
+    }
+
+    for (int c = 0; c < person->GetNumberOfChildren(); c++) {
+      if (person->children_[c]->location_ != person->location_) {
+        Log::Warning("CategoricalEnvironment::AssignMothers()",
+                     "After child/mother assignment, child has different "
+                     "location from mother");
+      }
+    }
+
+    // Check that mothers recognise their children
+    if (person->age_ < 15) {
+      if (!person->mother_->IsParentOf(person->GetAgentPtr<Person>())) {
+        Log::Warning("CategoricalEnvironment::AssignMothers()",
+                     "After child/mother assignment, child points on mother, "
+                     "who does not recognise him/her.");
+      }
+    }
+  });*/
+}
+
 void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
-    const std::vector<std::vector<float>>& location_mixing_matrix,
-    const std::vector<std::vector<float>>& age_mixing_matrix,
-    const std::vector<std::vector<float>>& sociobehav_mixing_matrix) {
+    const CompiledParams& params) {
+  BuildCasualPartnerCategoryDistribution(
+      casual_female_agents_, params, &mate_compound_category_distribution_);
+
+  // MSM select their male partners with the same mixing matrices. The
+  // distribution is only built if there are MSM.
+  if (casual_msm_agents_.GetNumAgents() > 0) {
+    BuildCasualPartnerCategoryDistribution(
+        casual_msm_agents_, params, &msm_compound_category_distribution_);
+  } else {
+    msm_compound_category_distribution_.clear();
+  }
+}
+
+void CategoricalEnvironment::BuildCasualPartnerCategoryDistribution(
+    const AgentIndex& partners, const CompiledParams& params,
+    std::vector<std::vector<float>>* distribution) {
   //#pragma omp parallel
-  for (auto& el : mate_compound_category_distribution_) {
+  for (auto& el : *distribution) {
     el.clear();
   }
-  mate_compound_category_distribution_.resize(
-      no_locations_ * no_age_categories_ * no_sociobehavioural_categories_);
+  distribution->resize(no_locations_ * no_age_categories_ *
+                       no_sociobehavioural_categories_);
+
+  // Number of potential partners per location and per location x age
+  std::vector<float> no_at_location(no_locations_, 0.0);
+  std::vector<float> no_at_location_age(no_locations_ * no_age_categories_,
+                                        0.0);
+  for (size_t j = 0; j < partners.GetNumCategories(); j++) {
+    size_t l_j = ComputeLocationFromCompoundIndex(j);
+    size_t a_j = ComputeAgeFromCompoundIndex(j);
+    no_at_location[l_j] += partners[j].GetNumAgents();
+    no_at_location_age[l_j * no_age_categories_ + a_j] +=
+        partners[j].GetNumAgents();
+  }
 
   //#pragma omp for
   for (size_t i = 0;
@@ -499,23 +508,23 @@ void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
        i++) {  // Loop over male agent compound categories (location x age x
                // socio-behaviour)
 
-    // AM : Probability distribution matrix to select a female mate given male
-    // agent and female mate compound categories
-    mate_compound_category_distribution_[i].resize(
-        no_locations_ * no_age_categories_ * no_sociobehavioural_categories_);
+    // AM : Probability distribution matrix to select a mate given
+    // agent and mate compound categories
+    (*distribution)[i].resize(no_locations_ * no_age_categories_ *
+                              no_sociobehavioural_categories_);
 
     // Get Location, Age and Socio-behaviour of male agent from Index
     size_t l_i = ComputeLocationFromCompoundIndex(i);
     size_t a_i = ComputeAgeFromCompoundIndex(i);
     size_t s_i = ComputeSociobehaviourFromCompoundIndex(i);
 
-    // Step 1 - Location: Compute probability to select a female mate from
+    // Step 1 - Location: Compute probability to select a mate from
     // each location
     std::vector<float> proba_locations(no_locations_, 0.0);
     float sum_locations = 0.0;
     for (size_t l_j = 0; l_j < no_locations_; l_j++) {
       proba_locations[l_j] =
-          location_mixing_matrix[l_i][l_j] * GetNumCasualFemalesAtLocation(l_j);
+          params.GetLocationMixing(l_i, l_j) * no_at_location[l_j];
       sum_locations += proba_locations[l_j];
     }
     // Normalise to get probability between 0 and 1
@@ -525,20 +534,20 @@ void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
       }
     }
 
-    // Step 2 -  Age: Compute probability to select a female mate from each
+    // Step 2 -  Age: Compute probability to select a mate from each
     // age category given the selected location
     std::vector<std::vector<float>> proba_ages_given_location;
     proba_ages_given_location.resize(no_locations_);
     for (size_t l_j = 0; l_j < no_locations_;
-         l_j++) {  // Loop over potential locations of female mate
+         l_j++) {  // Loop over potential locations of mate
       proba_ages_given_location[l_j].resize(no_age_categories_);
       float sum_ages = 0.0;
       for (size_t a_j = 0; a_j < no_age_categories_;
            a_j++) {  // For each location l_j, compute probability to select a
-                     // female mate from each age category a_j
+                     // mate from each age category a_j
         proba_ages_given_location[l_j][a_j] =
-            age_mixing_matrix[a_i][a_j] *
-            GetNumCasualFemalesAtLocationAge(l_j, a_j);
+            params.GetAgeMixing(a_i, a_j) *
+            no_at_location_age[l_j * no_age_categories_ + a_j];
         sum_ages += proba_ages_given_location[l_j][a_j];
       }
       // Normalise to compute probability between 0 and 1 to select from each
@@ -562,8 +571,8 @@ void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
         float sum_socio = 0.0;
         for (size_t s_j = 0; s_j < no_sociobehavioural_categories_; s_j++) {
           proba_socio_given_location_age[l_j][a_j][s_j] =
-              sociobehav_mixing_matrix[s_i][s_j] *
-              GetNumCasualFemalesAtIndex(l_j, a_j, s_j);
+              params.GetSociobehavMixing(s_i, s_j) *
+              partners[ComputeCompoundIndex(l_j, a_j, s_j)].GetNumAgents();
           sum_socio += proba_socio_given_location_age[l_j][a_j][s_j];
         }
         // Normalise to compute probability between 0 and 1 to select each
@@ -577,7 +586,7 @@ void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
     }
 
     // Compute the final probability that a male agent of compound category i,
-    // selects a female mate of compound category j.
+    // selects a mate of compound category j.
     for (size_t j = 0; j < no_locations_ * no_age_categories_ *
                                no_sociobehavioural_categories_;
          j++) {
@@ -585,39 +594,20 @@ void CategoricalEnvironment::UpdateCasualPartnerCategoryDistribution(
       size_t a_j = ComputeAgeFromCompoundIndex(j);
       size_t s_j = ComputeSociobehaviourFromCompoundIndex(j);
 
-      mate_compound_category_distribution_[i][j] =
+      (*distribution)[i][j] =
           proba_locations[l_j] * proba_ages_given_location[l_j][a_j] *
           proba_socio_given_location_age[l_j][a_j][s_j];
 
       // Compute Cumulative distribution
       if (j > 0) {
-        mate_compound_category_distribution_[i][j] +=
-            mate_compound_category_distribution_[i][j - 1];
-      }
-    }
-
-    // Make sure that the commulative probability distribution actually ends
-    // with 1.0 and not 0.9999x or something similar. Do not fix only the last
-    // element but all the previous ones, which had the same cumulative
-    // probability ~1 (<=> probability = 0)
-    size_t no_compound_categories =
-        no_locations_ * no_age_categories_ * no_sociobehavioural_categories_;
-    auto last_cumul_proba =
-        mate_compound_category_distribution_[i][no_compound_categories - 1];
-    // Go looking backward
-    for (size_t j = no_compound_categories - 1; j >= 0; j--) {
-      if (mate_compound_category_distribution_[i][j] == last_cumul_proba) {
-        mate_compound_category_distribution_[i][j] = 1.0;
-      } else {
-        break;
+        (*distribution)[i][j] += (*distribution)[i][j - 1];
       }
     }
   }
 }
 
 void CategoricalEnvironment::UpdateRegularPartnerCategoryDistribution(
-    std::vector<std::vector<float>> reg_partner_age_mixing_matrix,
-    std::vector<std::vector<float>> reg_partner_sociobehav_mixing_matrix) {
+    const CompiledParams& params) {
   //#pragma omp parallel
   for (auto& el : reg_partner_compound_category_distribution_) {
     el.clear();
@@ -666,7 +656,7 @@ void CategoricalEnvironment::UpdateRegularPartnerCategoryDistribution(
              a_j++) {  // For each location l_j, compute probability to select a
                        // female mate from each age category a_j
           proba_ages_given_location[l_j][a_j] =
-              reg_partner_age_mixing_matrix[a_i][a_j] *
+              params.GetRegPartnerAgeMixing(a_i, a_j) *
               GetNumRegularFemalesAtLocationAge(l_j, a_j);
           sum_ages += proba_ages_given_location[l_j][a_j];
         }
@@ -699,7 +689,7 @@ void CategoricalEnvironment::UpdateRegularPartnerCategoryDistribution(
           float sum_socio = 0.0;
           for (size_t s_j = 0; s_j < no_sociobehavioural_categories_; s_j++) {
             proba_socio_given_location_age[l_j][a_j][s_j] =
-                reg_partner_sociobehav_mixing_matrix[s_i][s_j] *
+                params.GetRegPartnerSociobehavMixing(s_i, s_j) *
                 GetNumRegularFemalesAtIndex(l_j, a_j, s_j);
             sum_socio += proba_socio_given_location_age[l_j][a_j][s_j];
           }
@@ -741,65 +731,25 @@ void CategoricalEnvironment::UpdateRegularPartnerCategoryDistribution(
             reg_partner_compound_category_distribution_[i][j - 1];
       }
     }
-
-    // Make sure that the commulative probability distribution actually ends
-    // with 1.0 and not 0.9999x or something similar. Do not fix only the last
-    // element but all the previous ones, which had the same cumulative
-    // probability ~1 (<=> probability = 0)
-    size_t no_compound_categories =
-        no_locations_ * no_age_categories_ * no_sociobehavioural_categories_;
-    auto last_cumul_proba =
-        reg_partner_compound_category_distribution_[i]
-                                                   [no_compound_categories - 1];
-    // Go looking backward
-    for (size_t j = no_compound_categories - 1; j >= 0; j--) {
-      if (reg_partner_compound_category_distribution_[i][j] ==
-          last_cumul_proba) {
-        reg_partner_compound_category_distribution_[i][j] = 1.0;
-      } else {
-        break;
-      }
-    }
   }
 }
 
 void CategoricalEnvironment::UpdateMigrationLocationProbability(
-    size_t year_index,
-    const std::vector<std::vector<std::vector<float>>>& migration_matrix) {
+    size_t year_index, const CompiledParams& params) {
   for (auto& el : migration_location_distribution_) {
     el.clear();
   }
   migration_location_distribution_.resize(no_locations_);
   for (size_t i = 0; i < no_locations_; i++) {
     migration_location_distribution_[i].resize(no_locations_);
-    // Compute Denominator for Normalization
-    float sum = 0.0;
     for (size_t j = 0; j < no_locations_; j++) {
       // Weight migration_matrix with population size per destination
       migration_location_distribution_[i][j] =
-          migration_matrix[year_index][i][j] * GetNumAdultsAtLocation(j);
-      sum += migration_location_distribution_[i][j];
-    }
-    // Normalize and Cumulate
-    for (size_t j = 0; j < no_locations_; j++) {
-      if (j == 0) {
-        migration_location_distribution_[i][j] =
-            migration_location_distribution_[i][j] / sum;
-      } else {
-        migration_location_distribution_[i][j] =
-            migration_location_distribution_[i][j - 1] +
-            migration_location_distribution_[i][j] / sum;
-      }
-    }
-    // Check that we do end with 1.0 (not 0.99999, or 1.00001)
-    auto last_cumul_proba =
-        migration_location_distribution_[i][no_locations_ - 1];
-    // Go looking backward
-    for (size_t j = no_locations_ - 1; j >= 0; j--) {
-      if (migration_location_distribution_[i][j] == last_cumul_proba) {
-        migration_location_distribution_[i][j] = 1.0;
-      } else {
-        break;
+          params.GetMigration(year_index, i, j) * GetNumAdultsAtLocation(j);
+      // Cumulate. The weights are not normalised, see SampleCumulative.
+      if (j > 0) {
+        migration_location_distribution_[i][j] +=
+            migration_location_distribution_[i][j - 1];
       }
     }
   }
@@ -817,95 +767,94 @@ void CategoricalEnvironment::AddAdultToLocation(AgentPointer<Person> agent,
                                                 size_t location) {
   assert(location >= 0 and location < no_locations_);
 
-  if (location >= adults_.size()) {
+  if (location >= adults_.GetNumCategories()) {
     Log::Fatal("CategoricalEnvironment::AddAdultToLocation()",
                "Location index is out of bounds. Received (loc ", location,
-               ") and adults_.size(): ", adults_.size());
+               ") and no. categories of adults_: ", adults_.GetNumCategories());
   }
-  adults_[location].AddAgent(agent);
+  adults_.AddAgent(agent, location);
 }
 
 void CategoricalEnvironment::AddCasualFemaleToIndex(AgentPointer<Person> agent,
-                                                    size_t location, size_t age,
-                                                    size_t sb) {
-  assert(location >= 0 and location < no_locations_);
-  assert(age >= 0 and age < no_age_categories_);
-  assert(sb >= 0 and sb < no_sociobehavioural_categories_);
-
-  size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  if (compound_index >= casual_female_agents_.size()) {
+                                                    size_t index) {
+  if (index >= casual_female_agents_.GetNumCategories()) {
     Log::Fatal(
         "CategoricalEnvironment::AddCasualFemaleToIndex()",
-        "Location index is out of bounds. Received compound index: ",
-        compound_index, " (loc ", location, ", age ", age, ", sb ", sb,
-        ") casual_female_agents_.size(): ", casual_female_agents_.size());
+        "Compound index is out of bounds. Received compound index: ", index,
+        " and no. categories of casual_female_agents_: ",
+        casual_female_agents_.GetNumCategories());
   }
-  casual_female_agents_[compound_index].AddAgent(agent);
+  casual_female_agents_.AddAgent(agent, index);
 };
 
 void CategoricalEnvironment::AddRegularFemaleToIndex(AgentPointer<Person> agent,
-                                                     size_t location,
-                                                     size_t age, size_t sb) {
-  assert(location >= 0 and location < no_locations_);
-  assert(age >= 0 and age < no_age_categories_);
-  assert(sb >= 0 and sb < no_sociobehavioural_categories_);
-
-  size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  if (compound_index >= regular_female_agents_.size()) {
+                                                     size_t index) {
+  if (index >= regular_female_agents_.GetNumCategories()) {
     Log::Fatal(
         "CategoricalEnvironment::AddRegularFemaleToIndex()",
-        "Location index is out of bounds. Received compound index: ",
-        compound_index, " (loc ", location, ", age ", age, ", sb ", sb,
-        ") regular_female_agents_.size(): ", regular_female_agents_.size());
+        "Compound index is out of bounds. Received compound index: ", index,
+        " and no. categories of regular_female_agents_: ",
+        regular_female_agents_.GetNumCategories());
   }
-  regular_female_agents_[compound_index].AddAgent(agent);
+  regular_female_agents_.AddAgent(agent, index);
 };
 
 void CategoricalEnvironment::AddRegularMaleToIndex(AgentPointer<Person> agent,
                                                    size_t index) {
-  if (index >= regular_male_agents_.size()) {
+  if (index >= regular_male_agents_.GetNumCategories()) {
     Log::Fatal(
         "CategoricalEnvironment::AddRegularMaleToIndex()",
         "Compound index is out of bounds. Received compound index: ", index,
-        " and regular_male_agents_.size(): ", regular_male_agents_.size());
+        " and no. categories of regular_male_agents_: ",
+        regular_male_agents_.GetNumCategories());
   }
-  regular_male_agents_[index].AddAgent(agent);
+  regular_male_agents_.AddAgent(agent, index);
 };
 
 void CategoricalEnvironment::AddCasualMaleToIndex(AgentPointer<Person> agent,
-                                                  size_t location, size_t age,
-                                                  size_t sb) {
-  assert(location >= 0 and location < no_locations_);
-  assert(age >= 0 and age < no_age_categories_);
-  assert(sb >= 0 and sb < no_sociobehavioural_categories_);
+                                                  size_t index) {
+  if (index >= casual_male_agents_.GetNumCategories()) {
+    Log::Fatal(
+        "CategoricalEnvironment::AddCasualMaleToIndex()",
+        "Compound index is out of bounds. Received compound index: ", index,
+        " and no. categories of casual_male_agents_: ",
+        casual_male_agents_.GetNumCategories());
+  }
+  casual_male_agents_.AddAgent(agent, index);
+};
 
-  size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  if (compound_index >= casual_male_agents_.size()) {
-    Log::Fatal("CategoricalEnvironment::AddCasualMaleToIndex()",
-               "Location index is out of bounds. Received compound index: ",
-               compound_index, " (loc ", location, ", age ", age, ", sb ", sb,
-               ") casual_male_agents_.size(): ", casual_male_agents_.size());
+void CategoricalEnvironment::AddCasualMsmToIndex(AgentPointer<Person> agent,
+                                                 size_t index) {
+  if (index >= casual_msm_agents_.GetNumCategories()) {
+    Log::Fatal(
+        "CategoricalEnvironment::AddCasualMsmToIndex()",
+        "Compound index is out of bounds. Received compound index: ", index,
+        " and no. categories of casual_msm_agents_: ",
+        casual_msm_agents_.GetNumCategories());
   }
-  casual_male_agents_[compound_index].AddAgent(agent);
+  casual_msm_agents_.AddAgent(agent, index);
 };
 
-void CategoricalEnvironment::AddMotherToLocation(AgentPointer<Person> agent,
-                                                 size_t location) {
-  assert(location >= 0 and location < no_locations_);
-  mothers_[location].AddAgent(agent);
+void CategoricalEnvironment::AddMotherToIndex(AgentPointer<Person> agent,
+                                              size_t location, size_t age_band,
+                                              int state) {
+  size_t stratum = GetMotherStratum(location, age_band, state);
+  assert(stratum < mothers_.GetNumCategories());
+  mothers_.AddAgent(agent, stratum);
 }
 
 AgentPointer<Person> CategoricalEnvironment::GetRandomCasualFemaleFromIndex(
     size_t location, size_t age, size_t sb) {
   size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  if (compound_index >= casual_female_agents_.size()) {
+  if (compound_index >= casual_female_agents_.GetNumCategories()) {
     Log::Fatal(
         "CategoricalEnvironment::GetRandomCasualFemaleFromIndex()",
         "Location index is out of bounds. Received compound index: ",
         compound_index, " (loc ", location, ", age ", age, ", sb ", sb,
-        ") casual_female_agents_.size(): ", casual_female_agents_.size());
+        ") no. categories of casual_female_agents_: ",
+        casual_female_agents_.GetNumCategories());
   }
-  return casual_female_agents_[compound_index].GetRandomAgent();
+  return GetRandomAgent(casual_female_agents_[compound_index]);
 };
 
 AgentPointer<Person> CategoricalEnvironment::GetRandomCasualFemaleFromIndex(
@@ -914,19 +863,32 @@ AgentPointer<Person> CategoricalEnvironment::GetRandomCasualFemaleFromIndex(
   size_t age = ComputeAgeFromCompoundIndex(compound_index);
   size_t sb = ComputeSociobehaviourFromCompoundIndex(compound_index);
 
-  if (compound_index >= casual_female_agents_.size()) {
+  if (compound_index >= casual_female_agents_.GetNumCategories()) {
     Log::Fatal(
         "CategoricalEnvironment::GetRandomCasualFemaleFromIndex()",
         "Location index is out of bounds. Received compound index: ",
         compound_index, " (loc ", location, ", age ", age, ", sb ", sb,
-        ") casual_female_agents_.size(): ", casual_female_agents_.size());
+        ") no. categories of casual_female_agents_: ",
+        casual_female_agents_.GetNumCategories());
   }
   if (casual_female_agents_[compound_index].GetNumAgents() == 0) {
     Log::Fatal("CategoricalEnvironment::GetRandomCasualFemaleFromIndex()",
                "Female agents empty. Received compound index: ", compound_index,
                " (loc ", location, ", age ", age, ", sb ", sb, ")");
   }
-  return casual_female_agents_[compound_index].GetRandomAgent();
+  return GetRandomAgent(casual_female_agents_[compound_index]);
+};
+
+AgentPointer<Person> CategoricalEnvironment::GetRandomCasualMsmFromIndex(
+    size_t compound_index) {
+  if (compound_index >= casual_msm_agents_.GetNumCategories() ||
+      casual_msm_agents_[compound_index].GetNumAgents() == 0) {
+    Log::Fatal("CategoricalEnvironment::GetRandomCasualMsmFromIndex()",
+               "No MSM at compound index: ", compound_index,
+               " no. categories of casual_msm_agents_: ",
+               casual_msm_agents_.GetNumCategories());
+  }
+  return GetRandomAgent(casual_msm_agents_[compound_index]);
 };
 
 // Function for Debug - prints number of females per location.
@@ -953,7 +915,7 @@ size_t CategoricalEnvironment::GetNumCasualFemalesAtIndex(size_t location,
                                                           size_t age,
                                                           size_t sb) {
   size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  assert(compound_index < casual_female_agents_.size());
+  assert(compound_index < casual_female_agents_.GetNumCategories());
   return casual_female_agents_[compound_index].GetNumAgents();
 }
 
@@ -961,12 +923,12 @@ size_t CategoricalEnvironment::GetNumRegularFemalesAtIndex(size_t location,
                                                            size_t age,
                                                            size_t sb) {
   size_t compound_index = ComputeCompoundIndex(location, age, sb);
-  assert(compound_index < regular_female_agents_.size());
+  assert(compound_index < regular_female_agents_.GetNumCategories());
   return regular_female_agents_[compound_index].GetNumAgents();
 }
 
 size_t CategoricalEnvironment::GetNumAdultsAtLocation(size_t location) {
-  assert(location < adults_.size());
+  assert(location < adults_.GetNumCategories());
   return adults_[location].GetNumAgents();
 }
 
@@ -975,7 +937,7 @@ size_t CategoricalEnvironment::GetNumCasualFemalesAtLocationAge(size_t location,
   size_t sum = 0;
   for (size_t sb = 0; sb < no_sociobehavioural_categories_; sb++) {
     size_t compound_index = ComputeCompoundIndex(location, age, sb);
-    assert(compound_index < casual_female_agents_.size());
+    assert(compound_index < casual_female_agents_.GetNumCategories());
     sum += casual_female_agents_[compound_index].GetNumAgents();
   }
   return sum;
@@ -986,7 +948,7 @@ size_t CategoricalEnvironment::GetNumRegularFemalesAtLocationAge(
   size_t sum = 0;
   for (size_t sb = 0; sb < no_sociobehavioural_categories_; sb++) {
     size_t compound_index = ComputeCompoundIndex(location, age, sb);
-    assert(compound_index < regular_female_agents_.size());
+    assert(compound_index < regular_female_agents_.GetNumCategories());
     sum += regular_female_agents_[compound_index].GetNumAgents();
   }
   return sum;
@@ -997,7 +959,7 @@ size_t CategoricalEnvironment::GetNumCasualFemalesAtLocation(size_t location) {
   for (size_t sb = 0; sb < no_sociobehavioural_categories_; sb++) {
     for (size_t age = 0; age < no_age_categories_; age++) {
       size_t compound_index = ComputeCompoundIndex(location, age, sb);
-      assert(compound_index < casual_female_agents_.size());
+      assert(compound_index < casual_female_agents_.GetNumCategories());
       sum += casual_female_agents_[compound_index].GetNumAgents();
     }
   }
@@ -1009,7 +971,7 @@ size_t CategoricalEnvironment::GetNumRegularFemalesAtLocation(size_t location) {
   for (size_t sb = 0; sb < no_sociobehavioural_categories_; sb++) {
     for (size_t age = 0; age < no_age_categories_; age++) {
       size_t compound_index = ComputeCompoundIndex(location, age, sb);
-      assert(compound_index < regular_female_agents_.size());
+      assert(compound_index < regular_female_agents_.GetNumCategories());
       sum += regular_female_agents_[compound_index].GetNumAgents();
     }
   }
@@ -1019,22 +981,28 @@ size_t CategoricalEnvironment::GetNumRegularFemalesAtLocation(size_t location) {
 // AM: GET Random mother from location
 AgentPointer<Person> CategoricalEnvironment::GetRandomMotherFromLocation(
     size_t location) {
-  if (mothers_[location].GetNumAgents() == 0) {
+  // The strata of a location are contiguous in mothers_
+  size_t strata_per_location = mothers_.GetNumCategories() / no_locations_;
+  size_t first = location * strata_per_location;
+  size_t no_mothers = 0;
+  for (size_t s = first; s < first + strata_per_location; s++) {
+    no_mothers += mothers_[s].GetNumAgents();
+  }
+  if (no_mothers == 0) {
     Log::Warning("CategoricalEnvironment::GetRandomMotherFromLocation()",
                  "Mothers empty. Received location: ", location);
     return nullptr;
   }
-  return mothers_[location].GetRandomAgent();
+  auto* r = Simulation::GetActive()->GetRandom();
+  size_t i = r->Integer(no_mothers);
+  size_t s = first;
+  while (i >= mothers_[s].GetNumAgents()) {
+    i -= mothers_[s].GetNumAgents();
+    s++;
+  }
+  return mothers_[s].GetAgentAtIndex(i);
 }
 
-const std::vector<float>&
-CategoricalEnvironment::GetMateCompoundCategoryDistribution(size_t loc,
-                                                            size_t age_category,
-                                                            size_t sociobehav) {
-  size_t compound_index = ComputeCompoundIndex(loc, age_category, sociobehav);
-  return mate_compound_category_distribution_[compound_index];
-};
-
 const std::vector<float>& CategoricalEnvironment::GetMigrationLocDistribution(
     size_t loc) {
   return migration_location_distribution_[loc];
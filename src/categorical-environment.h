@@ -18,10 +18,27 @@
 #include "core/resource_manager.h"
 #include "core/util/log.h"
 
+#include "async-writer.h"
+#include "births.h"
+#include "category-index.h"
+#include "cohort-tracker.h"
+#include "compiled-params.h"
+#include "contact-matrices.h"
+#include "couple-table.h"
 #include "datatypes.h"
+#include "household-table.h"
+#include "huge-page-allocator.h"
+#include "partner-notification.h"
+#include "partnership-history.h"
+#include "partnership-intents.h"
 #include "person.h"
+#include "population-snapshot.h"
+#include "regular-matching.h"
 #include "sim-param.h"  // AM: Added to get location_mixing_matrix to update mate_location_distribution_
+#include "statistics-pipeline.h"
+#include "transmission-table.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <random>
@@ -29,40 +46,10 @@
 namespace bdm {
 namespace hiv_malawi {
 
-// This is a small helper class that wraps a vector of Agent pointers. It's a
-// building block of the CategoricalEnvironment because we store a vector of
-// AgentPointer for each of the categorical locations.
-class AgentVector {
- private:
-  // thread-local vector of AgentPointers
-  SharedData<std::vector<AgentPointer<Person>>> agents_;
-  std::vector<uint64_t> offsets_;
-  ThreadInfo* tinfo_ = nullptr;
-  std::atomic<uint64_t> size_;
-  Spinlock lock_;
-  bool dirty_ = false;
-
-  void UpdateOffsets();
-
- public:
-  AgentVector();
-  AgentVector(const AgentVector& other);
-
-  // Get the number of agents in the vector
-  size_t GetNumAgents() const { return size_; }
-
-  // Get a radom agent from the vector agents_
-  AgentPointer<Person> GetRandomAgent();
-
-  // Get a agent at given index in the vector agents_
-  AgentPointer<Person> GetAgentAtIndex(size_t i);
-
-  // Add an AgentPointer to the vector agents_
-  void AddAgent(AgentPointer<Person> agent);
-
-  // Delete vector entries and resize vector to 0
-  void Clear();
-};
+// Index of agent pointers by category. It's a building block of the
+// CategoricalEnvironment because we store the AgentPointers of each of the
+// categorical locations.
+using AgentIndex = CategoryIndex<AgentPointer<Person>>;
 
 // This is our customn BioDynaMo environment to describe the female population
 // at all locations. By knowing the all females at a location, it's easy to
@@ -81,43 +68,102 @@ class CategoricalEnvironment : public Environment {
   size_t no_sociobehavioural_categories_;
   // Vector to store all female agents within a certain age interval
   // [min_age_, max_age_], indexed by location x age x sociobehaviours.
-  std::vector<AgentVector> casual_female_agents_;
+  AgentIndex casual_female_agents_;
   // Vector to store all adult female agents, indexed by location x age x
   // sociobehaviours.
-  std::vector<AgentVector> regular_female_agents_;
+  AgentIndex regular_female_agents_;
   // Vector to store all male agents within a certain age interval
   // [min_age_, max_age_], indexed by location x age x sociobehaviours.
-  std::vector<AgentVector> casual_male_agents_;
+  AgentIndex casual_male_agents_;
+  // Vector to store all men who have sex with men (MSM) within a certain age
+  // interval [min_age_, max_age_], indexed by location x age x
+  // sociobehaviours. Filled in the same pass as casual_female_agents_.
+  AgentIndex casual_msm_agents_;
   // Vector to store all adult single men looking for a regular female partner,
   // indexed by the location x age x sociobehaviours of their potential partner.
-  std::vector<AgentVector> regular_male_agents_;
-  // AM: Vector to store all potential mothers (female between min_age_ and
-  // max_age_), indexed by location only.
-  std::vector<AgentVector> mothers_;
+  AgentIndex regular_male_agents_;
+  // AM: Vector to store all potential mothers (female between min_age and
+  // max_age_birth), indexed by location x fertility age band x state.
+  AgentIndex mothers_;
   // Vector to store all adult agents (male and female older than min_age_),
   // indexed by location. Used to estimate population size per location, and
   // attractiveness.
-  std::vector<AgentVector> adults_;
+  AgentIndex adults_;
   // We only assign mother in the first update.
   bool mothers_are_assiged_;
+  // Index of the replicate that this process simulates (see ForkReplicates).
+  // Offsets the seed of the regular partner matching.
+  uint64_t replicate_ = 0;
 
   // AM: Matrix to store cumulative probability to select a female mate (casual
   // partner) from one compound category (location x age category x
   // sociobehaviour category) given male agent compound category
   std::vector<std::vector<float>> mate_compound_category_distribution_;
 
+  // Same as mate_compound_category_distribution_ for the selection of a male
+  // casual partner by an MSM. Only built if there are MSM.
+  std::vector<std::vector<float>> msm_compound_category_distribution_;
+
   // AM: Matrix to store cumulative probability to select a female regular
   // partner from one compound category (location x age category x
   // sociobehaviour category) given male agent compound category
   std::vector<std::vector<float>> reg_partner_compound_category_distribution_;
 
-  // AM: DEBUG Matrix to store the locations of selected mates
-  std::vector<std::vector<float>> mate_location_frequencies_;
   // AM: Matrix to store the current (year) cumulative probability to
   // relocate/migrate from one origin to one destination location Location x
   // Location
   std::vector<std::vector<float>> migration_location_distribution_;
 
+  // Effective transmission probabilities for all combinations of infector
+  // state and prevention modifiers. Built once in the first update.
+  TransmissionTable transmission_table_;
+
+  // Validated, flat copy of the SimParam tables. Compiled at startup (or in
+  // the first update).
+  CompiledParams compiled_params_;
+
+  // All regular partnerships of the current simulation step and the
+  // serodiscordant sub-index. Rebuilt at every update.
+  CoupleTable couple_table_;
+
+  // Households of the current simulation step. Rebuilt at every update.
+  HouseholdTable household_table_;
+
+  // Births of the current simulation step
+  Births births_;
+
+  // Matching of the single men and women for new regular partnerships, and
+  // its queues and results (kept to reuse the memory)
+  RegularMatching regular_matching_;
+  std::vector<std::vector<MatchingSingle>> matching_men_;
+  std::vector<std::vector<MatchingSingle>> matching_women_;
+  std::vector<MatchingPair> matching_pairs_;
+
+  // Agent statistics computed from snapshots on the I/O thread (pipelined
+  // statistics). Declared before the I/O thread, whose jobs refer to it.
+  StatisticsPipeline statistics_pipeline_;
+
+  // I/O thread of the streaming outputs. Declared before the outputs such that
+  // it outlives them.
+  AsyncWriter async_writer_;
+
+  // Life-history events of the sampled cohort
+  CohortTracker cohort_tracker_;
+  // Realised casual and regular contacts by compound category
+  ContactMatrices contact_matrices_;
+
+  // Writer of the yearly population snapshots (opened by WriteSnapshot)
+  SnapshotWriter snapshot_writer_;
+
+  // Pending changes to partners, mates, children, and mothers
+  PartnershipIntents partnership_intents_;
+
+  // Recent partnerships of all agents
+  PartnershipHistory partnership_history_;
+
+  // Index cases and results of the assisted partner notification
+  PartnerNotification partner_notification_;
+
  protected:
   // This is the update function, the is called automatically by BioDynaMo for
   // every simulation step. We delete the previous information and store a
@@ -131,21 +177,22 @@ class CategoricalEnvironment : public Environment {
   // origin location to destination location. Probability depends on a (location
   // x location) mixing matrix and the adult population size (attractivity) per
   // district
-  void UpdateMigrationLocationProbability(
-      size_t year_index,
-      const std::vector<std::vector<std::vector<float>>>& migration_matrix);
+  void UpdateMigrationLocationProbability(size_t year_index,
+                                          const CompiledParams& params);
 
   // Update (at every iteration) matrix storing the porbability that a male
   // agent selects a casual partner based on their compound categories (location
   // x age category x sociobehaviour category)
-  void UpdateCasualPartnerCategoryDistribution(
-      const std::vector<std::vector<float>>& location_mixing_matrix,
-      const std::vector<std::vector<float>>& age_mixing_matrix,
-      const std::vector<std::vector<float>>& sociobehav_mixing_matrix);
+  void UpdateCasualPartnerCategoryDistribution(const CompiledParams& params);
+
+  // Build the cumulative distributions to select a casual partner from the
+  // given index (casual_female_agents_ or casual_msm_agents_) for all compound
+  // categories of the male agent.
+  void BuildCasualPartnerCategoryDistribution(
+      const AgentIndex& partners, const CompiledParams& params,
+      std::vector<std::vector<float>>* distribution);
 
-  void UpdateRegularPartnerCategoryDistribution(
-      std::vector<std::vector<float>> reg_partner_age_mixing_matrix,
-      std::vector<std::vector<float>> reg_partner_sociobehav_mixing_matrix);
+  void UpdateRegularPartnerCategoryDistribution(const CompiledParams& params);
 
  public:
   // Constructor
@@ -165,6 +212,19 @@ class CategoricalEnvironment : public Environment {
            (no_age_categories_ * no_locations_) * sb;
   }
 
+  // Set the compound category of the person from its location, age, and
+  // socio-behaviour, or -1 if the person is younger than min_age_
+  inline void UpdateCompoundCategory(Person* person) {
+    if (person->age_ < min_age_) {
+      person->compound_category_ = -1;
+      return;
+    }
+    person->compound_category_ = static_cast<int>(ComputeCompoundIndex(
+        person->location_,
+        person->GetAgeCategory(min_age_, no_age_categories_),
+        person->social_behaviour_factor_));
+  }
+
   // Mapping from position in the female_agents_ and male_agents_ index to the
   // appropriate location.
   inline size_t ComputeLocationFromCompoundIndex(size_t i) {
@@ -192,19 +252,19 @@ class CategoricalEnvironment : public Environment {
     return (int)i / (no_age_categories_ * no_locations_);
   }
 
-  // Add an agent pointer to a certain location, age group, and sb category in
-  // casual_female_agents_ index.
-  void AddCasualFemaleToIndex(AgentPointer<Person> agent, size_t location,
-                              size_t age, size_t sb);
-  // Add an agent pointer to a certain location, age group, and sb category in
-  // regular_female_agents_ index.
-  void AddRegularFemaleToIndex(AgentPointer<Person> agent, size_t location,
-                               size_t age, size_t sb);
-
-  // Add an agent pointer to a certain location, age group, and sb category in
-  // casual_male_agents_ index.
-  void AddCasualMaleToIndex(AgentPointer<Person> agent, size_t location,
-                            size_t age, size_t sb);
+  // Add an agent pointer to a certain compound index (location x age group x
+  // sb) category in casual_female_agents_ index.
+  void AddCasualFemaleToIndex(AgentPointer<Person> agent, size_t index);
+  // Add an agent pointer to a certain compound index (location x age group x
+  // sb) category in regular_female_agents_ index.
+  void AddRegularFemaleToIndex(AgentPointer<Person> agent, size_t index);
+
+  // Add an agent pointer to a certain compound index (location x age group x
+  // sb) category in casual_male_agents_ index.
+  void AddCasualMaleToIndex(AgentPointer<Person> agent, size_t index);
+  // Add an agent pointer to a certain compound index (location x age group x
+  // sb) category in casual_msm_agents_ index.
+  void AddCasualMsmToIndex(AgentPointer<Person> agent, size_t index);
   // Add a male agent pointer to a certain compound index (location x age group
   // x sb) category in regular_male_agents_ index.
   void AddRegularMaleToIndex(AgentPointer<Person> agent, size_t index);
@@ -212,8 +272,26 @@ class CategoricalEnvironment : public Environment {
   // Add an adult agent pointer to a certain location in adults_ index
   void AddAdultToLocation(AgentPointer<Person> agent, size_t location);
 
-  // Add an agent pointer to a certain location in mothers_ index
-  void AddMotherToLocation(AgentPointer<Person> agent, size_t location);
+  // Add an agent pointer to a certain location, fertility age band, and state
+  // in mothers_ index
+  void AddMotherToIndex(AgentPointer<Person> agent, size_t location,
+                        size_t age_band, int state);
+
+  // Returns the stratum of the mothers_ index for the given location,
+  // fertility age band, and state
+  size_t GetMotherStratum(size_t location, size_t age_band, int state) const {
+    size_t no_bands =
+        mothers_.GetNumCategories() / (no_locations_ * GemsState::kGemsLast);
+    return (location * no_bands + age_band) * GemsState::kGemsLast + state;
+  }
+
+  // Get the number of strata of the mothers_ index
+  size_t GetNumMotherStrata() const { return mothers_.GetNumCategories(); }
+
+  // Get the potential mothers of a stratum
+  AgentIndex::Category GetMothers(size_t stratum) const {
+    return mothers_[stratum];
+  }
 
   // Returns a random AgentPointer at a specific location, age group, and sb
   // category in casual_female_agents_
@@ -232,6 +310,10 @@ class CategoricalEnvironment : public Environment {
   // age group, and sb category) in regular_female_agents_
   AgentPointer<Person> GetRandomRegularFemaleFromIndex(size_t compound_index);
 
+  // Returns a random AgentPointer at a specific compound category (location,
+  // age group, and sb category) in casual_msm_agents_
+  AgentPointer<Person> GetRandomCasualMsmFromIndex(size_t compound_index);
+
   // Returns a random Potential Mother (AgentPointer) at a specific location
   AgentPointer<Person> GetRandomMotherFromLocation(size_t location);
 
@@ -280,13 +362,102 @@ class CategoricalEnvironment : public Environment {
   int GetNoSociobehaviouralCategories() {
     return no_sociobehavioural_categories_;
   };
-  // AM: Getter of mate_compound_category_distribution_
+  // AM: Getter of mate_compound_category_distribution_ for an agent of the
+  // given compound category
   const std::vector<float>& GetMateCompoundCategoryDistribution(
-      size_t loc, size_t age_category, size_t sociobehav);
+      size_t compound_index) {
+    return mate_compound_category_distribution_[compound_index];
+  }
+
+  // Returns true if MSM were indexed in the last update
+  bool HasMsm() const { return !msm_compound_category_distribution_.empty(); }
+
+  // Getter of msm_compound_category_distribution_ for an agent of the given
+  // compound category
+  const std::vector<float>& GetMsmCompoundCategoryDistribution(
+      size_t compound_index) {
+    return msm_compound_category_distribution_[compound_index];
+  }
 
   // AM: Getter of migration_location_distribution_
   const std::vector<float>& GetMigrationLocDistribution(size_t loc);
 
+  // Samples an index from a cumulative distribution of (unnormalised) weights
+  // with a uniform random number in [0, 1). The total weight, i.e. the last
+  // entry, must be positive; callers skip distributions without candidates.
+  static size_t SampleCumulative(double rand_num,
+                                 const std::vector<float>& cumulative) {
+    assert(!cumulative.empty() && cumulative.back() > 0);
+    auto it = std::upper_bound(cumulative.begin(), cumulative.end(),
+                               rand_num * cumulative.back());
+    if (it == cumulative.end()) {
+      // rand_num * total rounded up to the total: last non-empty category
+      it = std::lower_bound(cumulative.begin(), cumulative.end(),
+                            cumulative.back());
+    }
+    return static_cast<size_t>(it - cumulative.begin());
+  }
+
+  // Getter of the precomputed transmission probabilities
+  const TransmissionTable& GetTransmissionTable() const {
+    return transmission_table_;
+  }
+
+  // Getter of the compiled parameter tables
+  const CompiledParams& GetCompiledParams() const { return compiled_params_; }
+
+  // Assign a mother to each child of the initial population. Only executed
+  // once, i.e. in the first update unless called before.
+  void AssignMothers();
+
+  // Set the index of the replicate that this process simulates
+  void SetReplicate(uint64_t replicate) { replicate_ = replicate; }
+
+  // Apply the parameter overrides of a scenario timeline from its years on
+  void ApplyTimeline(const std::string& filename) {
+    compiled_params_.ApplyTimelineFile(filename);
+  }
+
+  // Validate the parameters and compile the tables used by the behaviours
+  void CompileParams(const SimParam* sparam) {
+    compiled_params_.Compile(sparam);
+  }
+
+  // Getter of the regular partnerships
+  CoupleTable& GetCoupleTable() { return couple_table_; }
+
+  // Getter of the households
+  HouseholdTable& GetHouseholdTable() { return household_table_; }
+
+  // Getter of the birth generation
+  Births& GetBirths() { return births_; }
+
+  // Getter of the I/O thread of the streaming outputs
+  AsyncWriter& GetAsyncWriter() { return async_writer_; }
+
+  // Getter of the pipelined agent statistics
+  StatisticsPipeline& GetStatisticsPipeline() { return statistics_pipeline_; }
+
+  // Getter of the cohort tracker
+  CohortTracker& GetCohortTracker() { return cohort_tracker_; }
+
+  // Getter of the contact matrices
+  ContactMatrices& GetContactMatrices() { return contact_matrices_; }
+
+  // Getter of the population snapshot writer
+  SnapshotWriter& GetSnapshotWriter() { return snapshot_writer_; }
+
+  // Getter of the pending partnership intents
+  PartnershipIntents& GetPartnershipIntents() { return partnership_intents_; }
+
+  // Getter of the partnership history
+  PartnershipHistory& GetPartnershipHistory() { return partnership_history_; }
+
+  // Getter of the partner notification
+  PartnerNotification& GetPartnerNotification() {
+    return partner_notification_;
+  }
+
   // The remaining public functions are inherited from Environment but not
   // needed here.
   void Clear() override { ; };
@@ -0,0 +1,160 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CATEGORY_INDEX_H_
+#define CATEGORY_INDEX_H_
+
+#include <omp.h>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "huge-page-allocator.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Index of agents by category (e.g. the compound category of the casual
+// partners, see CategoricalEnvironment). The agents of all categories are
+// stored in a single buffer, sorted by category, with the offsets of the
+// categories. The buffer of a large population spans several huge pages and is
+// backed according to SimParam::huge_pages; a buffer per category would stay
+// far below the size of a huge page.
+//
+// Agents are added by any thread into thread-local buffers and sorted into the
+// index by Finalize() (counting sort). The agents of a category are in the
+// order of the threads that added them, and of the additions of each thread.
+template <typename T>
+class CategoryIndex {
+ public:
+  // The agents of one category
+  class Category {
+   public:
+    Category(const T* agents, size_t size) : agents_(agents), size_(size) {}
+
+    size_t GetNumAgents() const { return size_; }
+
+    T GetAgentAtIndex(size_t i) const {
+      assert(i < size_);
+      return agents_[i];
+    }
+
+    const T* begin() const { return agents_; }
+    const T* end() const { return agents_ + size_; }
+
+   private:
+    const T* agents_;
+    size_t size_;
+  };
+
+  // Remove all agents and set the number of categories. Must not be called
+  // in a parallel region.
+  void Clear(size_t no_categories) {
+    threads_.resize(omp_get_max_threads());
+    for (auto& thread : threads_) {
+      thread.agents.clear();
+    }
+    agents_.clear();
+    offsets_.assign(no_categories + 1, 0);
+  }
+
+  // Add an agent to the category. Thread-safe; the agent is only visible
+  // after Finalize(). Agents can only be added between Clear() and
+  // Finalize().
+  void AddAgent(const T& agent, size_t category) {
+    assert(category + 1 < offsets_.size());
+    assert(agents_.empty());
+    auto tid = static_cast<size_t>(omp_get_thread_num());
+    assert(tid < threads_.size());
+    threads_[tid].agents.push_back({agent, static_cast<uint32_t>(category)});
+  }
+
+  // Sort the added agents into the index. Must be called before the index is
+  // read, and not in a parallel region.
+  void Finalize() {
+    size_t no_added = 0;
+    for (const auto& thread : threads_) {
+      no_added += thread.agents.size();
+    }
+    if (no_added == 0) {
+      // Nothing added since the last call
+      return;
+    }
+    const size_t no_categories = GetNumCategories();
+    const size_t no_threads = threads_.size();
+    // Position of the first agent of each thread in each category, ordered by
+    // category and thread
+    std::vector<uint64_t> starts(no_categories * no_threads + 1, 0);
+#pragma omp parallel for
+    for (size_t t = 0; t < no_threads; t++) {
+      for (const auto& added : threads_[t].agents) {
+        starts[added.category * no_threads + t]++;
+      }
+    }
+    uint64_t sum = 0;
+    for (auto& el : starts) {
+      uint64_t count = el;
+      el = sum;
+      sum += count;
+    }
+    for (size_t c = 0; c < no_categories; c++) {
+      offsets_[c] = starts[c * no_threads];
+    }
+    offsets_[no_categories] = sum;
+    agents_.resize(sum);
+#pragma omp parallel for
+    for (size_t t = 0; t < no_threads; t++) {
+      std::vector<uint64_t> next(no_categories);
+      for (size_t c = 0; c < no_categories; c++) {
+        next[c] = starts[c * no_threads + t];
+      }
+      for (const auto& added : threads_[t].agents) {
+        agents_[next[added.category]++] = added.agent;
+      }
+      threads_[t].agents.clear();
+    }
+  }
+
+  size_t GetNumCategories() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+  }
+
+  // Number of agents in all categories
+  size_t GetNumAgents() const { return agents_.size(); }
+
+  Category operator[](size_t category) const {
+    assert(category < GetNumCategories());
+    return {agents_.data() + offsets_[category],
+            offsets_[category + 1] - offsets_[category]};
+  }
+
+ private:
+  struct Added {
+    T agent;
+    uint32_t category;
+  };
+
+  // Agents added by one thread. Aligned to avoid false sharing between the
+  // threads.
+  struct alignas(64) ThreadAgents {
+    std::vector<Added, HugePageAllocator<Added>> agents;
+  };
+
+  std::vector<ThreadAgents> threads_;
+  std::vector<T, HugePageAllocator<T>> agents_;
+  std::vector<uint64_t> offsets_;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // CATEGORY_INDEX_H_
@@ -0,0 +1,142 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "cohort-tracker.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+// SplitMix64 finalizer, maps consecutive ids to uniformly distributed hashes
+uint64_t Hash(uint64_t id) {
+  uint64_t z = id + 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+CohortTracker::CohortTracker() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  thread_events_.resize(tinfo->GetMaxThreads());
+}
+
+CohortTracker::~CohortTracker() {
+  // Write the events of the last simulation step
+  if (writer_ != nullptr) {
+    writer_->Flush();
+  }
+  if (file_.is_open()) {
+    writer_ = nullptr;
+    Flush(filename_);
+  }
+}
+
+bool CohortTracker::IsSelected(uint64_t id, float fraction) {
+  if (fraction <= 0) {
+    return false;
+  }
+  return static_cast<double>(Hash(id) >> 11) * 0x1.0p-53 < fraction;
+}
+
+uint64_t CohortTracker::GetChildId(uint64_t mother_id, int birth_year,
+                                   int birth_order) {
+  uint64_t birth = (static_cast<uint64_t>(birth_year) << 32) ^
+                   static_cast<uint64_t>(birth_order);
+  return Hash(Hash(mother_id) ^ birth) | (1ull << 63);
+}
+
+void CohortTracker::Select(Person* person, float fraction) {
+  person->tracked_ = IsSelected(person->cohort_id_, fraction);
+  Record(person, CohortEventType::kEventEnter, static_cast<int>(person->age_),
+         person->sex_);
+  if (!person->IsHealthy()) {
+    Record(person, CohortEventType::kEventStateChange, person->state_);
+  }
+}
+
+void CohortTracker::Add(Person* person, int type, int value, int value2) {
+  auto* sim = Simulation::GetActive();
+  int year = static_cast<int>(sim->GetParam()->Get<SimParam>()->start_year +
+                              sim->GetScheduler()->GetSimulatedSteps());
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  thread_events_[tid].push_back({person->cohort_id_,
+                                 static_cast<int16_t>(year),
+                                 static_cast<uint8_t>(type),
+                                 static_cast<uint8_t>(value2), value});
+}
+
+void CohortTracker::Flush(const std::string& filename) {
+  auto events = std::make_shared<std::vector<CohortEvent>>();
+  for (auto& el : thread_events_) {
+    events->insert(events->end(), el.begin(), el.end());
+    el.clear();
+  }
+  if (writer_ == nullptr) {
+    Write(events.get(), filename);
+    return;
+  }
+  uint64_t bytes = events->size() * sizeof(CohortEvent);
+  writer_->Submit([this, events, filename]() { Write(events.get(), filename); },
+                  bytes);
+}
+
+void CohortTracker::Write(std::vector<CohortEvent>* events,
+                          const std::string& filename) {
+  if (disabled_ || (events->empty() && file_.is_open())) {
+    return;
+  }
+  // Events of one agent may be recorded by different threads. Sort by all
+  // fields to obtain a deterministic file.
+  std::sort(events->begin(), events->end(),
+            [](const CohortEvent& a, const CohortEvent& b) {
+              if (a.id_ != b.id_) {
+                return a.id_ < b.id_;
+              }
+              if (a.year_ != b.year_) {
+                return a.year_ < b.year_;
+              }
+              if (a.type_ != b.type_) {
+                return a.type_ < b.type_;
+              }
+              if (a.value_ != b.value_) {
+                return a.value_ < b.value_;
+              }
+              return a.value2_ < b.value2_;
+            });
+
+  if (!file_.is_open()) {
+    filename_ = filename;
+    file_.open(filename, std::ios::out | std::ios::binary);
+    if (!file_.is_open()) {
+      Log::Warning("CohortTracker::Flush()", "Cannot open cohort file ",
+                   filename, ". Cohort events will be discarded.");
+      disabled_ = true;
+      return;
+    }
+    file_.write("HIVCOH01", 8);
+  }
+  file_.write(reinterpret_cast<const char*>(events->data()),
+              events->size() * sizeof(CohortEvent));
+  file_.flush();
+  no_events_ += events->size();
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,123 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef COHORT_TRACKER_H_
+#define COHORT_TRACKER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "async-writer.h"
+#include "person.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Types of life-history events of tracked agents
+enum CohortEventType {
+  kEventEnter,           // Agent enters the simulation (value: age, value2:
+                         // sex)
+  kEventDebut,           // Sexual debut (value: age)
+  kEventCasualPartner,   // Casual contact (value: 0)
+  kEventRegularPartner,  // New regular partnership (value: 0)
+  kEventInfection,       // HIV infection (value: transmission type, value2:
+                         // state of the infector)
+  kEventStateChange,     // Transition of the GemsState (value: new state)
+  kEventMigration,       // Relocation (value: new location)
+  kEventDeath,           // Death (value: age)
+  kCohortEventLast
+};
+
+// A single life-history event (16 bytes). The event file is a sequence of
+// CohortEvents preceded by an 8 byte header ("HIVCOH01").
+struct CohortEvent {
+  // Person::cohort_id_ of the agent
+  uint64_t id_;
+  int16_t year_;
+  uint8_t type_;
+  uint8_t value2_;
+  int32_t value_;
+};
+
+// The CohortTracker records the life histories of a sampled cohort. Agents are
+// selected deterministically by a hash of their cohort id (Person::cohort_id_)
+// when they enter the simulation (population initialization, birth, or
+// expansion of a compressed child) and flagged with Person::tracked_. Unlike
+// the uids, the cohort ids and hence the cohort do not depend on the thread
+// schedule. Events of tracked agents are
+// written into thread-local buffers; for untracked agents, Record() only
+// checks the flag. The buffers are merged once per year, then sorted and
+// appended to a binary file (on the I/O thread of the AsyncWriter, if set).
+class CohortTracker {
+ public:
+  CohortTracker();
+  ~CohortTracker();
+
+  // Returns true if the agent with the given cohort id belongs to the cohort,
+  // i.e. if its hashed id falls into the given fraction of the hash range.
+  static bool IsSelected(uint64_t id, float fraction);
+
+  // Returns the cohort id of the child of the mother with the given cohort id,
+  // born in the given year after birth_order other children. The ids of
+  // children have the highest bit set, unlike the indexes of the initial
+  // population.
+  static uint64_t GetChildId(uint64_t mother_id, int birth_year,
+                             int birth_order);
+
+  // Flag the agent if it belongs to the cohort and record its entry (and its
+  // state if infected). Must be called after the agent received its cohort id,
+  // age, sex, and state.
+  void Select(Person* person, float fraction);
+
+  // Record an event of a tracked agent. Thread-safe.
+  void Record(Person* person, int type, int value, int value2 = 0) {
+    if (person->tracked_) {
+      Add(person, type, value, value2);
+    }
+  }
+
+  // Append the events recorded since the last call to the given file. The
+  // file is created at the first call.
+  void Flush(const std::string& filename);
+
+  // Hand over the sorting and writing of the events to the given writer
+  void SetWriter(AsyncWriter* writer) { writer_ = writer; }
+
+  // Number of events written to the file so far. Only up to date once the
+  // writer is flushed. Thread-safe.
+  uint64_t GetNumEvents() const { return no_events_.load(); }
+
+ private:
+  // Thread-local event buffers
+  SharedData<std::vector<CohortEvent>> thread_events_;
+  AsyncWriter* writer_ = nullptr;
+  // The members below are only written by Write()
+  std::ofstream file_;
+  std::string filename_;
+  // True if the file could not be opened
+  bool disabled_ = false;
+  // Read by GetNumEvents() while the I/O thread may write
+  std::atomic<uint64_t> no_events_{0};
+
+  void Add(Person* person, int type, int value, int value2);
+
+  // Sort the events and append them to the file
+  void Write(std::vector<CohortEvent>* events, const std::string& filename);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // COHORT_TRACKER_H_
@@ -0,0 +1,464 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "compiled-params.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "core/util/log.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+// Tolerance for the normalisation of (cumulative) distributions
+const float kTolerance = 1e-4;
+
+void Fail(const std::string& name, const std::string& message) {
+  Log::Fatal("CompiledParams::Compile()", "Invalid parameter ", name, ": ",
+             message);
+}
+
+template <typename T>
+void CheckSize(const std::string& name, const std::vector<T>& v,
+               size_t size) {
+  if (v.size() != size) {
+    Fail(name, "expected " + std::to_string(size) + " entries, received " +
+                   std::to_string(v.size()));
+  }
+}
+
+// Check the dimensions of a matrix and append it to the flat table
+void Flatten(const std::string& name,
+             const std::vector<std::vector<float>>& matrix, size_t rows,
+             size_t cols, std::vector<float>* out) {
+  CheckSize(name, matrix, rows);
+  for (auto& row : matrix) {
+    CheckSize(name + " (row)", row, cols);
+    out->insert(out->end(), row.begin(), row.end());
+  }
+}
+
+void CheckSorted(const std::string& name, const std::vector<int>& v) {
+  if (v.empty()) {
+    Fail(name, "must not be empty");
+  }
+  if (!std::is_sorted(v.begin(), v.end()) ||
+      std::adjacent_find(v.begin(), v.end()) != v.end()) {
+    Fail(name, "must be strictly increasing");
+  }
+}
+
+// Check that v is a cumulative distribution, i.e. non-decreasing in [0, 1]
+// and ending with 1. If allow_zero is true, an all-zero vector (no event) is
+// accepted as well. The last element is set to exactly 1.
+void CheckCumulative(const std::string& name, std::vector<float>* v,
+                     bool allow_zero = false) {
+  if (v->empty()) {
+    Fail(name, "must not be empty");
+  }
+  float previous = 0;
+  for (auto p : *v) {
+    if (p < previous || p > 1 + kTolerance) {
+      Fail(name, "must be a non-decreasing cumulative distribution in [0, 1]");
+    }
+    previous = p;
+  }
+  if (allow_zero && v->back() == 0) {
+    return;
+  }
+  if (std::fabs(v->back() - 1) > kTolerance) {
+    Fail(name, "cumulative distribution must end with 1");
+  }
+  // Entries equal to the last one (probability 0 afterwards) are set to 1 as
+  // well
+  float last = v->back();
+  for (auto it = v->rbegin(); it != v->rend() && *it == last; ++it) {
+    *it = 1.0;
+  }
+}
+
+void CheckProbabilities(const std::string& name, const std::vector<float>& v) {
+  for (auto p : v) {
+    if (p < 0 || p > 1) {
+      Fail(name, "probabilities must be in [0, 1]");
+    }
+  }
+}
+
+}  // namespace
+
+void CompiledParams::Compile(const SimParam* sparam) {
+  if (sparam->nb_locations <= 0 || sparam->nb_age_categories <= 0 ||
+      sparam->nb_sociobehav_categories <= 0) {
+    Fail("nb_locations/nb_age_categories/nb_sociobehav_categories",
+         "must be positive");
+  }
+  no_locations_ = sparam->nb_locations;
+  no_age_categories_ = sparam->nb_age_categories;
+  no_sociobehav_categories_ = sparam->nb_sociobehav_categories;
+  const size_t no_states = GemsState::kGemsLast;
+
+  // The multi-dimensional tables of the parameter table file are read from
+  // the mapping, the others were copied by SimParam::LoadParameterTables()
+  tables_.reset();
+  if (!sparam->parameter_table_file.empty()) {
+    tables_.reset(new ParameterTables());
+    if (!tables_->Open(sparam->parameter_table_file)) {
+      Fail("parameter_table_file",
+           "cannot map " + sparam->parameter_table_file);
+    }
+  }
+
+  // Year transitions and the tables that depend on them
+  CheckSorted("no_mates_year_transition", sparam->no_mates_year_transition);
+  size_t no_mates_years = sparam->no_mates_year_transition.size();
+  for (auto* table : {&sparam->no_mates_mean, &sparam->no_mates_sigma,
+                      &sparam->no_acts_mean, &sparam->no_acts_sigma}) {
+    CheckSize("no_mates/no_acts tables", *table, no_mates_years);
+    for (auto& row : *table) {
+      CheckSize("no_mates/no_acts tables (row)", row,
+                no_sociobehav_categories_);
+    }
+  }
+  CheckSorted("no_regacts_year_transition",
+              sparam->no_regacts_year_transition);
+  CheckSize("no_regular_acts_mean", sparam->no_regular_acts_mean,
+            sparam->no_regacts_year_transition.size());
+  CheckSorted("sociobehavioural_risk_year_transition",
+              sparam->sociobehavioural_risk_year_transition);
+  CheckSize("sociobehavioural_risk_probability",
+            sparam->sociobehavioural_risk_probability,
+            sparam->sociobehavioural_risk_year_transition.size());
+  for (auto& row : sparam->sociobehavioural_risk_probability) {
+    CheckSize("sociobehavioural_risk_probability (row)", row, no_states);
+    CheckProbabilities("sociobehavioural_risk_probability", row);
+  }
+  CheckSorted("migration_year_transition", sparam->migration_year_transition);
+  CheckSorted("art_year_transition", sparam->art_year_transition);
+
+  // HIV progression. One population category without ART and one per
+  // population group in each ART era.
+  no_population_categories_ =
+      1 + (sparam->art_year_transition.size() - 1) * kPopulationGroupLast;
+  const float* hiv_transition = GetMappedTable(
+      "hiv_transition_matrix",
+      {no_states, static_cast<uint32_t>(no_population_categories_),
+       no_states});
+  if (hiv_transition == nullptr) {
+    CheckSize("hiv_transition_matrix", sparam->hiv_transition_matrix,
+              no_states);
+    for (auto& state : sparam->hiv_transition_matrix) {
+      CheckSize("hiv_transition_matrix", state, no_population_categories_);
+      for (auto& row : state) {
+        CheckSize("hiv_transition_matrix (row)", row, no_states);
+      }
+    }
+  }
+  hiv_transition_.clear();
+  for (size_t s = 0; s < no_states; s++) {
+    for (size_t c = 0; c < no_population_categories_; c++) {
+      const float* row =
+          hiv_transition != nullptr
+              ? hiv_transition + (s * no_population_categories_ + c) * no_states
+              : sparam->hiv_transition_matrix[s][c].data();
+      std::vector<float> cumulative(row, row + no_states);
+      CheckCumulative("hiv_transition_matrix", &cumulative, true);
+      hiv_transition_.insert(hiv_transition_.end(), cumulative.begin(),
+                             cumulative.end());
+    }
+  }
+
+  // Mortality
+  CheckSize("hiv_mortality_rate", sparam->hiv_mortality_rate, no_states);
+  CheckProbabilities("hiv_mortality_rate", sparam->hiv_mortality_rate);
+  hiv_mortality_ = sparam->hiv_mortality_rate;
+  const auto& age_transition = sparam->mortality_rate_age_transition;
+  CheckSorted("mortality_rate_age_transition", age_transition);
+  CheckSize("mortality_rate_by_age", sparam->mortality_rate_by_age,
+            age_transition.size() + 1);
+  CheckProbabilities("mortality_rate_by_age", sparam->mortality_rate_by_age);
+  // Tabulate per year of age. Ages beyond the table use its last entry.
+  int max_age = std::max(age_transition.back(), sparam->max_age) + 1;
+  age_mortality_.resize(max_age);
+  for (int age = 0; age < max_age; age++) {
+    size_t index = std::upper_bound(age_transition.begin(),
+                                    age_transition.end(), age) -
+                   age_transition.begin();
+    age_mortality_[age] = sparam->mortality_rate_by_age[index];
+  }
+
+  // Socio-behavioural transitions of adults
+  const float* sociobehaviour_transition = GetMappedTable(
+      "sociobehaviour_transition_matrix",
+      {static_cast<uint32_t>(no_sociobehav_categories_), 2,
+       static_cast<uint32_t>(no_sociobehav_categories_)});
+  if (sociobehaviour_transition == nullptr) {
+    CheckSize("sociobehaviour_transition_matrix",
+              sparam->sociobehaviour_transition_matrix,
+              no_sociobehav_categories_);
+    for (auto& sb : sparam->sociobehaviour_transition_matrix) {
+      CheckSize("sociobehaviour_transition_matrix", sb, 2);
+      for (auto& row : sb) {
+        CheckSize("sociobehaviour_transition_matrix (row)", row,
+                  no_sociobehav_categories_);
+      }
+    }
+  }
+  low_risk_probability_.clear();
+  for (size_t sb = 0; sb < no_sociobehav_categories_; sb++) {
+    for (size_t sex = 0; sex < 2; sex++) {
+      const float* row =
+          sociobehaviour_transition != nullptr
+              ? sociobehaviour_transition +
+                    (sb * 2 + sex) * no_sociobehav_categories_
+              : sparam->sociobehaviour_transition_matrix[sb][sex].data();
+      std::vector<float> probabilities(row, row + no_sociobehav_categories_);
+      CheckProbabilities("sociobehaviour_transition_matrix", probabilities);
+      float sum = 0;
+      for (auto p : probabilities) {
+        sum += p;
+      }
+      if (std::fabs(sum - 1) > kTolerance) {
+        Fail("sociobehaviour_transition_matrix", "rows must sum up to 1");
+      }
+      low_risk_probability_.push_back(row[0]);
+    }
+  }
+
+  // Mixing matrices
+  MapOrFlatten("location_mixing_matrix", sparam->location_mixing_matrix,
+               no_locations_, no_locations_, &location_mixing_);
+  MapOrFlatten("age_mixing_matrix", sparam->age_mixing_matrix,
+               no_age_categories_, no_age_categories_, &age_mixing_);
+  MapOrFlatten("sociobehav_mixing_matrix", sparam->sociobehav_mixing_matrix,
+               no_sociobehav_categories_, no_sociobehav_categories_,
+               &sociobehav_mixing_);
+  MapOrFlatten("reg_partner_age_mixing_matrix",
+               sparam->reg_partner_age_mixing_matrix, no_age_categories_,
+               no_age_categories_, &reg_partner_age_mixing_);
+  MapOrFlatten("reg_partner_sociobehav_mixing_matrix",
+               sparam->reg_partner_sociobehav_mixing_matrix,
+               no_sociobehav_categories_, no_sociobehav_categories_,
+               &reg_partner_sociobehav_mixing_);
+  size_t no_migration_years = sparam->migration_year_transition.size();
+  migration_.owned.clear();
+  migration_.data = GetMappedTable(
+      "migration_matrix", {static_cast<uint32_t>(no_migration_years),
+                           static_cast<uint32_t>(no_locations_),
+                           static_cast<uint32_t>(no_locations_)});
+  if (migration_.data == nullptr) {
+    CheckSize("migration_matrix", sparam->migration_matrix,
+              no_migration_years);
+    for (auto& matrix : sparam->migration_matrix) {
+      Flatten("migration_matrix", matrix, no_locations_, no_locations_,
+              &migration_.owned);
+    }
+    migration_.data = migration_.owned.data();
+  }
+
+  // Distributions of the population initialization
+  auto male_age = sparam->male_age_distribution;
+  CheckCumulative("male_age_distribution", &male_age);
+  auto female_age = sparam->female_age_distribution;
+  CheckCumulative("female_age_distribution", &female_age);
+  auto location = sparam->location_distribution;
+  CheckCumulative("location_distribution", &location);
+  CheckSize("location_distribution", location, no_locations_);
+
+  // Fertility
+  CheckSorted("fertility_age_bands", sparam->fertility_age_bands);
+  if (!sparam->fertility_rates.empty()) {
+    CheckSize("fertility_rates", sparam->fertility_rates,
+              sparam->fertility_age_bands.size());
+    CheckProbabilities("fertility_rates", sparam->fertility_rates);
+  }
+
+  CompileTimeline(sparam);
+}
+
+namespace {
+
+// Index of the period of a year transition table that contains the given year.
+// Years before the first transition use the first period.
+int GetPeriod(const std::vector<int>& year_transition, int year) {
+  int index = static_cast<int>(std::upper_bound(year_transition.begin(),
+                                                year_transition.end(), year) -
+                               year_transition.begin()) -
+              1;
+  return index < 0 ? 0 : index;
+}
+
+// Returns the entry of a YearParams block with the given parameter name (and
+// index for per-category parameters), or nullptr if there is none
+float* Resolve(YearParams* block, const std::string& name, size_t index) {
+  if (name == "no_regular_acts_mean") {
+    return &block->no_regular_acts_mean;
+  } else if (name == "migration_probability") {
+    return &block->migration_probability;
+  } else if (name == "biomedical_risk_probability") {
+    return &block->biomedical_risk_probability;
+  } else if (name == "prep_probability") {
+    return &block->prep_probability;
+  } else if (name == "vmmc_probability") {
+    return &block->vmmc_probability;
+  } else if (name == "condom_use_probability") {
+    return &block->condom_use_probability;
+  } else if (name == "birth_infection_probability_treated") {
+    return &block->birth_infection_probability_treated;
+  } else if (name == "birth_infection_probability_untreated") {
+    return &block->birth_infection_probability_untreated;
+  } else if (name == "birth_infection_probability_prophylaxis") {
+    return &block->birth_infection_probability_prophylaxis;
+  }
+  std::vector<float>* vector = nullptr;
+  if (name == "no_mates_mean") {
+    vector = &block->no_mates_mean;
+  } else if (name == "no_mates_sigma") {
+    vector = &block->no_mates_sigma;
+  } else if (name == "no_acts_mean") {
+    vector = &block->no_acts_mean;
+  } else if (name == "no_acts_sigma") {
+    vector = &block->no_acts_sigma;
+  } else if (name == "sociobehavioural_risk_probability") {
+    vector = &block->sociobehavioural_risk_probability;
+  }
+  if (vector == nullptr || index >= vector->size()) {
+    return nullptr;
+  }
+  return &(*vector)[index];
+}
+
+}  // namespace
+
+const float* CompiledParams::GetMappedTable(
+    const std::string& name, const std::vector<uint32_t>& dims) const {
+  if (tables_ == nullptr) {
+    return nullptr;
+  }
+  std::vector<uint32_t> mapped_dims;
+  const float* data = tables_->Get(name, &mapped_dims);
+  if (data != nullptr && mapped_dims != dims) {
+    std::string expected;
+    for (auto dim : dims) {
+      expected += (expected.empty() ? "" : " x ") + std::to_string(dim);
+    }
+    Fail(name, "expected a table of " + expected + " entries in " +
+                   "parameter_table_file");
+  }
+  return data;
+}
+
+void CompiledParams::MapOrFlatten(
+    const std::string& name, const std::vector<std::vector<float>>& matrix,
+    size_t rows, size_t cols, Table* table) const {
+  table->owned.clear();
+  table->data = GetMappedTable(
+      name, {static_cast<uint32_t>(rows), static_cast<uint32_t>(cols)});
+  if (table->data == nullptr) {
+    Flatten(name, matrix, rows, cols, &table->owned);
+    table->data = table->owned.data();
+  }
+}
+
+void CompiledParams::CompileTimeline(const SimParam* sparam) {
+  first_year_ = static_cast<int>(sparam->start_year);
+  // One block more than the number of iterations for the operations that run
+  // after the last step
+  size_t no_years = sparam->number_of_iterations + 1;
+  years_.resize(no_years);
+  for (size_t y = 0; y < no_years; y++) {
+    auto& block = years_[y];
+    int year = first_year_ + static_cast<int>(y);
+    block.year = year;
+    block.art_era = GetPeriod(sparam->art_year_transition, year);
+    block.migration_index = GetPeriod(sparam->migration_year_transition, year);
+    block.no_regular_acts_mean = sparam->no_regular_acts_mean[GetPeriod(
+        sparam->no_regacts_year_transition, year)];
+    block.migration_probability = sparam->migration_probability;
+    block.biomedical_risk_probability = sparam->biomedical_risk_probability;
+    block.prep_probability = sparam->prep_probability;
+    block.vmmc_probability = sparam->vmmc_probability;
+    block.condom_use_probability = sparam->condom_use_probability;
+    block.birth_infection_probability_treated =
+        sparam->birth_infection_probability_treated;
+    block.birth_infection_probability_untreated =
+        sparam->birth_infection_probability_untreated;
+    block.birth_infection_probability_prophylaxis =
+        sparam->birth_infection_probability_prophylaxis;
+    int mates_period = GetPeriod(sparam->no_mates_year_transition, year);
+    block.no_mates_mean = sparam->no_mates_mean[mates_period];
+    block.no_mates_sigma = sparam->no_mates_sigma[mates_period];
+    block.no_acts_mean = sparam->no_acts_mean[mates_period];
+    block.no_acts_sigma = sparam->no_acts_sigma[mates_period];
+    block.sociobehavioural_risk_probability =
+        sparam->sociobehavioural_risk_probability[GetPeriod(
+            sparam->sociobehavioural_risk_year_transition, year)];
+  }
+  if (!sparam->timeline_file.empty()) {
+    ApplyTimelineFile(sparam->timeline_file);
+  }
+}
+
+void CompiledParams::ApplyTimelineFile(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    Fail("timeline_file", "cannot open " + filename);
+  }
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    // year,parameter,value[,index]
+    std::stringstream row(line);
+    std::string year_str, name, value_str, index_str;
+    std::getline(row, year_str, ',');
+    std::getline(row, name, ',');
+    std::getline(row, value_str, ',');
+    std::getline(row, index_str, ',');
+    std::string where = filename + ":" + std::to_string(line_number);
+    int year = 0;
+    float value = 0;
+    size_t index = 0;
+    try {
+      year = std::stoi(year_str);
+      value = std::stof(value_str);
+      if (!index_str.empty()) {
+        index = std::stoul(index_str);
+      }
+    } catch (const std::exception&) {
+      Fail("timeline_file", "cannot parse " + where);
+    }
+
+    if (Resolve(&years_[0], name, index) == nullptr) {
+      Fail("timeline_file", "unknown parameter or index out of range in " +
+                                where);
+    }
+    // The override applies from the given year on
+    for (auto& block : years_) {
+      if (block.year >= year) {
+        *Resolve(&block, name, index) = value;
+      }
+    }
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,218 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef COMPILED_PARAMS_H_
+#define COMPILED_PARAMS_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "datatypes.h"
+#include "parameter-tables.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Parameters of one simulated year, with all year transitions and timeline
+// overrides applied
+struct YearParams {
+  int year;
+  // ART era (index into art_year_transition). Era 0 has no ART.
+  int art_era;
+  // Index into the migration_matrix
+  int migration_index;
+  float no_regular_acts_mean;
+  float migration_probability;
+  float biomedical_risk_probability;
+  float prep_probability;
+  float vmmc_probability;
+  float condom_use_probability;
+  float birth_infection_probability_treated;
+  float birth_infection_probability_untreated;
+  float birth_infection_probability_prophylaxis;
+  // Per socio-behavioural category
+  std::vector<float> no_mates_mean;
+  std::vector<float> no_mates_sigma;
+  std::vector<float> no_acts_mean;
+  std::vector<float> no_acts_sigma;
+  // Per GemsState
+  std::vector<float> sociobehavioural_risk_probability;
+};
+
+// Read-optimised copy of the SimParam tables, compiled once at startup.
+// Compile() validates the dimensions, the sortedness of the year and age
+// transitions, and the normalisation of all (cumulative) distributions, and
+// aborts with Log::Fatal if an invariant is violated. The tables are stored
+// flat (row-major), such that the behaviours and the environment can read them
+// without bounds checks or fallbacks. The mixing and migration matrices of the
+// parameter table file (SimParam::parameter_table_file) are read in place; the
+// file stays mapped as long as the CompiledParams.
+//
+// All year-dependent parameters are compiled into one YearParams block per
+// simulated year (timeline). The blocks combine the *_year_transition tables,
+// the ART eras, and the overrides of the optional timeline file, such that
+// the behaviours read the parameters of the current year in O(1).
+class CompiledParams {
+ public:
+  // Population groups of the hiv_transition_matrix within an ART era
+  enum PopulationGroup {
+    kWomen15To40,
+    kChildren,
+    kOthers,
+    kPopulationGroupLast
+  };
+
+  CompiledParams() = default;
+
+  // The tables may point into the object
+  CompiledParams(const CompiledParams&) = delete;
+  CompiledParams& operator=(const CompiledParams&) = delete;
+
+  // Validate the parameters and build the flat tables and the timeline
+  void Compile(const SimParam* sparam);
+
+  // Apply the overrides of a timeline file (see SimParam::timeline_file) to
+  // the compiled years, e.g. of sparam->timeline_file or of a scenario
+  void ApplyTimelineFile(const std::string& filename);
+
+  // Returns the parameters of the given year. Years outside of the simulated
+  // period use the first or last compiled year.
+  const YearParams& GetYearParams(int year) const {
+    int index = year - first_year_;
+    if (index < 0) {
+      index = 0;
+    } else if (index >= static_cast<int>(years_.size())) {
+      index = years_.size() - 1;
+    }
+    return years_[index];
+  }
+
+  // Returns the population category (second index of the
+  // hiv_transition_matrix) of an agent in the given ART era. Era 0 has a
+  // single category for everyone.
+  static int GetPopulationCategory(int art_era, int sex, float age) {
+    if (art_era == 0) {
+      return 0;
+    }
+    int group = kOthers;
+    if (sex == Sex::kFemale && age >= 15 && age <= 40) {
+      group = kWomen15To40;
+    } else if (age < 15) {
+      group = kChildren;
+    }
+    return 1 + (art_era - 1) * kPopulationGroupLast + group;
+  }
+
+  // Returns true if Compile() has been called
+  bool IsCompiled() const { return !hiv_transition_.empty(); }
+
+  // Cumulative probabilities (GemsState::kGemsLast entries) to transition from
+  // the given state in the given population category. All zero if the state
+  // does not change.
+  const float* GetHivTransition(int state, int population_category) const {
+    return &hiv_transition_[(state * no_population_categories_ +
+                             population_category) *
+                            GemsState::kGemsLast];
+  }
+
+  // Annual HIV-related mortality of the given state
+  float GetHivMortality(int state) const { return hiv_mortality_[state]; }
+
+  // Annual age-related mortality, tabulated per year of age
+  float GetAgeMortality(float age) const {
+    size_t index = static_cast<size_t>(age);
+    return age_mortality_[index < age_mortality_.size()
+                              ? index
+                              : age_mortality_.size() - 1];
+  }
+
+  // Probability that an adult of the given socio-behaviour and sex has a low
+  // risk socio-behaviour in the next year
+  float GetLowRiskProbability(int sociobehaviour, int sex) const {
+    return low_risk_probability_[sociobehaviour * 2 + sex];
+  }
+
+  // Mixing weights of the casual and regular partner selection
+  float GetLocationMixing(size_t from, size_t to) const {
+    return location_mixing_.data[from * no_locations_ + to];
+  }
+  float GetAgeMixing(size_t from, size_t to) const {
+    return age_mixing_.data[from * no_age_categories_ + to];
+  }
+  float GetSociobehavMixing(size_t from, size_t to) const {
+    return sociobehav_mixing_.data[from * no_sociobehav_categories_ + to];
+  }
+  float GetRegPartnerAgeMixing(size_t from, size_t to) const {
+    return reg_partner_age_mixing_.data[from * no_age_categories_ + to];
+  }
+  float GetRegPartnerSociobehavMixing(size_t from, size_t to) const {
+    return reg_partner_sociobehav_mixing_
+        .data[from * no_sociobehav_categories_ + to];
+  }
+
+  // Migration weight from one location to another in the given period of
+  // migration_year_transition
+  float GetMigration(size_t year_index, size_t from, size_t to) const {
+    return migration_
+        .data[(year_index * no_locations_ + from) * no_locations_ + to];
+  }
+
+ private:
+  size_t no_locations_ = 0;
+  size_t no_age_categories_ = 0;
+  size_t no_sociobehav_categories_ = 0;
+  size_t no_population_categories_ = 0;
+
+  int first_year_ = 0;
+  std::vector<YearParams> years_;
+
+  std::vector<float> hiv_transition_;
+  std::vector<float> hiv_mortality_;
+  std::vector<float> age_mortality_;
+  std::vector<float> low_risk_probability_;
+
+  // Flat table that is either read in place from the mapped parameter table
+  // file or owned
+  struct Table {
+    const float* data = nullptr;
+    std::vector<float> owned;
+  };
+  Table location_mixing_;
+  Table age_mixing_;
+  Table sociobehav_mixing_;
+  Table reg_partner_age_mixing_;
+  Table reg_partner_sociobehav_mixing_;
+  Table migration_;
+
+  std::unique_ptr<ParameterTables> tables_;
+
+  // Returns the table of the parameter table file with the given name, or
+  // nullptr if there is none. Aborts if the dimensions do not match.
+  const float* GetMappedTable(const std::string& name,
+                              const std::vector<uint32_t>& dims) const;
+
+  // Point the table to the mapped table of the given name, or to a flat copy
+  // of the matrix of the SimParam member
+  void MapOrFlatten(const std::string& name,
+                    const std::vector<std::vector<float>>& matrix,
+                    size_t rows, size_t cols, Table* table) const;
+
+  // Build the YearParams of the simulated years
+  void CompileTimeline(const SimParam* sparam);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // COMPILED_PARAMS_H_
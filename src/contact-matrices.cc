@@ -0,0 +1,127 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "contact-matrices.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+const char* const kContactTypeNames[kContactTypeLast] = {"casual", "msm",
+                                                         "regular"};
+const char* const kMixingDimensionNames[kMixingDimensionLast] = {
+    "location", "age", "sociobehaviour"};
+
+}  // namespace
+
+ContactMatrices::ContactMatrices() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  thread_counts_.resize(tinfo->GetMaxThreads());
+}
+
+ContactMatrices::~ContactMatrices() {
+  // Write the contacts of the last simulation step
+  if (writer_ != nullptr) {
+    writer_->Flush();
+  }
+  if (file_.is_open()) {
+    writer_ = nullptr;
+    Flush(filename_, year_);
+  }
+}
+
+void ContactMatrices::Enable(size_t no_locations, size_t no_age_categories,
+                             size_t no_sociobehavioural_categories) {
+  no_locations_ = no_locations;
+  no_age_categories_ = no_age_categories;
+  sizes_[kLocationMixing] = no_locations;
+  sizes_[kAgeMixing] = no_age_categories;
+  sizes_[kSociobehaviourMixing] = no_sociobehavioural_categories;
+  matrix_size_ = 0;
+  for (int d = 0; d < kMixingDimensionLast; d++) {
+    offsets_[d] = matrix_size_;
+    matrix_size_ += sizes_[d] * sizes_[d];
+  }
+  for (auto& counts : thread_counts_) {
+    counts.assign(kContactTypeLast * matrix_size_, 0);
+  }
+  totals_.assign(kContactTypeLast * matrix_size_, 0);
+}
+
+void ContactMatrices::Flush(const std::string& filename, int year) {
+  if (!IsEnabled()) {
+    return;
+  }
+  // Dense merge of the thread-local counts in a fixed order
+  auto counts =
+      std::make_shared<std::vector<uint64_t>>(kContactTypeLast * matrix_size_);
+  for (auto& el : thread_counts_) {
+    for (size_t i = 0; i < el.size(); i++) {
+      (*counts)[i] += el[i];
+    }
+    std::fill(el.begin(), el.end(), 0);
+  }
+  int counts_year = year_;
+  year_ = year;
+  if (writer_ == nullptr) {
+    Write(*counts, counts_year, filename);
+    return;
+  }
+  uint64_t bytes = counts->size() * sizeof(uint64_t);
+  writer_->Submit(
+      [this, counts, counts_year, filename]() {
+        Write(*counts, counts_year, filename);
+      },
+      bytes);
+}
+
+void ContactMatrices::Write(const std::vector<uint64_t>& counts, int year,
+                            const std::string& filename) {
+  if (disabled_) {
+    return;
+  }
+  if (!file_.is_open()) {
+    filename_ = filename;
+    file_.open(filename, std::ios::out);
+    if (!file_.is_open()) {
+      Log::Warning("ContactMatrices::Flush()", "Cannot open ", filename,
+                   ". Contacts will be discarded.");
+      disabled_ = true;
+      return;
+    }
+    file_ << "year,type,dimension,row,column,count\n";
+  }
+  for (int t = 0; t < kContactTypeLast; t++) {
+    for (int d = 0; d < kMixingDimensionLast; d++) {
+      for (size_t row = 0; row < sizes_[d]; row++) {
+        for (size_t column = 0; column < sizes_[d]; column++) {
+          size_t i = t * matrix_size_ + Cell(d, row, column);
+          if (counts[i] == 0) {
+            continue;
+          }
+          file_ << year << "," << kContactTypeNames[t] << ","
+                << kMixingDimensionNames[d] << "," << row << "," << column
+                << "," << counts[i] << "\n";
+          totals_[i] += counts[i];
+        }
+      }
+    }
+  }
+  file_.flush();
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
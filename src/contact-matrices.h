@@ -0,0 +1,138 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef CONTACT_MATRICES_H_
+#define CONTACT_MATRICES_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "async-writer.h"
+#include "biodynamo.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Types of realised contacts
+enum ContactType {
+  kCasualContactMixing,   // Casual contact of a male with a female mate
+  kMsmContactMixing,      // Casual contact of an MSM with a male mate
+  kRegularContactMixing,  // New regular partnership
+  kContactTypeLast
+};
+
+// Dimensions of the compound categories (location x age category x
+// sociobehaviour)
+enum MixingDimension {
+  kLocationMixing,
+  kAgeMixing,
+  kSociobehaviourMixing,
+  kMixingDimensionLast
+};
+
+// The ContactMatrices count the realised contacts by the compound categories
+// of the agent that chose the contact (rows) and of its mate (columns), one
+// matrix per contact type and dimension. They validate the mixing assumptions
+// (e.g. mate_compound_category_distribution_) against the contacts that are
+// realised in the simulation. Contacts are counted in thread-local dense
+// matrices; Record() costs three increments. The counts are merged once per
+// year and appended to a CSV file with lines
+// "year,type,dimension,row,column,count" (on the I/O thread of the
+// AsyncWriter, if set). Cells without contacts are omitted.
+class ContactMatrices {
+ public:
+  ContactMatrices();
+  ~ContactMatrices();
+
+  // Start counting with the given number of categories of each dimension.
+  // The compound categories are laid out as in
+  // CategoricalEnvironment::ComputeCompoundIndex.
+  void Enable(size_t no_locations, size_t no_age_categories,
+              size_t no_sociobehavioural_categories);
+
+  bool IsEnabled() const { return matrix_size_ > 0; }
+
+  // Count a contact of the given type between an agent and its mate, given by
+  // their compound categories. Thread-safe; does nothing if not enabled.
+  void Record(int type, size_t category, size_t mate_category) {
+    if (!IsEnabled()) {
+      return;
+    }
+    auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+    uint64_t* counts = thread_counts_[tid].data() + type * matrix_size_;
+    counts[Cell(kLocationMixing, Location(category),
+                Location(mate_category))]++;
+    counts[Cell(kAgeMixing, Age(category), Age(mate_category))]++;
+    counts[Cell(kSociobehaviourMixing, Sociobehaviour(category),
+                Sociobehaviour(mate_category))]++;
+  }
+
+  // Append the contacts recorded since the last call to the given file, as
+  // the contacts of the year given at the last call. The following contacts
+  // are recorded for the given year. The file is created at the first call.
+  void Flush(const std::string& filename, int year);
+
+  // Hand over the writing of the matrices to the given writer
+  void SetWriter(AsyncWriter* writer) { writer_ = writer; }
+
+  // Number of contacts written to the file so far, in the given cell. Only up
+  // to date once the writer is flushed.
+  uint64_t GetTotal(int type, int dimension, size_t row, size_t column) const {
+    return totals_[type * matrix_size_ + Cell(dimension, row, column)];
+  }
+
+ private:
+  size_t no_locations_ = 0;
+  size_t no_age_categories_ = 0;
+  // Number of cells of the matrices of one contact type, and offsets of the
+  // matrices of each dimension
+  size_t matrix_size_ = 0;
+  size_t offsets_[kMixingDimensionLast] = {};
+  size_t sizes_[kMixingDimensionLast] = {};
+  // Year of the contacts that are currently recorded
+  int year_ = 0;
+  // Thread-local dense counts of all contact types
+  SharedData<std::vector<uint64_t>> thread_counts_;
+  AsyncWriter* writer_ = nullptr;
+  // The members below are only accessed by Write()
+  std::vector<uint64_t> totals_;
+  std::ofstream file_;
+  std::string filename_;
+  // True if the file could not be opened
+  bool disabled_ = false;
+
+  size_t Location(size_t category) const {
+    return (category % (no_age_categories_ * no_locations_)) /
+           no_age_categories_;
+  }
+  size_t Age(size_t category) const {
+    return (category % (no_age_categories_ * no_locations_)) %
+           no_age_categories_;
+  }
+  size_t Sociobehaviour(size_t category) const {
+    return category / (no_age_categories_ * no_locations_);
+  }
+  size_t Cell(int dimension, size_t row, size_t column) const {
+    return offsets_[dimension] + row * sizes_[dimension] + column;
+  }
+
+  // Append the non-zero counts to the file
+  void Write(const std::vector<uint64_t>& counts, int year,
+             const std::string& filename);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // CONTACT_MATRICES_H_
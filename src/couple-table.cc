@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "couple-table.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+CoupleTable::CoupleTable() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  thread_couples_.resize(tinfo->GetMaxThreads());
+}
+
+void CoupleTable::Clear() {
+  for (auto& el : thread_couples_) {
+    el.clear();
+  }
+  couples_.clear();
+  serodiscordant_.clear();
+}
+
+void CoupleTable::AddCouple(AgentPointer<Person> male,
+                            AgentPointer<Person> female, int formation_year) {
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  thread_couples_[tid].push_back({male, female, formation_year});
+}
+
+void CoupleTable::Finalize() {
+  size_t no_couples = 0;
+  for (auto& el : thread_couples_) {
+    no_couples += el.size();
+  }
+  couples_.reserve(no_couples);
+  for (auto& el : thread_couples_) {
+    couples_.insert(couples_.end(), el.begin(), el.end());
+    el.clear();
+  }
+
+  // Build the serodiscordant sub-index
+  for (size_t i = 0; i < couples_.size(); i++) {
+    if (couples_[i].male_->IsHealthy() != couples_[i].female_->IsHealthy()) {
+      serodiscordant_.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+void CoupleTable::Transmit(const TransmissionTable& transmission_table,
+                           float no_acts, float max_age,
+                           CohortTracker* tracker) {
+  const int64_t no_discordant = serodiscordant_.size();
+  probabilities_.resize(no_discordant);
+
+  // Step 1: Look up the transmission probability of every serodiscordant
+  // couple.
+#pragma omp parallel for
+  for (int64_t k = 0; k < no_discordant; k++) {
+    auto& couple = couples_[serodiscordant_[k]];
+    Person* male = couple.male_.Get();
+    Person* female = couple.female_.Get();
+    if (male->age_ >= max_age) {
+      probabilities_[k] = 0.0;
+    } else if (male->IsHealthy()) {
+      probabilities_[k] = transmission_table.GetProbability(
+          TransmissionDirection::kFemaleToMale, female->state_,
+          female->prevention_, male->prevention_, no_acts);
+    } else {
+      probabilities_[k] = transmission_table.GetProbability(
+          TransmissionDirection::kMaleToFemale, male->state_,
+          male->prevention_, female->prevention_, no_acts);
+    }
+  }
+
+  // Step 2: Sample the transmissions. Every agent belongs to at most one
+  // couple, hence no synchronization is required.
+#pragma omp parallel for
+  for (int64_t k = 0; k < no_discordant; k++) {
+    if (probabilities_[k] <= 0.0) {
+      continue;
+    }
+    auto* random = Simulation::GetActive()->GetRandom();
+    if (random->Uniform() < probabilities_[k]) {
+      auto& couple = couples_[serodiscordant_[k]];
+      Person* male = couple.male_.Get();
+      Person* female = couple.female_.Get();
+      Person* infected = male->IsHealthy() ? female : male;
+      Person* healthy = male->IsHealthy() ? male : female;
+      healthy->BecomeInfected(TransmissionType::kRegularPartner,
+                              infected->state_,
+                              infected->social_behaviour_factor_);
+      if (tracker != nullptr) {
+        tracker->Record(healthy, CohortEventType::kEventInfection,
+                        TransmissionType::kRegularPartner, infected->state_);
+      }
+    }
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,96 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef COUPLE_TABLE_H_
+#define COUPLE_TABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cohort-tracker.h"
+#include "person.h"
+#include "transmission-table.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// A regular partnership between a male and a female agent.
+struct Couple {
+  AgentPointer<Person> male_;
+  AgentPointer<Person> female_;
+  // Year in which the partnership was formed
+  int formation_year_;
+};
+
+// The CoupleTable stores all regular partnerships of the current simulation
+// step in one contiguous array together with the subset of serodiscordant
+// couples. Only serodiscordant couples can transmit HIV, hence the yearly
+// regular transmission only iterates over this (small) sub-index instead of
+// visiting every male agent.
+//
+// The table is rebuilt by the CategoricalEnvironment at every update: couples
+// are collected into thread-local buffers during the indexing pass and the
+// regular partner matching, and merged in Finalize(). Breakups and deaths
+// therefore drop out of the table at the next update.
+class CoupleTable {
+ public:
+  CoupleTable();
+
+  // Delete all couples. Must be called before the first AddCouple of an update.
+  void Clear();
+
+  // Add a couple to the thread-local buffer of the calling thread. Thread-safe.
+  void AddCouple(AgentPointer<Person> male, AgentPointer<Person> female,
+                 int formation_year);
+
+  // Merge the thread-local buffers into the couple array and build the
+  // serodiscordant sub-index.
+  void Finalize();
+
+  // Get the number of couples
+  size_t GetNumCouples() const { return couples_.size(); }
+
+  // Get the number of serodiscordant couples
+  size_t GetNumSerodiscordantCouples() const { return serodiscordant_.size(); }
+
+  // Get the couple at index i
+  const Couple& GetCouple(size_t i) const { return couples_[i]; }
+
+  // Get the indices (in the couple array) of all serodiscordant couples
+  const std::vector<uint32_t>& GetSerodiscordantCouples() const {
+    return serodiscordant_;
+  }
+
+  // Run one year of regular transmission in all serodiscordant couples. The
+  // infected partner infects the healthy one with the probability given by
+  // the transmission table for no_acts acts. Couples with a male older than
+  // max_age do not have intercourse. Infections of tracked agents are recorded
+  // by tracker (if not nullptr).
+  void Transmit(const TransmissionTable& transmission_table, float no_acts,
+                float max_age, CohortTracker* tracker = nullptr);
+
+ private:
+  // Thread-local couple buffers, filled by AddCouple
+  SharedData<std::vector<Couple>> thread_couples_;
+  // All couples of the current simulation step
+  std::vector<Couple> couples_;
+  // Indices of the serodiscordant couples in couples_
+  std::vector<uint32_t> serodiscordant_;
+  // Transmission probability of each serodiscordant couple. Member variable to
+  // avoid reallocations.
+  std::vector<float> probabilities_;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // COUPLE_TABLE_H_
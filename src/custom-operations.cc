@@ -29,5 +29,127 @@ void ResetCasualPartners::operator()() {
   rm->ForEachAgentParallel(reset_functor);
 }
 
+void GiveBirths::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  int year = static_cast<int>(
+      sparam->start_year +
+      sim->GetScheduler()->GetSimulatedSteps());  // Current year
+  env->GetBirths().Generate(env, sparam, sim->GetRandom(), year);
+}
+
+void WriteSnapshot::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  auto& writer = env->GetSnapshotWriter();
+  if (!writer.IsOpen() &&
+      !writer.Open(sparam->snapshot_file, sparam->snapshot_rows_per_group,
+                   &env->GetAsyncWriter())) {
+    Log::Fatal("WriteSnapshot", "Cannot open snapshot file ",
+               sparam->snapshot_file);
+  }
+  int year = static_cast<int>(
+      sparam->start_year +
+      sim->GetScheduler()->GetSimulatedSteps());  // Current year
+
+  // Gather the columns in thread-local buffers
+  SharedData<std::vector<SnapshotRow>> thread_rows;
+  thread_rows.resize(ThreadInfo::GetInstance()->GetMaxThreads());
+  auto gather = L2F([&](Agent* agent) {
+    auto* person = bdm_static_cast<Person*>(agent);
+    SnapshotRow row;
+    row.values[kColumnUid] = static_cast<int64_t>(
+        static_cast<uint64_t>(person->GetUid()));
+    row.values[kColumnAge] = static_cast<int64_t>(person->age_);
+    row.values[kColumnSex] = person->sex_;
+    row.values[kColumnLocation] = person->location_;
+    row.values[kColumnState] = person->state_;
+    row.values[kColumnSocioBehaviour] = person->social_behaviour_factor_;
+    row.values[kColumnPartnerUid] =
+        person->partner_ != nullptr
+            ? static_cast<int64_t>(
+                  static_cast<uint64_t>(person->partner_->GetUid()))
+            : -1;
+    row.values[kColumnMotherUid] =
+        person->mother_ != nullptr
+            ? static_cast<int64_t>(
+                  static_cast<uint64_t>(person->mother_->GetUid()))
+            : -1;
+    row.values[kColumnTransmissionType] =
+        person->IsHealthy() ? -1 : person->transmission_type_;
+    auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+    thread_rows[tid].push_back(row);
+  });
+  sim->GetResourceManager()->ForEachAgentParallel(gather);
+
+  std::vector<SnapshotRow> rows;
+  for (auto& el : thread_rows) {
+    rows.insert(rows.end(), el.begin(), el.end());
+  }
+  writer.Write(year, std::move(rows));
+}
+
+void CaptureStatistics::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  int year = static_cast<int>(
+      sparam->start_year +
+      sim->GetScheduler()->GetSimulatedSteps());  // Current year
+
+  // Gather the hot columns in thread-local buffers. The statistics do not
+  // depend on the order of the rows.
+  SharedData<std::vector<HotRow>> thread_rows;
+  thread_rows.resize(ThreadInfo::GetInstance()->GetMaxThreads());
+  auto gather = L2F([&](Agent* agent) {
+    auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+    thread_rows[tid].push_back(
+        HotRow::From(*bdm_static_cast<Person*>(agent)));
+  });
+  sim->GetResourceManager()->ForEachAgentParallel(gather);
+
+  std::vector<HotRow> rows;
+  rows.reserve(sim->GetResourceManager()->GetNumAgents());
+  for (auto& el : thread_rows) {
+    rows.insert(rows.end(), el.begin(), el.end());
+  }
+  env->GetStatisticsPipeline().Submit(year, std::move(rows),
+                                      &env->GetAsyncWriter());
+}
+
+void ResolvePartnershipIntents::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  env->GetPartnershipIntents().Resolve();
+}
+
+void TracePartners::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+  env->GetPartnerNotification().Trace(&env->GetPartnershipHistory(), sparam,
+                                      sim->GetRandom(),
+                                      &env->GetCohortTracker());
+}
+
+void RegularPartnershipTransmission::operator()() {
+  auto* sim = Simulation::GetActive();
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  const auto* sparam = sim->GetParam()->Get<SimParam>();
+
+  // Determine the number of regular acts
+  // AM: Number of regular acts depends on the current year
+  int year = static_cast<int>(
+      sparam->start_year +
+      sim->GetScheduler()->GetSimulatedSteps());  // Current year
+  const auto& year_params = env->GetCompiledParams().GetYearParams(year);
+
+  env->GetCoupleTable().Transmit(env->GetTransmissionTable(),
+                                 year_params.no_regular_acts_mean,
+                                 env->GetMaxAge(), &env->GetCohortTracker());
+}
+
 }  // namespace hiv_malawi
 }  // namespace bdm
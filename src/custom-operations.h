@@ -15,6 +15,7 @@
 
 #include "core/operation/operation.h"
 #include "core/resource_manager.h"
+#include "categorical-environment.h"
 #include "person.h"
 
 namespace bdm {
@@ -26,6 +27,54 @@ struct ResetCasualPartners : public StandaloneOperationImpl {
   void operator()() override;
 };
 
+// Generate the births of the current year per (location, fertility age band,
+// state) stratum of potential mothers. Must run after the environment update
+// and before the agent operations, such that mothers are protected in the year
+// in which they give birth.
+struct GiveBirths : public StandaloneOperationImpl {
+  BDM_OP_HEADER(GiveBirths);
+  void operator()() override;
+};
+
+// Write a snapshot of the population to sparam->snapshot_file. The columns are
+// gathered in parallel and handed to the SnapshotWriter, which encodes and
+// writes them on the I/O thread of the environment's AsyncWriter.
+struct WriteSnapshot : public StandaloneOperationImpl {
+  BDM_OP_HEADER(WriteSnapshot);
+  void operator()() override;
+};
+
+// Capture the hot columns of all agents at the end of the year and submit
+// them to the StatisticsPipeline of the environment (pipelined statistics).
+// The statistics are computed on the I/O thread while the next year runs.
+// Must be scheduled after the agent operations (OpType::kPostSchedule).
+struct CaptureStatistics : public StandaloneOperationImpl {
+  BDM_OP_HEADER(CaptureStatistics);
+  void operator()() override;
+};
+
+// Resolve the partnership intents that agents emitted during the behaviour
+// loop. Must be scheduled after the agent operations (OpType::kSchedule).
+struct ResolvePartnershipIntents : public StandaloneOperationImpl {
+  BDM_OP_HEADER(ResolvePartnershipIntents);
+  void operator()() override;
+};
+
+// Assisted partner notification for the agents that started treatment in the
+// current simulation step. Must be scheduled after ResolvePartnershipIntents.
+struct TracePartners : public StandaloneOperationImpl {
+  BDM_OP_HEADER(TracePartners);
+  void operator()() override;
+};
+
+// Regular partnership transmission. Serodiscordant couples are taken from the
+// CoupleTable of the CategoricalEnvironment, i.e. this operation must run after
+// the environment update of the current simulation step.
+struct RegularPartnershipTransmission : public StandaloneOperationImpl {
+  BDM_OP_HEADER(RegularPartnershipTransmission);
+  void operator()() override;
+};
+
 }  // namespace hiv_malawi
 }  // namespace bdm
 
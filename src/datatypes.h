@@ -74,6 +74,27 @@ enum TransmissionType {
   kTransmissionLast
 };
 
+// Biomedical and behavioural prevention measures. An agent stores the measures
+// that apply to them as a bitfield, hence the powers of two. PrEP and VMMC
+// protect the susceptible partner, condoms protect both partners of a contact.
+enum PreventionModifier {
+  kNoPrevention = 0,
+  kPrEP = 1,
+  kVMMC = 2,
+  kCondom = 4,
+  // Number of possible combinations of the modifiers above. Leave at the end.
+  kPreventionLast = 8
+};
+
+// Direction of a (potential) HIV transmission. Leave the kDirectionLast at the
+// End.
+enum TransmissionDirection {
+  kMaleToFemale,
+  kFemaleToMale,
+  kMaleToMale,
+  kDirectionLast
+};
+
 }  // namespace hiv_malawi
 }  // namespace bdm
 
@@ -0,0 +1,458 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "ensemble-aggregator.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+constexpr char kEnsembleMagic[] = "HIVENS02";
+// Version without the number of non-finite values per point
+constexpr char kEnsembleMagicV1[] = "HIVENS01";
+constexpr double kPi = 3.14159265358979323846;
+
+// Number of buffered values (relative to the compression) that triggers a
+// compression of the sketch
+constexpr double kBufferFactor = 5;
+
+void Append(std::string* data, const void* value, size_t bytes) {
+  data->append(reinterpret_cast<const char*>(value), bytes);
+}
+
+void AppendU64(std::string* data, uint64_t value) {
+  Append(data, &value, sizeof(value));
+}
+
+void AppendDouble(std::string* data, double value) {
+  Append(data, &value, sizeof(value));
+}
+
+// Sequential reader that fails on truncated data
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data) {}
+
+  bool Read(void* value, size_t bytes) {
+    if (position_ + bytes > data_.size()) {
+      return false;
+    }
+    std::memcpy(value, data_.data() + position_, bytes);
+    position_ += bytes;
+    return true;
+  }
+  bool ReadU64(uint64_t* value) { return Read(value, sizeof(*value)); }
+  bool ReadDouble(double* value) { return Read(value, sizeof(*value)); }
+
+ private:
+  const std::string& data_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// QuantileSketch
+////////////////////////////////////////////////////////////////////////////////
+
+void QuantileSketch::Add(double value, double weight) {
+  if (!std::isfinite(value)) {
+    return;
+  }
+  if (GetCount() == 0) {
+    min_ = value;
+    max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  buffer_.push_back({value, weight});
+  if (buffer_.size() >= kBufferFactor * compression_) {
+    Compress();
+  }
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+  if (other.GetCount() == 0) {
+    return;
+  }
+  if (GetCount() == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  const auto& centroids = other.GetCentroids();
+  buffer_.insert(buffer_.end(), centroids.begin(), centroids.end());
+  Compress();
+}
+
+double QuantileSketch::GetCount() const {
+  double count = 0;
+  for (const auto& c : centroids_) {
+    count += c.weight;
+  }
+  for (const auto& c : buffer_) {
+    count += c.weight;
+  }
+  return count;
+}
+
+const std::vector<QuantileSketch::Centroid>& QuantileSketch::GetCentroids()
+    const {
+  Compress();
+  return centroids_;
+}
+
+void QuantileSketch::SetCentroids(const std::vector<Centroid>& centroids,
+                                  double min, double max) {
+  centroids_ = centroids;
+  buffer_.clear();
+  min_ = min;
+  max_ = max;
+}
+
+void QuantileSketch::Compress() const {
+  if (buffer_.empty()) {
+    return;
+  }
+  std::vector<Centroid> all;
+  all.reserve(centroids_.size() + buffer_.size());
+  all.insert(all.end(), centroids_.begin(), centroids_.end());
+  all.insert(all.end(), buffer_.begin(), buffer_.end());
+  buffer_.clear();
+  std::stable_sort(all.begin(), all.end(),
+                   [](const Centroid& a, const Centroid& b) {
+                     return a.mean < b.mean;
+                   });
+
+  double total = 0;
+  for (const auto& c : all) {
+    total += c.weight;
+  }
+  // Scale function and its inverse, see header
+  const double factor = compression_ / (2 * kPi);
+  auto scale = [&](double q) {
+    return factor * std::asin(2 * std::min(std::max(q, 0.0), 1.0) - 1);
+  };
+  auto inverse_scale = [&](double k) {
+    return (std::sin(std::min(k / factor, kPi / 2)) + 1) / 2;
+  };
+
+  // Merge neighbouring centroids as long as the merged centroid spans less
+  // than one unit of the scale function
+  centroids_.clear();
+  Centroid current = all[0];
+  double weight_before = 0;
+  double limit = total * inverse_scale(scale(0) + 1);
+  for (size_t i = 1; i < all.size(); i++) {
+    const auto& next = all[i];
+    if (weight_before + current.weight + next.weight <= limit) {
+      double weight = current.weight + next.weight;
+      current.mean += (next.mean - current.mean) * next.weight / weight;
+      current.weight = weight;
+    } else {
+      centroids_.push_back(current);
+      weight_before += current.weight;
+      limit = total * inverse_scale(scale(weight_before / total) + 1);
+      current = next;
+    }
+  }
+  centroids_.push_back(current);
+}
+
+double QuantileSketch::Quantile(double q) const {
+  Compress();
+  if (centroids_.empty()) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (centroids_.size() == 1) {
+    return centroids_[0].mean;
+  }
+  double total = GetCount();
+  double index = std::min(std::max(q, 0.0), 1.0) * total;
+  auto interpolate = [](double a, double b, double t) {
+    return a + std::min(std::max(t, 0.0), 1.0) * (b - a);
+  };
+
+  // Values between the minimum and the center of the first centroid
+  const auto& first = centroids_.front();
+  if (index < first.weight / 2) {
+    return interpolate(min_, first.mean, index / (first.weight / 2));
+  }
+  // Values between the centers of two centroids
+  double cumulative = first.weight / 2;
+  for (size_t i = 0; i + 1 < centroids_.size(); i++) {
+    double step = (centroids_[i].weight + centroids_[i + 1].weight) / 2;
+    if (cumulative + step > index) {
+      return interpolate(centroids_[i].mean, centroids_[i + 1].mean,
+                         (index - cumulative) / step);
+    }
+    cumulative += step;
+  }
+  // Values between the center of the last centroid and the maximum
+  const auto& last = centroids_.back();
+  return interpolate(last.mean, max_, (index - cumulative) / (last.weight / 2));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EnsembleAggregator
+////////////////////////////////////////////////////////////////////////////////
+
+void EnsembleAggregator::Point::Add(double y) {
+  if (!std::isfinite(y)) {
+    no_non_finite++;
+    return;
+  }
+  count++;
+  double delta = y - mean;
+  mean += delta / count;
+  m2 += delta * (y - mean);
+  sketch.Add(y);
+}
+
+void EnsembleAggregator::Point::Merge(const Point& other) {
+  no_non_finite += other.no_non_finite;
+  if (other.count == 0) {
+    return;
+  }
+  double n = static_cast<double>(count + other.count);
+  double delta = other.mean - mean;
+  mean += delta * other.count / n;
+  m2 += other.m2 + delta * delta * count * other.count / n;
+  count += other.count;
+  sketch.Merge(other.sketch);
+}
+
+void EnsembleAggregator::Add(const std::string& id,
+                             const std::vector<double>& x_values,
+                             const std::vector<double>& y_values) {
+  auto& points = series_[id];
+  size_t size = std::min(x_values.size(), y_values.size());
+  for (size_t i = 0; i < size; i++) {
+    points[x_values[i]].Add(y_values[i]);
+  }
+}
+
+void EnsembleAggregator::Merge(const EnsembleAggregator& other) {
+  for (const auto& series : other.series_) {
+    auto& points = series_[series.first];
+    for (const auto& point : series.second) {
+      points[point.first].Merge(point.second);
+    }
+  }
+}
+
+std::vector<std::string> EnsembleAggregator::GetIds() const {
+  std::vector<std::string> ids;
+  for (const auto& series : series_) {
+    ids.push_back(series.first);
+  }
+  return ids;
+}
+
+std::vector<EnsembleAggregator::Band> EnsembleAggregator::GetBands(
+    const std::string& id, const std::vector<double>& quantiles) const {
+  std::vector<Band> bands;
+  auto it = series_.find(id);
+  if (it == series_.end()) {
+    return bands;
+  }
+  for (const auto& point : it->second) {
+    const auto& p = point.second;
+    Band band;
+    band.x = point.first;
+    band.count = p.count;
+    band.no_non_finite = p.no_non_finite;
+    band.mean = p.mean;
+    band.stddev = p.count > 1 ? std::sqrt(p.m2 / (p.count - 1)) : 0;
+    for (auto q : quantiles) {
+      band.quantiles.push_back(p.sketch.Quantile(q));
+    }
+    bands.push_back(std::move(band));
+  }
+  return bands;
+}
+
+std::string EnsembleAggregator::Serialize() const {
+  std::string data(kEnsembleMagic, 8);
+  AppendU64(&data, series_.size());
+  for (const auto& series : series_) {
+    AppendU64(&data, series.first.size());
+    data.append(series.first);
+    AppendU64(&data, series.second.size());
+    for (const auto& point : series.second) {
+      const auto& p = point.second;
+      AppendDouble(&data, point.first);
+      AppendU64(&data, p.count);
+      AppendU64(&data, p.no_non_finite);
+      AppendDouble(&data, p.mean);
+      AppendDouble(&data, p.m2);
+      AppendDouble(&data, p.sketch.GetMin());
+      AppendDouble(&data, p.sketch.GetMax());
+      const auto& centroids = p.sketch.GetCentroids();
+      AppendU64(&data, centroids.size());
+      for (const auto& c : centroids) {
+        AppendDouble(&data, c.mean);
+        AppendDouble(&data, c.weight);
+      }
+    }
+  }
+  return data;
+}
+
+bool EnsembleAggregator::Deserialize(const std::string& data) {
+  if (data.size() < 8) {
+    return false;
+  }
+  bool v1 = data.compare(0, 8, kEnsembleMagicV1) == 0;
+  if (!v1 && data.compare(0, 8, kEnsembleMagic) != 0) {
+    return false;
+  }
+  Reader reader(data);
+  char magic[8];
+  uint64_t no_series;
+  if (!reader.Read(magic, 8) || !reader.ReadU64(&no_series)) {
+    return false;
+  }
+  // Read into a separate aggregate, such that this one is unchanged if the
+  // data is truncated
+  EnsembleAggregator read;
+  for (uint64_t s = 0; s < no_series; s++) {
+    uint64_t id_length, no_points;
+    if (!reader.ReadU64(&id_length) || id_length > data.size()) {
+      return false;
+    }
+    std::string id(id_length, '\0');
+    if (!reader.Read(&id[0], id_length) || !reader.ReadU64(&no_points)) {
+      return false;
+    }
+    auto& points = read.series_[id];
+    for (uint64_t i = 0; i < no_points; i++) {
+      double x, min, max;
+      uint64_t no_centroids;
+      Point p;
+      if (!reader.ReadDouble(&x) || !reader.ReadU64(&p.count) ||
+          (!v1 && !reader.ReadU64(&p.no_non_finite)) ||
+          !reader.ReadDouble(&p.mean) || !reader.ReadDouble(&p.m2) ||
+          !reader.ReadDouble(&min) || !reader.ReadDouble(&max) ||
+          !reader.ReadU64(&no_centroids) || no_centroids > data.size()) {
+        return false;
+      }
+      std::vector<QuantileSketch::Centroid> centroids(no_centroids);
+      for (auto& c : centroids) {
+        if (!reader.ReadDouble(&c.mean) || !reader.ReadDouble(&c.weight)) {
+          return false;
+        }
+      }
+      p.sketch.SetCentroids(centroids, min, max);
+      points[x] = std::move(p);
+    }
+  }
+  Merge(read);
+  return true;
+}
+
+bool EnsembleAggregator::Read(const std::string& filename) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return Deserialize(buffer.str());
+}
+
+bool EnsembleAggregator::Write(const std::string& filename) const {
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  auto data = Serialize();
+  file.write(data.data(), data.size());
+  return static_cast<bool>(file);
+}
+
+bool EnsembleAggregator::AddToFile(const std::string& filename) const {
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (flock(fd, LOCK_EX) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // Read the current aggregate. An empty file was just created.
+  std::string data;
+  char chunk[1 << 16];
+  ssize_t bytes;
+  while ((bytes = read(fd, chunk, sizeof(chunk))) > 0) {
+    data.append(chunk, bytes);
+  }
+  EnsembleAggregator merged;
+  bool ok = bytes == 0 && (data.empty() || merged.Deserialize(data));
+
+  if (ok) {
+    merged.Merge(*this);
+    data = merged.Serialize();
+    ok = ftruncate(fd, 0) == 0;
+    size_t written = 0;
+    while (ok && written < data.size()) {
+      bytes = pwrite(fd, data.data() + written, data.size() - written, written);
+      ok = bytes > 0;
+      written += ok ? bytes : 0;
+    }
+  }
+  flock(fd, LOCK_UN);
+  return close(fd) == 0 && ok;
+}
+
+bool EnsembleAggregator::WriteBands(
+    const std::string& filename, const std::vector<double>& quantiles) const {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  file << "id,x,count,non_finite,mean,stddev";
+  for (auto q : quantiles) {
+    file << ",q" << q;
+  }
+  file << "\n" << std::setprecision(10);
+  for (const auto& id : GetIds()) {
+    for (const auto& band : GetBands(id, quantiles)) {
+      file << id << "," << band.x << "," << band.count << ","
+           << band.no_non_finite << "," << band.mean << "," << band.stddev;
+      for (auto value : band.quantiles) {
+        file << "," << value;
+      }
+      file << "\n";
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,157 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef ENSEMBLE_AGGREGATOR_H_
+#define ENSEMBLE_AGGREGATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Mergeable sketch of a distribution for approximate quantiles (merging
+// t-digest). Values are collected as centroids (mean, weight); the size of
+// the centroids is limited by the scale function k(q) = compression / (2 pi)
+// asin(2q - 1), such that centroids are small in the tails. The memory is
+// O(compression), independent of the number of values.
+class QuantileSketch {
+ public:
+  struct Centroid {
+    double mean;
+    double weight;
+  };
+
+  explicit QuantileSketch(double compression = 100)
+      : compression_(compression) {}
+
+  // Non-finite values are ignored
+  void Add(double value, double weight = 1);
+  void Merge(const QuantileSketch& other);
+
+  // Quantile q in [0, 1], interpolated between the centroids. Returns NaN if
+  // the sketch is empty.
+  double Quantile(double q) const;
+
+  double GetCount() const;
+  double GetMin() const { return min_; }
+  double GetMax() const { return max_; }
+
+  // Compressed centroids, sorted by mean
+  const std::vector<Centroid>& GetCentroids() const;
+  // Restore a sketch from its centroids and extremes
+  void SetCentroids(const std::vector<Centroid>& centroids, double min,
+                    double max);
+
+ private:
+  void Compress() const;
+
+  double compression_;
+  double min_ = 0;
+  double max_ = 0;
+  // Compressed centroids and values that were added since the last
+  // compression. Compressed lazily, e.g. in the const Quantile.
+  mutable std::vector<Centroid> centroids_;
+  mutable std::vector<Centroid> buffer_;
+};
+
+// Aggregates the time series of the replicates of an ensemble into, for each
+// series and x value (year), the exact count, mean, and variance and a
+// QuantileSketch. The memory is independent of the number of replicates, and
+// aggregates of different processes can be merged, e.g. to compute median and
+// 95% bands of 1000 replicates without keeping their time series. Non-finite
+// values (e.g. a prevalence of 0/0) are not aggregated, but counted per point.
+//
+// File layout (little endian):
+//   "HIVENS02" | no_series (8) | series
+//   series: id_length (8) | id | no_points (8) | points
+//   point: x | count | no_non_finite | mean | m2 | min | max (8 each) |
+//          no_centroids (8) | centroids (mean, weight; 8 each)
+// Files of version 01 (without no_non_finite) are read as well.
+//
+// This file does not depend on BioDynaMo, such that the tool in tools/ can be
+// built without it.
+class EnsembleAggregator {
+ public:
+  // Summary of one series at one x value
+  struct Band {
+    double x;
+    uint64_t count;
+    // Number of non-finite values that were skipped
+    uint64_t no_non_finite;
+    double mean;
+    double stddev;
+    // In the order of the requested quantiles
+    std::vector<double> quantiles;
+  };
+
+  // Add the time series of one replicate
+  void Add(const std::string& id, const std::vector<double>& x_values,
+           const std::vector<double>& y_values);
+
+  // Add all series of another aggregate
+  void Merge(const EnsembleAggregator& other);
+
+  std::vector<std::string> GetIds() const;
+  std::vector<Band> GetBands(const std::string& id,
+                             const std::vector<double>& quantiles) const;
+
+  // Binary representation in the layout of the file, e.g. to send the
+  // aggregate of a worker process through a pipe. Deserialize merges the
+  // aggregate into this one and returns false if the data is invalid.
+  std::string Serialize() const;
+  bool Deserialize(const std::string& data);
+
+  // Merge the aggregate of a file into this one. Returns false if the file
+  // cannot be read or is not an aggregate.
+  bool Read(const std::string& filename);
+  bool Write(const std::string& filename) const;
+
+  // Merge this aggregate into the one of the file, which is created if it
+  // does not exist. The file is locked (flock) while it is updated, i.e.
+  // replicates that run concurrently can share the file.
+  bool AddToFile(const std::string& filename) const;
+
+  // Write the bands of all series as CSV with the columns
+  // id,x,count,non_finite,mean,stddev,q<quantile>...
+  bool WriteBands(const std::string& filename,
+                  const std::vector<double>& quantiles) const;
+
+  // Quantiles of the median and the 50% and 95% bands
+  static std::vector<double> GetBandQuantiles() {
+    return {0.025, 0.25, 0.5, 0.75, 0.975};
+  }
+
+ private:
+  struct Point {
+    uint64_t count = 0;
+    uint64_t no_non_finite = 0;
+    double mean = 0;
+    // Sum of squared deviations from the mean (Welford / Chan et al.)
+    double m2 = 0;
+    QuantileSketch sketch;
+
+    void Add(double y);
+    void Merge(const Point& other);
+  };
+
+  // Ordered maps, such that files and bands do not depend on the order in
+  // which replicates were added
+  std::map<std::string, std::map<double, Point>> series_;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // ENSEMBLE_AGGREGATOR_H_
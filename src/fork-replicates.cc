@@ -0,0 +1,624 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "fork-replicates.h"
+
+#include <omp.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analyze.h"
+#include "biodynamo.h"
+#include "categorical-environment.h"
+#include "core/util/log.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+// Reseeds the random number generators and the regular partner matching of
+// the active simulation for the given replicate
+void Reseed(uint64_t replicate) {
+  auto* sim = Simulation::GetActive();
+  uint64_t seed = sim->GetParam()->random_seed + replicate;
+  auto& randoms = sim->GetAllRandom();
+  for (size_t i = 0; i < randoms.size(); i++) {
+    randoms[i]->SetSeed(seed * 1000003 + i);
+  }
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+  env->SetReplicate(replicate);
+}
+
+// Buffered output would be written by the parent and the forked process
+void FlushOutput() {
+  std::cout.flush();
+  fflush(stdout);
+}
+
+// Prepares a forked process for the given task (replicate or scenario)
+using SetupTask = std::function<void(uint64_t task)>;
+
+// Process that runs one task, and the result it sent so far
+struct Worker {
+  pid_t pid;
+  int fd;
+  uint64_t task;
+  std::string data;
+};
+
+// Body of the forked process
+[[noreturn]] void RunTask(uint64_t task, const ForkedTask& run, int fd) {
+  auto data = run(task);
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t bytes = write(fd, data.data() + written, data.size() - written);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      _exit(1);
+    }
+    written += bytes;
+  }
+  close(fd);
+  FlushOutput();
+  // Skip the destructors of the state inherited from the parent, e.g. of the
+  // Simulation, which would clean up the output directory of the parent
+  _exit(0);
+}
+
+Worker StartWorker(uint64_t task, const ForkedTask& run,
+                   const std::vector<Worker>& running) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    Log::Fatal("ForkWorkers()", "Cannot create a pipe for task ", task);
+  }
+  FlushOutput();
+  pid_t pid = fork();
+  if (pid < 0) {
+    Log::Fatal("ForkWorkers()", "Cannot fork task ", task);
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    for (const auto& worker : running) {
+      close(worker.fd);
+    }
+    RunTask(task, run, fds[1]);
+  }
+  close(fds[1]);
+  return {pid, fds[0], task, ""};
+}
+
+}  // namespace
+
+uint64_t ForkWorkers(uint64_t no_tasks, uint64_t no_workers,
+                     const ForkedTask& run, const FinishTask& finish) {
+  if (no_workers == 0) {
+    no_workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::vector<Worker> running;
+  // Aggregates of finished tasks that wait for their predecessors
+  std::map<uint64_t, std::string> finished;
+  uint64_t next = 0;
+  uint64_t next_to_finish = 0;
+  uint64_t no_failed = 0;
+  std::vector<char> chunk(1 << 16);
+
+  while (next < no_tasks || !running.empty()) {
+    while (running.size() < no_workers && next < no_tasks) {
+      running.push_back(StartWorker(next++, run, running));
+    }
+
+    std::vector<pollfd> fds(running.size());
+    for (size_t i = 0; i < running.size(); i++) {
+      fds[i] = {running[i].fd, POLLIN, 0};
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Log::Fatal("ForkWorkers()", "Cannot poll the workers");
+    }
+    // Backwards, such that finished workers can be erased
+    for (size_t i = running.size(); i-- > 0;) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      auto& worker = running[i];
+      ssize_t bytes = read(worker.fd, chunk.data(), chunk.size());
+      if (bytes > 0) {
+        worker.data.append(chunk.data(), bytes);
+        continue;
+      }
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      // End of the pipe, i.e. the worker exited
+      close(worker.fd);
+      int status = 0;
+      waitpid(worker.pid, &status, 0);
+      if (bytes == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        finished[worker.task] = std::move(worker.data);
+      } else {
+        Log::Warning("ForkWorkers()", "Task ", worker.task, " failed");
+        finished[worker.task] = "";
+        no_failed++;
+      }
+      running.erase(running.begin() + i);
+    }
+
+    for (auto it = finished.find(next_to_finish); it != finished.end();
+         it = finished.find(next_to_finish)) {
+      finish(it->first, it->second);
+      finished.erase(it);
+      next_to_finish++;
+    }
+  }
+  return no_failed;
+}
+
+namespace {
+
+// Simulates no_tasks tasks of no_iterations steps in forked processes (see
+// ForkWorkers). The result of a task is the aggregate of its time series.
+uint64_t ForkSimulations(uint64_t no_tasks, uint64_t no_workers,
+                         uint64_t no_iterations, const SetupTask& setup,
+                         const FinishTask& finish) {
+  // Output of the I/O thread must be complete before the state is shared
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(
+      Simulation::GetActive()->GetEnvironment());
+  env->GetAsyncWriter().Flush();
+
+  auto simulate = [&](uint64_t task) {
+    omp_set_num_threads(1);
+    env->GetAsyncWriter().ResetAfterFork();
+    setup(task);
+
+    Simulation::GetActive()->GetScheduler()->Simulate(no_iterations);
+
+    EnsembleAggregator aggregator;
+    AddToAggregator(&aggregator);
+    return aggregator.Serialize();
+  };
+  return ForkWorkers(no_tasks, no_workers, simulate, finish);
+}
+
+// State of a slot of the particle filter in memory that is shared by the
+// coordinator and the particles
+struct ParticleSlot {
+  // Posted by the coordinator after the resampling. One semaphore per parity
+  // of the round, such that a particle that moves into the slot cannot take
+  // the post for the previous occupant.
+  sem_t go[2];
+  // Process of the particle in the slot, and of the particle in the slot
+  // after the resampling
+  std::atomic<pid_t> pid;
+  std::atomic<pid_t> new_pid;
+  // Slot of the particle that is cloned into the slot by the resampling
+  std::atomic<uint64_t> ancestor;
+  // Number of rounds the particle finished
+  std::atomic<uint64_t> round;
+  // Set by the previous occupant once it read the ancestors
+  std::atomic<bool> acknowledged;
+  double log_likelihood;
+};
+
+struct ParticleFilterState {
+  // Posted by each particle after a round, and after reading the ancestors
+  sem_t done;
+  sem_t acknowledged;
+  // Process of the coordinator. The clones of the particles are not its
+  // children, hence they check whether it is alive by its pid.
+  pid_t coordinator;
+};
+
+// The coordinator and the particles of RunParticleFilter. The state that is
+// shared between them is mapped before the particles are forked.
+class ParticleFilter {
+ public:
+  ParticleFilter(const std::vector<SurveyObservation>& observations,
+                 uint64_t no_particles, uint64_t no_iterations,
+                 const std::string& ensemble_file)
+      : no_particles_(no_particles),
+        no_iterations_(no_iterations),
+        ensemble_file_(ensemble_file) {
+    for (const auto& observation : observations) {
+      if (rounds_.empty() || rounds_.back().year != observation.year) {
+        rounds_.push_back({observation.year, {}});
+      }
+      rounds_.back().observations.push_back(observation);
+    }
+    state_ = new (MapShared(sizeof(ParticleFilterState))) ParticleFilterState;
+    sem_init(&state_->done, 1, 0);
+    sem_init(&state_->acknowledged, 1, 0);
+    state_->coordinator = getpid();
+    slots_ = static_cast<ParticleSlot*>(
+        MapShared(no_particles_ * sizeof(ParticleSlot)));
+    for (uint64_t s = 0; s < no_particles_; s++) {
+      new (&slots_[s]) ParticleSlot;
+      sem_init(&slots_[s].go[0], 1, 0);
+      sem_init(&slots_[s].go[1], 1, 0);
+      slots_[s].pid = 0;
+      slots_[s].new_pid = 0;
+      slots_[s].ancestor = s;
+      slots_[s].round = 0;
+      slots_[s].acknowledged = false;
+      slots_[s].log_likelihood = 0;
+    }
+  }
+
+  ~ParticleFilter() {
+    for (uint64_t s = 0; s < no_particles_; s++) {
+      sem_destroy(&slots_[s].go[0]);
+      sem_destroy(&slots_[s].go[1]);
+    }
+    sem_destroy(&state_->done);
+    sem_destroy(&state_->acknowledged);
+    munmap(slots_, no_particles_ * sizeof(ParticleSlot));
+    munmap(state_, sizeof(ParticleFilterState));
+  }
+
+  // Runs the coordinator and returns the number of lost particles
+  uint64_t Run(EnsembleAggregator* aggregator,
+               std::vector<ParticleFilterStep>* steps) {
+    auto* sim = Simulation::GetActive();
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+    std::remove(ensemble_file_.c_str());
+    // Output of the I/O thread must be complete before the state is shared
+    env->GetAsyncWriter().Flush();
+    FlushOutput();
+
+    std::vector<pid_t> children(no_particles_);
+    for (uint64_t s = 0; s < no_particles_; s++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        Log::Fatal("RunParticleFilter()", "Cannot fork particle ", s);
+      }
+      if (pid == 0) {
+        // Terminate with the coordinator. The setting is not inherited by
+        // the clones, which check the coordinator in WaitForCoordinator.
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != state_->coordinator) {
+          _exit(1);
+        }
+        // The clones of the particles exit without being waited for
+        signal(SIGCHLD, SIG_IGN);
+        omp_set_num_threads(1);
+        env->GetAsyncWriter().ResetAfterFork();
+        Reseed(s);
+        RunParticle(s, 0);
+      }
+      slots_[s].pid = pid;
+      children[s] = pid;
+    }
+
+    std::vector<bool> alive(no_particles_, true);
+    uint64_t no_lost = 0;
+    double log_evidence = 0;
+    for (uint64_t r = 0; r <= rounds_.size(); r++) {
+      no_lost += Wait(
+          &state_->done, [&](uint64_t s) { return slots_[s].round == r + 1; },
+          &alive);
+      if (r == rounds_.size() ||
+          std::none_of(alive.begin(), alive.end(), [](bool a) { return a; })) {
+        break;
+      }
+
+      std::vector<double> log_weights(no_particles_);
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        log_weights[s] = alive[s] ? slots_[s].log_likelihood
+                                  : -std::numeric_limits<double>::infinity();
+      }
+      log_evidence += LogMeanWeight(log_weights);
+      steps->push_back({rounds_[r].year, EffectiveSampleSize(log_weights),
+                        log_evidence});
+
+      std::mt19937_64 rng(sim->GetParam()->random_seed + r);
+      std::uniform_real_distribution<double> uniform(0, 1);
+      auto ancestors = SystematicResampling(log_weights, uniform(rng));
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        slots_[s].ancestor = ancestors[s];
+        slots_[s].new_pid = 0;
+        slots_[s].acknowledged = false;
+      }
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        if (alive[s]) {
+          sem_post(&slots_[s].go[r % 2]);
+        }
+      }
+      // The particles that died before the clones were forked are counted
+      // with the slots that remain empty
+      Wait(
+          &state_->acknowledged,
+          [&](uint64_t s) { return slots_[s].acknowledged.load(); }, &alive);
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        slots_[s].pid = slots_[s].new_pid.load();
+        alive[s] = slots_[s].pid != 0;
+        if (!alive[s]) {
+          Log::Warning("RunParticleFilter()", "Particle ", s,
+                       " was not cloned");
+          no_lost++;
+        }
+      }
+    }
+
+    for (auto pid : children) {
+      waitpid(pid, nullptr, 0);
+    }
+    if (std::any_of(alive.begin(), alive.end(), [](bool a) { return a; }) &&
+        !aggregator->Read(ensemble_file_)) {
+      Log::Warning("RunParticleFilter()", "Cannot read ", ensemble_file_);
+    }
+    return no_lost;
+  }
+
+ private:
+  // Observations of one year
+  struct Round {
+    int year;
+    std::vector<SurveyObservation> observations;
+  };
+
+  std::vector<Round> rounds_;
+  uint64_t no_particles_;
+  uint64_t no_iterations_;
+  std::string ensemble_file_;
+  ParticleFilterState* state_;
+  ParticleSlot* slots_;
+
+  static void* MapShared(size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      Log::Fatal("RunParticleFilter()", "Cannot map shared memory");
+    }
+    return memory;
+  }
+
+  // Waits for a post on the semaphore by each slot that is alive. Slots whose
+  // process died before it posted are marked as not alive. Returns their
+  // number.
+  uint64_t Wait(sem_t* semaphore, const std::function<bool(uint64_t)>& posted,
+                std::vector<bool>* alive) {
+    uint64_t remaining = std::count(alive->begin(), alive->end(), true);
+    uint64_t no_died = 0;
+    while (remaining > 0) {
+      timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += 1;
+      if (sem_timedwait(semaphore, &deadline) == 0) {
+        remaining--;
+        continue;
+      }
+      // Exited children must be reaped, otherwise they appear to be alive
+      while (waitpid(-1, nullptr, WNOHANG) > 0) {
+      }
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        if (!(*alive)[s] || posted(s) || kill(slots_[s].pid, 0) == 0 ||
+            errno != ESRCH || posted(s)) {
+          continue;
+        }
+        Log::Warning("RunParticleFilter()", "Particle ", s, " died");
+        (*alive)[s] = false;
+        remaining--;
+        no_died++;
+      }
+    }
+    return no_died;
+  }
+
+  // Waits for the post of the coordinator on the semaphore. Exits if the
+  // coordinator died, which would leave the particle waiting forever.
+  void WaitForCoordinator(sem_t* semaphore) {
+    while (true) {
+      timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += 1;
+      if (sem_timedwait(semaphore, &deadline) == 0) {
+        return;
+      }
+      if (kill(state_->coordinator, 0) != 0 && errno == ESRCH) {
+        _exit(1);
+      }
+    }
+  }
+
+  // Simulates until the value of the observation is collected
+  bool SimulateTo(const SurveyObservation& observation) {
+    auto* sim = Simulation::GetActive();
+    auto* scheduler = sim->GetScheduler();
+    const auto* sparam = sim->GetParam()->Get<SimParam>();
+    // The value of a year is collected at the end of its step
+    int64_t steps = static_cast<int64_t>(observation.year) -
+                    sparam->start_year - 1 -
+                    static_cast<int64_t>(scheduler->GetSimulatedSteps());
+    if (steps > 0) {
+      scheduler->Simulate(steps);
+    }
+    double value;
+    while (!GetCollectedValue(observation.id, observation.year, &value)) {
+      if (scheduler->GetSimulatedSteps() >= no_iterations_) {
+        return false;
+      }
+      scheduler->Simulate(1);
+    }
+    return true;
+  }
+
+  // Body of a particle that starts the given round in the given slot
+  [[noreturn]] void RunParticle(uint64_t slot, uint64_t round) {
+    auto* sim = Simulation::GetActive();
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+    for (; round < rounds_.size(); round++) {
+      double log_likelihood = 0;
+      for (const auto& observation : rounds_[round].observations) {
+        double value;
+        if (!SimulateTo(observation) ||
+            !GetCollectedValue(observation.id, observation.year, &value)) {
+          Log::Warning("RunParticleFilter()", "No value of ", observation.id,
+                       " in ", observation.year);
+          _exit(1);
+        }
+        log_likelihood += SurveyLogLikelihood(observation, value);
+      }
+      slots_[slot].log_likelihood = log_likelihood;
+      slots_[slot].round = round + 1;
+      sem_post(&state_->done);
+      WaitForCoordinator(&slots_[slot].go[round % 2]);
+
+      std::vector<uint64_t> offspring;
+      for (uint64_t s = 0; s < no_particles_; s++) {
+        if (slots_[s].ancestor == slot) {
+          offspring.push_back(s);
+        }
+      }
+      if (offspring.empty()) {
+        slots_[slot].acknowledged = true;
+        sem_post(&state_->acknowledged);
+        _exit(0);
+      }
+      // The particle continues in its first offspring slot and clones itself
+      // copy-on-write into the others
+      env->GetAsyncWriter().Flush();
+      FlushOutput();
+      uint64_t next_slot = offspring[0];
+      bool clone = false;
+      for (size_t i = 1; i < offspring.size(); i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+          next_slot = offspring[i];
+          clone = true;
+          break;
+        }
+        if (pid < 0) {
+          Log::Warning("RunParticleFilter()", "Cannot clone particle ", slot);
+        } else {
+          slots_[offspring[i]].new_pid = pid;
+        }
+      }
+      if (clone) {
+        env->GetAsyncWriter().ResetAfterFork();
+      } else {
+        slots_[next_slot].new_pid = getpid();
+        slots_[slot].acknowledged = true;
+        sem_post(&state_->acknowledged);
+      }
+      slot = next_slot;
+      // Distinct random numbers for each particle of each round
+      Reseed((round + 1) * no_particles_ + slot);
+    }
+
+    auto* scheduler = sim->GetScheduler();
+    if (scheduler->GetSimulatedSteps() < no_iterations_) {
+      scheduler->Simulate(no_iterations_ - scheduler->GetSimulatedSteps());
+    }
+    EnsembleAggregator aggregator;
+    AddToAggregator(&aggregator);
+    if (!aggregator.AddToFile(ensemble_file_)) {
+      _exit(1);
+    }
+    slots_[slot].round = rounds_.size() + 1;
+    sem_post(&state_->done);
+    FlushOutput();
+    // Skip the destructors of the state inherited from the coordinator
+    _exit(0);
+  }
+};
+
+}  // namespace
+
+uint64_t ForkReplicates(uint64_t no_replicates, uint64_t no_workers,
+                        uint64_t no_iterations,
+                        EnsembleAggregator* aggregator) {
+  uint64_t no_invalid = 0;
+  auto merge = [&](uint64_t replicate, const std::string& data) {
+    if (!data.empty() && !aggregator->Deserialize(data)) {
+      Log::Warning("ForkReplicates()", "Invalid time series of replicate ",
+                   replicate);
+      no_invalid++;
+    }
+  };
+  uint64_t no_failed =
+      ForkSimulations(no_replicates, no_workers, no_iterations, Reseed, merge);
+  return no_failed + no_invalid;
+}
+
+uint64_t ForkScenarios(const std::vector<std::string>& timeline_files,
+                       uint64_t no_workers, uint64_t no_iterations,
+                       std::vector<EnsembleAggregator>* aggregators) {
+  aggregators->resize(timeline_files.size());
+  // The random number generators are not reseeded: all scenarios continue
+  // with the state at the fork. The streams are consumed in the order of the
+  // draws, hence they diverge at the first draw that differs.
+  auto apply_timeline = [&](uint64_t scenario) {
+    if (!timeline_files[scenario].empty()) {
+      auto* env = bdm_static_cast<CategoricalEnvironment*>(
+          Simulation::GetActive()->GetEnvironment());
+      env->ApplyTimeline(timeline_files[scenario]);
+    }
+  };
+  uint64_t no_invalid = 0;
+  auto merge = [&](uint64_t scenario, const std::string& data) {
+    if (!data.empty() && !(*aggregators)[scenario].Deserialize(data)) {
+      Log::Warning("ForkScenarios()", "Invalid time series of scenario ",
+                   scenario);
+      no_invalid++;
+    }
+  };
+  uint64_t no_failed = ForkSimulations(timeline_files.size(), no_workers,
+                                       no_iterations, apply_timeline, merge);
+  return no_failed + no_invalid;
+}
+
+uint64_t RunParticleFilter(const std::vector<SurveyObservation>& observations,
+                           uint64_t no_particles, uint64_t no_iterations,
+                           const std::string& ensemble_file,
+                           EnsembleAggregator* aggregator,
+                           std::vector<ParticleFilterStep>* steps) {
+  const auto* sparam = Simulation::GetActive()->GetParam()->Get<SimParam>();
+  for (const auto& observation : observations) {
+    if (observation.year <= sparam->start_year ||
+        observation.year >
+            sparam->start_year + static_cast<int64_t>(no_iterations)) {
+      Log::Fatal("RunParticleFilter()", "The observation of ", observation.id,
+                 " in ", observation.year, " is not in the simulated years");
+    }
+  }
+  ParticleFilter filter(observations, no_particles, no_iterations,
+                        ensemble_file);
+  return filter.Run(aggregator, steps);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef FORK_REPLICATES_H_
+#define FORK_REPLICATES_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ensemble-aggregator.h"
+#include "survey-observations.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Runs a task in a forked process and returns its result
+using ForkedTask = std::function<std::string(uint64_t task)>;
+// Receives the result of a finished task. Empty if the task failed.
+using FinishTask = std::function<void(uint64_t task, const std::string&)>;
+
+// Runs no_tasks tasks in forked processes, at most no_workers at a time (0:
+// one per hardware thread), and hands their results to finish in task order,
+// such that the results do not depend on the order in which the workers
+// finish. A task fails if its process does not exit normally with status 0,
+// e.g. if it crashes. Returns the number of failed tasks.
+uint64_t ForkWorkers(uint64_t no_tasks, uint64_t no_workers,
+                     const ForkedTask& run, const FinishTask& finish);
+
+// The functions below continue the active simulation in forked worker
+// processes, at most no_workers at a time (0: one per hardware thread). The
+// workers share the state of the parent copy-on-write, i.e. the work up to the
+// fork is done once and pages are only copied when a worker modifies them.
+// Each worker simulates no_iterations steps with a single OpenMP thread and
+// writes the aggregate of its time series (see AddToAggregator) to a pipe. The
+// parent merges the aggregates in the order of the workers. The functions
+// return the number of workers that failed.
+//
+// The OpenMP threads of the parent do not exist in the workers. GNU libgomp
+// cannot start a parallel region with more than one thread in a forked
+// process; the workers are therefore single-threaded, which is the efficient
+// choice for batches of simulations anyway.
+
+// Simulates no_replicates replicates. The population, the environment, and
+// the operations must be set up, and the mothers assigned, but no step
+// simulated yet. Each worker reseeds the random number generators and the
+// regular partner matching with random_seed + replicate. The aggregates of all
+// replicates are merged into the aggregator.
+uint64_t ForkReplicates(uint64_t no_replicates, uint64_t no_workers,
+                        uint64_t no_iterations,
+                        EnsembleAggregator* aggregator);
+
+// Simulates one scenario per timeline file (see SimParam::timeline_file; an
+// empty name continues without additional overrides) from the current state,
+// e.g. after the years before an intervention were simulated once. The random
+// number generators are not reseeded, i.e. the scenarios start from the same
+// random number state. They do not use common random numbers: the first draw
+// that differs between two scenarios shifts all following draws. The
+// aggregate of scenario i is stored in (*aggregators)[i].
+uint64_t ForkScenarios(const std::vector<std::string>& timeline_files,
+                       uint64_t no_workers, uint64_t no_iterations,
+                       std::vector<EnsembleAggregator>* aggregators);
+
+// Diagnostics of a particle filter after the observations of a year
+struct ParticleFilterStep {
+  int year;
+  // Effective sample size of the weights before resampling
+  double ess;
+  // Estimate of the log marginal likelihood of the observations so far
+  double log_evidence;
+};
+
+// Sequential Monte Carlo (bootstrap particle filter) fit to survey
+// observations. Each of the no_particles particles is a forked process that
+// simulates until the next year with observations. The coordinator (the
+// calling process) weights the particles by the likelihood of the
+// observations (see SurveyLogLikelihood) and resamples them systematically.
+// A particle that is drawn k times forks k - 1 copies of itself, i.e. its
+// population and environment are cloned copy-on-write, and a particle that
+// is not drawn exits. The clones are reseeded and continue to the next year.
+// After the last observation the particles simulate until no_iterations and
+// add their time series to ensemble_file, which is read into the aggregator.
+// The particles run with a single OpenMP thread. The setup is the same as for
+// ForkReplicates. The observations must be sorted by year (see
+// ReadSurveyObservations). Returns the number of particles that failed.
+uint64_t RunParticleFilter(const std::vector<SurveyObservation>& observations,
+                           uint64_t no_particles, uint64_t no_iterations,
+                           const std::string& ensemble_file,
+                           EnsembleAggregator* aggregator,
+                           std::vector<ParticleFilterStep>* steps);
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // FORK_REPLICATES_H_
@@ -0,0 +1,104 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "household-table.h"
+
+#include <algorithm>
+
+namespace bdm {
+namespace hiv_malawi {
+
+HouseholdTable::HouseholdTable() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  thread_members_.resize(tinfo->GetMaxThreads());
+}
+
+void HouseholdTable::Clear() {
+  for (auto& el : thread_members_) {
+    el.clear();
+  }
+  members_.clear();
+  offsets_.clear();
+}
+
+void HouseholdTable::AddMember(Person* head, Person* person) {
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  thread_members_[tid].push_back({static_cast<uint64_t>(head->GetUid()),
+                                  static_cast<uint64_t>(person->GetUid()),
+                                  person->GetAgentPtr<Person>()});
+}
+
+void HouseholdTable::Build() {
+  size_t no_members = 0;
+  for (auto& el : thread_members_) {
+    no_members += el.size();
+  }
+  members_.reserve(no_members);
+  for (auto& el : thread_members_) {
+    members_.insert(members_.end(), el.begin(), el.end());
+    el.clear();
+  }
+  // Sort by household and member to obtain a deterministic order.
+  std::sort(members_.begin(), members_.end(),
+            [](const Member& a, const Member& b) {
+              if (a.head_key != b.head_key) {
+                return a.head_key < b.head_key;
+              }
+              return a.key < b.key;
+            });
+
+  offsets_.clear();
+  for (size_t i = 0; i < members_.size(); i++) {
+    if (i == 0 || members_[i].head_key != members_[i - 1].head_key) {
+      offsets_.push_back(i);
+    }
+  }
+  offsets_.push_back(members_.size());
+
+  // Assign the household index to the members and compute the statistics in
+  // the same pass.
+  const int64_t no_households = GetNumHouseholds();
+  uint64_t no_serodiscordant = 0;
+  uint64_t no_orphans = 0;
+#pragma omp parallel for reduction(+ : no_serodiscordant, no_orphans)
+  for (int64_t h = 0; h < no_households; h++) {
+    bool has_infected = false;
+    bool has_healthy = false;
+    for (uint32_t i = offsets_[h]; i < offsets_[h + 1]; i++) {
+      auto* person = members_[i].agent.Get();
+      person->household_ = h;
+      if (person->IsHealthy()) {
+        has_healthy = true;
+      } else {
+        has_infected = true;
+      }
+      if (person->age_ < 15 && person->mother_ == nullptr) {
+        no_orphans++;
+      }
+    }
+    if (has_infected && has_healthy) {
+      no_serodiscordant++;
+    }
+  }
+
+  statistics_ = HouseholdStatistics();
+  statistics_.no_households = no_households;
+  if (no_households > 0) {
+    statistics_.mean_household_size =
+        static_cast<double>(members_.size()) / no_households;
+  }
+  statistics_.no_serodiscordant_households = no_serodiscordant;
+  statistics_.no_orphans = no_orphans;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,104 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef HOUSEHOLD_TABLE_H_
+#define HOUSEHOLD_TABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "person.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Household statistics at the beginning of the current simulation step.
+struct HouseholdStatistics {
+  uint64_t no_households = 0;
+  double mean_household_size = 0.0;
+  // Households with at least one infected and one healthy member
+  uint64_t no_serodiscordant_households = 0;
+  // Children (under 15) without mother
+  uint64_t no_orphans = 0;
+};
+
+// The HouseholdTable groups the agents into households. A household consists
+// of an adult woman, her regular partner, and her children under 15. Single
+// adult men and children without mother form a household on their own. The
+// members of a household are stored contiguously (agents sorted by household),
+// i.e. household h consists of the members in [offsets_[h], offsets_[h+1]).
+//
+// The table is rebuilt by the CategoricalEnvironment at every update from the
+// partner and mother links. Person::household_ stores the index of the
+// household of the agent in the current simulation step.
+class HouseholdTable {
+ public:
+  HouseholdTable();
+
+  // Delete all households. Must be called before the first AddMember of an
+  // update.
+  void Clear();
+
+  // Add the person to the household of head. Thread-safe.
+  void AddMember(Person* head, Person* person);
+
+  // Merge the thread-local buffers into the contiguous member array, assign
+  // the household index to all members, and compute the statistics.
+  void Build();
+
+  // Get the number of households
+  size_t GetNumHouseholds() const {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+  }
+
+  // Get the number of members of household h
+  size_t GetHouseholdSize(size_t h) const {
+    return offsets_[h + 1] - offsets_[h];
+  }
+
+  // Get the i-th member of household h
+  AgentPointer<Person> GetMember(size_t h, size_t i) const {
+    return members_[offsets_[h] + i].agent;
+  }
+
+  // Get the uid of the i-th member of household h. Allows to identify members
+  // that died without dereferencing them.
+  uint64_t GetMemberKey(size_t h, size_t i) const {
+    return members_[offsets_[h] + i].key;
+  }
+
+  // Get the statistics computed in the last Build()
+  const HouseholdStatistics& GetStatistics() const { return statistics_; }
+
+ private:
+  struct Member {
+    // Uid of the household head, used to sort the members by household
+    uint64_t head_key;
+    // Uid of the member
+    uint64_t key;
+    AgentPointer<Person> agent;
+  };
+
+  // Thread-local member buffers, filled by AddMember
+  SharedData<std::vector<Member>> thread_members_;
+  // Members of all households, sorted by household
+  std::vector<Member> members_;
+  // Start of each household in members_ (size: number of households + 1)
+  std::vector<uint32_t> offsets_;
+
+  HouseholdStatistics statistics_;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // HOUSEHOLD_TABLE_H_
@@ -0,0 +1,101 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "huge-page-allocator.h"
+
+#include <sys/mman.h>
+#include <atomic>
+#include <cstdint>
+
+#include "core/util/log.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+std::atomic<int> policy{kNoHugePages};
+std::atomic<bool> hugetlbfs_warned{false};
+
+size_t RoundUpToHugePage(size_t bytes) {
+  return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+}  // namespace
+
+void SetHugePagePolicy(const std::string& name) {
+  if (name == "none") {
+    policy = kNoHugePages;
+  } else if (name == "transparent") {
+    policy = kTransparentHugePages;
+  } else if (name == "hugetlbfs") {
+    policy = kHugetlbfsPages;
+  } else {
+    Log::Fatal("SetHugePagePolicy()", "Unknown huge page policy '", name,
+               "'. Use none, transparent, or hugetlbfs.");
+  }
+}
+
+HugePagePolicy GetHugePagePolicy() {
+  return static_cast<HugePagePolicy>(policy.load());
+}
+
+void* AllocateHugePages(size_t bytes) {
+  size_t length = RoundUpToHugePage(bytes);
+  auto current = GetHugePagePolicy();
+
+  if (current == kHugetlbfsPages) {
+    void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      return ptr;
+    }
+    if (!hugetlbfs_warned.exchange(true)) {
+      Log::Warning("AllocateHugePages()",
+                   "The hugetlbfs pool is exhausted or not configured "
+                   "(/proc/sys/vm/nr_hugepages). Falling back to transparent "
+                   "huge pages.");
+    }
+    current = kTransparentHugePages;
+  }
+
+  // Map one huge page more than required and unmap the unaligned head and
+  // tail, such that the buffer consists of whole huge pages
+  size_t mapped = length + kHugePageSize;
+  void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto begin = reinterpret_cast<uintptr_t>(raw);
+  auto aligned = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  if (aligned > begin) {
+    munmap(raw, aligned - begin);
+  }
+  size_t tail = begin + mapped - (aligned + length);
+  if (tail > 0) {
+    munmap(reinterpret_cast<void*>(aligned + length), tail);
+  }
+  void* ptr = reinterpret_cast<void*>(aligned);
+  if (current == kTransparentHugePages) {
+    // Only a hint; fails without error if THP is disabled
+    madvise(ptr, length, MADV_HUGEPAGE);
+  }
+  return ptr;
+}
+
+void DeallocateHugePages(void* ptr, size_t bytes) {
+  munmap(ptr, RoundUpToHugePage(bytes));
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,91 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef HUGE_PAGE_ALLOCATOR_H_
+#define HUGE_PAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <string>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// How large buffers are backed by memory pages
+enum HugePagePolicy {
+  // Regular (4 kB) pages
+  kNoHugePages,
+  // Transparent huge pages, requested with madvise(MADV_HUGEPAGE)
+  kTransparentHugePages,
+  // Pages of the hugetlbfs pool (MAP_HUGETLB). Falls back to transparent huge
+  // pages if the pool is exhausted or not configured.
+  kHugetlbfsPages
+};
+
+// Size of a huge page on x86-64
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+// Set the policy from its name ("none", "transparent", or "hugetlbfs"). Must
+// be called before large buffers are allocated.
+void SetHugePagePolicy(const std::string& policy);
+HugePagePolicy GetHugePagePolicy();
+
+// Map / unmap a buffer of at least kHugePageSize bytes. The buffer is aligned
+// to kHugePageSize and backed according to the policy.
+void* AllocateHugePages(size_t bytes);
+void DeallocateHugePages(void* ptr, size_t bytes);
+
+// Allocator for containers that grow to several huge pages and are accessed
+// at random, e.g. the agent indexes of the CategoricalEnvironment. Huge pages
+// reduce the TLB misses of such accesses. Small buffers are allocated with
+// operator new, such that the many small containers do not waste memory.
+template <typename T>
+class HugePageAllocator {
+ public:
+  using value_type = T;
+
+  HugePageAllocator() = default;
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U>&) {}  // NOLINT
+
+  T* allocate(size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (bytes < kHugePageSize) {
+      return static_cast<T*>(::operator new(bytes));
+    }
+    return static_cast<T*>(AllocateHugePages(bytes));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (bytes < kHugePageSize) {
+      ::operator delete(ptr);
+    } else {
+      DeallocateHugePages(ptr, bytes);
+    }
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+  return false;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // HUGE_PAGE_ALLOCATOR_H_
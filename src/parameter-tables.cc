@@ -0,0 +1,408 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "parameter-tables.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+const char kTableMagic[] = "HIVPTAB1";
+const uint64_t kTableAlignment = 64;
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kTableAlignment - 1) / kTableAlignment * kTableAlignment;
+}
+
+// Minimal JSON reader that keeps numbers and arrays and skips everything else
+struct JsonValue {
+  enum Type { kNumber, kArray, kOther } type = kOther;
+  double number = 0;
+  std::vector<JsonValue> items;
+};
+
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& text) : text_(text) {}
+
+  // Parse the document and collect the numeric arrays of all objects
+  bool Parse(std::vector<ParameterTable>* tables) {
+    JsonValue value;
+    bool ok = ParseValue(&value, tables);
+    SkipSpace();
+    return ok && pos_ == text_.size();
+  }
+
+ private:
+  const std::string& text_;
+  size_t pos_ = 0;
+
+  void SkipSpace() {
+    while (pos_ < text_.size() && std::isspace(text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  bool ParseString(std::string* out) {
+    if (text_[pos_] != '"') {
+      return false;
+    }
+    pos_++;
+    out->clear();
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      if (text_[pos_] == '\\') {
+        pos_++;
+      }
+      if (pos_ < text_.size()) {
+        out->push_back(text_[pos_++]);
+      }
+    }
+    if (pos_ >= text_.size()) {
+      return false;
+    }
+    pos_++;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, std::vector<ParameterTable>* tables) {
+    SkipSpace();
+    if (pos_ >= text_.size()) {
+      return false;
+    }
+    char c = text_[pos_];
+    if (c == '{') {
+      return ParseObject(tables);
+    }
+    if (c == '[') {
+      value->type = JsonValue::kArray;
+      pos_++;
+      SkipSpace();
+      if (pos_ < text_.size() && text_[pos_] == ']') {
+        pos_++;
+        return true;
+      }
+      while (true) {
+        value->items.emplace_back();
+        if (!ParseValue(&value->items.back(), tables)) {
+          return false;
+        }
+        SkipSpace();
+        if (pos_ < text_.size() && text_[pos_] == ',') {
+          pos_++;
+        } else if (pos_ < text_.size() && text_[pos_] == ']') {
+          pos_++;
+          return true;
+        } else {
+          return false;
+        }
+      }
+    }
+    if (c == '"') {
+      std::string ignored;
+      return ParseString(&ignored);
+    }
+    if (c == '-' || std::isdigit(c)) {
+      const char* begin = text_.c_str() + pos_;
+      char* end = nullptr;
+      value->type = JsonValue::kNumber;
+      value->number = std::strtod(begin, &end);
+      pos_ += end - begin;
+      return end != begin;
+    }
+    for (const char* word : {"true", "false", "null"}) {
+      if (text_.compare(pos_, std::strlen(word), word) == 0) {
+        pos_ += std::strlen(word);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ParseObject(std::vector<ParameterTable>* tables) {
+    pos_++;
+    SkipSpace();
+    if (pos_ < text_.size() && text_[pos_] == '}') {
+      pos_++;
+      return true;
+    }
+    while (true) {
+      SkipSpace();
+      std::string key;
+      if (pos_ >= text_.size() || !ParseString(&key)) {
+        return false;
+      }
+      SkipSpace();
+      if (pos_ >= text_.size() || text_[pos_] != ':') {
+        return false;
+      }
+      pos_++;
+      JsonValue value;
+      if (!ParseValue(&value, tables)) {
+        return false;
+      }
+      ParameterTable table;
+      table.name = key;
+      if (ToTable(value, &table)) {
+        tables->push_back(table);
+      }
+      SkipSpace();
+      if (pos_ < text_.size() && text_[pos_] == ',') {
+        pos_++;
+      } else if (pos_ < text_.size() && text_[pos_] == '}') {
+        pos_++;
+        return true;
+      } else {
+        return false;
+      }
+    }
+  }
+
+  // Convert a rectangular, numeric array of rank 1 to 3 into a table
+  static bool ToTable(const JsonValue& value, ParameterTable* table) {
+    if (value.type != JsonValue::kArray || value.items.empty()) {
+      return false;
+    }
+    const JsonValue* v = &value;
+    while (v->type == JsonValue::kArray && !v->items.empty()) {
+      table->dims.push_back(static_cast<uint32_t>(v->items.size()));
+      v = &v->items[0];
+    }
+    if (v->type != JsonValue::kNumber || table->dims.size() > 3) {
+      return false;
+    }
+    return Flatten(value, 0, table);
+  }
+
+  static bool Flatten(const JsonValue& value, size_t depth,
+                      ParameterTable* table) {
+    if (depth == table->dims.size()) {
+      table->data.push_back(static_cast<float>(value.number));
+      return value.type == JsonValue::kNumber;
+    }
+    if (value.type != JsonValue::kArray ||
+        value.items.size() != table->dims[depth]) {
+      return false;
+    }
+    for (auto& item : value.items) {
+      if (!Flatten(item, depth + 1, table)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+}  // namespace
+
+ParameterTables::~ParameterTables() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+bool ParameterTables::Open(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 16) {
+    close(fd);
+    return false;
+  }
+  size_ = static_cast<uint64_t>(st.st_size);
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = data;
+
+  const char* bytes = static_cast<const char*>(data_);
+  std::memcpy(&no_tables_, bytes + 8, 8);
+  entries_ = reinterpret_cast<const Entry*>(bytes + 16);
+  bool valid = std::memcmp(bytes, kTableMagic, 8) == 0 &&
+               16 + no_tables_ * sizeof(Entry) <= size_;
+  for (uint64_t t = 0; valid && t < no_tables_; t++) {
+    const Entry& entry = entries_[t];
+    uint64_t no_elements = 1;
+    for (uint32_t d = 0; d < entry.rank && d < 3; d++) {
+      no_elements *= entry.dims[d];
+    }
+    valid = entry.rank <= 3 && entry.name[55] == '\0' &&
+            entry.offset % kTableAlignment == 0 &&
+            entry.offset + no_elements * sizeof(float) <= size_;
+  }
+  if (!valid) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    entries_ = nullptr;
+    no_tables_ = 0;
+  }
+  return valid;
+}
+
+const float* ParameterTables::Get(const std::string& name,
+                                  std::vector<uint32_t>* dims) const {
+  for (uint64_t t = 0; t < no_tables_; t++) {
+    const Entry& entry = entries_[t];
+    if (name == entry.name) {
+      dims->assign(entry.dims, entry.dims + entry.rank);
+      return reinterpret_cast<const float*>(static_cast<const char*>(data_) +
+                                            entry.offset);
+    }
+  }
+  return nullptr;
+}
+
+std::vector<std::string> ParameterTables::GetNames() const {
+  std::vector<std::string> names;
+  for (uint64_t t = 0; t < no_tables_; t++) {
+    names.push_back(entries_[t].name);
+  }
+  return names;
+}
+
+bool ParameterTables::Write(const std::string& filename,
+                            const std::vector<ParameterTable>& tables) {
+  std::vector<Entry> entries(tables.size());
+  uint64_t offset = Align(16 + tables.size() * sizeof(Entry));
+  for (size_t t = 0; t < tables.size(); t++) {
+    auto& table = tables[t];
+    auto& entry = entries[t];
+    uint64_t no_elements = 1;
+    for (auto d : table.dims) {
+      no_elements *= d;
+    }
+    if (table.name.size() >= sizeof(entry.name) || table.dims.size() > 3 ||
+        no_elements != table.data.size()) {
+      return false;
+    }
+    std::memset(&entry, 0, sizeof(Entry));
+    std::memcpy(entry.name, table.name.c_str(), table.name.size());
+    entry.rank = static_cast<uint32_t>(table.dims.size());
+    for (size_t d = 0; d < table.dims.size(); d++) {
+      entry.dims[d] = table.dims[d];
+    }
+    entry.offset = offset;
+    offset = Align(offset + table.data.size() * sizeof(float));
+  }
+
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  uint64_t no_tables = tables.size();
+  file.write(kTableMagic, 8);
+  file.write(reinterpret_cast<const char*>(&no_tables), 8);
+  file.write(reinterpret_cast<const char*>(entries.data()),
+             entries.size() * sizeof(Entry));
+  uint64_t position = 16 + entries.size() * sizeof(Entry);
+  const char padding[kTableAlignment] = {};
+  for (size_t t = 0; t < tables.size(); t++) {
+    file.write(padding, entries[t].offset - position);
+    file.write(reinterpret_cast<const char*>(tables[t].data.data()),
+               tables[t].data.size() * sizeof(float));
+    position = entries[t].offset + tables[t].data.size() * sizeof(float);
+  }
+  file.write(padding, Align(position) - position);
+  return static_cast<bool>(file);
+}
+
+bool ParameterTables::ReadCsv(const std::string& filename,
+                              const std::string& name, ParameterTable* table) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  table->name = name;
+  table->dims.clear();
+  table->data.clear();
+  uint32_t no_blocks = 0, no_rows = 0, no_cols = 0, rows_in_block = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      // An empty line closes the current block
+      if (rows_in_block > 0) {
+        if (no_blocks > 0 && rows_in_block != no_rows) {
+          return false;
+        }
+        no_rows = rows_in_block;
+        no_blocks++;
+        rows_in_block = 0;
+      }
+      continue;
+    }
+    std::stringstream row(line);
+    std::string cell;
+    uint32_t cols = 0;
+    while (std::getline(row, cell, ',')) {
+      char* end = nullptr;
+      float value = std::strtof(cell.c_str(), &end);
+      if (end == cell.c_str()) {
+        return false;
+      }
+      table->data.push_back(value);
+      cols++;
+    }
+    if (no_cols > 0 && cols != no_cols) {
+      return false;
+    }
+    no_cols = cols;
+    rows_in_block++;
+  }
+  if (rows_in_block > 0) {
+    if (no_blocks > 0 && rows_in_block != no_rows) {
+      return false;
+    }
+    no_rows = rows_in_block;
+    no_blocks++;
+  }
+  if (no_blocks == 0) {
+    return false;
+  }
+  if (no_blocks > 1) {
+    table->dims = {no_blocks, no_rows, no_cols};
+  } else if (no_rows > 1) {
+    table->dims = {no_rows, no_cols};
+  } else {
+    table->dims = {no_cols};
+  }
+  return true;
+}
+
+bool ParameterTables::ReadJson(const std::string& filename,
+                               std::vector<ParameterTable>* tables) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string text = buffer.str();
+  JsonParser parser(text);
+  return parser.Parse(tables);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,96 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef PARAMETER_TABLES_H_
+#define PARAMETER_TABLES_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// A named, dense table of up to three dimensions (row-major)
+struct ParameterTable {
+  std::string name;
+  std::vector<uint32_t> dims;
+  std::vector<float> data;
+};
+
+// Read-only, memory-mapped file of parameter tables. The file is mapped with
+// MAP_SHARED, i.e. concurrent simulations that use the same file share the
+// pages in the page cache and do not parse the tables.
+//
+// Layout (little endian):
+//   "HIVPTAB1" | no_tables (8 bytes) | no_tables entries | data
+//   entry: name (56 bytes, zero padded) | rank (4) | dims (3 x 4) | offset (8)
+// The data of each table is an array of floats starting at the given offset,
+// aligned to 64 bytes.
+//
+// This file does not depend on BioDynaMo, such that the converter in tools/
+// can be built without it.
+class ParameterTables {
+ public:
+  ParameterTables() {}
+  ~ParameterTables();
+
+  ParameterTables(const ParameterTables&) = delete;
+  ParameterTables& operator=(const ParameterTables&) = delete;
+
+  // Map the file. Returns false if it cannot be mapped or is not a valid
+  // table file.
+  bool Open(const std::string& filename);
+
+  // Returns the data of the table with the given name and its dimensions, or
+  // nullptr if there is no such table. The data stays valid until the object
+  // is destroyed.
+  const float* Get(const std::string& name,
+                   std::vector<uint32_t>* dims) const;
+
+  // Names of all tables in the file
+  std::vector<std::string> GetNames() const;
+
+  // Write the given tables to a file. Returns false on failure.
+  static bool Write(const std::string& filename,
+                    const std::vector<ParameterTable>& tables);
+
+  // Read a table from a CSV file. Rows are lines, columns are separated by
+  // commas. Three-dimensional tables are given as blocks of rows separated by
+  // empty lines. Returns false if the file is missing or ragged.
+  static bool ReadCsv(const std::string& filename, const std::string& name,
+                      ParameterTable* table);
+
+  // Read all numeric (nested) arrays of up to three dimensions from a JSON
+  // file, e.g. the SimParam section of a bdm.json. Members that are not
+  // arrays of numbers are ignored. Returns false if the file cannot be parsed.
+  static bool ReadJson(const std::string& filename,
+                       std::vector<ParameterTable>* tables);
+
+ private:
+  struct Entry {
+    char name[56];
+    uint32_t rank;
+    uint32_t dims[3];
+    uint64_t offset;
+  };
+
+  void* data_ = nullptr;
+  uint64_t size_ = 0;
+  const Entry* entries_ = nullptr;
+  uint64_t no_tables_ = 0;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // PARAMETER_TABLES_H_
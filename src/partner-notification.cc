@@ -0,0 +1,141 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "partner-notification.h"
+
+#include <algorithm>
+
+namespace bdm {
+namespace hiv_malawi {
+
+PartnerNotification::PartnerNotification() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  index_cases_.resize(tinfo->GetMaxThreads());
+}
+
+void PartnerNotification::AddIndexCase(Person* person,
+                                       const PartnershipHistory& history) {
+  if (person->history_slot_ < 0) {
+    return;
+  }
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  index_cases_[tid].push_back(
+      {person->history_slot_, history.GetGeneration(person->history_slot_)});
+}
+
+void PartnerNotification::Trace(PartnershipHistory* history,
+                                const SimParam* sparam, Random* random,
+                                CohortTracker* tracker) {
+  // Merge the thread-local buffers and sort them to obtain a deterministic
+  // order of the random numbers.
+  std::vector<IndexCase> index_cases;
+  for (auto& el : index_cases_) {
+    index_cases.insert(index_cases.end(), el.begin(), el.end());
+    el.clear();
+  }
+  std::sort(index_cases.begin(), index_cases.end(),
+            [](const IndexCase& a, const IndexCase& b) {
+              return a.slot < b.slot;
+            });
+  index_cases.erase(std::unique(index_cases.begin(), index_cases.end(),
+                                [](const IndexCase& a, const IndexCase& b) {
+                                  return a.slot == b.slot;
+                                }),
+                    index_cases.end());
+
+  no_index_cases_ = 0;
+  no_notified_ = 0;
+  no_treated_ = 0;
+  visited_.resize(history->GetNumSlots(), false);
+  auto visit = [&](int slot) {
+    visited_[slot] = true;
+    visited_slots_.push_back(slot);
+  };
+
+  // Slots of the agents that are interviewed in the current generation
+  std::vector<int> interviewed, notified;
+  for (const auto& index_case : index_cases) {
+    // Index cases that died in the meantime are not interviewed.
+    if (history->GetGeneration(index_case.slot) != index_case.generation) {
+      continue;
+    }
+    no_index_cases_++;
+    interviewed.push_back(index_case.slot);
+    visit(index_case.slot);
+  }
+
+  std::vector<const PartnershipRecord*> traced;
+  for (size_t depth = 0;
+       depth < sparam->partner_notification_depth && !interviewed.empty();
+       depth++) {
+    notified.clear();
+    for (int slot : interviewed) {
+      // Repeated partnerships with the same partner are traced once
+      traced.clear();
+      size_t no_records = history->GetNumRecords(slot);
+      for (size_t i = 0;
+           i < no_records &&
+           traced.size() < sparam->partner_notification_no_partners;
+           i++) {
+        const auto& record = history->GetRecord(slot, i);
+        auto same_partner = [&](const PartnershipRecord* other) {
+          return other->partner_slot_ == record.partner_slot_ &&
+                 other->partner_generation_ == record.partner_generation_;
+        };
+        if (std::any_of(traced.begin(), traced.end(), same_partner)) {
+          continue;
+        }
+        traced.push_back(&record);
+        auto partner = history->GetPartner(record);
+        // Partner died in the meantime or was already notified (or
+        // interviewed) in this tracing
+        if (partner == nullptr || visited_[record.partner_slot_]) {
+          continue;
+        }
+        if (random->Uniform() >= sparam->partner_notification_success) {
+          continue;
+        }
+        no_notified_++;
+        visit(record.partner_slot_);
+        notified.push_back(record.partner_slot_);
+        if (partner->IsAcute() || partner->IsChronic()) {
+          // The partner is tested positive and possibly starts treatment
+          if (random->Uniform() < sparam->partner_notification_art_uptake) {
+            partner->state_ = GemsState::kTreated;
+            no_treated_++;
+            if (tracker != nullptr) {
+              tracker->Record(partner.Get(),
+                              CohortEventType::kEventStateChange,
+                              GemsState::kTreated);
+            }
+          }
+        } else if (partner->IsHealthy() &&
+                   sparam->partner_notification_prep_uptake > 0) {
+          // The partner is tested negative and possibly starts PrEP
+          if (random->Uniform() < sparam->partner_notification_prep_uptake) {
+            partner->prevention_ |= PreventionModifier::kPrEP;
+          }
+        }
+      }
+    }
+    // The notified partners are interviewed in the next generation
+    interviewed.swap(notified);
+  }
+
+  for (int slot : visited_slots_) {
+    visited_[slot] = false;
+  }
+  visited_slots_.clear();
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,85 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef PARTNER_NOTIFICATION_H_
+#define PARTNER_NOTIFICATION_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cohort-tracker.h"
+#include "partnership-history.h"
+#include "person.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Assisted partner notification. Agents that are diagnosed (i.e. start
+// treatment) during the behaviour loop are registered as index cases. After the
+// partnership intents were resolved, the most recent distinct partners of
+// every index case are looked up in the PartnershipHistory, which directly
+// maps to the partner agents. The notified partners are interviewed in turn,
+// up to partner_notification_depth generations. Their records are found by
+// the history slot and generation of the partner, and agents are notified at
+// most once per tracing (visited slots). Hence, tracing does not scan the
+// population and its cost is proportional to (number of traced agents) x
+// (history length).
+class PartnerNotification {
+ public:
+  PartnerNotification();
+
+  // Register a newly diagnosed agent as index case. Agents without any
+  // recorded partnership are ignored. Thread-safe.
+  void AddIndexCase(Person* person, const PartnershipHistory& history);
+
+  // Trace the partners of all index cases registered since the last call and
+  // offer them testing. The partners of notified partners are traced up to
+  // partner_notification_depth generations. Infected partners that are not
+  // yet treated start treatment with probability
+  // partner_notification_art_uptake, healthy partners receive PrEP with
+  // probability partner_notification_prep_uptake.
+  // Treatment starts of tracked agents are recorded by tracker (if not
+  // nullptr).
+  void Trace(PartnershipHistory* history, const SimParam* sparam,
+             Random* random, CohortTracker* tracker = nullptr);
+
+  // Number of index cases, notified partners, and partners that started
+  // treatment in the last call of Trace()
+  uint64_t GetNumIndexCases() const { return no_index_cases_; }
+  uint64_t GetNumNotified() const { return no_notified_; }
+  uint64_t GetNumTreated() const { return no_treated_; }
+
+ private:
+  // The index case is identified by its history slot. The generation detects
+  // index cases that died before the tracing.
+  struct IndexCase {
+    int slot;
+    uint16_t generation;
+  };
+
+  // Thread-local index case buffers
+  SharedData<std::vector<IndexCase>> index_cases_;
+  // History slots that were interviewed or notified in the current tracing.
+  // Reset after each tracing through the list of visited slots.
+  std::vector<bool> visited_;
+  std::vector<int> visited_slots_;
+
+  uint64_t no_index_cases_ = 0;
+  uint64_t no_notified_ = 0;
+  uint64_t no_treated_ = 0;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // PARTNER_NOTIFICATION_H_
@@ -0,0 +1,237 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "partnership-history.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace bdm {
+namespace hiv_malawi {
+
+void PartnershipHistory::Initialize(size_t history_length,
+                                    const std::string& spill_file) {
+  if (history_length == 0 ||
+      history_length > std::numeric_limits<uint8_t>::max()) {
+    Log::Fatal("PartnershipHistory::Initialize()",
+               "The partnership history length must be in [1, 255]. Received ",
+               history_length, ".");
+  }
+  history_length_ = history_length;
+  if (!spill_file.empty()) {
+    spill_.open(spill_file, std::ios::out | std::ios::binary);
+    if (!spill_.is_open()) {
+      Log::Warning("PartnershipHistory::Initialize()", "Could not open ",
+                   spill_file, ". Older partnerships will be discarded.");
+    }
+  }
+}
+
+int PartnershipHistory::Acquire(Person* person) {
+  if (person->history_slot_ >= 0) {
+    return person->history_slot_;
+  }
+  int slot;
+  if (!free_.empty()) {
+    slot = free_.back();
+    free_.pop_back();
+  } else {
+    slot = static_cast<int>(owners_.size());
+    owners_.push_back(nullptr);
+    headers_.push_back({0, 0, 0, 0});
+    records_.resize(records_.size() + history_length_);
+  }
+  owners_[slot] = person->GetAgentPtr<Person>();
+  person->history_slot_ = slot;
+  return slot;
+}
+
+void PartnershipHistory::Release(int slot) {
+  if (slot < 0 || static_cast<size_t>(slot) >= owners_.size()) {
+    return;
+  }
+  auto& header = headers_[slot];
+  // Records that point to this slot become invalid.
+  header.generation++;
+  header.lifetime_partners = 0;
+  header.next = 0;
+  header.size = 0;
+  owners_[slot] = nullptr;
+  free_.push_back(slot);
+}
+
+bool PartnershipHistory::HasPartner(int slot, uint64_t partner_uid) const {
+  for (size_t i = 0; i < headers_[slot].size; i++) {
+    if (GetRecord(slot, i).partner_uid_ == partner_uid) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PartnershipHistory::Append(int slot, const PartnershipRecord& record) {
+  if (!HasPartner(slot, record.partner_uid_)) {
+    headers_[slot].lifetime_partners++;
+  }
+  auto& header = headers_[slot];
+  auto& entry = records_[slot * history_length_ + header.next];
+  if (header.size == history_length_) {
+    // The oldest record is overwritten.
+    if (spill_.is_open()) {
+      uint64_t owner_uid = static_cast<uint64_t>(owners_[slot]->GetUid());
+      spill_.write(reinterpret_cast<const char*>(&owner_uid),
+                   sizeof(owner_uid));
+      spill_.write(reinterpret_cast<const char*>(&entry.partner_uid_),
+                   sizeof(entry.partner_uid_));
+      spill_.write(reinterpret_cast<const char*>(&entry.start_year_),
+                   sizeof(entry.start_year_));
+      spill_.write(reinterpret_cast<const char*>(&entry.type_),
+                   sizeof(entry.type_));
+      spill_.write(reinterpret_cast<const char*>(&entry.age_gap_),
+                   sizeof(entry.age_gap_));
+    }
+  } else {
+    header.size++;
+  }
+  entry = record;
+  header.next = (header.next + 1) % history_length_;
+}
+
+void PartnershipHistory::Record(Person* a, Person* b, int type, int year) {
+  int slot_a = Acquire(a);
+  int slot_b = Acquire(b);
+  int age_gap = std::max(-128, std::min(127, static_cast<int>(b->age_) -
+                                                 static_cast<int>(a->age_)));
+  Append(slot_a, {static_cast<uint64_t>(b->GetUid()),
+                  static_cast<uint32_t>(slot_b), headers_[slot_b].generation,
+                  static_cast<int16_t>(year), static_cast<uint8_t>(type),
+                  static_cast<int8_t>(age_gap)});
+  Append(slot_b, {static_cast<uint64_t>(a->GetUid()),
+                  static_cast<uint32_t>(slot_a), headers_[slot_a].generation,
+                  static_cast<int16_t>(year), static_cast<uint8_t>(type),
+                  static_cast<int8_t>(-age_gap)});
+}
+
+void PartnershipHistory::RecordWithDeceased(Person* survivor,
+                                            uint64_t deceased_uid,
+                                            int deceased_slot,
+                                            int deceased_age, int type,
+                                            int year) {
+  int slot = Acquire(survivor);
+  int age_gap = std::max(
+      -128, std::min(127, deceased_age - static_cast<int>(survivor->age_)));
+  // The slot of the deceased agent is released after the resolution, which
+  // invalidates the generation of the record.
+  uint32_t partner_slot = kNoHistorySlot;
+  uint16_t partner_generation = 0;
+  if (deceased_slot >= 0) {
+    partner_slot = static_cast<uint32_t>(deceased_slot);
+    partner_generation = headers_[deceased_slot].generation;
+  }
+  Append(slot, {deceased_uid, partner_slot, partner_generation,
+                static_cast<int16_t>(year), static_cast<uint8_t>(type),
+                static_cast<int8_t>(age_gap)});
+}
+
+size_t PartnershipHistory::GetNumRecords(int slot) const {
+  if (slot < 0) {
+    return 0;
+  }
+  return headers_[slot].size;
+}
+
+const PartnershipRecord& PartnershipHistory::GetRecord(int slot,
+                                                       size_t i) const {
+  const auto& header = headers_[slot];
+  size_t pos = (header.next + history_length_ - 1 - i) % history_length_;
+  return records_[slot * history_length_ + pos];
+}
+
+uint32_t PartnershipHistory::GetLifetimePartners(int slot) const {
+  if (slot < 0) {
+    return 0;
+  }
+  return headers_[slot].lifetime_partners;
+}
+
+AgentPointer<Person> PartnershipHistory::GetPartner(
+    const PartnershipRecord& record) const {
+  if (record.partner_slot_ == kNoHistorySlot ||
+      headers_[record.partner_slot_].generation != record.partner_generation_) {
+    return nullptr;
+  }
+  return owners_[record.partner_slot_];
+}
+
+const PartnershipStatistics& PartnershipHistory::GetStatistics(int year) {
+  if (statistics_year_ == year) {
+    return statistics_;
+  }
+  uint64_t no_agents = 0;
+  uint64_t lifetime_partners = 0;
+  uint64_t no_concurrent = 0;
+  int64_t sum_age_gap = 0;
+  uint64_t no_regular = 0;
+  // Distinct partners of the slot owner in the current year
+  std::vector<uint64_t> partners_this_year;
+  for (size_t slot = 0; slot < owners_.size(); slot++) {
+    if (owners_[slot] == nullptr) {
+      continue;
+    }
+    auto* owner = owners_[slot].Get();
+    const auto& header = headers_[slot];
+    no_agents++;
+    lifetime_partners += header.lifetime_partners;
+    // Partners in the current year: new partnerships of this year plus an
+    // ongoing regular partnership from a previous year
+    partners_this_year.clear();
+    if (owner->hasPartner() && owner->partnership_year_ < year) {
+      partners_this_year.push_back(
+          static_cast<uint64_t>(owner->partner_->GetUid()));
+    }
+    for (size_t i = 0; i < header.size; i++) {
+      const auto& record = GetRecord(slot, i);
+      if (record.start_year_ == year &&
+          std::find(partners_this_year.begin(), partners_this_year.end(),
+                    record.partner_uid_) == partners_this_year.end()) {
+        partners_this_year.push_back(record.partner_uid_);
+      }
+      if (record.type_ == TransmissionType::kRegularPartner &&
+          owner->IsMale()) {
+        sum_age_gap += record.age_gap_;
+        no_regular++;
+      }
+    }
+    if (partners_this_year.size() >= 2) {
+      no_concurrent++;
+    }
+  }
+
+  statistics_ = PartnershipStatistics();
+  statistics_.no_agents = no_agents;
+  if (no_agents > 0) {
+    statistics_.mean_lifetime_partners =
+        static_cast<double>(lifetime_partners) / no_agents;
+    statistics_.concurrency_prevalence =
+        static_cast<double>(no_concurrent) / no_agents;
+  }
+  if (no_regular > 0) {
+    statistics_.mean_regular_age_gap =
+        static_cast<double>(sum_age_gap) / no_regular;
+  }
+  statistics_year_ = year;
+  return statistics_;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
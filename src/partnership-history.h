@@ -0,0 +1,163 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef PARTNERSHIP_HISTORY_H_
+#define PARTNERSHIP_HISTORY_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "person.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// A single (casual or regular) partnership as seen from one of the partners.
+// The partner is identified by its uid, and found by its history slot and the
+// generation of the slot, such that records pointing to a deceased partner can
+// be detected after the slot was reused. 24 bytes.
+struct PartnershipRecord {
+  uint64_t partner_uid_;
+  // kNoHistorySlot if the partner died before it owned a slot
+  uint32_t partner_slot_;
+  uint16_t partner_generation_;
+  int16_t start_year_;
+  // TransmissionType::kCasualPartner or TransmissionType::kRegularPartner
+  uint8_t type_;
+  // Age of the partner minus age of the agent, clamped to [-128, 127]
+  int8_t age_gap_;
+};
+static_assert(sizeof(PartnershipRecord) == 24,
+              "PartnershipRecord is part of the memory bound of the history");
+
+constexpr uint32_t kNoHistorySlot = 0xffffffff;
+
+// Population-level statistics computed from the partnership history.
+struct PartnershipStatistics {
+  // Number of (alive) agents with at least one recorded partnership
+  uint64_t no_agents = 0;
+  // Mean number of partners over the lifetime of these agents
+  double mean_lifetime_partners = 0.0;
+  // Fraction of these agents with two or more distinct partners in the
+  // current year
+  double concurrency_prevalence = 0.0;
+  // Mean age gap (female minus male age) of the regular partnerships that are
+  // still in the history of male agents
+  double mean_regular_age_gap = 0.0;
+};
+
+// The PartnershipHistory stores the most recent partnerships of every agent in
+// a shared arena. Each agent that has had at least one partner owns a slot
+// with a fixed number of records (ring buffer), hence the memory is bounded by
+// (number of sexually active agents) x (history length) x 24 bytes. Slots of
+// deceased agents are recycled. If a spill file is given, records that are
+// overwritten in the ring buffer are appended to the file as packed binary
+// records of 20 bytes: uid of the owner (uint64), uid of the partner
+// (uint64), start year (int16), type (uint8), and age gap (int8).
+//
+// Partnerships are recorded while the PartnershipIntents are resolved, which is
+// single-threaded, hence no synchronization is required.
+class PartnershipHistory {
+ public:
+  PartnershipHistory() = default;
+
+  // Set the number of records per agent and the (optional) spill file. Must be
+  // called before the first partnership is recorded.
+  void Initialize(size_t history_length, const std::string& spill_file);
+
+  // Returns true if Initialize() has been called.
+  bool IsInitialized() const { return history_length_ > 0; }
+
+  // Record a partnership between a and b for both agents.
+  void Record(Person* a, Person* b, int type, int year);
+
+  // Record a partnership of the survivor with an agent that died in the same
+  // step. The deceased agent must not be dereferenced, hence we pass its uid,
+  // slot (-1 if it has none), and age. Only the survivor's history is updated.
+  void RecordWithDeceased(Person* survivor, uint64_t deceased_uid,
+                          int deceased_slot, int deceased_age, int type,
+                          int year);
+
+  // Release the slot of a deceased agent. The agent must not be dereferenced,
+  // hence we pass its slot.
+  void Release(int slot);
+
+  // Get the number of records of the slot (at most history length)
+  size_t GetNumRecords(int slot) const;
+
+  // Get the i-th most recent record of the slot
+  const PartnershipRecord& GetRecord(int slot, size_t i) const;
+
+  // Get the number of partners over the lifetime of the slot owner. A
+  // partnership with a partner that is still in the history of the owner is
+  // not counted again.
+  uint32_t GetLifetimePartners(int slot) const;
+
+  // Get the current generation of the slot. It changes when the owner dies.
+  uint16_t GetGeneration(int slot) const { return headers_[slot].generation; }
+
+  // Returns the owner of the partner of a record, or nullptr if the partner
+  // died in the meantime.
+  AgentPointer<Person> GetPartner(const PartnershipRecord& record) const;
+
+  // Get the number of slots, including the free ones
+  size_t GetNumSlots() const { return owners_.size(); }
+
+  // Get the number of slots in use
+  size_t GetNumActiveSlots() const { return owners_.size() - free_.size(); }
+
+  // Compute the PartnershipStatistics in a single pass over the arena. The
+  // result is cached, i.e. the pass runs at most once per year.
+  const PartnershipStatistics& GetStatistics(int year);
+
+ private:
+  // Per-slot bookkeeping
+  struct SlotHeader {
+    uint32_t lifetime_partners;
+    uint16_t generation;
+    // Position of the next record in the ring buffer
+    uint8_t next;
+    // Number of valid records
+    uint8_t size;
+  };
+
+  // Returns the slot of the person. Assigns a new slot if necessary.
+  int Acquire(Person* person);
+
+  // Append a record to the ring buffer of a slot
+  void Append(int slot, const PartnershipRecord& record);
+
+  // Returns true if the partner of the uid is in the ring buffer of the slot
+  bool HasPartner(int slot, uint64_t partner_uid) const;
+
+  size_t history_length_ = 0;
+  // history_length_ records per slot, stored contiguously
+  std::vector<PartnershipRecord> records_;
+  std::vector<SlotHeader> headers_;
+  // Agent that owns the slot, nullptr for free slots
+  std::vector<AgentPointer<Person>> owners_;
+  // Slots that can be reused
+  std::vector<int> free_;
+
+  // Records that are overwritten in the ring buffer are spilled to this file
+  std::ofstream spill_;
+
+  PartnershipStatistics statistics_;
+  int statistics_year_ = -1;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // PARTNERSHIP_HISTORY_H_
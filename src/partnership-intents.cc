@@ -0,0 +1,309 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "partnership-intents.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "categorical-environment.h"
+#include "cohort-tracker.h"
+#include "couple-table.h"
+#include "household-table.h"
+#include "partnership-history.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+uint64_t UidOf(const Person* person) {
+  return static_cast<uint64_t>(person->GetUid());
+}
+
+}  // namespace
+
+PartnershipIntents::PartnershipIntents() {
+  auto* tinfo = ThreadInfo::GetInstance();
+  thread_intents_.resize(tinfo->GetMaxThreads());
+}
+
+void PartnershipIntents::Add(const PartnershipIntent& intent) {
+  auto tid = ThreadInfo::GetInstance()->GetMyThreadId();
+  thread_intents_[tid].push_back(intent);
+}
+
+void PartnershipIntents::AddRelocation(Person* person, int new_location) {
+  // Agents born in the current step do not belong to a household yet.
+  if (person->household_ < 0) {
+    return;
+  }
+  uint64_t key = UidOf(person);
+  Add({key, key, IntentType::kRelocateHousehold, person->GetAgentPtr<Person>(),
+       nullptr, new_location, person->household_});
+}
+
+void PartnershipIntents::AddCasualContact(Person* person,
+                                          AgentPointer<Person> mate,
+                                          int infector_state, int infector_sb) {
+  Add({UidOf(person), UidOf(mate.Get()), IntentType::kCasualContact,
+       person->GetAgentPtr<Person>(), mate, infector_state, infector_sb});
+}
+
+void PartnershipIntents::AddBreakup(Person* person) {
+  if (!person->hasPartner()) {
+    Log::Warning("PartnershipIntents::AddBreakup()", "Person is single");
+    return;
+  }
+  Add({UidOf(person), UidOf(person->partner_.Get()), IntentType::kBreakup,
+       person->GetAgentPtr<Person>(), person->partner_, 0, 0});
+}
+
+void PartnershipIntents::AddFormation(AgentPointer<Person> male,
+                                      AgentPointer<Person> female, int year) {
+  Add({UidOf(male.Get()), UidOf(female.Get()), IntentType::kFormation, male,
+       female, year, 0});
+}
+
+void PartnershipIntents::AddDeath(Person* person) {
+  uint64_t key = UidOf(person);
+  auto source = person->GetAgentPtr<Person>();
+  // If has regular partner, end partnership
+  if (person->hasPartner()) {
+    Add({key, UidOf(person->partner_.Get()), IntentType::kUnlinkPartner,
+         source, person->partner_, 0, 0});
+  }
+  // If mother dies, children have no mother anymore
+  for (auto& child : person->children_) {
+    Add({key, UidOf(child.Get()), IntentType::kUnlinkChild, source, child, 0,
+         0});
+  }
+  // If a child dies and has a mother, remove him from mother's list of
+  // children
+  if (person->mother_ != nullptr) {
+    Add({key, UidOf(person->mother_.Get()), IntentType::kUnlinkMother, source,
+         person->mother_, 0, 0});
+  }
+  Add({key, key, IntentType::kDeath, source, nullptr, person->history_slot_,
+       static_cast<int>(person->age_)});
+}
+
+size_t PartnershipIntents::GetNumIntents() const {
+  size_t no_intents = intents_.size();
+  for (auto& el : thread_intents_) {
+    no_intents += el.size();
+  }
+  return no_intents;
+}
+
+void PartnershipIntents::Collect() {
+  intents_.clear();
+  for (auto& el : thread_intents_) {
+    intents_.insert(intents_.end(), el.begin(), el.end());
+    el.clear();
+  }
+  // The thread-local buffers are merged in an arbitrary order. Intents of one
+  // agent are always emitted by the same thread, hence a stable sort by type
+  // and issuing agent yields a deterministic order.
+  std::stable_sort(intents_.begin(), intents_.end(),
+                   [](const PartnershipIntent& a, const PartnershipIntent& b) {
+                     if (a.type_ != b.type_) {
+                       return a.type_ < b.type_;
+                     }
+                     return a.key_ < b.key_;
+                   });
+}
+
+bool PartnershipIntents::IsDead(uint64_t key) const {
+  return std::binary_search(dead_.begin(), dead_.end(), key);
+}
+
+const PartnershipIntent& PartnershipIntents::GetDeath(uint64_t key) const {
+  // intents_ is sorted by type and issuing agent
+  auto it = std::lower_bound(
+      intents_.begin(), intents_.end(), key,
+      [](const PartnershipIntent& intent, uint64_t k) {
+        return intent.type_ < IntentType::kDeath ||
+               (intent.type_ == IntentType::kDeath && intent.key_ < k);
+      });
+  assert(it != intents_.end() && it->type_ == IntentType::kDeath &&
+         it->key_ == key);
+  return *it;
+}
+
+void PartnershipIntents::RecordDeceasedContact(
+    const PartnershipIntent& intent, int year) {
+  bool source_dead = IsDead(intent.key_);
+  auto* survivor = source_dead ? intent.target_.Get() : intent.source_.Get();
+  const auto& death = GetDeath(source_dead ? intent.key_ : intent.target_key_);
+  history_->RecordWithDeceased(survivor, death.key_, death.value_,
+                               death.value2_, TransmissionType::kCasualPartner,
+                               year);
+}
+
+void PartnershipIntents::MoveHousehold(int h, int new_location) {
+  if (households_ == nullptr ||
+      static_cast<size_t>(h) >= households_->GetNumHouseholds()) {
+    return;
+  }
+  for (size_t i = 0; i < households_->GetHouseholdSize(h); i++) {
+    if (IsDead(households_->GetMemberKey(h, i))) {
+      continue;
+    }
+    auto member = households_->GetMember(h, i);
+    member->location_ = new_location;
+    if (env_ != nullptr) {
+      env_->UpdateCompoundCategory(member.Get());
+    }
+    if (tracker_ != nullptr) {
+      tracker_->Record(member.Get(), CohortEventType::kEventMigration,
+                       new_location);
+    }
+    // Children born in the current step are not yet part of the household of
+    // their mother.
+    if (member->sex_ == Sex::kFemale) {
+      for (auto& child : member->children_) {
+        if (child->household_ < 0) {
+          // Newborns are younger than min_age and have no compound category
+          child->location_ = new_location;
+        }
+      }
+    }
+  }
+}
+
+void PartnershipIntents::Resolve(CoupleTable* couple_table) {
+  Collect();
+
+  // Agents that died must not be dereferenced below.
+  dead_.clear();
+  for (auto& intent : intents_) {
+    if (intent.type_ == IntentType::kDeath) {
+      dead_.push_back(intent.key_);
+    }
+  }
+  std::sort(dead_.begin(), dead_.end());
+
+  bool record_history = history_ != nullptr && history_->IsInitialized();
+  int year = 0;
+  if (record_history) {
+    auto* sim = Simulation::GetActive();
+    year = static_cast<int>(sim->GetParam()->Get<SimParam>()->start_year +
+                            sim->GetScheduler()->GetSimulatedSteps());
+  }
+
+  for (auto& intent : intents_) {
+    if (IsDead(intent.target_key_)) {
+      // The contact is recorded in the history of the male if he survived
+      if (intent.type_ == IntentType::kCasualContact && record_history &&
+          !IsDead(intent.key_)) {
+        RecordDeceasedContact(intent, year);
+      }
+      continue;
+    }
+    switch (intent.type_) {
+      case IntentType::kRelocateHousehold:
+        MoveHousehold(intent.value2_, intent.value_);
+        break;
+      case IntentType::kCasualContact:
+        intent.target_->no_casual_partners_ += 1;
+        if (record_history) {
+          if (IsDead(intent.key_)) {
+            // The male died in the same step
+            RecordDeceasedContact(intent, year);
+          } else {
+            history_->Record(intent.source_.Get(), intent.target_.Get(),
+                             TransmissionType::kCasualPartner, year);
+          }
+        }
+        if (tracker_ != nullptr) {
+          tracker_->Record(intent.target_.Get(),
+                           CohortEventType::kEventCasualPartner, 0);
+        }
+        if (intent.value_ != GemsState::kHealthy &&
+            intent.target_->IsHealthy()) {
+          intent.target_->BecomeInfected(TransmissionType::kCasualPartner,
+                                         intent.value_, intent.value2_);
+          if (tracker_ != nullptr) {
+            tracker_->Record(intent.target_.Get(),
+                             CohortEventType::kEventInfection,
+                             TransmissionType::kCasualPartner, intent.value_);
+          }
+        }
+        break;
+      case IntentType::kBreakup:
+        // If the issuing agent died, the partnership is ended by its
+        // kUnlinkPartner intent.
+        if (!IsDead(intent.key_) &&
+            intent.source_->IsPartnerOf(intent.target_)) {
+          intent.source_->SeparateFromPartner();
+        }
+        break;
+      case IntentType::kFormation:
+        intent.source_->SetPartner(intent.target_);
+        intent.source_->partnership_year_ = intent.value_;
+        intent.target_->partnership_year_ = intent.value_;
+        if (record_history) {
+          history_->Record(intent.source_.Get(), intent.target_.Get(),
+                           TransmissionType::kRegularPartner, intent.value_);
+        }
+        if (couple_table != nullptr) {
+          couple_table->AddCouple(intent.source_, intent.target_,
+                                  intent.value_);
+        }
+        if (tracker_ != nullptr) {
+          tracker_->Record(intent.source_.Get(),
+                           CohortEventType::kEventRegularPartner, 0);
+          tracker_->Record(intent.target_.Get(),
+                           CohortEventType::kEventRegularPartner, 0);
+        }
+        break;
+      case IntentType::kUnlinkPartner:
+        if (intent.target_->IsPartnerOf(intent.source_)) {
+          intent.target_->partner_ = nullptr;
+        }
+        break;
+      case IntentType::kUnlinkChild:
+        if (intent.target_->IsChildOf(intent.source_)) {
+          intent.target_->mother_ = nullptr;
+        }
+        break;
+      case IntentType::kUnlinkMother: {
+        // Compare pointers only, the child must not be dereferenced.
+        auto& children = intent.target_->children_;
+        auto it = std::find(children.begin(), children.end(), intent.source_);
+        if (it != children.end()) {
+          children.erase(it);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // Recycle the history slots of the deceased agents. This happens after all
+  // partnerships were recorded, such that slots are not reused within one
+  // resolution.
+  if (history_ != nullptr) {
+    for (auto& intent : intents_) {
+      if (intent.type_ == IntentType::kDeath) {
+        history_->Release(intent.value_);
+      }
+    }
+  }
+  intents_.clear();
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
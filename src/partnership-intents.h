@@ -0,0 +1,159 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef PARTNERSHIP_INTENTS_H_
+#define PARTNERSHIP_INTENTS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "person.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+class CohortTracker;
+class CategoricalEnvironment;
+class CoupleTable;
+class HouseholdTable;
+class PartnershipHistory;
+
+// Types of intents. The order of the enum defines the order in which the
+// intents are resolved. It follows the order of the behaviours of an agent
+// (migration, mating, partnership, getting older).
+enum IntentType {
+  kRelocateHousehold,  // The household of a migrating agent moves with it
+  kCasualContact,      // Casual contact of a male with a female agent
+  kBreakup,            // End of a regular partnership
+  kFormation,          // Start of a regular partnership
+  kUnlinkPartner,      // The partner of a deceased agent becomes single
+  kUnlinkChild,        // The child of a deceased mother loses its mother
+  kUnlinkMother,       // The mother of a deceased child loses her child
+  kDeath,              // Marks the issuing agent as deceased
+  kIntentLast
+};
+
+// A change that an agent wants to apply to another agent.
+struct PartnershipIntent {
+  // Uid of the agent that issued the intent. Used to order intents
+  // deterministically.
+  uint64_t key_;
+  // Uid of the target agent. Used to detect targets that died.
+  uint64_t target_key_;
+  int type_;
+  AgentPointer<Person> source_;
+  AgentPointer<Person> target_;
+  // Type dependent payload, e.g. the new location, the infector's state, or
+  // the history slot of a deceased agent
+  int value_;
+  // Type dependent payload, e.g. the infector's socio-behavioural category or
+  // the age of a deceased agent
+  int value2_;
+};
+
+// Agents must not modify other agents during the parallel behaviour loop.
+// Instead, all changes to partners, casual mates, children, and mothers are
+// emitted as intents into thread-local buffers and resolved afterwards in a
+// single-threaded, deterministic phase (sorted by intent type and issuing
+// agent). Agents that die are never dereferenced during resolution; they are
+// only compared by uid. Hence, the behaviour loop runs without any neighbour
+// locking.
+class PartnershipIntents {
+ public:
+  PartnershipIntents();
+
+  // The household of the migrating agent (i.e. the partner of a migrating
+  // male and the children under 15) moves to new_location. The migrating agent
+  // updates its own location itself.
+  void AddRelocation(Person* person, int new_location);
+
+  // Casual contact between a male agent and a female mate. If infector_state
+  // is not GemsState::kHealthy, the mate becomes infected.
+  void AddCasualContact(Person* person, AgentPointer<Person> mate,
+                        int infector_state, int infector_sb);
+
+  // The agent separates from its regular partner.
+  void AddBreakup(Person* person);
+
+  // A new regular partnership formed in the given year.
+  void AddFormation(AgentPointer<Person> male, AgentPointer<Person> female,
+                    int year);
+
+  // The agent dies. Its partner, children, and mother are unlinked during
+  // resolution. Must be called before the agent is removed from the
+  // simulation.
+  void AddDeath(Person* person);
+
+  // Resolve all pending intents and clear the buffers. New partnerships are
+  // registered in couple_table (if not nullptr).
+  void Resolve(CoupleTable* couple_table = nullptr);
+
+  // Get the number of pending intents
+  size_t GetNumIntents() const;
+
+  // Casual contacts and new regular partnerships are recorded in the given
+  // history during the resolution.
+  void SetHistory(PartnershipHistory* history) { history_ = history; }
+
+  // Relocations move the households of the given table.
+  void SetHouseholds(HouseholdTable* households) { households_ = households; }
+
+  // Migrations, partnerships, and infections of tracked agents are recorded
+  // by the given tracker.
+  void SetTracker(CohortTracker* tracker) { tracker_ = tracker; }
+
+  // Relocated agents update their compound category in the given
+  // environment.
+  void SetEnvironment(CategoricalEnvironment* env) { env_ = env; }
+
+ private:
+  // Thread-local intent buffers
+  SharedData<std::vector<PartnershipIntent>> thread_intents_;
+  // Uids of the agents that died since the last resolution (sorted)
+  std::vector<uint64_t> dead_;
+  // Buffer to merge the thread-local intents. Member variable to avoid
+  // reallocations.
+  std::vector<PartnershipIntent> intents_;
+  // Partnership history, may be nullptr
+  PartnershipHistory* history_ = nullptr;
+  // Households of the current simulation step, may be nullptr
+  HouseholdTable* households_ = nullptr;
+  // Cohort tracker, may be nullptr
+  CohortTracker* tracker_ = nullptr;
+  // Environment of the compound categories, may be nullptr
+  CategoricalEnvironment* env_ = nullptr;
+
+  void Add(const PartnershipIntent& intent);
+
+  // Merge the thread-local buffers into intents_ and sort them.
+  void Collect();
+
+  // Returns true if the agent with the given uid died since the last
+  // resolution.
+  bool IsDead(uint64_t key) const;
+
+  // Get the kDeath intent of the agent with the given uid, which died since
+  // the last resolution. Its payload is the history slot and the age.
+  const PartnershipIntent& GetDeath(uint64_t key) const;
+
+  // Record a casual contact of which one partner died in the history of the
+  // other partner.
+  void RecordDeceasedContact(const PartnershipIntent& intent, int year);
+
+  // Move all living members of household h to the new location.
+  void MoveHousehold(int h, int new_location);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // PARTNERSHIP_INTENTS_H_
@@ -40,25 +40,38 @@ struct RandomMigration : public Behavior {
     auto* param = sim->GetParam();
     const auto* sparam = param->Get<SimParam>();
 
+    int year = static_cast<int>(sparam->start_year +
+                                sim->GetScheduler()->GetSimulatedSteps());
+    const auto& year_params = env->GetCompiledParams().GetYearParams(year);
+
     // Probability to migrate
     float rand_num = static_cast<float>(random->Uniform());
     // Adult men and adult single women can initiate migration
-    if (rand_num <= sparam->migration_probability && person->age_ >= 15 &&
+    if (rand_num <= year_params.migration_probability &&
+        person->age_ >= 15 &&
         ((person->sex_ == Sex::kMale) ||
          (person->sex_ == Sex::kFemale && !person->hasPartner()))) {
       // Randomly determine the migration location
       // AM: Sample migration location. It depends on the current year and
       // current location
-      float rand_num_loc = static_cast<float>(random->Uniform());
+      double rand_num_loc = random->Uniform();
       // Get (cumulative) probability distribution that agent relocates the
       // current year, to each location
       const auto& migration_location_distribution_ =
           env->GetMigrationLocDistribution(person->location_);
-
-      int new_location =
-          SampleLocation(rand_num_loc, migration_location_distribution_);
-
-      person->Relocate(new_location);
+      if (migration_location_distribution_.back() == 0) {
+        // No destination with adults
+        return;
+      }
+      int new_location = CategoricalEnvironment::SampleCumulative(
+          rand_num_loc, migration_location_distribution_);
+
+      // The partner and the children follow during the resolution of the
+      // partnership intents.
+      person->location_ = new_location;
+      // The mates of this year are sampled from the new location
+      env->UpdateCompoundCategory(person);
+      env->GetPartnershipIntents().AddRelocation(person, new_location);
     }
   }
 };
@@ -74,21 +87,6 @@ struct MatingBehaviour : public Behavior {
 
   MatingBehaviour() {}
 
-  int SampleCompoundCategory(float rand_num,
-                             const std::vector<float>& category_distribution) {
-    for (size_t i = 0; i < category_distribution.size(); i++) {
-      if (rand_num <= category_distribution[i]) {
-        return i;
-      }
-    }
-
-    // This line of code should never be reached
-    Log::Warning("SampleCompoundCategory()",
-                 "Could not sample the category. Recieved inputs: ", rand_num,
-                 ". Use location 0.");
-    return 0;
-  }
-
   void Run(Agent* agent) override {
     auto* sim = Simulation::GetActive();
     auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
@@ -103,170 +101,120 @@ struct MatingBehaviour : public Behavior {
     int year = static_cast<int>(
         sparam->start_year +
         sim->GetScheduler()->GetSimulatedSteps());  // Current year
-    // If no transition year is higher than current year, then use last
-    // transition year
-    int year_index = sparam->no_mates_year_transition.size() - 1;
-    for (size_t y = 0; y < sparam->no_mates_year_transition.size() - 1; y++) {
-      if (year < sparam->no_mates_year_transition[y + 1]) {
-        year_index = y;
-        break;
-      }
-    }
+    const auto& year_params = env->GetCompiledParams().GetYearParams(year);
+    const int sb = person->social_behaviour_factor_;
     /*int no_mates = static_cast<int>(random->Gaus(
-        sparam->no_mates_mean[year_index][person->social_behaviour_factor_],
-        sparam->no_mates_sigma[year_index][person->social_behaviour_factor_]));*/
+        year_params.no_mates_mean[sb], year_params.no_mates_sigma[sb]));*/
 
     // Poisson Distribution
-    int no_mates = random->Poisson(
-        sparam->no_mates_mean[year_index][person->social_behaviour_factor_]);
+    int no_mates = random->Poisson(year_params.no_mates_mean[sb]);
 
     // This part is only executed for male persons in a certain age group, since
     // the infection goes into both directions.
     if (no_mates > 0 && person->sex_ == Sex::kMale &&
         person->age_ >= env->GetMinAge() && person->age_ < env->GetMaxAge()) {
-      // Compute male agent's age category
-      size_t age_category =
-          person->GetAgeCategory(env->GetMinAge(), env->GetNoAgeCategories());
       // Get (cumulative) probability distribution that the male agent selects a
       // female mate from each compound category
       const std::vector<float>& mate_compound_category_distribution =
-          env->GetMateCompoundCategoryDistribution(
-              person->location_, age_category,
-              person->social_behaviour_factor_);
+          env->GetMateCompoundCategoryDistribution(person->compound_category_);
+      // MSM select male mates from the MSM index with the same cost
+      const bool msm = person->msm_ && env->HasMsm();
+      const std::vector<float>* msm_compound_category_distribution = nullptr;
+      if (msm) {
+        msm_compound_category_distribution =
+            &env->GetMsmCompoundCategoryDistribution(
+                person->compound_category_);
+      }
       // Reset to 0 for this year
       // person->no_casual_partners_ = 0;
+      const auto& transmission_table = env->GetTransmissionTable();
 
       for (int i = 0; i < no_mates; i++) {
-        // AM: select compound category of mate
-        float rand_num = static_cast<float>(random->Uniform());
+        // The mate of an MSM is male with probability msm_mate_probability
+        bool male_mate =
+            msm && random->Uniform() < sparam->msm_mate_probability;
 
-        size_t mate_compound_category = SampleCompoundCategory(
-            rand_num, mate_compound_category_distribution);
+        // AM: select compound category of mate
+        double rand_num = random->Uniform();
+        const auto& distribution = male_mate
+                                       ? *msm_compound_category_distribution
+                                       : mate_compound_category_distribution;
+        if (distribution.back() == 0) {
+          // No potential mates in the categories the agent mixes with
+          continue;
+        }
+        size_t mate_compound_category =
+            CategoricalEnvironment::SampleCumulative(rand_num, distribution);
 
-        // AM: Choose a random female mate at the selected mate compound
+        // AM: Choose a random mate at the selected mate compound
         // category (location, age group and sociobehavioral category
         AgentPointer<Person> mate =
-            env->GetRandomCasualFemaleFromIndex(mate_compound_category);
+            male_mate
+                ? env->GetRandomCasualMsmFromIndex(mate_compound_category)
+                : env->GetRandomCasualFemaleFromIndex(mate_compound_category);
 
         if (mate == nullptr) {
           Log::Fatal("MatingBehaviour()",
                      "Received nullptr as AgentPointer mate.");
         }
+        // An MSM may draw himself from the MSM index
+        if (male_mate && mate->GetUid() == person->GetUid()) {
+          continue;
+        }
+        int direction_to_person = TransmissionDirection::kFemaleToMale;
+        int direction_to_mate = TransmissionDirection::kMaleToFemale;
+        if (male_mate) {
+          direction_to_person = TransmissionDirection::kMaleToMale;
+          direction_to_mate = TransmissionDirection::kMaleToMale;
+        }
 
-        // Increment number of casual partners for both agents
+        // Increment number of casual partners. The mate's counter is
+        // incremented when the casual contact is resolved.
         person->no_casual_partners_ = person->no_casual_partners_ + 1;
-        mate->no_casual_partners_ = mate->no_casual_partners_ + 1;
 
         int no_acts = static_cast<int>(random->Gaus(
-            sparam->no_acts_mean[year_index][person->social_behaviour_factor_],
-            sparam
-                ->no_acts_sigma[year_index][person->social_behaviour_factor_]));
-
-        // Scenario healthy male has intercourse with infected acute female
-        if (mate->state_ == GemsState::kAcute &&
-            person->state_ == GemsState::kHealthy &&
-            random->Uniform() <
-                (1.0 -
-                 pow(1.0 - sparam->infection_probability_acute_fm, no_acts))) {
-          person->state_ = GemsState::kAcute;
-          person->transmission_type_ = TransmissionType::kCasualPartner;
-          person->infection_origin_state_ = mate->state_;
-          person->infection_origin_sb_ = mate->social_behaviour_factor_;
-          // AM: Add MatingBehaviour only when male gets infected
-          /*person->AddBehavior(new MatingBehaviour());
-          std::cout << "This should not currently happen: AddBehavior(new
-          MatingBehaviour()) in MatingBehaviour::Run()" << std::endl;*/
-        }
-        // Scenario healthy male has intercourse with infected chronic female
-        else if (mate->state_ == GemsState::kChronic &&
-                 person->state_ == GemsState::kHealthy &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_chronic_fm,
-                                no_acts))) {
-          person->state_ = GemsState::kAcute;
-          person->transmission_type_ = TransmissionType::kCasualPartner;
-          person->infection_origin_state_ = mate->state_;
-          person->infection_origin_sb_ = mate->social_behaviour_factor_;
-          // AM: Add MatingBehaviour only when male gets infected
-          /*person->AddBehavior(new MatingBehaviour());
-          std::cout << "This should not currently happen: AddBehavior(new
-          MatingBehaviour()) in MatingBehaviour::Run()" << std::endl;*/
-        }
-        // Scenario healthy male has intercourse with infected treated female
-        else if (mate->state_ == GemsState::kTreated &&
-                 person->state_ == GemsState::kHealthy &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_treated_fm,
-                                no_acts))) {
-          person->state_ = GemsState::kAcute;
-          person->transmission_type_ = TransmissionType::kCasualPartner;
-          person->infection_origin_state_ = mate->state_;
-          person->infection_origin_sb_ = mate->social_behaviour_factor_;
-          // AM: Add MatingBehaviour only when male gets infected
-          /*person->AddBehavior(new MatingBehaviour());
-          std::cout << "This should not currently happen: AddBehavior(new
-          MatingBehaviour()) in MatingBehaviour::Run()" << std::endl;*/
-        }
-        // Scenario healthy male has intercourse with infected failing treatment
-        // female
-        else if (mate->state_ == GemsState::kFailing &&
-                 person->state_ == GemsState::kHealthy &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_failing_fm,
-                                no_acts))) {
-          person->state_ = GemsState::kAcute;
-          person->transmission_type_ = TransmissionType::kCasualPartner;
-          person->infection_origin_state_ = mate->state_;
-          person->infection_origin_sb_ = mate->social_behaviour_factor_;
-          // AM: Add MatingBehaviour only when male gets infected
-          /*person->AddBehavior(new MatingBehaviour());
-          std::cout << "This should not currently happen: AddBehavior(new
-          MatingBehaviour()) in MatingBehaviour::Run()" << std::endl;*/
-        }
-        // Scenario infected acute male has intercourse with healthy female
-        else if (mate->state_ == GemsState::kHealthy &&
-                 person->state_ == GemsState::kAcute &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_acute_mf,
-                                no_acts))) {
-          mate->state_ = GemsState::kAcute;
-          mate->transmission_type_ = TransmissionType::kCasualPartner;
-          mate->infection_origin_state_ = person->state_;
-          mate->infection_origin_sb_ = person->social_behaviour_factor_;
-        }  // Scenario infected chronic male has intercourse with healthy female
-        else if (mate->state_ == GemsState::kHealthy &&
-                 person->state_ == GemsState::kChronic &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_chronic_mf,
-                                no_acts))) {
-          mate->state_ = GemsState::kAcute;
-          mate->transmission_type_ = TransmissionType::kCasualPartner;
-          mate->infection_origin_state_ = person->state_;
-          mate->infection_origin_sb_ = person->social_behaviour_factor_;
-        }  // Scenario infected treated male has intercourse with healthy female
-        else if (mate->state_ == GemsState::kHealthy &&
-                 person->state_ == GemsState::kTreated &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_treated_mf,
-                                no_acts))) {
-          mate->state_ = GemsState::kAcute;
-          mate->transmission_type_ = TransmissionType::kCasualPartner;
-          mate->infection_origin_state_ = person->state_;
-          mate->infection_origin_sb_ = person->social_behaviour_factor_;
-        }  // Scenario infected failing treatment male has intercourse with
-           // healthy female
-        else if (mate->state_ == GemsState::kHealthy &&
-                 person->state_ == GemsState::kFailing &&
-                 random->Uniform() <
-                     (1.0 - pow(1.0 - sparam->infection_probability_failing_mf,
-                                no_acts))) {
-          mate->state_ = GemsState::kAcute;
-          mate->transmission_type_ = TransmissionType::kCasualPartner;
-          mate->infection_origin_state_ = person->state_;
-          mate->infection_origin_sb_ = person->social_behaviour_factor_;
+            year_params.no_acts_mean[sb], year_params.no_acts_sigma[sb]));
+
+        // State of the male if he infects the mate
+        int infector_state = GemsState::kHealthy;
+
+        // Only serodiscordant contacts can lead to a transmission. The
+        // probability for no_acts acts is looked up in the precomputed table,
+        // which accounts for the prevention modifiers of both partners.
+        if (person->IsHealthy() && !mate->IsHealthy()) {
+          // Scenario healthy male has intercourse with infected mate
+          if (random->Uniform() <
+              transmission_table.GetProbability(
+                  direction_to_person, mate->state_, mate->prevention_,
+                  person->prevention_, no_acts)) {
+            person->BecomeInfected(TransmissionType::kCasualPartner,
+                                   mate->state_,
+                                   mate->social_behaviour_factor_);
+            env->GetCohortTracker().Record(
+                person, CohortEventType::kEventInfection,
+                TransmissionType::kCasualPartner, mate->state_);
+          }
+        } else if (!person->IsHealthy() && mate->IsHealthy()) {
+          // Scenario infected male has intercourse with healthy mate
+          if (random->Uniform() <
+              transmission_table.GetProbability(
+                  direction_to_mate, person->state_, person->prevention_,
+                  mate->prevention_, no_acts)) {
+            infector_state = person->state_;
+          }
         } else {
           ;  // if both are infected or both are healthy, do nothing
         }
+        // The mate is modified during the resolution of the partnership
+        // intents.
+        env->GetPartnershipIntents().AddCasualContact(
+            person, mate, infector_state, person->social_behaviour_factor_);
+        env->GetCohortTracker().Record(
+            person, CohortEventType::kEventCasualPartner, 0);
+        env->GetContactMatrices().Record(
+            male_mate ? ContactType::kMsmContactMixing
+                      : ContactType::kCasualContactMixing,
+            person->compound_category_, mate_compound_category);
       }
     }
   }
@@ -289,17 +237,21 @@ struct RegularPartnershipBehaviour : public Behavior {
     const auto* sparam = param->Get<SimParam>();
     auto* person = bdm_static_cast<Person*>(agent);
 
+    // The partnership is only ended during the resolution of the partnership
+    // intents, hence we track the relationship status locally.
+    bool single = !person->hasPartner();
+
     // Adult men in regular partnership can break up (symmetric for female)
-    if (person->IsAdult() && person->hasPartner() &&
+    if (person->IsAdult() && !single &&
         random->Uniform() <= sparam->break_up_probability) {
-      // Set female partner to single
-      person->partner_->partner_ = nullptr;
-      // Set male agent to single
-      person->partner_ = nullptr;
+      auto* env =
+          bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+      env->GetPartnershipIntents().AddBreakup(person);
+      single = true;
     }
 
     // Adult single men can decide to engage in a regular partnership
-    if (person->IsAdult() && !person->hasPartner() &&
+    if (person->IsAdult() && single &&
         random->Uniform() <= sparam->regular_partnership_probability) {
       person->seek_regular_partnership_ = true;
     } else {
@@ -308,169 +260,110 @@ struct RegularPartnershipBehaviour : public Behavior {
   }
 };
 
-// This is the regular mating behaviour. The Behavior
-// is only executed by male agents. In serodiscordant regular partners,
-// the infected partner transmits HIV to his healthy partner with a certain
-// probability.
-struct RegularMatingBehaviour : public Behavior {
-  BDM_BEHAVIOR_HEADER(RegularMatingBehaviour, Behavior, 1);
+// The GetOlder behavior describes all things that happen to an agent while
+// getting older such as for instance having a greater chance to die.
+struct GetOlder : public Behavior {
+  BDM_BEHAVIOR_HEADER(GetOlder, Behavior, 1);
 
-  RegularMatingBehaviour() {}
+  GetOlder() {}
 
-  void Run(Agent* agent) override {
-    auto* sim = Simulation::GetActive();
-    auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
-    auto* random = sim->GetRandom();
-    auto* param = sim->GetParam();
-    const auto* sparam = param->Get<SimParam>();
-    auto* person = bdm_static_cast<Person*>(agent);
+  // Record a life-history event if the agent belongs to the tracked cohort
+  void Track(Person* person, int type, int value) {
+    if (person->tracked_) {
+      auto* env = bdm_static_cast<CategoricalEnvironment*>(
+          Simulation::GetActive()->GetEnvironment());
+      env->GetCohortTracker().Record(person, type, value);
+    }
+  }
 
-    // Determine the number of regular acts
-    // AM: Number of regular acts depends on the current year
-    int year = static_cast<int>(
-        sparam->start_year +
-        sim->GetScheduler()->GetSimulatedSteps());  // Current year
-    // If no transition year is higher than current year, then use last
-    // transition year
-    int year_index = sparam->no_regacts_year_transition.size() - 1;
-    for (int y = 0; y < sparam->no_regacts_year_transition.size() - 1; y++) {
-      if (year < sparam->no_regacts_year_transition[y + 1]) {
-        year_index = y;
-        break;
-      }
+  // Assign the prevention modifiers that the agent does not carry yet with the
+  // probabilities of the year. PrEP is only given to HIV-negative agents, and
+  // stopped once the agent is infected. We only sample if the respective
+  // intervention is active to leave the random number stream untouched
+  // otherwise.
+  static void AssignPrevention(Person* person, const YearParams& year_params,
+                               Random* random) {
+    if (!person->IsHealthy()) {
+      person->prevention_ &= ~PreventionModifier::kPrEP;
+    } else if (year_params.prep_probability > 0 &&
+               !person->HasPrevention(PreventionModifier::kPrEP) &&
+               random->Uniform() < year_params.prep_probability) {
+      person->prevention_ |= PreventionModifier::kPrEP;
     }
+    if (year_params.vmmc_probability > 0 && person->IsMale() &&
+        !person->HasPrevention(PreventionModifier::kVMMC) &&
+        random->Uniform() < year_params.vmmc_probability) {
+      person->prevention_ |= PreventionModifier::kVMMC;
+    }
+    if (year_params.condom_use_probability > 0 &&
+        !person->HasPrevention(PreventionModifier::kCondom) &&
+        random->Uniform() < year_params.condom_use_probability) {
+      person->prevention_ |= PreventionModifier::kCondom;
+    }
+  }
 
-    if (person->hasPartner() && person->age_ < env->GetMaxAge()) {
-      // Scenario healthy male has intercourse with infected acute female
-      // partner
-      if (person->partner_->state_ == GemsState::kAcute &&
-          person->state_ == GemsState::kHealthy &&
-          random->Uniform() <
-              (1.0 - pow(1.0 - sparam->infection_probability_acute_fm,
-                         sparam->no_regular_acts_mean[year_index]))) {
-        person->state_ = GemsState::kAcute;
-        person->transmission_type_ = TransmissionType::kRegularPartner;
-        person->infection_origin_state_ = person->partner_->state_;
-        // AM: Add MatingBehaviour only when infected
-        // person->AddBehavior(new MatingBehaviour());
-      }
-      // Scenario healthy male has intercourse with infected chronic female
-      // partner
-      else if (person->partner_->state_ == GemsState::kChronic &&
-               person->state_ == GemsState::kHealthy &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_chronic_fm,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->state_ = GemsState::kAcute;
-        person->transmission_type_ = TransmissionType::kRegularPartner;
-        person->infection_origin_state_ = person->partner_->state_;
-        // AM: Add MatingBehaviour only when infected
-        // person->AddBehavior(new MatingBehaviour());
+  // Progression, mortality, and aging of the compressed children of a mother.
+  // Children that reach min_age become Person agents. Records of children born
+  // in the current year are skipped, like newborn agents that join the
+  // simulation at the end of the step.
+  void AgeChildRecords(Person* mother, const SimParam* sparam,
+                       const CompiledParams& params, Random* random,
+                       int year) {
+    auto* ctxt = Simulation::GetActive()->GetExecutionContext();
+    // Same population category as in Run() for children
+    int year_population_category = CompiledParams::GetPopulationCategory(
+        params.GetYearParams(year).art_era, Sex::kFemale, 0);
+    auto& records = mother->child_records_;
+    size_t kept = 0;
+    for (size_t r = 0; r < records.size(); r++) {
+      auto record = records[r];
+      if (record.birth_year_ >= year) {
+        records[kept++] = record;
+        continue;
       }
-      // Scenario healthy male has intercourse with infected treated female
-      // partner
-      else if (person->partner_->state_ == GemsState::kTreated &&
-               person->state_ == GemsState::kHealthy &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_treated_fm,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->state_ = GemsState::kAcute;
-        person->transmission_type_ = TransmissionType::kRegularPartner;
-        person->infection_origin_state_ = person->partner_->state_;
-        // AM: Add MatingBehaviour only when infected
-        // person->AddBehavior(new MatingBehaviour());
+      // Age before getting older this year
+      int age = year - record.birth_year_ - 1;
+      if (record.state_ != GemsState::kHealthy) {
+        const float* transition_proba =
+            params.GetHivTransition(record.state_, year_population_category);
+        for (int i = 0; i < GemsState::kGemsLast; i++) {
+          if (random->Uniform() < transition_proba[i]) {
+            record.state_ = i;
+            break;
+          }
+        }
       }
-      // Scenario healthy male has intercourse with infected failing treatment
-      // female partner
-      else if (person->partner_->state_ == GemsState::kFailing &&
-               person->state_ == GemsState::kHealthy &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_failing_fm,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->state_ = GemsState::kAcute;
-        person->transmission_type_ = TransmissionType::kRegularPartner;
-        person->infection_origin_state_ = person->partner_->state_;
-        // AM: Add MatingBehaviour only when infected
-        // person->AddBehavior(new MatingBehaviour());
+      bool dies = random->Uniform() < params.GetHivMortality(record.state_);
+      dies |= random->Uniform() < params.GetAgeMortality(age);
+      if (dies) {
+        continue;
       }
-      // Scenario infected acute male has intercourse with healthy female
-      // partner
-      else if (person->partner_->state_ == GemsState::kHealthy &&
-               person->state_ == GemsState::kAcute &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_acute_mf,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->partner_->state_ = GemsState::kAcute;
-        person->partner_->transmission_type_ =
-            TransmissionType::kRegularPartner;
-        person->partner_->infection_origin_state_ = person->state_;
-      }  // Scenario infected chronic male has intercourse with healthy female
-         // partner
-      else if (person->partner_->state_ == GemsState::kHealthy &&
-               person->state_ == GemsState::kChronic &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_chronic_mf,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->partner_->state_ = GemsState::kAcute;
-        person->partner_->transmission_type_ =
-            TransmissionType::kRegularPartner;
-        person->partner_->infection_origin_state_ = person->state_;
-      }  // Scenario infected treated male has intercourse with healthy female
-         // partner
-      else if (person->partner_->state_ == GemsState::kHealthy &&
-               person->state_ == GemsState::kTreated &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_treated_mf,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->partner_->state_ = GemsState::kAcute;
-        person->partner_->transmission_type_ =
-            TransmissionType::kRegularPartner;
-        person->partner_->infection_origin_state_ = person->state_;
-      }  // Scenario infected failing treatment male has intercourse with
-         // healthy female partner
-      else if (person->partner_->state_ == GemsState::kHealthy &&
-               person->state_ == GemsState::kFailing &&
-               random->Uniform() <
-                   (1.0 - pow(1.0 - sparam->infection_probability_failing_mf,
-                              sparam->no_regular_acts_mean[year_index]))) {
-        person->partner_->state_ = GemsState::kAcute;
-        person->partner_->transmission_type_ =
-            TransmissionType::kRegularPartner;
-        person->partner_->infection_origin_state_ = person->state_;
-      } else {
-        ;  // if both are infected or both are healthy, do nothing
+      if (age + 1 >= sparam->min_age) {
+        // 15th birthday: the child becomes an agent
+        auto* child = Births::ExpandChildRecord(
+            record, mother->cohort_id_, mother->location_, year, sparam,
+            random);
+        ctxt->AddAgent(child);
+        child->mother_ = mother->GetAgentPtr<Person>();
+        mother->AddChild(child->GetAgentPtr<Person>());
+        continue;
       }
+      records[kept++] = record;
     }
+    records.resize(kept);
   }
-};
 
-// The GetOlder behavior describes all things that happen to an agent while
-// getting older such as for instance having a greater chance to die.
-struct GetOlder : public Behavior {
-  BDM_BEHAVIOR_HEADER(GetOlder, Behavior, 1);
-
-  GetOlder() {}
-
-  // AM : Get mortality rate by age
-  float get_mortality_rate_age(
-      float age, const std::vector<int>& mortality_rate_age_transition,
-      const std::vector<float>& mortality_rate_by_age) {
-    size_t age_index = mortality_rate_by_age.size() - 1;
-    for (size_t i = 0; i < mortality_rate_age_transition.size(); i++) {
-      if (age < mortality_rate_age_transition[i]) {
-        age_index = i;
-        break;
-      }
+  // The compressed children of a deceased mother become Person agents
+  // without mother.
+  void ExpandChildRecords(Person* mother, const SimParam* sparam,
+                          Random* random, int year) {
+    auto* ctxt = Simulation::GetActive()->GetExecutionContext();
+    for (const auto& record : mother->child_records_) {
+      ctxt->AddAgent(Births::ExpandChildRecord(record, mother->cohort_id_,
+                                               mother->location_, year, sparam,
+                                               random));
     }
-    // std::cout << "Age " << age << " => Mortality rate " <<
-    // mortality_rate_by_age[age_index] << std::endl;
-    return mortality_rate_by_age[age_index];
-  }
-
-  // AM: Get HIV-related mortality rate
-  float get_mortality_rate_hiv(int state,
-                               const std::vector<float>& hiv_mortality_rate) {
-    return hiv_mortality_rate[state];
+    mother->child_records_.clear();
   }
 
   void Run(Agent* agent) override {
@@ -478,53 +371,47 @@ struct GetOlder : public Behavior {
     auto* random = sim->GetRandom();
     auto* param = sim->GetParam();
     const auto* sparam = param->Get<SimParam>();
+    auto* env = bdm_static_cast<CategoricalEnvironment*>(sim->GetEnvironment());
+    const auto& params = env->GetCompiledParams();
     auto* person = bdm_static_cast<Person*>(agent);
+    int year = static_cast<int>(sparam->start_year +
+                                sim->GetScheduler()->GetSimulatedSteps());
+    const auto& year_params = params.GetYearParams(year);
 
     // Assign or reassign risk factors
     if (floor(person->age_) ==
         sparam->min_age) {  // Assign potentially high risk
                             // factor at first year of adulthood
+      Track(person, CohortEventType::kEventDebut, sparam->min_age);
       // Probability of being at high risk depends on year and HIV status
-      int year = static_cast<int>(
-          sparam->start_year +
-          sim->GetScheduler()->GetSimulatedSteps());  // Current year
-      // Check transition year
-      // If no sociobehavioural risk transition year is higher than current
-      // year, then use last transition year
-      int year_index = sparam->sociobehavioural_risk_year_transition.size() - 1;
-      for (size_t y = 0;
-           y < sparam->sociobehavioural_risk_year_transition.size() - 1; y++) {
-        if (year < sparam->sociobehavioural_risk_year_transition[y + 1]) {
-          year_index = y;
-          break;
-        }
-      }
-
       if (random->Uniform() <=
-          sparam
-              ->sociobehavioural_risk_probability[year_index][person->state_]) {
+          year_params.sociobehavioural_risk_probability[person->state_]) {
         person->social_behaviour_factor_ = 1;
       } else {
         person->social_behaviour_factor_ = 0;
       }
-      if (random->Uniform() <= sparam->biomedical_risk_probability) {
+      if (random->Uniform() <= year_params.biomedical_risk_probability) {
         person->biomedical_factor_ = 1;
       } else {
         person->biomedical_factor_ = 0;
       }
+      // Men have sex with men with probability msm_probability
+      if (sparam->msm_probability > 0 && person->IsMale()) {
+        person->msm_ = random->Uniform() < sparam->msm_probability;
+      }
     } else if (person->age_ > sparam->min_age) {
       // Potential change in risk factor foradults (after first year of
       // adulthood)
       // Update risk factors stochastically like in initialization
       if (random->Uniform() <=
-          sparam->sociobehaviour_transition_matrix
-              [person->social_behaviour_factor_][person->sex_][0]) {
+          params.GetLowRiskProbability(person->social_behaviour_factor_,
+                                       person->sex_)) {
         person->social_behaviour_factor_ = 0;
 
       } else {
         person->social_behaviour_factor_ = 1;
       }
-      if (random->Uniform() > sparam->biomedical_risk_probability) {
+      if (random->Uniform() > year_params.biomedical_risk_probability) {
         person->biomedical_factor_ = 0;
       } else {
         person->biomedical_factor_ = 1;
@@ -533,52 +420,41 @@ struct GetOlder : public Behavior {
       person->social_behaviour_factor_ = 0;
       person->biomedical_factor_ = 0;
     }
+    // Adults who are not covered yet may take up the prevention interventions
+    // of this year, e.g. after a scale-up in the timeline
+    if (person->age_ >= sparam->min_age) {
+      AssignPrevention(person, year_params, random);
+    }
 
     // AM: HIV state transition, depending on current year and population
     // category (important for transition to treatment)
-    int year_population_category = -1;
-
-    int start_year = sim->GetParam()->Get<SimParam>()->start_year;
-    int year =
-        static_cast<int>(start_year + sim->GetScheduler()->GetSimulatedSteps());
-
-    // TO DO AM: Replace code below with function :
-    // ComputeYearPopulationCategory(int year, float age, int sex)
-    // year_population_category =
-    // sim->GetParam()->Get<SimParam>()->ComputeYearPopulationCategory(year,
-    // person->age_, person->sex_);
-    if (year < 2003) {  // Prior to 2003
-      year_population_category =
-          0;  // All (No difference in ART between people. ART not available.)
-    } else if (year < 2011) {  // Between 2003 and 2010
-      if (person->sex_ == Sex::kFemale && person->age_ >= 15 and
-          person->age_ <= 40) {
-        year_population_category = 1;  // Female between 15 and 40
-      } else if (person->age_ < 15) {
-        year_population_category = 2;  // Child
-      } else {
-        year_population_category =
-            3;  // Others (Male over 15 and Female over 40)
-      }
-    } else {  // After 2011
-      if (person->sex_ == Sex::kFemale && person->age_ >= 15 and
-          person->age_ <= 40) {
-        year_population_category = 4;  // Female between 15 and 40
-      } else if (person->age_ < 15) {
-        year_population_category = 5;  // Child
-      } else {
-        year_population_category =
-            6;  // Others (Male over 15, and Female over 40)
-      }
-    }
-    const auto& transition_proba =
-        sparam->hiv_transition_matrix[person->state_][year_population_category];
-    for (size_t i = 0; i < transition_proba.size(); i++) {
+    int year_population_category = CompiledParams::GetPopulationCategory(
+        year_params.art_era, person->sex_, person->age_);
+    int previous_state = person->state_;
+    const float* transition_proba =
+        params.GetHivTransition(person->state_, year_population_category);
+    for (int i = 0; i < GemsState::kGemsLast; i++) {
       if (random->Uniform() < transition_proba[i]) {
         person->state_ = i;
         break;
       }
     }
+    if (person->state_ != previous_state) {
+      Track(person, CohortEventType::kEventStateChange, person->state_);
+    }
+
+    // Agents that start treatment are diagnosed and become index cases of the
+    // partner notification
+    if (sparam->partner_notification &&
+        previous_state != GemsState::kTreated && person->IsTreated()) {
+      env->GetPartnerNotification().AddIndexCase(
+          person, env->GetPartnershipHistory());
+    }
+
+    // Compressed children get older with their mother
+    if (!person->child_records_.empty()) {
+      AgeChildRecords(person, sparam, params, random, year);
+    }
 
     // Possibly die - if not, just get older
     bool stay_alive{true};
@@ -586,15 +462,12 @@ struct GetOlder : public Behavior {
     // AM: Mortality
     // HIV-related mortality
     float rand_num_hiv = static_cast<float>(random->Uniform());
-    if (rand_num_hiv <
-        get_mortality_rate_hiv(person->state_, sparam->hiv_mortality_rate)) {
+    if (rand_num_hiv < params.GetHivMortality(person->state_)) {
       stay_alive = false;
     }
     // Age-related mortality
     float rand_num_age = static_cast<float>(random->Uniform());
-    if (rand_num_age < get_mortality_rate_age(
-                           person->age_, sparam->mortality_rate_age_transition,
-                           sparam->mortality_rate_by_age)) {
+    if (rand_num_age < params.GetAgeMortality(person->age_)) {
       stay_alive = false;
     }
 
@@ -611,154 +484,21 @@ struct GetOlder : public Behavior {
     }
 
     if (!stay_alive) {
-      // Person dies, i.e. is removed from simulation.
+      // Person dies, i.e. is removed from simulation. Partner, children, and
+      // mother are unlinked during the resolution of the partnership intents.
+      env->GetPartnershipIntents().AddDeath(person);
+      Track(person, CohortEventType::kEventDeath,
+            static_cast<int>(person->age_));
+      if (!person->child_records_.empty()) {
+        ExpandChildRecords(person, sparam, random, year);
+      }
       person->RemoveFromSimulation();
     } else {
       // increase age
       person->age_ += 1;
-    }
-  }
-};
-
-// The GiveBirth behavior is assigned to all female agents. If a female is in a
-// certain age range, she can give birth to a child that is located at the same
-// place. If she is HIV positive, there is a certain chance to infect the child
-// while giving birth.
-struct GiveBirth : public Behavior {
-  BDM_BEHAVIOR_HEADER(GiveBirth, Behavior, 1);
-
-  GiveBirth() {}
-
-  // Helper function to create a single child
-  Person* CreateChild(Random* random_generator, Person* mother,
-                      const SimParam* sparam, size_t year) {
-    // Create new child
-    Person* child = new Person();
-    // BioDynaMo API: Add agent (child) to simulation
-    Simulation::GetActive()->GetExecutionContext()->AddAgent(child);
-
-    // Assign sex
-    child->sex_ =
-        SampleSex(random_generator->Uniform(), sparam->probability_male);
-    // Assign age - possibly -1 ?
-    child->age_ = random_generator->Uniform();
-    // Assign location
-    child->location_ = mother->location_;
-    // Compute risk factors
-    child->social_behaviour_factor_ = 0;
-    child->biomedical_factor_ = 0;
-    // Stores the current GemsState of the child.
-    if (mother->state_ == GemsState::kHealthy) {
-      child->state_ = GemsState::kHealthy;
-
-      ///! The aguments below are currently either not used or repetitive.
-      // // Store the year when the agent got infected
-      // child->year_of_infection_ = std::numeric_limits<float>::max();
-    }
-    ///! The aguments below are currently either not used or repetitive.
-    // // year of infection to present year, Question: Ask Lukas how to get
-    // iter child->year_of_infection_ = 2000;
-    //}
-    // AM: birth infection probability depends on whether mother is treated and
-    // current year
-    else if (mother->state_ == GemsState::kTreated) {
-      if (random_generator->Uniform() <
-          sparam->birth_infection_probability_treated) {
-        child->state_ = GemsState::kAcute;
-        child->transmission_type_ = TransmissionType::kMotherToChild;
-        child->infection_origin_state_ = mother->state_;
-      } else {
-        child->state_ = GemsState::kHealthy;
-      }
-    } else if (year < 2003 ||
-               mother->state_ ==
-                   GemsState::kFailing) {  // AM: Mother is not healthy and not
-                                           // treated
-      if (random_generator->Uniform() <
-          sparam->birth_infection_probability_untreated) {
-        child->state_ = GemsState::kAcute;
-        child->transmission_type_ = TransmissionType::kMotherToChild;
-        child->infection_origin_state_ = mother->state_;
-      } else {
-        child->state_ = GemsState::kHealthy;
-      }
-    } else {
-      if (random_generator->Uniform() <
-          sparam->birth_infection_probability_prophylaxis) {
-        child->state_ = GemsState::kAcute;
-        child->transmission_type_ = TransmissionType::kMotherToChild;
-        child->infection_origin_state_ = mother->state_;
-      } else {
-        child->state_ = GemsState::kHealthy;
-      }
-    }
-
-    // Register child with mother
-    mother->AddChild(child->GetAgentPtr<Person>());
-
-    // Assign mother to child. When, the child becomes adult, break the link.
-    child->mother_ = mother->GetAgentPtr<Person>();
-
-    ///! The aguments below are currently either not used or repetitive.
-    // // NOTE: we do not assign a specific mother or partner at the moment. Use
-    // // nullptr instead.
-    // child->mother_id_ = nullptr;
-    // child->partner_id_ = nullptr;
-
-    // BioDynaMo API: Add the behaviors to the Agent
-    child->AddBehavior(new RandomMigration());
-    if (child->sex_ == Sex::kFemale) {
-      child->AddBehavior(new GiveBirth());
-    } else {
-      child->AddBehavior(new MatingBehaviour());
-      /*if (child->state_ != GemsState::kHealthy){
-          child->AddBehavior(new MatingBehaviour());
-      }*/
-      child->AddBehavior(new RegularMatingBehaviour());
-      child->AddBehavior(new RegularPartnershipBehaviour());
-    }
-    child->AddBehavior(new GetOlder());
-
-    return child;
-  }
-
-  void Run(Agent* agent) override {
-    auto* sim = Simulation::GetActive();
-    auto* random = sim->GetRandom();
-    auto* param = sim->GetParam();
-    const auto* sparam = param->Get<SimParam>();
-    auto* mother = bdm_static_cast<Person*>(agent);
-
-    // Each potential mother gives birth with a certain probability.
-    if (random->Uniform() < sparam->give_birth_probability &&
-        mother->age_ <= sparam->max_age_birth &&
-        mother->age_ >= sparam->min_age) {
-      // The probability of the child to be infected depends on the current year
-      // (ex. prophylaxis)
-      int year = static_cast<int>(
-          sparam->start_year +
-          sim->GetScheduler()->GetSimulatedSteps());  // Current year
-
-      // Create a child
-      auto* new_child = CreateChild(random, mother, sparam, year);
-
-      // Protect mother from death.
-      if (sparam->protect_mothers_at_birth) {
-        mother->LockProtection();
-      }
-
-      // DEBUG: CHECK MOTHER AND CHILD HAVE SAME LOCATIONS
-      if (mother->location_ != new_child->location_) {
-        Log::Warning("\n\nGiveBirth::Run()",
-                     "Mother created a child who is at a different location");
-      }
-      // DEBUG: CHECK MOTHER AND CHILD POINT ON EACH OTHERS
-      if (!mother->IsParentOf(new_child->GetAgentPtr<Person>())) {
-        Log::Warning("\n\nGiveBirth::Run()", "Mother does not point on child ");
-      }
-      if (new_child->mother_ != mother->GetAgentPtr<Person>()) {
-        Log::Warning("\n\nGiveBirth::Run()", "Child does not point on mother ");
-      }
+      // Age and socio-behaviour of the next year. The agent is indexed under
+      // the new category by the next update of the environment.
+      env->UpdateCompoundCategory(person);
     }
   }
 };
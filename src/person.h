@@ -19,6 +19,23 @@
 
 namespace bdm {
 namespace hiv_malawi {
+
+// Lightweight representation of a child under min_age. If
+// sparam->compress_children is true, children are stored as ChildRecords with
+// their mother instead of as Person agents. They age, progress, and die in the
+// GetOlder behaviour of their mother and become Person agents at their 15th
+// birthday or when their mother dies.
+struct ChildRecord {
+  // Year of birth
+  int16_t birth_year_;
+  uint8_t sex_;
+  uint8_t state_;
+  // State and socio-behavioural factor of the mother at birth (if infected)
+  uint8_t infection_origin_state_;
+  uint8_t infection_origin_sb_;
+  // Number of earlier births of the mother (see Person::cohort_id_)
+  uint8_t birth_order_;
+};
 ////////////////////////////////////////////////////////////////////////////////
 // BioDynaMo's Agent / Individual
 ////////////////////////////////////////////////////////////////////////////////
@@ -36,6 +53,15 @@ class Person : public Agent {
     children_.reserve(3);
     protected_ = false;
     no_casual_partners_ = 0;
+    prevention_ = PreventionModifier::kNoPrevention;
+    partnership_year_ = -1;
+    history_slot_ = -1;
+    household_ = -1;
+    compound_category_ = -1;
+    tracked_ = false;
+    cohort_id_ = 0;
+    no_births_ = 0;
+    msm_ = false;
   }
   virtual ~Person() {}
 
@@ -71,12 +97,18 @@ class Person : public Agent {
   int location_;
   // Stores a factor representing the socio-behavioural risk
   int social_behaviour_factor_;
+  // Compound category (location x age category x socio-behaviour) of the
+  // agent in the indexes of the CategoricalEnvironment, -1 below min_age. Set
+  // by CategoricalEnvironment::UpdateCompoundCategory when the agent is
+  // created, relocates, or gets older (GetOlder updates the age and the
+  // socio-behaviour).
+  int compound_category_;
   // Stores a factor representing the biomedical risk
   int biomedical_factor_;
   // Protect a person against death. Currently only used for mothers in the year
   // in which they give birth and if sparam->protect_mothers_at_birth is true.
   // The associated member functions LockProtection, UnlockProtection, and
-  // IsProtected appear in the GiveBirth and GetOlder Behaviors.
+  // IsProtected appear in the Births generation and the GetOlder Behavior.
   bool protected_;
   // Single adult men can seek for a regular partnership. All male seeking
   // for regular partnership are then indexed, select the compound category of
@@ -85,6 +117,26 @@ class Person : public Agent {
   bool seek_regular_partnership_;
   // Number of casual partners
   int no_casual_partners_;
+  // Bitfield of the PreventionModifier(s) that apply to the agent
+  int prevention_;
+  // Year in which the current regular partnership was formed (-1 if unknown)
+  int partnership_year_;
+  // Slot of the agent in the PartnershipHistory (-1 if never had a partner)
+  int history_slot_;
+  // Index of the agent's household in the HouseholdTable of the current
+  // simulation step (-1 if born in the current step)
+  int household_;
+  // True if the agent belongs to the cohort of the CohortTracker
+  bool tracked_;
+  // Id of the agent in the cohort files. Unlike the uid, it does not depend on
+  // the thread schedule: the index in the initial population, or derived from
+  // the mother's id, the year of birth, and the birth order (see
+  // CohortTracker::GetChildId).
+  uint64_t cohort_id_;
+  // Number of children the agent gave birth to
+  int no_births_;
+  // True if the agent is a man who has sex with men (and possibly women)
+  bool msm_;
 
   ///! The aguments below are currently either not used or repetitive.
   // // Stores if an agent is infected or not
@@ -97,44 +149,16 @@ class Person : public Agent {
   // Stores the IDs of the children. Useful, when mother migrates, and takes her
   // children. Unlink mother from child, when mother dies
   std::vector<AgentPointer<Person>> children_;
+  // Compressed children (under min_age) of the agent, see ChildRecord
+  std::vector<ChildRecord> child_records_;
   // Stores the ID of the regular partner. Useful for infection in
   // serodiscordant regular relationships, and family migration.
   AgentPointer<Person> partner_ = nullptr;
 
-  // The following function is used to avoid simultaneous modification of
-  // related agents. (Tread safety)
-  void CriticalRegion(std::vector<AgentPointer<Agent>>* aptrs) override {
-    aptrs->push_back(GetAgentPtr<Agent>());
-    if (partner_ != nullptr) {
-      aptrs->push_back(partner_);
-    }
-    for (auto& child : children_) {
-      aptrs->push_back(child);
-    }
-    if (mother_ != nullptr) {
-      aptrs->push_back(mother_);
-    }
-  }
-
-  void RemoveFromSimulation() override {
-    // If has regular partner, end partnership
-    if (hasPartner()) {
-      SeparateFromPartner();
-    }
-    // If mother dies, children have no mother anymore
-    for (uint64_t c = 0; c < children_.size(); c++) {
-      children_[c]->mother_ = nullptr;
-    }
-    // If a child dies and has a mother, remove him from mother's list of
-    // children
-    if (mother_ != nullptr) {
-      // std::cout << "A Child dies" << std::endl;
-      mother_->RemoveChild(GetAgentPtr<Person>());
-      // std::cout << " ==> Removed from mother's list of children" <<
-      // std::endl;
-    }
-    Base::RemoveFromSimulation();
-  }
+  // Note: Behaviours do not modify the partner, children, or mother directly.
+  // Such changes (including the unlinking of agents that die) are emitted as
+  // PartnershipIntents and resolved after the behaviour loop. Hence, no
+  // CriticalRegion is required.
 
   // Returns True if the agent is healthy
   bool IsHealthy() { return state_ == GemsState::kHealthy; }
@@ -182,6 +206,18 @@ class Person : public Agent {
   // Return True if recently infected by an high risk partner
   bool HighRiskTransmission() { return IsAcute() && infection_origin_sb_ == 1; }
 
+  // Infects a healthy agent. Stores how the agent was infected as well as the
+  // state and socio-behavioural risk of the infector.
+  void BecomeInfected(int transmission_type, int origin_state, int origin_sb) {
+    state_ = GemsState::kAcute;
+    transmission_type_ = transmission_type;
+    infection_origin_state_ = origin_state;
+    infection_origin_sb_ = origin_sb;
+  }
+
+  // Returns True if the agent carries the given PreventionModifier
+  bool HasPrevention(int modifier) { return (prevention_ & modifier) != 0; }
+
   // Returns True if the agent has high-risk socio-behaviours
   bool HasHighRiskSocioBehav() { return social_behaviour_factor_ == 1; }
   // Returns True if the agent is at low-risk socio-behaviours
@@ -262,47 +298,6 @@ class Person : public Agent {
     }
   }
 
-  void Relocate(size_t new_location) {
-    location_ = new_location;
-
-    if (sex_ == Sex::kFemale) {
-      // Children (under 15yo) migrate with their mother
-      int nb_children = GetNumberOfChildren();
-      // std::cout << "I am a woman with "<< nb_children << " children and I
-      // migrated to location " << location_<< std::endl;
-      for (int c = 0; c < nb_children; c++) {
-        if (children_[c]->age_ < 15) {
-          /*if (old_location != children_[c]->location_){
-              Log::Warning("RandomMigration::Run()", "child and mother had
-          different locations BEFORE MIGRATION. Child's age = ",
-          children_[c]->age_, " ==> ", old_location, " vs. ",
-          children_[c]->location_);
-          }*/
-          // std::cout << " ==> I am a child (" << children_[c]->age_
-          // << ") and I will migrate with my mother from location " <<
-          // children_[c]->location_ << " to " << location_ <<
-          // std::endl;
-          children_[c]->location_ = location_;
-        }
-      }
-      // DEBUG : Check that all children migrated with Mother
-      for (int c = 0; c < nb_children; c++) {
-        if (children_[c]->age_ < 15) {
-          if (children_[c]->location_ != location_) {
-            Log::Warning("RandomMigration::Run()",
-                         "DEBUG: child and mother have different locations "
-                         "AFTER MIGRATION. Child's age = ",
-                         children_[c]->age_);
-          }
-        }
-      }
-    } else if (hasPartner()) {
-      // If a man engaged in a regular partnership relocates, his female partner
-      // relocates too.
-      partner_->Relocate(new_location);
-    }
-  }
-
   bool IsParentOf(AgentPointer<Person> child) {
     bool found = false;
     for (int c = 0; c < GetNumberOfChildren(); c++) {
@@ -134,7 +134,8 @@ int ComputeBiomedical(float rand_num, int age,
   }
 }
 
-auto CreatePerson(Random* random_generator, const SimParam* sparam) {
+auto CreatePerson(Random* random_generator, const SimParam* sparam,
+                  uint64_t index) {
   // Get all random numbers for initialization
   std::vector<float> rand_num{};
   rand_num.resize(10);
@@ -179,6 +180,20 @@ auto CreatePerson(Random* random_generator, const SimParam* sparam) {
       sparam->sociobehavioural_risk_probability[0][person->state_]);
   person->biomedical_factor_ = ComputeBiomedical(
       rand_num[7], person->age_, sparam->biomedical_risk_probability);
+  // Adult men have sex with men with probability msm_probability
+  person->msm_ = person->sex_ == Sex::kMale &&
+                 person->age_ >= sparam->min_age &&
+                 rand_num[8] < sparam->msm_probability;
+
+  auto* env = bdm_static_cast<CategoricalEnvironment*>(
+      Simulation::GetActive()->GetEnvironment());
+  env->UpdateCompoundCategory(person);
+  // Prevention coverage of the adults at the start of the simulation
+  if (person->age_ >= sparam->min_age) {
+    GetOlder::AssignPrevention(
+        person, env->GetCompiledParams().GetYearParams(sparam->start_year),
+        random_generator);
+  }
 
   // DEBUG
   /*if (person->state_ == GemsState::kAcute){
@@ -201,18 +216,22 @@ auto CreatePerson(Random* random_generator, const SimParam* sparam) {
   // person->partner_id_ = nullptr;
 
   // BioDynaMo API: Add the behaviors to the Agent
+  // Births are generated per category by the GiveBirths operation.
   person->AddBehavior(new RandomMigration());
-  if (person->sex_ == Sex::kFemale) {
-    person->AddBehavior(new GiveBirth());
-  } else {
+  if (person->sex_ == Sex::kMale) {
     /*if (person->state_ != GemsState::kHealthy){
       person->AddBehavior(new MatingBehaviour());
     }*/
     person->AddBehavior(new MatingBehaviour());
-    person->AddBehavior(new RegularMatingBehaviour());
     person->AddBehavior(new RegularPartnershipBehaviour());
   }
   person->AddBehavior(new GetOlder());
+
+  // Select the person for the tracked cohort
+  person->cohort_id_ = index;
+  if (sparam->cohort_fraction > 0) {
+    env->GetCohortTracker().Select(person, sparam->cohort_fraction);
+  }
   return person;
 };
 
@@ -228,7 +247,7 @@ void InitializePopulation() {
 #pragma omp for
     for (uint64_t x = 0; x < sparam->initial_population_size; x++) {
       // Create a person
-      auto* new_person = CreatePerson(random_generator, sparam);
+      auto* new_person = CreatePerson(random_generator, sparam, x);
       // BioDynaMo API: Add agent (person) to simulation
       ctxt->AddAgent(new_person);
     }
@@ -49,8 +49,9 @@ int ComputeSociobehavioural(float rand_num, int age,
 int ComputeBiomedical(float rand_num, int age,
                       float biomedical_risk_probability);
 
-// create a single person
-auto CreatePerson(Random* random_generator, SimParam* sparam);
+// create a single person with the given index in the initial population
+auto CreatePerson(Random* random_generator, const SimParam* sparam,
+                  uint64_t index);
 
 // Initialize an entire population for the BDM simulation
 void InitializePopulation();
@@ -0,0 +1,367 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "population-snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <set>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+const char kSnapshotMagic[] = "HIVSNAP1";
+
+enum ChunkEncoding { kEncodingDelta, kEncodingRunLength };
+
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void PutVarint(uint64_t value, std::vector<uint8_t>* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t GetVarint(const uint8_t** in) {
+  uint64_t value = 0;
+  int shift = 0;
+  while (**in & 0x80) {
+    value |= static_cast<uint64_t>(**in & 0x7f) << shift;
+    shift += 7;
+    (*in)++;
+  }
+  value |= static_cast<uint64_t>(**in) << shift;
+  (*in)++;
+  return value;
+}
+
+void PutFixed(uint64_t value, std::vector<uint8_t>* out) {
+  for (int i = 0; i < 8; i++) {
+    out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint64_t GetFixed(const uint8_t** in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<uint64_t>((*in)[i]) << (8 * i);
+  }
+  *in += 8;
+  return value;
+}
+
+// Encode a column chunk with zigzag delta varints and with run-length
+// encoding, and keep the smaller of the two
+uint8_t EncodeColumn(const std::vector<int64_t>& values,
+                     std::vector<uint8_t>* out) {
+  std::vector<uint8_t> delta;
+  int64_t previous = 0;
+  for (auto value : values) {
+    PutVarint(ZigZag(value - previous), &delta);
+    previous = value;
+  }
+  std::vector<uint8_t> rle;
+  for (size_t i = 0; i < values.size();) {
+    size_t j = i + 1;
+    while (j < values.size() && values[j] == values[i]) {
+      j++;
+    }
+    PutVarint(ZigZag(values[i]), &rle);
+    PutVarint(j - i, &rle);
+    i = j;
+  }
+  if (rle.size() < delta.size()) {
+    out->swap(rle);
+    return ChunkEncoding::kEncodingRunLength;
+  }
+  out->swap(delta);
+  return ChunkEncoding::kEncodingDelta;
+}
+
+void DecodeColumn(uint8_t encoding, const std::vector<uint8_t>& in,
+                  size_t no_rows, std::vector<int64_t>* values) {
+  values->resize(no_rows);
+  const uint8_t* data = in.data();
+  if (encoding == ChunkEncoding::kEncodingRunLength) {
+    for (size_t i = 0; i < no_rows;) {
+      int64_t value = UnZigZag(GetVarint(&data));
+      uint64_t run = GetVarint(&data);
+      for (uint64_t j = 0; j < run && i < no_rows; j++) {
+        (*values)[i++] = value;
+      }
+    }
+  } else {
+    int64_t previous = 0;
+    for (size_t i = 0; i < no_rows; i++) {
+      previous += UnZigZag(GetVarint(&data));
+      (*values)[i] = previous;
+    }
+  }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// SnapshotWriter
+////////////////////////////////////////////////////////////////////////////////
+
+SnapshotWriter::~SnapshotWriter() { Close(); }
+
+bool SnapshotWriter::Open(const std::string& filename, size_t rows_per_group,
+                          AsyncWriter* writer) {
+  file_.open(filename, std::ios::out | std::ios::binary);
+  if (!file_.is_open()) {
+    return false;
+  }
+  rows_per_group_ = std::max<size_t>(rows_per_group, 1);
+  writer_ = writer;
+  file_.write(kSnapshotMagic, 8);
+  offset_ = 8;
+  return true;
+}
+
+void SnapshotWriter::Write(int year, std::vector<SnapshotRow>&& rows) {
+  if (writer_ == nullptr) {
+    Snapshot snapshot{year, std::move(rows)};
+    WriteSnapshot(&snapshot);
+    return;
+  }
+  uint64_t bytes = rows.size() * sizeof(SnapshotRow);
+  auto snapshot = std::make_shared<Snapshot>(Snapshot{year, std::move(rows)});
+  writer_->Submit([this, snapshot]() { WriteSnapshot(snapshot.get()); },
+                  bytes);
+}
+
+void SnapshotWriter::Close() {
+  if (!file_.is_open()) {
+    return;
+  }
+  if (writer_ != nullptr) {
+    writer_->Flush();
+  }
+
+  // Footer: number of row groups followed by their chunk index
+  std::vector<uint8_t> footer;
+  uint64_t footer_offset = offset_;
+  PutFixed(row_groups_.size(), &footer);
+  for (auto& group : row_groups_) {
+    PutFixed(static_cast<uint32_t>(group.year), &footer);
+    PutFixed(group.no_rows, &footer);
+    for (auto& chunk : group.chunks) {
+      footer.push_back(chunk.encoding);
+      PutFixed(static_cast<uint64_t>(chunk.min), &footer);
+      PutFixed(static_cast<uint64_t>(chunk.max), &footer);
+      PutFixed(chunk.offset, &footer);
+      PutFixed(chunk.size, &footer);
+    }
+  }
+  PutFixed(footer_offset, &footer);
+  WriteBytes(footer);
+  file_.write(kSnapshotMagic, 8);
+  file_.close();
+  row_groups_.clear();
+}
+
+void SnapshotWriter::WriteSnapshot(Snapshot* snapshot) {
+  auto& rows = snapshot->rows;
+  // Sort by location such that the zone maps of the location column are
+  // narrow, and by uid to obtain a deterministic file
+  std::sort(rows.begin(), rows.end(),
+            [](const SnapshotRow& a, const SnapshotRow& b) {
+              if (a.values[kColumnLocation] != b.values[kColumnLocation]) {
+                return a.values[kColumnLocation] < b.values[kColumnLocation];
+              }
+              return a.values[kColumnUid] < b.values[kColumnUid];
+            });
+
+  std::vector<int64_t> values;
+  std::vector<uint8_t> bytes;
+  for (size_t begin = 0; begin < rows.size(); begin += rows_per_group_) {
+    size_t end = std::min(begin + rows_per_group_, rows.size());
+    RowGroup group;
+    group.year = snapshot->year;
+    group.no_rows = static_cast<uint32_t>(end - begin);
+    for (int c = 0; c < SnapshotColumn::kColumnLast; c++) {
+      values.clear();
+      for (size_t i = begin; i < end; i++) {
+        values.push_back(rows[i].values[c]);
+      }
+      auto& chunk = group.chunks[c];
+      auto minmax = std::minmax_element(values.begin(), values.end());
+      chunk.min = *minmax.first;
+      chunk.max = *minmax.second;
+      chunk.encoding = EncodeColumn(values, &bytes);
+      chunk.offset = offset_;
+      chunk.size = bytes.size();
+      WriteBytes(bytes);
+    }
+    row_groups_.push_back(group);
+  }
+  file_.flush();
+}
+
+void SnapshotWriter::WriteBytes(const std::vector<uint8_t>& bytes) {
+  file_.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  offset_ += bytes.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SnapshotReader
+////////////////////////////////////////////////////////////////////////////////
+
+bool SnapshotReader::Open(const std::string& filename) {
+  row_groups_.clear();
+  file_.open(filename, std::ios::in | std::ios::binary);
+  if (!file_.is_open()) {
+    return false;
+  }
+  char magic[8];
+  file_.read(magic, 8);
+  if (!file_ || std::memcmp(magic, kSnapshotMagic, 8) != 0) {
+    return false;
+  }
+
+  // Trailer: footer offset and magic
+  file_.seekg(-16, std::ios::end);
+  std::vector<uint8_t> trailer(16);
+  file_.read(reinterpret_cast<char*>(trailer.data()), 16);
+  if (!file_ || std::memcmp(trailer.data() + 8, kSnapshotMagic, 8) != 0) {
+    return false;
+  }
+  const uint8_t* data = trailer.data();
+  uint64_t footer_offset = GetFixed(&data);
+  uint64_t footer_end = static_cast<uint64_t>(file_.tellg()) - 16;
+  if (footer_offset < 8 || footer_offset > footer_end) {
+    return false;
+  }
+
+  std::vector<uint8_t> footer(footer_end - footer_offset);
+  file_.seekg(footer_offset);
+  file_.read(reinterpret_cast<char*>(footer.data()), footer.size());
+  if (!file_) {
+    return false;
+  }
+  const size_t group_size = 16 + SnapshotColumn::kColumnLast * 33;
+  data = footer.data();
+  uint64_t no_groups = GetFixed(&data);
+  if (footer.size() != 8 + no_groups * group_size) {
+    return false;
+  }
+  row_groups_.resize(no_groups);
+  for (auto& group : row_groups_) {
+    group.year = static_cast<int32_t>(GetFixed(&data));
+    group.no_rows = static_cast<uint32_t>(GetFixed(&data));
+    for (auto& chunk : group.chunks) {
+      chunk.encoding = *data++;
+      chunk.min = static_cast<int64_t>(GetFixed(&data));
+      chunk.max = static_cast<int64_t>(GetFixed(&data));
+      chunk.offset = GetFixed(&data);
+      chunk.size = GetFixed(&data);
+    }
+  }
+  return true;
+}
+
+std::vector<int> SnapshotReader::GetYears() const {
+  std::set<int> years;
+  for (auto& group : row_groups_) {
+    years.insert(group.year);
+  }
+  return std::vector<int>(years.begin(), years.end());
+}
+
+size_t SnapshotReader::Scan(int year,
+                            const std::vector<SnapshotPredicate>& predicates,
+                            const std::function<void(const SnapshotRow&)>& f) {
+  no_read_ = 0;
+  no_skipped_ = 0;
+  size_t no_matches = 0;
+  std::vector<int64_t> columns[SnapshotColumn::kColumnLast];
+  std::vector<uint8_t> selected;
+  for (auto& group : row_groups_) {
+    if (group.year != year) {
+      continue;
+    }
+    // Skip the row group if a predicate does not intersect its zone map
+    bool skip = false;
+    for (auto& p : predicates) {
+      auto& chunk = group.chunks[p.column];
+      skip |= p.max < chunk.min || p.min > chunk.max;
+    }
+    if (skip) {
+      no_skipped_++;
+      continue;
+    }
+    no_read_++;
+
+    // Evaluate the predicates on their columns only
+    selected.assign(group.no_rows, 1);
+    std::vector<bool> decoded(SnapshotColumn::kColumnLast, false);
+    for (auto& p : predicates) {
+      if (!decoded[p.column]) {
+        ReadColumn(group, p.column, &columns[p.column]);
+        decoded[p.column] = true;
+      }
+      auto& values = columns[p.column];
+      for (size_t i = 0; i < group.no_rows; i++) {
+        selected[i] &= values[i] >= p.min && values[i] <= p.max;
+      }
+    }
+    if (std::find(selected.begin(), selected.end(), 1) == selected.end()) {
+      continue;
+    }
+
+    // Decode the remaining columns and emit the matching rows
+    for (int c = 0; c < SnapshotColumn::kColumnLast; c++) {
+      if (!decoded[c]) {
+        ReadColumn(group, c, &columns[c]);
+      }
+    }
+    SnapshotRow row;
+    for (size_t i = 0; i < group.no_rows; i++) {
+      if (!selected[i]) {
+        continue;
+      }
+      for (int c = 0; c < SnapshotColumn::kColumnLast; c++) {
+        row.values[c] = columns[c][i];
+      }
+      f(row);
+      no_matches++;
+    }
+  }
+  return no_matches;
+}
+
+void SnapshotReader::ReadColumn(const RowGroup& group, int column,
+                                std::vector<int64_t>* values) {
+  auto& chunk = group.chunks[column];
+  std::vector<uint8_t> bytes(chunk.size);
+  file_.clear();
+  file_.seekg(chunk.offset);
+  file_.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+  DecodeColumn(chunk.encoding, bytes, group.no_rows, values);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
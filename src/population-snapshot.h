@@ -0,0 +1,160 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef POPULATION_SNAPSHOT_H_
+#define POPULATION_SNAPSHOT_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "async-writer.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Columns of a population snapshot. Agent references (partner, mother) are
+// stored as uids, -1 if there is none. The age is stored in whole years.
+enum SnapshotColumn {
+  kColumnUid,
+  kColumnAge,
+  kColumnSex,
+  kColumnLocation,
+  kColumnState,
+  kColumnSocioBehaviour,
+  kColumnPartnerUid,
+  kColumnMotherUid,
+  kColumnTransmissionType,
+  kColumnLast
+};
+
+// One agent of a snapshot
+struct SnapshotRow {
+  int64_t values[SnapshotColumn::kColumnLast];
+};
+
+// Inclusive range [min, max] on a column
+struct SnapshotPredicate {
+  int column;
+  int64_t min;
+  int64_t max;
+};
+
+// Yearly population snapshots in a columnar file. The file does not depend on
+// BioDynaMo and can be read offline with the SnapshotReader.
+//
+// The rows of a year are sorted by location and uid and split into row
+// groups. Each column of a row group is stored as a separate chunk, encoded
+// either with zigzag delta varints or with run-length encoding (whichever is
+// smaller), together with its minimum and maximum (zone map). The index of all
+// chunks is written as footer when the file is closed:
+//
+//   "HIVSNAP1" | chunks ... | footer | footer offset (8 bytes) | "HIVSNAP1"
+//
+// If an AsyncWriter is given, sorting, encoding, and writing happen on its I/O
+// thread, i.e. Write() only hands over the rows.
+class SnapshotWriter {
+ public:
+  SnapshotWriter() {}
+  ~SnapshotWriter();
+
+  // Open the file. Returns false if the file cannot be opened.
+  bool Open(const std::string& filename, size_t rows_per_group,
+            AsyncWriter* writer = nullptr);
+
+  bool IsOpen() const { return file_.is_open(); }
+
+  // Queue the snapshot of the given year
+  void Write(int year, std::vector<SnapshotRow>&& rows);
+
+  // Wait for the queued snapshots, write the footer, and close the file
+  void Close();
+
+ private:
+  struct Chunk {
+    uint8_t encoding;
+    int64_t min;
+    int64_t max;
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct RowGroup {
+    int32_t year;
+    uint32_t no_rows;
+    Chunk chunks[SnapshotColumn::kColumnLast];
+  };
+  struct Snapshot {
+    int year;
+    std::vector<SnapshotRow> rows;
+  };
+
+  std::ofstream file_;
+  uint64_t offset_ = 0;
+  size_t rows_per_group_ = 0;
+  std::vector<RowGroup> row_groups_;
+  AsyncWriter* writer_ = nullptr;
+
+  void WriteSnapshot(Snapshot* snapshot);
+  void WriteBytes(const std::vector<uint8_t>& bytes);
+};
+
+// Reads snapshot files written by the SnapshotWriter. Row groups whose zone
+// maps do not intersect the predicates are skipped without being read, and
+// the remaining columns of a row group are only decoded if at least one row
+// matches the predicates.
+class SnapshotReader {
+ public:
+  // Open the file and read the footer. Returns false if the file is not a
+  // valid snapshot file.
+  bool Open(const std::string& filename);
+
+  // Years contained in the file
+  std::vector<int> GetYears() const;
+
+  // Call f for every row of the given year that matches all predicates.
+  // Returns the number of matching rows.
+  size_t Scan(int year, const std::vector<SnapshotPredicate>& predicates,
+              const std::function<void(const SnapshotRow&)>& f);
+
+  // Number of row groups read and skipped in the last Scan()
+  size_t GetNumRowGroupsRead() const { return no_read_; }
+  size_t GetNumRowGroupsSkipped() const { return no_skipped_; }
+
+ private:
+  struct Chunk {
+    uint8_t encoding;
+    int64_t min;
+    int64_t max;
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct RowGroup {
+    int32_t year;
+    uint32_t no_rows;
+    Chunk chunks[SnapshotColumn::kColumnLast];
+  };
+
+  std::ifstream file_;
+  std::vector<RowGroup> row_groups_;
+  size_t no_read_ = 0;
+  size_t no_skipped_ = 0;
+
+  void ReadColumn(const RowGroup& group, int column,
+                  std::vector<int64_t>* values);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // POPULATION_SNAPSHOT_H_
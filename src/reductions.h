@@ -0,0 +1,43 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef REDUCTIONS_H_
+#define REDUCTIONS_H_
+
+#include <type_traits>
+
+#include "core/container/shared_data.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Combines the thread-local partial results of a GenericReducer in the fixed
+// order of the thread slots. Only integral types are accepted: integer sums
+// are exact and hence independent of how the agents were distributed over the
+// threads, such that the statistics are bitwise identical for any number of
+// threads. Real-valued quantities must be accumulated as integers (e.g. in
+// fixed point) per thread and converted after the reduction.
+template <typename T>
+T SumTlResults(const SharedData<T>& tl_results) {
+  static_assert(std::is_integral<T>::value,
+                "Thread-local results must be integral to be reproducible");
+  T result = 0;
+  for (auto& el : tl_results) {
+    result += el;
+  }
+  return result;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // REDUCTIONS_H_
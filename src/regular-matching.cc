@@ -0,0 +1,201 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "regular-matching.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <utility>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+// splitmix64 finalizer
+uint64_t Mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Seed of the generator of a category in a round
+uint64_t MixSeed(uint64_t seed, uint64_t category, uint64_t round) {
+  return Mix(seed + 0x9e3779b97f4a7c15ULL * (category * 1024 + round + 1));
+}
+
+bool KeyLess(const MatchingSingle& a, const MatchingSingle& b) {
+  return a.key < b.key;
+}
+
+}  // namespace
+
+double RegularMatching::GetUniform(uint64_t seed, uint64_t key) {
+  // Distinct from the seeds of the queues (MixSeed)
+  uint64_t z = Mix(Mix(seed ^ 0x5851f42d4c957f2dULL) + key);
+  // 53 random bits
+  return (z >> 11) * 0x1.0p-53;
+}
+
+void RegularMatching::SetAgePreferences(size_t no_age_categories,
+                                        const std::vector<float>& age_mixing) {
+  no_age_categories_ = no_age_categories;
+  preferences_.assign(no_age_categories, {});
+  for (size_t a_i = 0; a_i < no_age_categories; a_i++) {
+    auto& order = preferences_[a_i];
+    for (size_t a_j = 0; a_j < no_age_categories; a_j++) {
+      if (age_mixing[a_i * no_age_categories + a_j] > 0) {
+        order.push_back(a_j);
+      }
+    }
+    // Most preferred first, ties broken by the distance to the own age
+    const float* row = &age_mixing[a_i * no_age_categories];
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) {
+                       if (row[a] != row[b]) {
+                         return row[a] > row[b];
+                       }
+                       return std::abs(static_cast<int>(a) -
+                                       static_cast<int>(a_i)) <
+                              std::abs(static_cast<int>(b) -
+                                       static_cast<int>(a_i));
+                     });
+  }
+}
+
+void RegularMatching::Match(std::vector<std::vector<MatchingSingle>>* men,
+                            std::vector<std::vector<MatchingSingle>>* women,
+                            size_t max_rounds, uint64_t seed,
+                            std::vector<MatchingPair>* pairs) {
+  const size_t no_categories = men->size();
+  pairs->clear();
+  matches_per_round_.assign(max_rounds + 1, 0);
+
+  // Number of women of each category that are already matched. Women are
+  // matched in queue order.
+  std::vector<uint32_t> next_woman(no_categories, 0);
+  // Positions of the men of each category that are not matched yet
+  std::vector<std::vector<uint32_t>> waiting(no_categories);
+  // Pairs formed by each (target) category in the current round
+  std::vector<std::vector<MatchingPair>> new_pairs(no_categories);
+
+  // Round 0: match within the category
+#pragma omp parallel for schedule(dynamic)
+  for (size_t c = 0; c < no_categories; c++) {
+    auto& m = (*men)[c];
+    auto& w = (*women)[c];
+    std::sort(m.begin(), m.end(), KeyLess);
+    std::sort(w.begin(), w.end(), KeyLess);
+    std::mt19937_64 rng(MixSeed(seed, c, 0));
+    std::shuffle(m.begin(), m.end(), rng);
+    std::shuffle(w.begin(), w.end(), rng);
+    size_t no_pairs = std::min(m.size(), w.size());
+    for (size_t i = 0; i < no_pairs; i++) {
+      new_pairs[c].push_back({static_cast<uint32_t>(c), m[i].index,
+                              static_cast<uint32_t>(c), w[i].index});
+    }
+    next_woman[c] = no_pairs;
+    for (size_t i = no_pairs; i < m.size(); i++) {
+      waiting[c].push_back(i);
+    }
+  }
+  for (auto& p : new_pairs) {
+    pairs->insert(pairs->end(), p.begin(), p.end());
+    matches_per_round_[0] += p.size();
+    p.clear();
+  }
+
+  // Proposals (man category, position) to each target category
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> proposals(
+      no_categories);
+  for (size_t round = 1; round <= max_rounds; round++) {
+    // The remaining men propose to their round-th alternative age category.
+    // Linear in the number of waiting men, hence done sequentially to keep
+    // the order of the proposals deterministic.
+    bool any_proposal = false;
+    for (size_t c = 0; c < no_categories; c++) {
+      proposals[c].clear();
+    }
+    for (size_t c = 0; c < no_categories; c++) {
+      size_t age = c % no_age_categories_;
+      size_t base = c - age;
+      for (uint32_t pos : waiting[c]) {
+        const auto& order = preferences_[(*men)[c][pos].age_category];
+        size_t rank = 0;
+        for (uint32_t alternative : order) {
+          if (alternative == age || ++rank < round) {
+            continue;
+          }
+          proposals[base + alternative].emplace_back(c, pos);
+          any_proposal = true;
+          break;
+        }
+      }
+    }
+    if (!any_proposal) {
+      break;
+    }
+
+    // Each category accepts as many proposals as it has single women left
+#pragma omp parallel for schedule(dynamic)
+    for (size_t t = 0; t < no_categories; t++) {
+      auto& props = proposals[t];
+      size_t no_free = (*women)[t].size() - next_woman[t];
+      if (props.empty() || no_free == 0) {
+        continue;
+      }
+      if (props.size() > no_free) {
+        std::mt19937_64 rng(MixSeed(seed, t, round));
+        std::shuffle(props.begin(), props.end(), rng);
+      }
+      size_t no_pairs = std::min(props.size(), no_free);
+      for (size_t i = 0; i < no_pairs; i++) {
+        const auto& man = (*men)[props[i].first][props[i].second];
+        const auto& woman = (*women)[t][next_woman[t] + i];
+        new_pairs[t].push_back({props[i].first, man.index,
+                                static_cast<uint32_t>(t), woman.index});
+      }
+      next_woman[t] += no_pairs;
+      // Keep only the accepted proposals to remove the men from waiting
+      props.resize(no_pairs);
+    }
+
+    // Merge the pairs and remove the matched men from the waiting lists
+    std::vector<std::vector<uint32_t>> matched(no_categories);
+    for (size_t t = 0; t < no_categories; t++) {
+      pairs->insert(pairs->end(), new_pairs[t].begin(), new_pairs[t].end());
+      matches_per_round_[round] += new_pairs[t].size();
+      new_pairs[t].clear();
+      for (const auto& prop : proposals[t]) {
+        matched[prop.first].push_back(prop.second);
+      }
+    }
+    for (size_t c = 0; c < no_categories; c++) {
+      if (matched[c].empty()) {
+        continue;
+      }
+      std::sort(matched[c].begin(), matched[c].end());
+      auto& w = waiting[c];
+      w.erase(std::remove_if(w.begin(), w.end(),
+                             [&](uint32_t pos) {
+                               return std::binary_search(matched[c].begin(),
+                                                         matched[c].end(),
+                                                         pos);
+                             }),
+              w.end());
+    }
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,97 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef REGULAR_MATCHING_H_
+#define REGULAR_MATCHING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// A single agent in the queue of a compound category. The key (cohort id)
+// defines the deterministic order of the queue.
+struct MatchingSingle {
+  uint64_t key;
+  // Position of the agent in the index of the caller
+  uint32_t index;
+  // Own age category (men), used to rank the alternative categories
+  uint32_t age_category;
+};
+
+// A new regular partnership, given by the categories and the (caller) indices
+// of the partners
+struct MatchingPair {
+  uint32_t man_category;
+  uint32_t man_index;
+  uint32_t woman_category;
+  uint32_t woman_index;
+};
+
+// Matching engine for regular partnerships. Men are queued in the compound
+// category (location x age x sociobehaviour) of their preferred partner,
+// women in their own compound category.
+//
+// In round 0, men and women of the same category are matched. In each
+// further round, the remaining men of a category propose to the next age
+// category (same location and sociobehaviour) in the order of their
+// preferences, i.e. of the row of their own age category in the
+// reg_partner_age_mixing_matrix. Age categories without preference are never
+// proposed to. Each category accepts as many proposals as it has single
+// women left. The number of rounds is bounded, hence the cost is linear in
+// the number of singles.
+//
+// The queues are sorted by key and shuffled with generators seeded per
+// category and round, such that the result does not depend on the number of
+// threads or on the order in which the queues were filled. The categories
+// are processed in parallel with dynamic scheduling, i.e. idle threads take
+// over the remaining (unbalanced) categories.
+class RegularMatching {
+ public:
+  RegularMatching() = default;
+
+  // Set the number of age categories and the age preferences of the men
+  // (no_age_categories x no_age_categories, row-major, row = own age).
+  void SetAgePreferences(size_t no_age_categories,
+                         const std::vector<float>& age_mixing);
+
+  // Match the men and women of all compound categories. The queues are
+  // reordered in place. Returns the new partnerships in deterministic order.
+  void Match(std::vector<std::vector<MatchingSingle>>* men,
+             std::vector<std::vector<MatchingSingle>>* women,
+             size_t max_rounds, uint64_t seed,
+             std::vector<MatchingPair>* pairs);
+
+  // Uniform number in [0, 1) for the agent with the given key, drawn from a
+  // generator seeded per agent. Used to select the partner category of the
+  // men in parallel, independent of the number of threads.
+  static double GetUniform(uint64_t seed, uint64_t key);
+
+  // Number of partnerships formed in each round of the last Match()
+  const std::vector<uint64_t>& GetMatchesPerRound() const {
+    return matches_per_round_;
+  }
+
+ private:
+  size_t no_age_categories_ = 1;
+  // Age categories in the order of preference for each own age category.
+  // Entries without preference are omitted.
+  std::vector<std::vector<uint32_t>> preferences_;
+  std::vector<uint64_t> matches_per_round_;
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // REGULAR_MATCHING_H_
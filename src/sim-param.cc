@@ -1,5 +1,9 @@
 #include "sim-param.h"
 
+#include <algorithm>
+
+#include "parameter-tables.h"
+
 namespace bdm {
 namespace hiv_malawi {
 
@@ -8,9 +12,78 @@ namespace hiv_malawi {
 // simulation parameters anywhere in the simulation.
 const ParamGroupUid SimParam::kUid = ParamGroupUidGenerator::Get()->NewUid();
 
+namespace {
+
+// Look up a table and check its rank. Returns false if the file does not
+// contain the table.
+bool GetTable(const ParameterTables& tables, const std::string& name,
+              size_t rank, std::vector<uint32_t>* dims, const float** data) {
+  *data = tables.Get(name, dims);
+  if (*data == nullptr) {
+    return false;
+  }
+  if (dims->size() != rank) {
+    Log::Fatal("SimParam::LoadParameterTables()", "Table ", name, " has rank ",
+               dims->size(), ", expected ", rank);
+  }
+  return true;
+}
+
+// Copy a table into the vector of the corresponding SimParam member
+void LoadTable(const ParameterTables& tables, const std::string& name,
+               std::vector<float>* out) {
+  std::vector<uint32_t> dims;
+  const float* data;
+  if (GetTable(tables, name, 1, &dims, &data)) {
+    out->assign(data, data + dims[0]);
+  }
+}
+
+}  // namespace
+
+void SimParam::LoadParameterTables() {
+  if (parameter_table_file.empty()) {
+    return;
+  }
+  ParameterTables tables;
+  if (!tables.Open(parameter_table_file)) {
+    Log::Fatal("SimParam::LoadParameterTables()",
+               "Cannot map parameter table file ", parameter_table_file);
+  }
+  // Tables that are read by the behaviours from the SimParam. The
+  // multi-dimensional tables are read in place by CompiledParams::Compile(),
+  // which keeps the file mapped.
+  LoadTable(tables, "mortality_rate_by_age", &mortality_rate_by_age);
+  LoadTable(tables, "hiv_mortality_rate", &hiv_mortality_rate);
+  LoadTable(tables, "initial_infection_probability",
+            &initial_infection_probability);
+  LoadTable(tables, "fertility_rates", &fertility_rates);
+
+  static const std::vector<std::string> kKnownTables{
+      "mortality_rate_by_age",
+      "hiv_mortality_rate",
+      "migration_matrix",
+      "hiv_transition_matrix",
+      "sociobehaviour_transition_matrix",
+      "location_mixing_matrix",
+      "age_mixing_matrix",
+      "reg_partner_age_mixing_matrix",
+      "sociobehav_mixing_matrix",
+      "reg_partner_sociobehav_mixing_matrix",
+      "initial_infection_probability",
+      "fertility_rates"};
+  for (auto& name : tables.GetNames()) {
+    if (std::find(kKnownTables.begin(), kKnownTables.end(), name) ==
+        kKnownTables.end()) {
+      Log::Warning("SimParam::LoadParameterTables()", "Ignoring table ", name,
+                   " of ", parameter_table_file);
+    }
+  }
+}
+
 void SimParam::SetSociobehavMixingMatrix() {
   sociobehav_mixing_matrix.clear();
-  sociobehav_mixing_matrix.resize(nb_age_categories);
+  sociobehav_mixing_matrix.resize(nb_sociobehav_categories);
 
   for (int i = 0; i < nb_sociobehav_categories; i++) {
     sociobehav_mixing_matrix[i].resize(nb_sociobehav_categories);
@@ -22,7 +95,7 @@ void SimParam::SetSociobehavMixingMatrix() {
 
 void SimParam::SetRegPartnerSociobehavMixingMatrix() {
   reg_partner_sociobehav_mixing_matrix.clear();
-  reg_partner_sociobehav_mixing_matrix.resize(nb_age_categories);
+  reg_partner_sociobehav_mixing_matrix.resize(nb_sociobehav_categories);
 
   for (int i = 0; i < nb_sociobehav_categories; i++) {
     reg_partner_sociobehav_mixing_matrix[i].resize(nb_sociobehav_categories);
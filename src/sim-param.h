@@ -13,6 +13,7 @@
 #ifndef SIM_PARAM_H_
 #define SIM_PARAM_H_
 
+#include <string>
 #include <vector>
 #include "biodynamo.h"
 #include "datatypes.h"  //AM: Added to access GemState Enum
@@ -83,9 +84,21 @@ class SimParam : public ParamGroup {
   // AM: Probability that a single man wants to engage in regular partnership
   float regular_partnership_probability = 1.0;
 
+  // Number of rounds in which single men that were not matched in the
+  // compound category of their choice propose to women of the next preferred
+  // age category (see RegularMatching). 0 only matches within categories.
+  uint64_t regular_matching_rounds = 3;
+
   // AM: Probability that a couple in regular partnership separate
   float break_up_probability = 1.0;
 
+  // Number of partnerships kept per agent in the partnership history (ring
+  // buffer, at most 255). Older partnerships are discarded, or appended to
+  // partnership_history_spill_file if a file name is given (see
+  // PartnershipHistory for the record format).
+  size_t partnership_history_length = 4;
+  std::string partnership_history_spill_file = "";
+
   // Years where number of mates per socio-behavioural factors changes
   const std::vector<int> no_mates_year_transition  //{1960, 1990, 2000};
       {1960, 1991, 1992, 1993, 1994, 1995, 1996,
@@ -157,6 +170,43 @@ class SimParam : public ParamGroup {
   float infection_probability_treated_mm = 1.3e-3 * coef_infection_probability;
   float infection_probability_failing_mm = 7.6e-3 * coef_infection_probability;
 
+  // Proportion of men who have sex with men (MSM). They are assigned at
+  // initialisation and at the first year of adulthood. Each casual partner of
+  // an MSM is male with probability msm_mate_probability, i.e. MSM with
+  // msm_mate_probability < 1 are bisexual. By default, there are no MSM.
+  float msm_probability = 0.0;
+  float msm_mate_probability = 0.5;
+
+  // Relative reduction of the per-act transmission probability for a
+  // susceptible agent on PrEP, a circumcised susceptible male (VMMC), and a
+  // contact in which one of the partners uses condoms.
+  float prep_efficacy = 0.86;
+  float vmmc_efficacy = 0.6;
+  float condom_efficacy = 0.8;
+
+  // Probabilities that an adult who is not covered yet is assigned PrEP
+  // (HIV-negative agents only), VMMC (males only), or consistent condom use,
+  // at the start of the simulation and then every year. By default, there is
+  // no prevention.
+  float prep_probability = 0.0;
+  float vmmc_probability = 0.0;
+  float condom_use_probability = 0.0;
+
+  // Assisted partner notification. The partner_notification_no_partners most
+  // recent distinct partners of agents that start treatment are traced with
+  // probability partner_notification_success. The partners of the notified
+  // partners are traced in turn, up to partner_notification_depth
+  // generations (1: partners of partners are not traced). Traced infected
+  // partners start treatment with probability partner_notification_art_uptake,
+  // traced healthy partners start PrEP with probability
+  // partner_notification_prep_uptake.
+  bool partner_notification = false;
+  size_t partner_notification_no_partners = 2;
+  size_t partner_notification_depth = 1;
+  float partner_notification_success = 0.5;
+  float partner_notification_art_uptake = 0.8;
+  float partner_notification_prep_uptake = 0.0;
+
   // AM: Transition Matrix between HIV states.
   // GemState->Year-and-Population-category->GemsState
   std::vector<std::vector<std::vector<float>>> hiv_transition_matrix;
@@ -231,14 +281,123 @@ class SimParam : public ParamGroup {
   /*const std::vector<bool> seed_districts{
       true, false};*/
 
-  // Parameter 0.18 is chosen because our GiveBirth Behaviour is based on a
-  // Bernoulli experiment. A binomial distribuition peaks at around 6 for 25
-  // tries (=40-15) and a birth probability of 0.24. This corresponds to the
-  // typical birth rate in the region. We substracted 0.06 to account for child
-  // motability and reach a realistic demographic development from 1960-2020.
+  // Parameter 0.18 is chosen because our birth generation is based on a
+  // Bernoulli experiment per woman and year. A binomial distribuition peaks at
+  // around 6 for 25 tries (=40-15) and a birth probability of 0.24. This
+  // corresponds to the typical birth rate in the region. We substracted 0.06 to
+  // account for child motability and reach a realistic demographic development
+  // from 1960-2020.
   // Parameter 0.21 is used in Janne's R implementation.
   float give_birth_probability = 0.188;  // 0.18
 
+  // Lower bounds of the fertility age bands. Women between min_age and
+  // max_age_birth are indexed as potential mothers by age band.
+  std::vector<int> fertility_age_bands{15, 20, 25, 30, 35, 40, 45};
+  // Annual probability to give birth per fertility age band (age-specific
+  // fertility table). If empty, give_birth_probability applies to all bands.
+  std::vector<float> fertility_rates{};
+
+  // If true, children under min_age are stored as lightweight ChildRecords with
+  // their mother instead of as agents. They become agents at min_age or when
+  // their mother dies.
+  bool compress_children = false;
+
+  // Fraction of agents whose life histories are recorded by the CohortTracker
+  // (0 disables the tracking). Agents are selected by a hash of their cohort
+  // id (see Person::cohort_id_).
+  float cohort_fraction = 0.0;
+  // Binary file in the output directory to which the cohort events are
+  // appended once per year
+  std::string cohort_file = "cohort-events.bin";
+
+  // Count the realised casual and regular contacts by location, age
+  // category, and sociobehaviour of both partners (see ContactMatrices)
+  bool collect_contact_matrices = false;
+  // CSV file to which the contact matrices are appended once per year
+  std::string contact_matrix_file = "contact-matrices.csv";
+
+  // Columnar file to which a snapshot of the population is written at the
+  // beginning of each year (empty disables the snapshots)
+  std::string snapshot_file = "";
+  // Number of agents per row group of the snapshot file. Smaller row groups
+  // allow readers to skip more data, larger ones compress better.
+  uint64_t snapshot_rows_per_group = 65536;
+
+  // If true, the hot prevalence and incidence statistics of a year (see
+  // HotCounts) are computed from a snapshot of the hot columns on the I/O
+  // thread, overlapping with the indexing and matching of the next year. The
+  // results are identical to the serial collectors, but only added to the
+  // TimeSeries at the end of the simulation. The other statistics remain
+  // collectors of the TimeSeries.
+  bool pipelined_statistics = false;
+
+  // Pages that back the large agent indexes of the CategoricalEnvironment:
+  // "none", "transparent" (madvise), or "hugetlbfs" (falls back to
+  // transparent huge pages if the pool is empty). See HugePageAllocator.
+  std::string huge_pages = "none";
+
+  // Binary file of the ensemble aggregate (see EnsembleAggregator). If set,
+  // the time series of the simulation are added to the aggregate at the end of
+  // the simulation; the file is created if it does not exist and locked while
+  // it is updated, i.e. replicates can share it. The aggregates of different
+  // files are merged with tools/ensemble-bands.cc.
+  std::string ensemble_file = "";
+
+  // Number of replicates that are forked from the initialized population (see
+  // ForkReplicates). 0 runs a single simulation. The replicates share the
+  // initial population copy-on-write and differ in their random seeds; their
+  // time series are only aggregated (ensemble_file and ensemble-bands.csv in
+  // the output directory). Each replicate runs in a worker process with a
+  // single OpenMP thread.
+  uint64_t fork_replicates = 0;
+  // Maximum number of replicates that run at the same time (0: one per
+  // hardware thread)
+  uint64_t fork_workers = 0;
+
+  // Scenarios that share the history up to scenario_year (see ForkScenarios).
+  // Each scenario is a timeline file whose overrides are applied on top of
+  // timeline_file; an empty name is the baseline. The years before
+  // scenario_year are simulated once, then each scenario continues in a
+  // forked process from the same population and random number state. The
+  // random streams are not synchronised per event, hence the scenarios do not
+  // use common random numbers once their draws differ. The time series of
+  // scenario i are written to
+  // scenario-<i>-bands.csv in the output directory (and added to
+  // <ensemble_file>.<i>). Cannot be combined with fork_replicates.
+  std::vector<std::string> scenario_timeline_files = {};
+  int scenario_year = 2010;
+
+  // Number of particles of a particle filter that fits the simulation to
+  // survey prevalences (see RunParticleFilter). 0 disables the filter. The
+  // observations are read from smc_survey_file, a CSV file with lines
+  // "year,id,value,sample_size", where id is a collected series, e.g.
+  // prevalence_women_15_49 for ANC or prevalence_15_49 for DHS surveys. The
+  // time series of the resampled particles are written to
+  // particle-filter-bands.csv, and the effective sample sizes and log
+  // evidence to particle-filter.csv in the output directory. Cannot be
+  // combined with fork_replicates or scenario_timeline_files.
+  uint64_t smc_particles = 0;
+  std::string smc_survey_file = "";
+
+  // Binary file of parameter tables (see ParameterTables and
+  // tools/param-tables.cc). Tables in the file replace the SimParam members of
+  // the same name, e.g. migration_matrix. The one-dimensional tables are
+  // copied into the members, the others are read in place from the mapped
+  // file by the CompiledParams. Empty disables the loading.
+  std::string parameter_table_file = "";
+
+  // Years in which the ART eras start. The first era has no ART. The
+  // hiv_transition_matrix has one population category for the first era and
+  // one per population group (women 15-40, children, others) for each
+  // following era.
+  std::vector<int> art_year_transition{1960, 2003, 2011};
+
+  // Optional CSV file of year-dependent parameter overrides (scenario
+  // timeline). Each line "year,parameter,value[,index]" sets a parameter from
+  // the given year on, e.g. "2015,prep_probability,0.2" or
+  // "1995,no_mates_mean,60,1" for socio-behavioural category 1.
+  std::string timeline_file = "";
+
   // AM : Probability for agent to be infected at birth, if its mother is
   // infected and treated
   float birth_infection_probability_treated = 0.05;
@@ -310,8 +469,8 @@ class SimParam : public ParamGroup {
   // as a function of initial_prevalence and seed districts.
   void SetInitialInfectionProbability();
 
-  // Resizes matrix to (nb_age_categories x nb_sociobehav_categories) and fills
-  // with ones.
+  // Resizes matrix to (nb_sociobehav_categories x nb_sociobehav_categories) and
+  // fills with ones.
   void SetSociobehavMixingMatrix();
 
   // Resizes matrix to (nb_age_categories x nb_age_categories) and fills with
@@ -322,8 +481,8 @@ class SimParam : public ParamGroup {
   // ones.
   void SetLocationMixingMatrix();
 
-  // Resizes matrix to (nb_age_categories x nb_sociobehav_categories) and fills
-  // with ones.
+  // Resizes matrix to (nb_sociobehav_categories x nb_sociobehav_categories) and
+  // fills with ones.
   void SetRegPartnerSociobehavMixingMatrix();
 
   // Resizes matrix to (nb_age_categories x nb_age_categories) and fills with
@@ -345,6 +504,11 @@ class SimParam : public ParamGroup {
   // Resizes to (migration_year_transitions x nb_locations x nb_locations) and
   // fills entries with normalized and cumulative probabilities
   void SetMigrationLocationProbability();
+
+  // Replace the one-dimensional tables defined above by those in
+  // parameter_table_file. Must be called after the parameters were read from
+  // the configuration files.
+  void LoadParameterTables();
 };
 
 }  // namespace hiv_malawi
@@ -0,0 +1,137 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "statistics-pipeline.h"
+
+#include <cassert>
+#include <memory>
+#include <utility>
+
+namespace bdm {
+namespace hiv_malawi {
+
+void HotCounts::Merge(const HotCounts& other) {
+  agents += other.agents;
+  infected += other.infected;
+  acute += other.acute;
+  infected_15_49 += other.infected_15_49;
+  all_15_49 += other.all_15_49;
+  infected_females += other.infected_females;
+  females += other.females;
+  infected_women_15_49 += other.infected_women_15_49;
+  women_15_49 += other.women_15_49;
+  infected_males += other.infected_males;
+  males += other.males;
+  infected_men_15_49 += other.infected_men_15_49;
+  men_15_49 += other.men_15_49;
+}
+
+const std::vector<HotStatistic>& GetHotStatistics() {
+  static const std::vector<HotStatistic> kStatistics = {
+      {"acute_agents",
+       [](const HotCounts& c) { return static_cast<double>(c.acute); }},
+      {"infected_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_15_49);
+       }},
+      {"all_15_49",
+       [](const HotCounts& c) { return static_cast<double>(c.all_15_49); }},
+      {"infected_females",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_females);
+       }},
+      {"females",
+       [](const HotCounts& c) { return static_cast<double>(c.females); }},
+      {"infected_women_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_women_15_49);
+       }},
+      {"women_15_49",
+       [](const HotCounts& c) { return static_cast<double>(c.women_15_49); }},
+      {"infected_males",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_males);
+       }},
+      {"males",
+       [](const HotCounts& c) { return static_cast<double>(c.males); }},
+      {"infected_men_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_men_15_49);
+       }},
+      {"men_15_49",
+       [](const HotCounts& c) { return static_cast<double>(c.men_15_49); }},
+      // AM: Prevalence
+      {"prevalence",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected) / c.agents;
+       }},
+      {"prevalence_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_15_49) / c.all_15_49;
+       }},
+      {"prevalence_females",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_females) / c.females;
+       }},
+      {"prevalence_women_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_women_15_49) / c.women_15_49;
+       }},
+      {"prevalence_males",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_males) / c.males;
+       }},
+      {"prevalence_men_15_49",
+       [](const HotCounts& c) {
+         return static_cast<double>(c.infected_men_15_49) / c.men_15_49;
+       }},
+      // AM: Incidence
+      {"incidence", [](const HotCounts& c) {
+         return static_cast<double>(c.acute) / c.agents;
+       }}};
+  assert(kStatistics.size() == kNumHotStatistics);
+  return kStatistics;
+}
+
+void StatisticsPipeline::Submit(double x, std::vector<HotRow> rows,
+                                AsyncWriter* writer) {
+  if (writer == nullptr) {
+    Evaluate(x, rows);
+    return;
+  }
+  uint64_t bytes = rows.size() * sizeof(HotRow);
+  // std::function requires copyable jobs
+  auto shared_rows = std::make_shared<std::vector<HotRow>>(std::move(rows));
+  writer->Submit([this, x, shared_rows]() { Evaluate(x, *shared_rows); },
+                 bytes);
+}
+
+void StatisticsPipeline::Evaluate(double x, const std::vector<HotRow>& rows) {
+  HotCounts counts;
+  for (const auto& row : rows) {
+    counts.Add(row);
+  }
+  x_values_.push_back(x);
+  counts_.push_back(counts);
+}
+
+std::vector<double> StatisticsPipeline::GetYValues(size_t statistic) const {
+  auto get = GetHotStatistics()[statistic].get;
+  std::vector<double> y_values(counts_.size());
+  for (size_t i = 0; i < counts_.size(); i++) {
+    y_values[i] = get(counts_[i]);
+  }
+  return y_values;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,156 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef STATISTICS_PIPELINE_H_
+#define STATISTICS_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "async-writer.h"
+#include "datatypes.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Copy of the attributes of an agent that are used by the hot statistics
+// (see HotCounts). 8 bytes.
+struct HotRow {
+  float age_;
+  uint8_t state_;
+  uint8_t sex_;
+
+  template <typename TPerson>
+  static HotRow From(const TPerson& person) {
+    HotRow row;
+    row.age_ = person.age_;
+    row.state_ = static_cast<uint8_t>(person.state_);
+    row.sex_ = static_cast<uint8_t>(person.sex_);
+    return row;
+  }
+
+  bool IsHealthy() const { return state_ == GemsState::kHealthy; }
+  bool IsAcute() const { return state_ == GemsState::kAcute; }
+  bool IsMale() const { return sex_ == Sex::kMale; }
+  bool IsFemale() const { return sex_ == Sex::kFemale; }
+};
+
+// Counts of the prevalence and incidence statistics, which are read every
+// year (e.g. by the fit to survey observations). They are computed in a
+// single pass over the agents (or over HotRows) instead of one pass per
+// counter. The counts are integers, hence the merge of thread-local counts is
+// exact and independent of the order.
+struct HotCounts {
+  uint64_t agents = 0;
+  uint64_t infected = 0;
+  uint64_t acute = 0;
+  uint64_t infected_15_49 = 0;
+  uint64_t all_15_49 = 0;
+  uint64_t infected_females = 0;
+  uint64_t females = 0;
+  uint64_t infected_women_15_49 = 0;
+  uint64_t women_15_49 = 0;
+  uint64_t infected_males = 0;
+  uint64_t males = 0;
+  uint64_t infected_men_15_49 = 0;
+  uint64_t men_15_49 = 0;
+
+  // Count an agent (Person or HotRow)
+  template <typename TPerson>
+  void Add(TPerson& person) {
+    bool infected_person = !person.IsHealthy();
+    bool age_15_49 = person.age_ >= 15 && person.age_ < 50;
+    bool female = person.IsFemale();
+    bool male = person.IsMale();
+    agents++;
+    infected += infected_person;
+    acute += person.IsAcute();
+    infected_15_49 += infected_person && age_15_49;
+    all_15_49 += age_15_49;
+    infected_females += infected_person && female;
+    females += female;
+    infected_women_15_49 += infected_person && female && age_15_49;
+    women_15_49 += female && age_15_49;
+    infected_males += infected_person && male;
+    males += male;
+    infected_men_15_49 += infected_person && male && age_15_49;
+    men_15_49 += male && age_15_49;
+  }
+
+  void Merge(const HotCounts& other);
+};
+
+// A statistic of the TimeSeries that is computed from the HotCounts
+struct HotStatistic {
+  const char* id;
+  double (*get)(const HotCounts& counts);
+};
+
+// The hot statistics: the counters and the prevalence and incidence ratios,
+// in the order of their registration. The number of infected agents is not
+// among them, because other collectors of the TimeSeries read it every year.
+constexpr size_t kNumHotStatistics = 18;
+const std::vector<HotStatistic>& GetHotStatistics();
+
+// Hot statistics that are computed from snapshots of the agents (HotRows)
+// instead of from the agents. The simulation captures a snapshot at the end of
+// each year and submits it; the counts are computed on the thread of an
+// AsyncWriter while the next year's indexing and matching run. The other
+// statistics remain collectors of the TimeSeries.
+class StatisticsPipeline {
+ public:
+  StatisticsPipeline() = default;
+
+  // Compute the hot statistics for the submitted snapshots
+  void Enable() { enabled_ = true; }
+  bool IsEmpty() const { return !enabled_; }
+
+  // Compute the hot statistics of the rows for the given x value (year). If a
+  // writer is given, the computation is queued on its thread; the results are
+  // available after AsyncWriter::Flush().
+  void Submit(double x, std::vector<HotRow> rows, AsyncWriter* writer);
+
+  // Results in the order of GetHotStatistics() and of the submissions
+  size_t GetNumStatistics() const { return GetHotStatistics().size(); }
+  const char* GetId(size_t statistic) const {
+    return GetHotStatistics()[statistic].id;
+  }
+  const std::vector<double>& GetXValues() const { return x_values_; }
+  std::vector<double> GetYValues(size_t statistic) const;
+
+  // Hot counts of the year x for the serial collectors, such that all hot
+  // statistics of a year share one pass. count() is only called for the first
+  // statistic of the year.
+  template <typename TCount>
+  const HotCounts& GetCounts(double x, TCount count) {
+    if (x != counts_x_) {
+      current_counts_ = count();
+      counts_x_ = x;
+    }
+    return current_counts_;
+  }
+
+ private:
+  bool enabled_ = false;
+  std::vector<double> x_values_;
+  std::vector<HotCounts> counts_;
+  double counts_x_ = -1;
+  HotCounts current_counts_;
+
+  void Evaluate(double x, const std::vector<HotRow>& rows);
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // STATISTICS_PIPELINE_H_
@@ -0,0 +1,147 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "survey-observations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace bdm {
+namespace hiv_malawi {
+
+namespace {
+
+// Weights relative to the largest one, such that exp does not underflow for
+// all particles
+std::vector<double> RelativeWeights(const std::vector<double>& log_weights) {
+  double max = -std::numeric_limits<double>::infinity();
+  for (auto lw : log_weights) {
+    max = std::max(max, lw);
+  }
+  std::vector<double> weights(log_weights.size());
+  for (size_t i = 0; i < log_weights.size(); i++) {
+    // All particles are equally (un)likely if none has a finite weight
+    weights[i] = std::isinf(max) ? 1 : std::exp(log_weights[i] - max);
+  }
+  return weights;
+}
+
+}  // namespace
+
+bool ReadSurveyObservations(const std::string& filename,
+                            std::vector<SurveyObservation>* observations) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    // year,id,value,sample_size
+    std::stringstream row(line);
+    std::string year, id, value, sample_size;
+    std::getline(row, year, ',');
+    std::getline(row, id, ',');
+    std::getline(row, value, ',');
+    std::getline(row, sample_size, ',');
+    SurveyObservation observation;
+    try {
+      observation.year = std::stoi(year);
+      observation.id = id;
+      observation.value = std::stod(value);
+      observation.sample_size = std::stoull(sample_size);
+    } catch (const std::exception&) {
+      return false;
+    }
+    if (id.empty() || observation.value < 0 || observation.value > 1) {
+      return false;
+    }
+    observations->push_back(observation);
+  }
+  std::stable_sort(observations->begin(), observations->end(),
+                   [](const SurveyObservation& a, const SurveyObservation& b) {
+                     return a.year < b.year;
+                   });
+  return true;
+}
+
+double SurveyLogLikelihood(const SurveyObservation& observation,
+                           double model_value) {
+  // Bounded away from 0 and 1, such that a single observation cannot rule
+  // out all particles
+  constexpr double kEpsilon = 1e-9;
+  double p = std::min(std::max(model_value, kEpsilon), 1 - kEpsilon);
+  double n = static_cast<double>(observation.sample_size);
+  double k = observation.value * n;
+  // Logarithm of the binomial coefficient, such that the log evidence of the
+  // particle filter is the log marginal likelihood of the observations
+  double log_coefficient =
+      std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1);
+  return log_coefficient + k * std::log(p) + (n - k) * std::log(1 - p);
+}
+
+std::vector<uint64_t> SystematicResampling(
+    const std::vector<double>& log_weights, double u) {
+  auto weights = RelativeWeights(log_weights);
+  double total = 0;
+  for (auto w : weights) {
+    total += w;
+  }
+  size_t n = weights.size();
+  std::vector<uint64_t> ancestors(n);
+  double cumulative = 0;
+  size_t i = 0;
+  for (size_t j = 0; j < n; j++) {
+    // The j-th of n evenly spaced points in the total weight
+    double point = (j + u) / n * total;
+    while (i + 1 < n && cumulative + weights[i] <= point) {
+      cumulative += weights[i];
+      i++;
+    }
+    ancestors[j] = i;
+  }
+  return ancestors;
+}
+
+double LogMeanWeight(const std::vector<double>& log_weights) {
+  double max = -std::numeric_limits<double>::infinity();
+  for (auto lw : log_weights) {
+    max = std::max(max, lw);
+  }
+  if (std::isinf(max) || log_weights.empty()) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  double sum = 0;
+  for (auto lw : log_weights) {
+    sum += std::exp(lw - max);
+  }
+  return max + std::log(sum / log_weights.size());
+}
+
+double EffectiveSampleSize(const std::vector<double>& log_weights) {
+  auto weights = RelativeWeights(log_weights);
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (auto w : weights) {
+    sum += w;
+    sum_of_squares += w * w;
+  }
+  return sum * sum / sum_of_squares;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
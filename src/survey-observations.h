@@ -0,0 +1,63 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef SURVEY_OBSERVATIONS_H_
+#define SURVEY_OBSERVATIONS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Prevalence measured by a survey (e.g. ANC sentinel surveillance or DHS) in
+// a given year. The model counterpart is the collected series of the same id,
+// e.g. prevalence_women_15_49 for ANC or prevalence_15_49 for DHS.
+struct SurveyObservation {
+  int year;
+  std::string id;
+  // Observed fraction and number of tested individuals
+  double value;
+  uint64_t sample_size;
+};
+
+// Read observations from a CSV file with lines "year,id,value,sample_size".
+// Empty lines and lines starting with '#' are ignored. The observations are
+// sorted by year. Returns false if the file cannot be read or parsed.
+bool ReadSurveyObservations(const std::string& filename,
+                            std::vector<SurveyObservation>* observations);
+
+// Binomial log-likelihood of the observation, given the prevalence of the
+// model. The number of positive individuals (value * sample_size) need not be
+// an integer; the binomial coefficient is computed with lgamma.
+double SurveyLogLikelihood(const SurveyObservation& observation,
+                           double model_value);
+
+// Systematic resampling: returns the ancestors of log_weights.size() new
+// particles, drawn proportionally to the weights with a single uniform random
+// number u in [0, 1). Ancestors are in ascending order.
+std::vector<uint64_t> SystematicResampling(
+    const std::vector<double>& log_weights, double u);
+
+// Logarithm of the mean of the weights, i.e. the increment of the log
+// evidence (marginal likelihood) after equally weighted particles were
+// weighted. -inf if all weights are zero.
+double LogMeanWeight(const std::vector<double>& log_weights);
+
+// Effective sample size (sum w)^2 / sum w^2 of the normalized weights
+double EffectiveSampleSize(const std::vector<double>& log_weights);
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // SURVEY_OBSERVATIONS_H_
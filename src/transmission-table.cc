@@ -0,0 +1,90 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include "transmission-table.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+void TransmissionTable::Build(const SimParam* sparam) {
+  const size_t no_combinations =
+      TransmissionDirection::kDirectionLast * GemsState::kGemsLast *
+      PreventionModifier::kPreventionLast * PreventionModifier::kPreventionLast;
+  per_act_.resize(no_combinations);
+  cumulative_.resize(no_combinations * (kMaxTabulatedActs + 1));
+
+  for (int dir = 0; dir < TransmissionDirection::kDirectionLast; dir++) {
+    // Per-act probabilities without prevention, indexed by GemsState of the
+    // infector. Healthy agents cannot transmit.
+    std::vector<float> base_probability(GemsState::kGemsLast, 0.0);
+    if (dir == TransmissionDirection::kMaleToFemale) {
+      base_probability[GemsState::kAcute] =
+          sparam->infection_probability_acute_mf;
+      base_probability[GemsState::kChronic] =
+          sparam->infection_probability_chronic_mf;
+      base_probability[GemsState::kTreated] =
+          sparam->infection_probability_treated_mf;
+      base_probability[GemsState::kFailing] =
+          sparam->infection_probability_failing_mf;
+    } else if (dir == TransmissionDirection::kMaleToMale) {
+      base_probability[GemsState::kAcute] =
+          sparam->infection_probability_acute_mm;
+      base_probability[GemsState::kChronic] =
+          sparam->infection_probability_chronic_mm;
+      base_probability[GemsState::kTreated] =
+          sparam->infection_probability_treated_mm;
+      base_probability[GemsState::kFailing] =
+          sparam->infection_probability_failing_mm;
+    } else {
+      base_probability[GemsState::kAcute] =
+          sparam->infection_probability_acute_fm;
+      base_probability[GemsState::kChronic] =
+          sparam->infection_probability_chronic_fm;
+      base_probability[GemsState::kTreated] =
+          sparam->infection_probability_treated_fm;
+      base_probability[GemsState::kFailing] =
+          sparam->infection_probability_failing_fm;
+    }
+
+    for (int state = 0; state < GemsState::kGemsLast; state++) {
+      for (int inf = 0; inf < PreventionModifier::kPreventionLast; inf++) {
+        for (int sus = 0; sus < PreventionModifier::kPreventionLast; sus++) {
+          // PrEP protects the susceptible partner.
+          double factor = 1.0;
+          if (sus & PreventionModifier::kPrEP) {
+            factor *= 1.0 - sparam->prep_efficacy;
+          }
+          // VMMC only protects a susceptible male.
+          if ((sus & PreventionModifier::kVMMC) &&
+              dir == TransmissionDirection::kFemaleToMale) {
+            factor *= 1.0 - sparam->vmmc_efficacy;
+          }
+          // A condom is used if one of the partners uses condoms.
+          if ((sus | inf) & PreventionModifier::kCondom) {
+            factor *= 1.0 - sparam->condom_efficacy;
+          }
+
+          size_t idx = ComputeIndex(dir, state, inf, sus);
+          double p = base_probability[state] * factor;
+          per_act_[idx] = p;
+          for (int n = 0; n <= kMaxTabulatedActs; n++) {
+            cumulative_[idx * (kMaxTabulatedActs + 1) + n] =
+                1.0 - std::pow(1.0 - p, n);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,110 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#ifndef TRANSMISSION_TABLE_H_
+#define TRANSMISSION_TABLE_H_
+
+#include <cmath>
+#include <vector>
+
+#include "datatypes.h"
+#include "sim-param.h"
+
+namespace bdm {
+namespace hiv_malawi {
+
+// The TransmissionTable stores the effective probability that HIV is
+// transmitted during a (casual or regular) partnership. The probabilities only
+// depend on the direction of the transmission, the GemsState of the infector
+// and the prevention modifiers of both partners. We therefore compute them once
+// for all combinations, such that the mating behaviours only need a single
+// table lookup per contact, independently of the number of active prevention
+// measures.
+class TransmissionTable {
+ public:
+  // Number of acts for which the cumulative probability 1 - (1 - p)^n is
+  // tabulated. Larger (or non-integer) numbers of acts fall back to pow().
+  static constexpr int kMaxTabulatedActs = 64;
+
+  TransmissionTable() = default;
+
+  // Compute the per-act and the cumulative probabilities for all combinations
+  // of (direction, infector state, infector modifiers, susceptible modifiers).
+  void Build(const SimParam* sparam);
+
+  // Returns true if Build() has been called.
+  bool IsBuilt() const { return !per_act_.empty(); }
+
+  // Returns the probability of transmission for a single act.
+  float GetPerActProbability(int direction, int infector_state,
+                             int infector_prevention,
+                             int susceptible_prevention) const {
+    return per_act_[ComputeIndex(direction, infector_state, infector_prevention,
+                                 susceptible_prevention)];
+  }
+
+  // Returns the probability that at least one out of no_acts acts transmits
+  // HIV.
+  float GetProbability(int direction, int infector_state,
+                       int infector_prevention, int susceptible_prevention,
+                       int no_acts) const {
+    if (no_acts <= 0) {
+      return 0.0;
+    }
+    size_t idx = ComputeIndex(direction, infector_state, infector_prevention,
+                              susceptible_prevention);
+    if (no_acts <= kMaxTabulatedActs) {
+      return cumulative_[idx * (kMaxTabulatedActs + 1) + no_acts];
+    }
+    return 1.0 - std::pow(1.0 - per_act_[idx], no_acts);
+  }
+
+  // Same as above for a number of acts that is given as a floating point
+  // number, e.g. the mean number of regular acts.
+  float GetProbability(int direction, int infector_state,
+                       int infector_prevention, int susceptible_prevention,
+                       float no_acts) const {
+    int no_acts_int = static_cast<int>(no_acts);
+    if (static_cast<float>(no_acts_int) == no_acts) {
+      return GetProbability(direction, infector_state, infector_prevention,
+                            susceptible_prevention, no_acts_int);
+    }
+    return 1.0 - std::pow(1.0 - GetPerActProbability(direction, infector_state,
+                                                      infector_prevention,
+                                                      susceptible_prevention),
+                          no_acts);
+  }
+
+ private:
+  // Probability of transmission for a single act, indexed by ComputeIndex.
+  std::vector<float> per_act_;
+  // Probability of transmission for 0, 1, ..., kMaxTabulatedActs acts. The
+  // entries of one combination are stored contiguously.
+  std::vector<float> cumulative_;
+
+  // Mapping from (direction, infector state, infector modifiers, susceptible
+  // modifiers) to the position in per_act_.
+  inline size_t ComputeIndex(int direction, int infector_state,
+                             int infector_prevention,
+                             int susceptible_prevention) const {
+    return susceptible_prevention +
+           PreventionModifier::kPreventionLast *
+               (infector_prevention +
+                PreventionModifier::kPreventionLast *
+                    (infector_state + GemsState::kGemsLast * direction));
+  }
+};
+
+}  // namespace hiv_malawi
+}  // namespace bdm
+
+#endif  // TRANSMISSION_TABLE_H_
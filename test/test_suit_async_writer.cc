@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "async-writer.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test if the jobs are executed in order and if the pending memory is bounded
+TEST(AsyncWriterTest, Order) {
+  AsyncWriter writer(16);
+  std::vector<int> order;
+  uint64_t max_pending = 0;
+  for (int i = 0; i < 100; i++) {
+    writer.Submit([&order, i]() { order.push_back(i); }, 8);
+    max_pending = std::max(max_pending, writer.GetPendingBytes());
+  }
+  writer.Flush();
+  EXPECT_LE(max_pending, 16u);
+  EXPECT_EQ(0u, writer.GetPendingBytes());
+  ASSERT_EQ(100u, order.size());
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(i, order[i]);
+  }
+}
+
+// Test if a writer whose I/O thread was started in the parent executes jobs
+// in a forked process after ResetAfterFork
+TEST(AsyncWriterTest, AfterFork) {
+  AsyncWriter writer;
+  int value = 0;
+  writer.Submit([&value]() { value = 1; }, 0);
+  writer.Flush();
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    writer.ResetAfterFork();
+    writer.Submit([&value]() { value = 2; }, 0);
+    writer.Flush();
+    _exit(value == 2 ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  EXPECT_EQ(1, value);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
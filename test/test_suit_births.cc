@@ -0,0 +1,51 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include "biodynamo.h"
+#include "births.h"
+#include "sim-param.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that every mother of a stratum can be selected, also for a single
+// birth, and that a sample contains no mother twice
+TEST(BirthsTest, SampleIndices) {
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+  auto* random = simulation.GetRandom();
+  std::vector<uint32_t> indices;
+  std::vector<int> no_selected(4, 0);
+  for (uint64_t seed = 1; seed <= 400; seed++) {
+    random->SetSeed(seed);
+    Births::SampleIndices(4, 1, random, &indices);
+    ASSERT_EQ(4u, indices.size());
+    ASSERT_LT(indices[0], 4u);
+    no_selected[indices[0]]++;
+  }
+  for (int count : no_selected) {
+    EXPECT_NEAR(100, count, 40);
+  }
+
+  // All mothers give birth
+  Births::SampleIndices(5, 5, random, &indices);
+  std::sort(indices.begin(), indices.end());
+  EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 3, 4}), indices);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <cstdint>
+#include <vector>
+#include "category-index.h"
+#include "huge-page-allocator.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that the agents are sorted into their categories in the order of the
+// threads that added them, and that the index can be refilled
+TEST(CategoryIndexTest, AddAndFinalize) {
+  CategoryIndex<uint64_t> index;
+  for (int refill = 0; refill < 2; refill++) {
+    index.Clear(5);
+    const uint64_t no_agents = 10000;
+    // Each thread adds a contiguous range of agents, as ForEachAgentParallel
+#pragma omp parallel for schedule(static)
+    for (uint64_t i = 0; i < no_agents; i++) {
+      // Category 2 stays empty
+      size_t category = i % 4 == 2 ? 4 : i % 4;
+      index.AddAgent(i, category);
+    }
+    index.Finalize();
+    ASSERT_EQ(5u, index.GetNumCategories());
+    EXPECT_EQ(no_agents, index.GetNumAgents());
+    EXPECT_EQ(0u, index[2].GetNumAgents());
+    for (size_t c : {0, 1, 3, 4}) {
+      auto agents = index[c];
+      ASSERT_EQ(no_agents / 4, agents.GetNumAgents());
+      for (size_t i = 0; i < agents.GetNumAgents(); i++) {
+        uint64_t expected = 4 * i + (c == 4 ? 2 : c);
+        EXPECT_EQ(expected, agents.GetAgentAtIndex(i));
+      }
+    }
+  }
+  index.Clear(3);
+  index.Finalize();
+  EXPECT_EQ(0u, index.GetNumAgents());
+  EXPECT_EQ(0u, index[1].GetNumAgents());
+}
+
+// Test that the agents of all categories share one buffer, which is backed by
+// huge pages once it is large enough
+TEST(CategoryIndexTest, PooledBuffer) {
+  SetHugePagePolicy("transparent");
+  CategoryIndex<uint64_t> index;
+  index.Clear(1000);
+  for (uint64_t i = 0; i < 1000000; i++) {
+    index.AddAgent(i, i % 1000);
+  }
+  index.Finalize();
+  for (size_t c = 1; c < index.GetNumCategories(); c++) {
+    EXPECT_EQ(index[c - 1].end(), index[c].begin());
+  }
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(index[0].begin()) % kHugePageSize);
+  SetHugePagePolicy("none");
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
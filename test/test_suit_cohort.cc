@@ -0,0 +1,143 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include "biodynamo.h"
+#include "births.h"
+#include "categorical-environment.h"
+#include "cohort-tracker.h"
+#include "person.h"
+#include "sim-param.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test the deterministic selection by uid hash
+TEST(CohortTest, Selection) {
+  size_t no_selected = 0;
+  for (uint64_t uid = 0; uid < 100000; uid++) {
+    bool selected = CohortTracker::IsSelected(uid, 0.1);
+    EXPECT_EQ(selected, CohortTracker::IsSelected(uid, 0.1));
+    no_selected += selected;
+  }
+  EXPECT_NEAR(10000, no_selected, 500);
+  EXPECT_FALSE(CohortTracker::IsSelected(42, 0.0));
+  EXPECT_TRUE(CohortTracker::IsSelected(42, 1.0));
+}
+
+// Test that the cohort ids of children only depend on the mother's id, the
+// year of birth, and the birth order
+TEST(CohortTest, ChildId) {
+  uint64_t id = CohortTracker::GetChildId(42, 1990, 0);
+  EXPECT_EQ(id, CohortTracker::GetChildId(42, 1990, 0));
+  EXPECT_NE(id, CohortTracker::GetChildId(42, 1990, 1));
+  EXPECT_NE(id, CohortTracker::GetChildId(42, 1991, 0));
+  EXPECT_NE(id, CohortTracker::GetChildId(43, 1990, 0));
+  // Children differ from the initial population and from their mothers
+  EXPECT_NE(0u, id >> 63);
+  EXPECT_NE(CohortTracker::GetChildId(id, 2005, 0),
+            CohortTracker::GetChildId(42, 2005, 0));
+}
+
+// Test that compressed children keep the cohort ids given by their birth order
+// when they are expanded
+TEST(CohortTest, CompressedChildId) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+  auto* env = new CategoricalEnvironment(15, 40, 1, 1, 1);
+  simulation.SetEnvironment(env);
+  auto* sparam = simulation.GetParam()->Get<SimParam>();
+  auto* mother = new Person();
+  mother->cohort_id_ = 42;
+  mother->sex_ = Sex::kFemale;
+  mother->location_ = 0;
+
+  // A child of the initial population and two children born in the same year
+  std::vector<int> birth_years = {1955, 1962, 1962};
+  for (int birth_year : birth_years) {
+    ChildRecord record{};
+    record.birth_year_ = birth_year;
+    record.sex_ = Sex::kFemale;
+    record.state_ = GemsState::kHealthy;
+    Births::AddChildRecord(mother, record);
+  }
+  ASSERT_EQ(birth_years.size(), mother->child_records_.size());
+  EXPECT_EQ(3, mother->no_births_);
+
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < birth_years.size(); i++) {
+    auto* child =
+        Births::ExpandChildRecord(mother->child_records_[i], mother->cohort_id_,
+                                  0, 1975, sparam, simulation.GetRandom());
+    EXPECT_EQ(CohortTracker::GetChildId(42, birth_years[i], i),
+              child->cohort_id_);
+    ids.push_back(child->cohort_id_);
+    delete child;
+  }
+  EXPECT_NE(ids[1], ids[2]);
+
+  delete mother;
+}
+
+// Test if only events of tracked agents are written to the file
+TEST(CohortTest, Flush) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+  auto* tracked = new Person();
+  auto* untracked = new Person();
+  for (auto* person : {tracked, untracked}) {
+    person->age_ = 20;
+    person->sex_ = Sex::kFemale;
+    person->state_ = GemsState::kHealthy;
+  }
+  tracked->cohort_id_ = 7;
+
+  std::string filename = "cohort-test-events.bin";
+  {
+    CohortTracker tracker;
+    tracker.Select(tracked, 1.0);
+    tracker.Select(untracked, 0.0);
+    tracker.Record(tracked, CohortEventType::kEventStateChange,
+                   GemsState::kAcute);
+    tracker.Record(untracked, CohortEventType::kEventStateChange,
+                   GemsState::kAcute);
+    tracker.Flush(filename);
+    EXPECT_EQ(2u, tracker.GetNumEvents());
+  }
+
+  std::ifstream file(filename, std::ios::binary);
+  char header[8];
+  file.read(header, 8);
+  EXPECT_EQ("HIVCOH01", std::string(header, 8));
+  CohortEvent events[3];
+  file.read(reinterpret_cast<char*>(events), sizeof(events));
+  ASSERT_EQ(2 * sizeof(CohortEvent), static_cast<size_t>(file.gcount()));
+  EXPECT_EQ(7u, events[0].id_);
+  EXPECT_EQ(CohortEventType::kEventEnter, events[0].type_);
+  EXPECT_EQ(20, events[0].value_);
+  EXPECT_EQ(CohortEventType::kEventStateChange, events[1].type_);
+  EXPECT_EQ(GemsState::kAcute, events[1].value_);
+  std::remove(filename.c_str());
+
+  delete tracked;
+  delete untracked;
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "contact-matrices.h"
+#include "sim-param.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that the contacts are counted by the location, age, and
+// sociobehaviour of both partners, and written for the year in which they
+// were recorded
+TEST(ContactMatricesTest, Flush) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+
+  // 3 locations, 2 age categories, 2 sociobehavioural categories. The
+  // compound category is age + 2 * location + 6 * sb.
+  std::string filename = "contact-matrices-test.csv";
+  {
+    ContactMatrices matrices;
+    EXPECT_FALSE(matrices.IsEnabled());
+    matrices.Record(kCasualContactMixing, 8, 5);
+    matrices.Enable(3, 2, 2);
+    EXPECT_TRUE(matrices.IsEnabled());
+    matrices.Flush(filename, 2000);
+
+    // Location 1, age 0, sb 1 with location 2, age 1, sb 0
+    matrices.Record(kCasualContactMixing, 8, 5);
+    matrices.Record(kCasualContactMixing, 8, 5);
+    // Location 0, age 1, sb 0 with location 0, age 0, sb 1
+    matrices.Record(kRegularContactMixing, 1, 6);
+    matrices.Flush(filename, 2001);
+
+    EXPECT_EQ(2u, matrices.GetTotal(kCasualContactMixing, kLocationMixing, 1,
+                                    2));
+    EXPECT_EQ(2u, matrices.GetTotal(kCasualContactMixing, kAgeMixing, 0, 1));
+    EXPECT_EQ(2u, matrices.GetTotal(kCasualContactMixing,
+                                    kSociobehaviourMixing, 1, 0));
+    EXPECT_EQ(0u, matrices.GetTotal(kMsmContactMixing, kLocationMixing, 1, 2));
+    EXPECT_EQ(1u, matrices.GetTotal(kRegularContactMixing, kAgeMixing, 1, 0));
+    EXPECT_EQ(1u, matrices.GetTotal(kRegularContactMixing,
+                                    kSociobehaviourMixing, 0, 1));
+  }
+
+  std::ifstream file(filename);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    lines.push_back(line);
+  }
+  std::vector<std::string> expected = {
+      "year,type,dimension,row,column,count",
+      "2000,casual,location,1,2,2",
+      "2000,casual,age,0,1,2",
+      "2000,casual,sociobehaviour,1,0,2",
+      "2000,regular,location,0,0,1",
+      "2000,regular,age,1,0,1",
+      "2000,regular,sociobehaviour,0,1,1"};
+  EXPECT_EQ(expected, lines);
+  std::remove(filename.c_str());
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -175,6 +175,34 @@ TEST(CounterTest, Infected) {
  
 }
 
+// Test the exact reduction of the casual partner totals
+TEST(CounterTest, CasualPartnerTotals) {
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+
+  // Add adult low-risk men with 0, ..., 99 casual partners
+  auto* rm = simulation.GetResourceManager();
+  for (int i = 0; i < 100; i++) {
+    auto* p = new Person();
+    p->sex_ = Sex::kMale;
+    p->age_ = 20;
+    p->state_ = GemsState::kHealthy;
+    p->social_behaviour_factor_ = 0;
+    p->no_casual_partners_ = i;
+    rm->AddAgent(p);
+  }
+  simulation.SetEnvironment(new EmptyEnvironment());
+  DefineAndRegisterCollectors();
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+  scheduler->Simulate(1);
+
+  auto* ts = simulation.GetTimeSeries();
+  EXPECT_EQ(4950, ts->GetYValues("total_nocas_men_low_sb")[0]);
+  EXPECT_EQ(49.5, ts->GetYValues("mean_nocas_men_low_sb")[0]);
+}
+
 
 
 }  // namespace hiv_malawi
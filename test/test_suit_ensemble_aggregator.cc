@@ -0,0 +1,117 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "ensemble-aggregator.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test the quantiles of a sketch of 0, 1, ..., 9999 in shuffled order, added
+// directly and merged from ten parts
+TEST(EnsembleAggregatorTest, QuantileSketch) {
+  QuantileSketch sketch;
+  std::vector<QuantileSketch> parts(10);
+  for (int i = 0; i < 10000; i++) {
+    double value = (i * 7919) % 10000;
+    sketch.Add(value);
+    parts[i % 10].Add(value);
+  }
+  QuantileSketch merged;
+  for (const auto& part : parts) {
+    merged.Merge(part);
+  }
+  EXPECT_EQ(10000, merged.GetCount());
+  EXPECT_EQ(0, merged.GetMin());
+  EXPECT_EQ(9999, merged.GetMax());
+  EXPECT_LT(merged.GetCentroids().size(), 200u);
+  for (double q : {0.025, 0.25, 0.5, 0.75, 0.975}) {
+    EXPECT_NEAR(q * 10000, sketch.Quantile(q), 20);
+    EXPECT_NEAR(q * 10000, merged.Quantile(q), 20);
+  }
+  EXPECT_EQ(0, merged.Quantile(0));
+  EXPECT_EQ(9999, merged.Quantile(1));
+}
+
+// Test that the aggregates of two workers, merged through a shared file, have
+// the exact mean and standard deviation of all replicates
+TEST(EnsembleAggregatorTest, MergeThroughFile) {
+  std::string filename = "ensemble-aggregator-test.bin";
+  std::remove(filename.c_str());
+
+  std::vector<double> years = {1960, 1961};
+  for (int worker = 0; worker < 2; worker++) {
+    EnsembleAggregator aggregator;
+    for (int replicate = 0; replicate < 50; replicate++) {
+      double y = worker * 50 + replicate;
+      aggregator.Add("infected_agents", years, {y, 2 * y});
+    }
+    ASSERT_TRUE(aggregator.AddToFile(filename));
+  }
+
+  EnsembleAggregator aggregator;
+  ASSERT_TRUE(aggregator.Read(filename));
+  std::remove(filename.c_str());
+  ASSERT_EQ(1u, aggregator.GetIds().size());
+  auto bands = aggregator.GetBands("infected_agents", {0.5});
+  ASSERT_EQ(2u, bands.size());
+  // Values 0, 1, ..., 99 and 0, 2, ..., 198
+  EXPECT_EQ(1960, bands[0].x);
+  EXPECT_EQ(100u, bands[0].count);
+  EXPECT_DOUBLE_EQ(49.5, bands[0].mean);
+  EXPECT_NEAR(29.011, bands[0].stddev, 1e-3);
+  EXPECT_NEAR(49.5, bands[0].quantiles[0], 1);
+  EXPECT_EQ(1961, bands[1].x);
+  EXPECT_DOUBLE_EQ(99, bands[1].mean);
+  EXPECT_NEAR(58.023, bands[1].stddev, 1e-3);
+}
+
+// Test that non-finite values are skipped and counted, also across merges
+TEST(EnsembleAggregatorTest, NonFiniteValues) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double inf = std::numeric_limits<double>::infinity();
+  EnsembleAggregator aggregator;
+  aggregator.Add("prevalence", {2000}, {0.1});
+  aggregator.Add("prevalence", {2000}, {nan});
+  aggregator.Add("prevalence", {2000}, {0.3});
+  EnsembleAggregator other;
+  other.Add("prevalence", {2000}, {inf});
+  ASSERT_TRUE(aggregator.Deserialize(other.Serialize()));
+
+  auto bands = aggregator.GetBands("prevalence", {0, 1});
+  ASSERT_EQ(1u, bands.size());
+  EXPECT_EQ(2u, bands[0].count);
+  EXPECT_EQ(2u, bands[0].no_non_finite);
+  EXPECT_DOUBLE_EQ(0.2, bands[0].mean);
+  EXPECT_DOUBLE_EQ(0.1, bands[0].quantiles[0]);
+  EXPECT_DOUBLE_EQ(0.3, bands[0].quantiles[1]);
+
+  std::string filename = "ensemble-bands-test.csv";
+  ASSERT_TRUE(aggregator.WriteBands(filename, {0.5}));
+  std::ifstream file(filename);
+  std::string header, line;
+  std::getline(file, header);
+  std::getline(file, line);
+  EXPECT_EQ("id,x,count,non_finite,mean,stddev,q0.5", header);
+  EXPECT_EQ(0u, line.find("prevalence,2000,2,2,0.2,"));
+  std::remove(filename.c_str());
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
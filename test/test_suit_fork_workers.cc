@@ -0,0 +1,91 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "ensemble-aggregator.h"
+#include "fork-replicates.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Stand-in for the simulation of a replicate: a time series drawn with the
+// seed of the replicate, as after Reseed()
+static std::string SimulateReplicate(uint64_t seed, uint64_t replicate) {
+  std::mt19937_64 rng(seed + replicate);
+  std::uniform_real_distribution<double> uniform;
+  std::vector<double> x_values, y_values;
+  for (int year = 1960; year < 1990; year++) {
+    x_values.push_back(year);
+    y_values.push_back(uniform(rng));
+  }
+  EnsembleAggregator aggregator;
+  aggregator.Add("prevalence", x_values, y_values);
+  return aggregator.Serialize();
+}
+
+// Merges the results of the tasks as ForkReplicates
+static uint64_t RunReplicates(uint64_t seed, uint64_t no_workers,
+                              EnsembleAggregator* aggregator,
+                              std::vector<uint64_t>* finished) {
+  auto run = [seed](uint64_t replicate) {
+    return SimulateReplicate(seed, replicate);
+  };
+  auto merge = [&](uint64_t replicate, const std::string& data) {
+    finished->push_back(replicate);
+    EXPECT_TRUE(aggregator->Deserialize(data));
+  };
+  return ForkWorkers(8, no_workers, run, merge);
+}
+
+// Test that the same seed yields identical aggregates, independent of the
+// number of workers and of the order in which they finish
+TEST(ForkWorkersTest, SameSeed) {
+  EnsembleAggregator serial, parallel, other_seed;
+  std::vector<uint64_t> serial_finished, parallel_finished, other_finished;
+  EXPECT_EQ(0u, RunReplicates(1, 1, &serial, &serial_finished));
+  EXPECT_EQ(0u, RunReplicates(1, 3, &parallel, &parallel_finished));
+  EXPECT_EQ(0u, RunReplicates(2, 3, &other_seed, &other_finished));
+
+  std::vector<uint64_t> expected = {0, 1, 2, 3, 4, 5, 6, 7};
+  EXPECT_EQ(expected, serial_finished);
+  EXPECT_EQ(expected, parallel_finished);
+  EXPECT_EQ(serial.Serialize(), parallel.Serialize());
+  EXPECT_NE(serial.Serialize(), other_seed.Serialize());
+}
+
+// Test that a worker that crashes is counted as failed, and that the other
+// tasks finish
+TEST(ForkWorkersTest, CrashedWorker) {
+  auto run = [](uint64_t task) {
+    if (task == 1) {
+      std::abort();
+    }
+    return std::string("task ") + std::to_string(task);
+  };
+  std::vector<std::string> results;
+  auto finish = [&](uint64_t task, const std::string& data) {
+    EXPECT_EQ(results.size(), task);
+    results.push_back(data);
+  };
+  EXPECT_EQ(1u, ForkWorkers(3, 2, run, finish));
+  std::vector<std::string> expected = {"task 0", "", "task 2"};
+  EXPECT_EQ(expected, results);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
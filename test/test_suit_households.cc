@@ -0,0 +1,89 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "household-table.h"
+#include "partnership-intents.h"
+#include "person.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test if the households are stored contiguously and if a household moves as a
+// whole when its head's partner migrates
+TEST(HouseholdTest, RelocateHousehold) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* man = new Person();
+  auto* woman = new Person();
+  auto* child = new Person();
+  auto* single = new Person();
+  auto* orphan = new Person();
+  man->sex_ = Sex::kMale;
+  man->age_ = 30;
+  man->state_ = GemsState::kChronic;
+  woman->sex_ = Sex::kFemale;
+  woman->age_ = 28;
+  child->sex_ = Sex::kFemale;
+  child->age_ = 5;
+  single->sex_ = Sex::kMale;
+  single->age_ = 40;
+  orphan->sex_ = Sex::kMale;
+  orphan->age_ = 10;
+  for (auto* person : {man, woman, child, single, orphan}) {
+    if (person != man) {
+      person->state_ = GemsState::kHealthy;
+    }
+    person->location_ = 0;
+    rm->AddAgent(person);
+  }
+  man->SetPartner(woman->GetAgentPtr<Person>());
+  woman->AddChild(child->GetAgentPtr<Person>());
+  child->mother_ = woman->GetAgentPtr<Person>();
+
+  HouseholdTable households;
+  households.Clear();
+  households.AddMember(woman, man);
+  households.AddMember(woman, woman);
+  households.AddMember(woman, child);
+  households.AddMember(single, single);
+  households.AddMember(orphan, orphan);
+  households.Build();
+
+  EXPECT_EQ(3u, households.GetNumHouseholds());
+  EXPECT_EQ(woman->household_, man->household_);
+  EXPECT_EQ(woman->household_, child->household_);
+  EXPECT_EQ(3u, households.GetHouseholdSize(woman->household_));
+  EXPECT_EQ(1u, households.GetHouseholdSize(single->household_));
+
+  const auto& statistics = households.GetStatistics();
+  EXPECT_DOUBLE_EQ(5.0 / 3.0, statistics.mean_household_size);
+  EXPECT_EQ(1u, statistics.no_serodiscordant_households);
+  EXPECT_EQ(1u, statistics.no_orphans);
+
+  // The man migrates, his household follows him
+  PartnershipIntents intents;
+  intents.SetHouseholds(&households);
+  man->location_ = 3;
+  intents.AddRelocation(man, 3);
+  intents.Resolve();
+
+  EXPECT_EQ(3, woman->location_);
+  EXPECT_EQ(3, child->location_);
+  EXPECT_EQ(0, single->location_);
+  EXPECT_EQ(0, orphan->location_);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
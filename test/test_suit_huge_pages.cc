@@ -0,0 +1,42 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+#include "huge-page-allocator.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that vectors keep their contents when they grow from small buffers to
+// huge pages, and that the large buffers are aligned to huge pages, for all
+// policies. The hugetlbfs policy falls back if no pool is configured.
+TEST(HugePageAllocatorTest, GrowAcrossThreshold) {
+  for (auto* name : {"none", "transparent", "hugetlbfs"}) {
+    SetHugePagePolicy(name);
+    std::vector<uint64_t, HugePageAllocator<uint64_t>> values;
+    for (uint64_t i = 0; i < 1000000; i++) {
+      values.push_back(i);
+    }
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(values.data()) % kHugePageSize);
+    for (uint64_t i = 0; i < values.size(); i += 997) {
+      EXPECT_EQ(i, values[i]);
+    }
+  }
+  SetHugePagePolicy("none");
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,161 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "compiled-params.h"
+#include "parameter-tables.h"
+#include "sim-param.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test the conversion of CSV and JSON tables and the mapped access
+TEST(ParameterTablesTest, Conversion) {
+  {
+    std::ofstream csv("param-test.csv");
+    csv << "1,2,3\n4,5,6\n\n7,8,9\n10,11,12\n";
+    std::ofstream json("param-test.json");
+    json << "{\"bdm::hiv_malawi::SimParam\": {\"initial_prevalence\": 0.1, "
+            "\"hiv_mortality_rate\": [0.0, 0.5, 1e-1], "
+            "\"age_mixing_matrix\": [[1, 2], [3, 4]], "
+            "\"ragged\": [[1], [2, 3]], \"name\": \"x\"}}";
+  }
+  std::vector<ParameterTable> tables(1);
+  ASSERT_TRUE(ParameterTables::ReadCsv("param-test.csv", "migration_matrix",
+                                       &tables[0]));
+  EXPECT_EQ(std::vector<uint32_t>({2, 2, 3}), tables[0].dims);
+  ASSERT_TRUE(ParameterTables::ReadJson("param-test.json", &tables));
+  ASSERT_EQ(3u, tables.size());
+  ASSERT_TRUE(ParameterTables::Write("param-test.bin", tables));
+
+  ParameterTables mapped;
+  ASSERT_TRUE(mapped.Open("param-test.bin"));
+  std::vector<uint32_t> dims;
+  const float* data = mapped.Get("migration_matrix", &dims);
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(std::vector<uint32_t>({2, 2, 3}), dims);
+  EXPECT_EQ(12.0f, data[11]);
+  data = mapped.Get("hiv_mortality_rate", &dims);
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(std::vector<uint32_t>({3}), dims);
+  EXPECT_FLOAT_EQ(0.1f, data[2]);
+  EXPECT_EQ(nullptr, mapped.Get("ragged", &dims));
+
+  // Replace the one-dimensional SimParam members
+  SimParam sparam;
+  sparam.parameter_table_file = "param-test.bin";
+  sparam.LoadParameterTables();
+  EXPECT_FLOAT_EQ(0.5f, sparam.hiv_mortality_rate[1]);
+
+  for (auto* file : {"param-test.csv", "param-test.json", "param-test.bin"}) {
+    std::remove(file);
+  }
+}
+
+// Test the lookups of the compiled default parameters
+TEST(ParameterTablesTest, CompiledParams) {
+  SimParam sparam;
+  CompiledParams params;
+  params.Compile(&sparam);
+  ASSERT_TRUE(params.IsCompiled());
+
+  EXPECT_EQ(sparam.mortality_rate_by_age[0], params.GetAgeMortality(14.5));
+  EXPECT_EQ(sparam.mortality_rate_by_age[1], params.GetAgeMortality(15));
+  EXPECT_EQ(sparam.mortality_rate_by_age.back(), params.GetAgeMortality(200));
+  EXPECT_EQ(sparam.hiv_mortality_rate[GemsState::kTreated],
+            params.GetHivMortality(GemsState::kTreated));
+  for (int i = 0; i < GemsState::kGemsLast; i++) {
+    EXPECT_EQ(sparam.hiv_transition_matrix[GemsState::kChronic][1][i],
+              params.GetHivTransition(GemsState::kChronic, 1)[i]);
+  }
+  EXPECT_EQ(sparam.sociobehaviour_transition_matrix[1][Sex::kFemale][0],
+            params.GetLowRiskProbability(1, Sex::kFemale));
+  EXPECT_EQ(sparam.location_mixing_matrix[3][3],
+            params.GetLocationMixing(3, 3));
+  EXPECT_EQ(sparam.migration_matrix[0][2][5], params.GetMigration(0, 2, 5));
+}
+
+// Test that the compiled parameters read the matrices of the parameter table
+// file
+TEST(ParameterTablesTest, CompiledMappedTables) {
+  SimParam sparam;
+  uint32_t no_ages = sparam.nb_age_categories;
+  uint32_t no_locations = sparam.nb_locations;
+  uint32_t no_periods = sparam.migration_year_transition.size();
+  std::vector<ParameterTable> tables(2);
+  tables[0].name = "age_mixing_matrix";
+  tables[0].dims = {no_ages, no_ages};
+  for (uint32_t i = 0; i < no_ages * no_ages; i++) {
+    tables[0].data.push_back(i);
+  }
+  tables[1].name = "migration_matrix";
+  tables[1].dims = {no_periods, no_locations, no_locations};
+  tables[1].data.assign(no_periods * no_locations * no_locations, 0.5);
+  ASSERT_TRUE(ParameterTables::Write("param-compiled-test.bin", tables));
+
+  sparam.parameter_table_file = "param-compiled-test.bin";
+  sparam.LoadParameterTables();
+  CompiledParams params;
+  params.Compile(&sparam);
+  // The file may be removed while it is mapped
+  std::remove("param-compiled-test.bin");
+  EXPECT_EQ(static_cast<float>(no_ages + 2), params.GetAgeMixing(1, 2));
+  EXPECT_EQ(0.5f, params.GetMigration(no_periods - 1, 0, 1));
+  // Tables that are not in the file are taken from the SimParam
+  EXPECT_EQ(sparam.location_mixing_matrix[3][3],
+            params.GetLocationMixing(3, 3));
+}
+
+// Test the year blocks of the timeline and the overrides of a timeline file
+TEST(ParameterTablesTest, Timeline) {
+  {
+    std::ofstream csv("timeline-test.csv");
+    csv << "# year,parameter,value[,index]\n"
+        << "2005,prep_probability,0.25\n"
+        << "2010,no_mates_mean,7,1\n";
+  }
+  SimParam sparam;
+  sparam.timeline_file = "timeline-test.csv";
+  CompiledParams params;
+  params.Compile(&sparam);
+
+  const auto& y1990 = params.GetYearParams(1990);
+  EXPECT_EQ(1990, y1990.year);
+  EXPECT_EQ(0, y1990.art_era);
+  EXPECT_EQ(0.0f, y1990.prep_probability);
+  EXPECT_EQ(sparam.no_regular_acts_mean[0], y1990.no_regular_acts_mean);
+  EXPECT_EQ(sparam.no_regular_acts_mean.back(),
+            params.GetYearParams(2015).no_regular_acts_mean);
+
+  EXPECT_EQ(0.25f, params.GetYearParams(2005).prep_probability);
+  EXPECT_EQ(1, params.GetYearParams(2005).art_era);
+  EXPECT_NE(7.0f, params.GetYearParams(2009).no_mates_mean[1]);
+  EXPECT_EQ(7.0f, params.GetYearParams(2010).no_mates_mean[1]);
+  EXPECT_EQ(2, params.GetYearParams(2011).art_era);
+  // Years outside of the simulation are clamped
+  EXPECT_EQ(sparam.start_year, params.GetYearParams(1900).year);
+
+  // Population categories of the hiv_transition_matrix
+  EXPECT_EQ(0, CompiledParams::GetPopulationCategory(0, Sex::kFemale, 20));
+  EXPECT_EQ(1, CompiledParams::GetPopulationCategory(1, Sex::kFemale, 20));
+  EXPECT_EQ(5, CompiledParams::GetPopulationCategory(2, Sex::kMale, 3));
+  EXPECT_EQ(6, CompiledParams::GetPopulationCategory(2, Sex::kFemale, 45));
+
+  std::remove("timeline-test.csv");
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
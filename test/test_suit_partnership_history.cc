@@ -0,0 +1,208 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include "partner-notification.h"
+#include "partnership-history.h"
+#include "partnership-intents.h"
+#include "person.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test the ring buffer, the lifetime counter, and the slot recycling
+TEST(PartnershipHistoryTest, RingBuffer) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* a = new Person();
+  auto* b = new Person();
+  auto* c = new Person();
+  a->sex_ = Sex::kMale;
+  a->age_ = 30;
+  b->sex_ = Sex::kFemale;
+  b->age_ = 25;
+  c->sex_ = Sex::kFemale;
+  c->age_ = 20;
+  rm->AddAgent(a);
+  rm->AddAgent(b);
+  rm->AddAgent(c);
+
+  PartnershipHistory history;
+  history.Initialize(2, "");
+  history.Record(a, b, TransmissionType::kCasualPartner, 2000);
+  history.Record(a, c, TransmissionType::kRegularPartner, 2001);
+  history.Record(a, b, TransmissionType::kCasualPartner, 2002);
+
+  // The oldest partnership of a was overwritten. The repeated partnership
+  // with b is not counted again.
+  EXPECT_EQ(2u, history.GetLifetimePartners(a->history_slot_));
+  EXPECT_EQ(2u, history.GetNumRecords(a->history_slot_));
+  EXPECT_EQ(1u, history.GetLifetimePartners(b->history_slot_));
+  EXPECT_EQ(1u, history.GetLifetimePartners(c->history_slot_));
+
+  // Most recent record first
+  const auto& last = history.GetRecord(a->history_slot_, 0);
+  EXPECT_EQ(2002, last.start_year_);
+  EXPECT_EQ(static_cast<uint64_t>(b->GetUid()), last.partner_uid_);
+  EXPECT_TRUE(history.GetPartner(last) == b->GetAgentPtr<Person>());
+  const auto& regular = history.GetRecord(a->history_slot_, 1);
+  EXPECT_EQ(TransmissionType::kRegularPartner, regular.type_);
+  EXPECT_EQ(-10, regular.age_gap_);
+
+  // After the death of c, the record no longer resolves to an agent
+  history.Release(c->history_slot_);
+  EXPECT_TRUE(history.GetPartner(regular) == nullptr);
+  EXPECT_EQ(2u, history.GetNumActiveSlots());
+
+  // Statistics for a and b: a has a mean regular age gap of -10, and both had
+  // a single partner in 2002
+  const auto& statistics = history.GetStatistics(2002);
+  EXPECT_EQ(2u, statistics.no_agents);
+  EXPECT_DOUBLE_EQ(1.5, statistics.mean_lifetime_partners);
+  EXPECT_DOUBLE_EQ(0.0, statistics.concurrency_prevalence);
+  EXPECT_DOUBLE_EQ(-10.0, statistics.mean_regular_age_gap);
+}
+
+// Test that a casual contact is recorded in the history of the mate if the
+// male died in the same step
+TEST(PartnershipHistoryTest, DeceasedPartner) {
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* male = new Person();
+  auto* female = new Person();
+  male->sex_ = Sex::kMale;
+  male->age_ = 40;
+  female->sex_ = Sex::kFemale;
+  female->age_ = 25;
+  rm->AddAgent(male);
+  rm->AddAgent(female);
+
+  PartnershipHistory history;
+  history.Initialize(4, "");
+  PartnershipIntents intents;
+  intents.SetHistory(&history);
+  intents.AddCasualContact(male, female->GetAgentPtr<Person>(),
+                           GemsState::kHealthy, 0);
+  intents.AddDeath(male);
+  intents.Resolve();
+
+  ASSERT_EQ(1u, history.GetNumRecords(female->history_slot_));
+  EXPECT_EQ(1u, history.GetLifetimePartners(female->history_slot_));
+  const auto& record = history.GetRecord(female->history_slot_, 0);
+  EXPECT_EQ(static_cast<uint64_t>(male->GetUid()), record.partner_uid_);
+  EXPECT_EQ(TransmissionType::kCasualPartner, record.type_);
+  EXPECT_EQ(15, record.age_gap_);
+  EXPECT_TRUE(history.GetPartner(record) == nullptr);
+  EXPECT_EQ(1, female->no_casual_partners_);
+}
+
+// Test if the partners of an index case are traced and start treatment
+TEST(PartnershipHistoryTest, PartnerNotification) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  auto* index = new Person();
+  auto* infected = new Person();
+  auto* healthy = new Person();
+  auto* old = new Person();
+  for (auto* person : {index, infected, healthy, old}) {
+    person->age_ = 30;
+    person->state_ = GemsState::kHealthy;
+    rm->AddAgent(person);
+  }
+  index->state_ = GemsState::kTreated;
+  infected->state_ = GemsState::kChronic;
+  old->state_ = GemsState::kChronic;
+
+  PartnershipHistory history;
+  history.Initialize(4, "");
+  history.Record(index, old, TransmissionType::kCasualPartner, 2000);
+  history.Record(index, healthy, TransmissionType::kCasualPartner, 2001);
+  history.Record(index, infected, TransmissionType::kCasualPartner, 2002);
+  history.Record(index, infected, TransmissionType::kCasualPartner, 2003);
+
+  SimParam sparam;
+  sparam.partner_notification_no_partners = 2;
+  sparam.partner_notification_success = 1.0;
+  sparam.partner_notification_art_uptake = 1.0;
+  sparam.partner_notification_prep_uptake = 1.0;
+
+  PartnerNotification notification;
+  notification.AddIndexCase(index, history);
+  notification.Trace(&history, &sparam, simulation.GetRandom());
+
+  // Only the two most recent distinct partners are traced
+  EXPECT_EQ(1u, notification.GetNumIndexCases());
+  EXPECT_EQ(2u, notification.GetNumNotified());
+  EXPECT_EQ(1u, notification.GetNumTreated());
+  EXPECT_TRUE(infected->IsTreated());
+  EXPECT_TRUE(healthy->prevention_ & PreventionModifier::kPrEP);
+  EXPECT_TRUE(old->IsChronic());
+}
+
+// Test that the partners of notified partners are traced up to the given
+// number of generations, and that every agent is notified at most once
+TEST(PartnershipHistoryTest, PartnerNotificationDepth) {
+  Simulation simulation(TEST_NAME);
+  auto* rm = simulation.GetResourceManager();
+  // Chain index - first - second - third, and first - index again
+  auto* index = new Person();
+  auto* first = new Person();
+  auto* second = new Person();
+  auto* third = new Person();
+  for (auto* person : {index, first, second, third}) {
+    person->age_ = 30;
+    person->state_ = GemsState::kChronic;
+    rm->AddAgent(person);
+  }
+  index->state_ = GemsState::kTreated;
+
+  PartnershipHistory history;
+  history.Initialize(4, "");
+  history.Record(index, first, TransmissionType::kCasualPartner, 2000);
+  history.Record(first, second, TransmissionType::kCasualPartner, 2001);
+  history.Record(second, third, TransmissionType::kCasualPartner, 2002);
+  history.Record(first, index, TransmissionType::kCasualPartner, 2003);
+
+  SimParam sparam;
+  sparam.partner_notification_no_partners = 2;
+  sparam.partner_notification_success = 1.0;
+  sparam.partner_notification_art_uptake = 1.0;
+
+  // Depth 1: only the partners of the index case
+  PartnerNotification notification;
+  sparam.partner_notification_depth = 1;
+  notification.AddIndexCase(index, history);
+  notification.Trace(&history, &sparam, simulation.GetRandom());
+  EXPECT_EQ(1u, notification.GetNumNotified());
+  EXPECT_EQ(1u, notification.GetNumTreated());
+  EXPECT_TRUE(first->IsTreated());
+  EXPECT_TRUE(second->IsChronic());
+
+  // Depth 2: also the partners of first, but not index again
+  first->state_ = GemsState::kChronic;
+  sparam.partner_notification_depth = 2;
+  notification.AddIndexCase(index, history);
+  notification.Trace(&history, &sparam, simulation.GetRandom());
+  EXPECT_EQ(1u, notification.GetNumIndexCases());
+  EXPECT_EQ(2u, notification.GetNumNotified());
+  EXPECT_EQ(2u, notification.GetNumTreated());
+  EXPECT_TRUE(first->IsTreated());
+  EXPECT_TRUE(second->IsTreated());
+  EXPECT_TRUE(third->IsChronic());
+  EXPECT_TRUE(index->IsTreated());
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
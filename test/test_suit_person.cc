@@ -11,6 +11,9 @@
 // -----------------------------------------------------------------------------
 
 #include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "categorical-environment.h"
 #include "person.h"
 
 #define TEST_NAME typeid(*this).name()
@@ -156,5 +159,46 @@ TEST(PersonTest, State) {
   EXPECT_TRUE(person.IsFailing());
 }
 
+// Test the compound category that is cached in each person
+TEST(PersonTest, CompoundCategory) {
+  Simulation simulation(TEST_NAME);
+  // 3 age categories, 2 locations, 2 socio-behavioural categories
+  CategoricalEnvironment env(15, 40, 3, 2, 2);
+  auto person = Person();
+  EXPECT_EQ(-1, person.compound_category_);
+
+  person.age_ = 27;
+  person.location_ = 1;
+  person.social_behaviour_factor_ = 1;
+  env.UpdateCompoundCategory(&person);
+  EXPECT_EQ(11, person.compound_category_);
+  EXPECT_EQ(2u, env.ComputeAgeFromCompoundIndex(person.compound_category_));
+  EXPECT_EQ(1u,
+            env.ComputeLocationFromCompoundIndex(person.compound_category_));
+
+  // Relocation
+  person.age_ = 20;
+  person.location_ = 0;
+  env.UpdateCompoundCategory(&person);
+  EXPECT_EQ(7, person.compound_category_);
+
+  // Younger than min_age
+  person.age_ = 10;
+  env.UpdateCompoundCategory(&person);
+  EXPECT_EQ(-1, person.compound_category_);
+}
+
+// Test that categories are sampled from unnormalised cumulative weights and
+// that categories without weight are never selected
+TEST(PersonTest, SampleCumulative) {
+  // Weights 0, 2, 0, 1, 0
+  std::vector<float> cumulative = {0, 2, 2, 3, 3};
+  EXPECT_EQ(1u, CategoricalEnvironment::SampleCumulative(0.0, cumulative));
+  EXPECT_EQ(1u, CategoricalEnvironment::SampleCumulative(0.6, cumulative));
+  EXPECT_EQ(3u, CategoricalEnvironment::SampleCumulative(0.7, cumulative));
+  EXPECT_EQ(3u, CategoricalEnvironment::SampleCumulative(
+                    std::nextafter(1.0, 0.0), cumulative));
+}
+
 }  // namespace hiv_malawi
 }  // namespace bdm
@@ -0,0 +1,161 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <omp.h>
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+#include "regular-matching.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that leftover men are matched with women of the next preferred age
+// category, and that the result does not depend on the order of the queues.
+TEST(RegularMatchingTest, AlternativeAgeCategories) {
+  // One location, one socio-behavioural category, three age categories. Men
+  // of age category 0 prefer 0, then 1, and never 2.
+  std::vector<float> age_mixing{0.6, 0.4, 0.0,  //
+                                0.3, 0.4, 0.3,  //
+                                0.0, 0.4, 0.6};
+  // Four men select category 0, one woman in category 0, two in category 1,
+  // and five in category 2.
+  std::vector<std::vector<MatchingSingle>> men(3), women(3);
+  for (uint32_t i = 0; i < 4; i++) {
+    men[0].push_back({100 + i, i, 0});
+  }
+  women[0].push_back({200, 0, 0});
+  women[1].push_back({201, 0, 1});
+  women[1].push_back({202, 1, 1});
+  for (uint32_t i = 0; i < 5; i++) {
+    women[2].push_back({300 + i, i, 2});
+  }
+  auto men_reversed = men;
+  std::reverse(men_reversed[0].begin(), men_reversed[0].end());
+  auto women_copy = women;
+
+  RegularMatching matching;
+  matching.SetAgePreferences(3, age_mixing);
+
+  // Only within the category
+  std::vector<MatchingPair> pairs;
+  matching.Match(&men, &women, 0, 42, &pairs);
+  EXPECT_EQ(1u, pairs.size());
+
+  // With alternative categories. The last man is not matched since he does
+  // not accept women of category 2.
+  men_reversed.swap(men);
+  matching.Match(&men, &women_copy, 3, 42, &pairs);
+  ASSERT_EQ(3u, pairs.size());
+  EXPECT_EQ(1u, matching.GetMatchesPerRound()[0]);
+  EXPECT_EQ(2u, matching.GetMatchesPerRound()[1]);
+  EXPECT_EQ(0u, matching.GetMatchesPerRound()[2]);
+  EXPECT_EQ(0u, pairs[0].woman_category);
+  EXPECT_EQ(1u, pairs[1].woman_category);
+  EXPECT_EQ(1u, pairs[2].woman_category);
+
+  // Same result for a different order of the queues
+  std::vector<MatchingPair> pairs_reversed;
+  men_reversed.swap(men);
+  for (auto& q : women) {
+    std::reverse(q.begin(), q.end());
+  }
+  matching.Match(&men, &women, 3, 42, &pairs_reversed);
+  ASSERT_EQ(pairs.size(), pairs_reversed.size());
+  for (size_t i = 0; i < pairs.size(); i++) {
+    EXPECT_EQ(pairs[i].man_category, pairs_reversed[i].man_category);
+    EXPECT_EQ(pairs[i].man_index, pairs_reversed[i].man_index);
+    EXPECT_EQ(pairs[i].woman_category, pairs_reversed[i].woman_category);
+    EXPECT_EQ(pairs[i].woman_index, pairs_reversed[i].woman_index);
+  }
+}
+
+// Returns the keys of the partners of each pair, in the order of the pairs
+static std::vector<std::pair<uint64_t, uint64_t>> MatchKeys(
+    RegularMatching* matching, std::vector<std::vector<MatchingSingle>> men,
+    std::vector<std::vector<MatchingSingle>> women, int no_threads) {
+  // The positions in the queues of the caller index the keys
+  auto index_keys = [](std::vector<std::vector<MatchingSingle>>* queues) {
+    std::vector<std::vector<uint64_t>> keys(queues->size());
+    for (size_t c = 0; c < queues->size(); c++) {
+      for (auto& single : (*queues)[c]) {
+        single.index = keys[c].size();
+        keys[c].push_back(single.key);
+      }
+    }
+    return keys;
+  };
+  auto man_keys = index_keys(&men);
+  auto woman_keys = index_keys(&women);
+  int max_threads = omp_get_max_threads();
+  omp_set_num_threads(no_threads);
+  std::vector<MatchingPair> pairs;
+  matching->Match(&men, &women, 3, 7, &pairs);
+  omp_set_num_threads(max_threads);
+  std::vector<std::pair<uint64_t, uint64_t>> keys;
+  for (const auto& pair : pairs) {
+    keys.emplace_back(man_keys[pair.man_category][pair.man_index],
+                      woman_keys[pair.woman_category][pair.woman_index]);
+  }
+  return keys;
+}
+
+// Test that the partner categories and the pairs do not depend on the number
+// of threads nor on the order in which the parallel loops filled the queues
+TEST(RegularMatchingTest, ThreadIndependence) {
+  // Two locations, three age categories
+  const uint32_t no_age_categories = 3;
+  const uint32_t no_categories = 2 * no_age_categories;
+  std::vector<float> age_mixing{0.6, 0.4, 0.0,  //
+                                0.3, 0.4, 0.3,  //
+                                0.0, 0.4, 0.6};
+  // Men select the category of their partner with GetUniform()
+  std::vector<std::vector<MatchingSingle>> men(no_categories),
+      women(no_categories);
+  for (uint64_t key = 0; key < 600; key++) {
+    uint32_t age = key % no_age_categories;
+    uint32_t location = (key / no_age_categories) % 2;
+    double u = RegularMatching::GetUniform(11, key);
+    EXPECT_EQ(u, RegularMatching::GetUniform(11, key));
+    EXPECT_LE(0.0, u);
+    EXPECT_LT(u, 1.0);
+    uint32_t target = location * no_age_categories +
+                      static_cast<uint32_t>(u * no_age_categories);
+    if (key % 5 < 2) {
+      women[location * no_age_categories + age].push_back({key, 0, age});
+    } else {
+      men[target].push_back({key, 0, age});
+    }
+  }
+
+  RegularMatching matching;
+  matching.SetAgePreferences(no_age_categories, age_mixing);
+  auto serial = MatchKeys(&matching, men, women, 1);
+  EXPECT_LT(100u, serial.size());
+
+  // Queues filled in a different order, as by another thread schedule
+  std::mt19937_64 rng(3);
+  for (auto* queues : {&men, &women}) {
+    for (auto& queue : *queues) {
+      std::shuffle(queue.begin(), queue.end(), rng);
+    }
+  }
+  auto parallel = MatchKeys(&matching, men, women, 4);
+  EXPECT_EQ(serial, parallel);
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
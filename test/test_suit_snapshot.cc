@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "async-writer.h"
+#include "population-snapshot.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test if the snapshots are read back unchanged and if row groups outside of
+// the predicates are skipped
+TEST(SnapshotTest, RoundTripAndPushdown) {
+  std::string filename = "snapshot-test.bin";
+  AsyncWriter async_writer;
+  {
+    SnapshotWriter writer;
+    ASSERT_TRUE(writer.Open(filename, 10, &async_writer));
+    for (int year = 1960; year < 1962; year++) {
+      std::vector<SnapshotRow> rows;
+      for (int64_t uid = 99; uid >= 0; uid--) {
+        SnapshotRow row;
+        row.values[kColumnUid] = uid;
+        row.values[kColumnAge] = uid % 60;
+        row.values[kColumnSex] = uid % 2;
+        row.values[kColumnLocation] = uid / 10;
+        row.values[kColumnState] = year - 1960;
+        row.values[kColumnSocioBehaviour] = 0;
+        row.values[kColumnPartnerUid] = uid % 3 == 0 ? -1 : 1000 + uid;
+        row.values[kColumnMotherUid] = -1;
+        row.values[kColumnTransmissionType] = -1;
+        rows.push_back(row);
+      }
+      writer.Write(year, std::move(rows));
+    }
+  }
+
+  SnapshotReader reader;
+  ASSERT_TRUE(reader.Open(filename));
+  EXPECT_EQ(std::vector<int>({1960, 1961}), reader.GetYears());
+
+  // Full scan
+  int64_t uid_sum = 0;
+  size_t no_rows = reader.Scan(1961, {}, [&](const SnapshotRow& row) {
+    uid_sum += row.values[kColumnUid];
+    EXPECT_EQ(1, row.values[kColumnState]);
+    EXPECT_EQ(row.values[kColumnUid] % 3 == 0 ? -1
+                                              : 1000 + row.values[kColumnUid],
+              row.values[kColumnPartnerUid]);
+  });
+  EXPECT_EQ(100u, no_rows);
+  EXPECT_EQ(4950, uid_sum);
+  EXPECT_EQ(10u, reader.GetNumRowGroupsRead());
+
+  // Rows are sorted by location, hence only two row groups intersect the
+  // predicate on the location
+  std::vector<SnapshotPredicate> predicates{{kColumnLocation, 3, 4},
+                                            {kColumnSex, 1, 1}};
+  no_rows = reader.Scan(1960, predicates, [](const SnapshotRow& row) {
+    EXPECT_GE(row.values[kColumnLocation], 3);
+    EXPECT_LE(row.values[kColumnLocation], 4);
+    EXPECT_EQ(1, row.values[kColumnSex]);
+  });
+  EXPECT_EQ(10u, no_rows);
+  EXPECT_EQ(2u, reader.GetNumRowGroupsRead());
+  EXPECT_EQ(8u, reader.GetNumRowGroupsSkipped());
+
+  std::remove(filename.c_str());
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
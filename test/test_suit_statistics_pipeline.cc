@@ -0,0 +1,126 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include "statistics-pipeline.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Returns the index of the hot statistic with the given id
+static size_t GetIndex(const StatisticsPipeline& pipeline, const char* id) {
+  for (size_t i = 0; i < pipeline.GetNumStatistics(); i++) {
+    if (std::strcmp(pipeline.GetId(i), id) == 0) {
+      return i;
+    }
+  }
+  ADD_FAILURE() << "No hot statistic " << id;
+  return 0;
+}
+
+// Test that the hot statistics computed on the I/O thread equal the ones
+// computed synchronously, for several years in submission order.
+TEST(StatisticsPipelineTest, AsyncEqualsSerial) {
+  std::vector<HotRow> rows;
+  for (int i = 0; i < 80; i++) {
+    HotRow row = {};
+    row.age_ = static_cast<float>(i % 40);
+    row.sex_ = i % 2 == 0 ? Sex::kMale : Sex::kFemale;
+    row.state_ = i % 4 == 0 ? GemsState::kAcute : GemsState::kHealthy;
+    rows.push_back(row);
+  }
+
+  StatisticsPipeline serial, pipelined;
+  serial.Enable();
+  pipelined.Enable();
+  {
+    AsyncWriter writer;
+    for (int year = 0; year < 3; year++) {
+      serial.Submit(1960 + year, rows, nullptr);
+      pipelined.Submit(1960 + year, rows, &writer);
+      rows.pop_back();
+    }
+    writer.Flush();
+  }
+
+  ASSERT_EQ(kNumHotStatistics, pipelined.GetNumStatistics());
+  EXPECT_EQ(serial.GetXValues(), pipelined.GetXValues());
+  for (size_t i = 0; i < serial.GetNumStatistics(); i++) {
+    EXPECT_STREQ(serial.GetId(i), pipelined.GetId(i));
+    EXPECT_EQ(serial.GetYValues(i), pipelined.GetYValues(i));
+  }
+
+  // Year 1960: 20 acute men, 12 of them aged 15 to 49 (ages 16, 20, ..., 36
+  // twice); 50 agents aged 15 to 39, 24 of them men
+  EXPECT_EQ(1960, pipelined.GetXValues()[0]);
+  auto y = [&](const char* id) {
+    return pipelined.GetYValues(GetIndex(pipelined, id))[0];
+  };
+  EXPECT_EQ(20, y("acute_agents"));
+  EXPECT_EQ(40, y("males"));
+  EXPECT_EQ(40, y("females"));
+  EXPECT_EQ(0, y("infected_females"));
+  EXPECT_EQ(20, y("infected_males"));
+  EXPECT_EQ(12, y("infected_men_15_49"));
+  EXPECT_EQ(24, y("men_15_49"));
+  EXPECT_EQ(50, y("all_15_49"));
+  EXPECT_EQ(0.25, y("prevalence"));
+  EXPECT_EQ(0.25, y("incidence"));
+  EXPECT_EQ(0.5, y("prevalence_males"));
+  EXPECT_EQ(0.24, y("prevalence_15_49"));
+  // Year 1962: 2 rows less (ages 39 and 38), both healthy
+  size_t prevalence = GetIndex(pipelined, "prevalence");
+  EXPECT_EQ(20.0 / 78, pipelined.GetYValues(prevalence)[2]);
+}
+
+// Test that the counts of a single pass equal the counts of one pass per
+// statistic
+TEST(StatisticsPipelineTest, FusedCounts) {
+  std::vector<HotRow> rows;
+  for (int i = 0; i < 100; i++) {
+    HotRow row = {};
+    row.age_ = static_cast<float>((i * 7) % 90);
+    row.sex_ = i % 3 == 0 ? Sex::kFemale : Sex::kMale;
+    row.state_ = i % 5 == 0   ? GemsState::kAcute
+                 : i % 5 == 1 ? GemsState::kChronic
+                              : GemsState::kHealthy;
+    rows.push_back(row);
+  }
+  HotCounts fused, first, second;
+  for (size_t i = 0; i < rows.size(); i++) {
+    fused.Add(rows[i]);
+    (i < 37 ? first : second).Add(rows[i]);
+  }
+  first.Merge(second);
+
+  uint64_t infected_women_15_49 = 0, women_15_49 = 0, acute = 0;
+  for (const auto& row : rows) {
+    bool age_15_49 = row.age_ >= 15 && row.age_ < 50;
+    infected_women_15_49 += !row.IsHealthy() && row.IsFemale() && age_15_49;
+    women_15_49 += row.IsFemale() && age_15_49;
+    acute += row.IsAcute();
+  }
+  for (auto* counts : {&fused, &first}) {
+    EXPECT_EQ(100u, counts->agents);
+    EXPECT_EQ(40u, counts->infected);
+    EXPECT_EQ(acute, counts->acute);
+    EXPECT_EQ(infected_women_15_49, counts->infected_women_15_49);
+    EXPECT_EQ(women_15_49, counts->women_15_49);
+  }
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
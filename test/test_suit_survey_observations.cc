@@ -0,0 +1,84 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "survey-observations.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test that the observations are read in the order of the years, and that the
+// likelihood is largest at the observed prevalence
+TEST(SurveyObservationsTest, ReadAndLikelihood) {
+  std::string filename = "survey-observations-test.csv";
+  {
+    std::ofstream file(filename);
+    file << "# year,id,value,sample_size\n"
+         << "2010,prevalence_15_49,0.106,7000\n"
+         << "\n"
+         << "2004,prevalence_women_15_49,0.133,1000\n";
+  }
+  std::vector<SurveyObservation> observations;
+  ASSERT_TRUE(ReadSurveyObservations(filename, &observations));
+  std::remove(filename.c_str());
+  ASSERT_EQ(2u, observations.size());
+  EXPECT_EQ(2004, observations[0].year);
+  EXPECT_EQ("prevalence_women_15_49", observations[0].id);
+  EXPECT_EQ(2010, observations[1].year);
+  EXPECT_EQ(7000u, observations[1].sample_size);
+
+  const auto& observation = observations[1];
+  double at_observed = SurveyLogLikelihood(observation, 0.106);
+  EXPECT_GT(at_observed, SurveyLogLikelihood(observation, 0.1));
+  EXPECT_GT(at_observed, SurveyLogLikelihood(observation, 0.11));
+  // A prevalence of zero is unlikely, but not impossible
+  EXPECT_TRUE(std::isfinite(SurveyLogLikelihood(observation, 0)));
+  // Normalised: 3 of 10 positive with a prevalence of 0.3
+  SurveyObservation small = {2010, "prevalence_15_49", 0.3, 10};
+  EXPECT_NEAR(std::log(120 * std::pow(0.3, 3) * std::pow(0.7, 7)),
+              SurveyLogLikelihood(small, 0.3), 1e-9);
+
+  EXPECT_FALSE(ReadSurveyObservations("does-not-exist.csv", &observations));
+}
+
+// Test that systematic resampling draws each particle proportionally to its
+// weight, and ignores particles without weight
+TEST(SurveyObservationsTest, SystematicResampling) {
+  double none = -std::numeric_limits<double>::infinity();
+  std::vector<double> log_weights = {std::log(1.0), none, std::log(2.0),
+                                     std::log(1.0)};
+  EXPECT_NEAR(8.0 / 3, EffectiveSampleSize(log_weights), 1e-12);
+  EXPECT_NEAR(0, LogMeanWeight(log_weights), 1e-12);
+
+  auto ancestors = SystematicResampling(log_weights, 0.5);
+  EXPECT_EQ(std::vector<uint64_t>({0, 2, 2, 3}), ancestors);
+  ancestors = SystematicResampling(log_weights, 0);
+  EXPECT_EQ(std::vector<uint64_t>({0, 2, 2, 3}), ancestors);
+
+  // Large log-likelihoods do not overflow
+  ancestors = SystematicResampling({-1e6, -1e6 + std::log(3.0)}, 0.9);
+  EXPECT_EQ(std::vector<uint64_t>({1, 1}), ancestors);
+  ancestors = SystematicResampling({-1e6, -1e6 + std::log(3.0)}, 0.1);
+  EXPECT_EQ(std::vector<uint64_t>({0, 1}), ancestors);
+  EXPECT_EQ(none, LogMeanWeight({none, none}));
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -14,6 +14,7 @@
 #include "analyze.h"
 #include "biodynamo.h"
 #include "categorical-environment.h"
+#include "custom-operations.h"
 #include "person-behavior.h"
 #include "person.h"
 #include "sim-param.h"
@@ -119,9 +120,15 @@ TEST(TransitionTest, MaleToFemale) {
   auto* env = new CategoricalEnvironment(15, 40, 1, 1, 1);
   simulation.SetEnvironment(env);
 
-  // Run simulation for one simulation time step
+  // Run simulation for one simulation time step. The female is infected when
+  // the casual contact is resolved.
   auto* scheduler = simulation.GetScheduler();
   scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "ResolvePartnershipIntents", OpComputeTarget::kCpu,
+      new ResolvePartnershipIntents());
+  scheduler->ScheduleOp(NewOperation("ResolvePartnershipIntents"),
+                        OpType::kSchedule);
   scheduler->Simulate(1);
 
   // Check if the female agent is not infected and in the state accute
@@ -130,5 +137,220 @@ TEST(TransitionTest, MaleToFemale) {
   EXPECT_TRUE(ap_female->CasualTransmission());
 }
 
+// Test if an infected, acute female agent infects her healthy regular partner.
+TEST(TransitionTest, RegularFemaleToMale) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+
+  // Set the probability female to male to 1.0
+  auto set_param = [&](Param* param) {
+    auto* sparam = param->Get<SimParam>();
+    sparam->infection_probability_acute_fm = 1.0;
+  };
+
+  // Create simulation object
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  // Add a healthy male to the simulation
+  auto male = new Person();
+  male->state_ = GemsState::kHealthy;
+  male->sex_ = Sex::kMale;
+  male->age_ = 20;
+  male->location_ = 0;
+  male->biomedical_factor_ = 0;
+  male->social_behaviour_factor_ = 0;
+  male->seek_regular_partnership_ = false;
+  auto ap_male = male->GetAgentPtr<Person>();  // Get agent pointer
+  rm->AddAgent(male);
+
+  // Add an infected (acute) female to the simulation
+  auto female = new Person();
+  female->state_ = GemsState::kAcute;
+  female->sex_ = Sex::kFemale;
+  female->age_ = 20;
+  female->location_ = 0;
+  female->biomedical_factor_ = 0;
+  female->social_behaviour_factor_ = 0;
+  rm->AddAgent(female);
+
+  // Both agents are in a regular partnership
+  male->SetPartner(female->GetAgentPtr<Person>());
+
+  // Set the custom environment
+  auto* env = new CategoricalEnvironment(15, 40, 1, 1, 1);
+  simulation.SetEnvironment(env);
+
+  // Schedule the regular transmission
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "RegularPartnershipTransmission", OpComputeTarget::kCpu,
+      new RegularPartnershipTransmission());
+  scheduler->ScheduleOp(NewOperation("RegularPartnershipTransmission"),
+                        OpType::kPreSchedule);
+  scheduler->Simulate(1);
+
+  // The couple is serodiscordant at the beginning of the step
+  EXPECT_EQ(1u, env->GetCoupleTable().GetNumCouples());
+  EXPECT_EQ(1u, env->GetCoupleTable().GetNumSerodiscordantCouples());
+  // Check if the male agent is infected and in the state acute
+  EXPECT_TRUE(ap_male->state_ == GemsState::kAcute);
+  // Check if the male agent received the infection via a regular transmission
+  EXPECT_TRUE(ap_male->RegularTransmission());
+}
+
+// Test the category-level birth generation with a fertility table in which all
+// women give birth, and certain mother to child transmission
+TEST(TransitionTest, Births) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+
+  auto set_param = [&](Param* param) {
+    auto* sparam = param->Get<SimParam>();
+    sparam->fertility_rates =
+        std::vector<float>(sparam->fertility_age_bands.size(), 1.0);
+    sparam->birth_infection_probability_untreated = 1.0;
+  };
+
+  // Create simulation object
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+
+  // Add a healthy and an infected (chronic) female to the simulation
+  auto healthy = new Person();
+  healthy->state_ = GemsState::kHealthy;
+  auto infected = new Person();
+  infected->state_ = GemsState::kChronic;
+  for (auto* female : {healthy, infected}) {
+    female->sex_ = Sex::kFemale;
+    female->age_ = 20;
+    female->location_ = 0;
+    female->biomedical_factor_ = 0;
+    female->social_behaviour_factor_ = 0;
+    rm->AddAgent(female);
+  }
+  auto ap_healthy = healthy->GetAgentPtr<Person>();
+  auto ap_infected = infected->GetAgentPtr<Person>();
+
+  // Set the custom environment
+  auto* env = new CategoricalEnvironment(15, 40, 1, 1, 1);
+  simulation.SetEnvironment(env);
+
+  // Schedule the births
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+  OperationRegistry::GetInstance()->AddOperationImpl(
+      "GiveBirths", OpComputeTarget::kCpu, new GiveBirths());
+  scheduler->ScheduleOp(NewOperation("GiveBirths"), OpType::kPreSchedule);
+  scheduler->Simulate(1);
+
+  EXPECT_EQ(2u, env->GetBirths().GetNumBirths());
+  EXPECT_EQ(1u, env->GetBirths().GetNumInfectedAtBirth());
+  EXPECT_EQ(4u, rm->GetNumAgents());
+  ASSERT_EQ(1, ap_healthy->GetNumberOfChildren());
+  ASSERT_EQ(1, ap_infected->GetNumberOfChildren());
+  EXPECT_TRUE(ap_healthy->children_[0]->IsHealthy());
+  EXPECT_TRUE(ap_infected->children_[0]->MTCTransmission());
+  EXPECT_TRUE(ap_infected->children_[0]->IsChildOf(ap_infected));
+}
+
+// Test if compressed children age with their mother and become agents at
+// min_age
+TEST(TransitionTest, CompressedChildren) {
+  // Register Sim Param
+  Param::RegisterParamGroup(new SimParam());
+
+  // Nobody dies
+  auto set_param = [&](Param* param) {
+    auto* sparam = param->Get<SimParam>();
+    sparam->compress_children = true;
+    sparam->mortality_rate_by_age =
+        std::vector<float>(sparam->mortality_rate_by_age.size(), 0.0);
+    sparam->hiv_mortality_rate =
+        std::vector<float>(sparam->hiv_mortality_rate.size(), 0.0);
+  };
+
+  // Create simulation object
+  Simulation simulation(TEST_NAME, set_param);
+  auto* rm = simulation.GetResourceManager();
+  const auto* sparam = simulation.GetParam()->Get<SimParam>();
+
+  auto mother = new Person();
+  mother->state_ = GemsState::kHealthy;
+  mother->sex_ = Sex::kFemale;
+  mother->age_ = 30;
+  mother->location_ = 0;
+  mother->biomedical_factor_ = 0;
+  mother->social_behaviour_factor_ = 0;
+  mother->AddBehavior(new GetOlder());
+  // A 14 year old and a 3 year old child
+  for (int age : {14, 3}) {
+    ChildRecord record;
+    record.birth_year_ = sparam->start_year - age - 1;
+    record.sex_ = Sex::kMale;
+    record.state_ = GemsState::kHealthy;
+    record.infection_origin_state_ = 0;
+    record.infection_origin_sb_ = 0;
+    mother->child_records_.push_back(record);
+  }
+  auto ap_mother = mother->GetAgentPtr<Person>();
+  rm->AddAgent(mother);
+
+  // Set the custom environment (GetOlder reads the compiled parameters)
+  auto* env = new CategoricalEnvironment(15, 40, 1, 1, 1);
+  simulation.SetEnvironment(env);
+
+  auto* scheduler = simulation.GetScheduler();
+  scheduler->UnscheduleOp(scheduler->GetOps("load balancing")[0]);
+  scheduler->Simulate(1);
+
+  // The older child turned 15 and became an agent
+  EXPECT_EQ(2u, rm->GetNumAgents());
+  EXPECT_EQ(1u, ap_mother->child_records_.size());
+  ASSERT_EQ(1, ap_mother->GetNumberOfChildren());
+  auto child = ap_mother->children_[0];
+  EXPECT_TRUE(child->IsChildOf(ap_mother));
+  EXPECT_EQ(0, child->location_);
+  EXPECT_LE(15, child->age_);
+  EXPECT_GT(16, child->age_);
+}
+
+// Test that the prevention modifiers are only added to agents that do not
+// carry them yet, and that PrEP is restricted to HIV-negative agents
+TEST(TransitionTest, Prevention) {
+  Param::RegisterParamGroup(new SimParam());
+  Simulation simulation(TEST_NAME);
+  auto* random = simulation.GetRandom();
+
+  YearParams year_params;
+  year_params.prep_probability = 1;
+  year_params.vmmc_probability = 1;
+  year_params.condom_use_probability = 0;
+
+  Person male;
+  male.sex_ = Sex::kMale;
+  male.state_ = GemsState::kHealthy;
+  male.prevention_ = PreventionModifier::kCondom;
+  GetOlder::AssignPrevention(&male, year_params, random);
+  EXPECT_EQ(PreventionModifier::kPrEP | PreventionModifier::kVMMC |
+                PreventionModifier::kCondom,
+            male.prevention_);
+
+  Person female;
+  female.sex_ = Sex::kFemale;
+  female.state_ = GemsState::kAcute;
+  GetOlder::AssignPrevention(&female, year_params, random);
+  EXPECT_EQ(PreventionModifier::kNoPrevention, female.prevention_);
+
+  // Coverage is kept when the uptake drops, PrEP stops with the infection
+  year_params.prep_probability = 0;
+  year_params.vmmc_probability = 0;
+  male.state_ = GemsState::kChronic;
+  GetOlder::AssignPrevention(&male, year_params, random);
+  EXPECT_EQ(PreventionModifier::kVMMC | PreventionModifier::kCondom,
+            male.prevention_);
+}
+
 }  // namespace hiv_malawi
 }  // namespace bdm
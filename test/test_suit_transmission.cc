@@ -0,0 +1,120 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include "datatypes.h"
+#include "sim-param.h"
+#include "transmission-table.h"
+
+#define TEST_NAME typeid(*this).name()
+
+namespace bdm {
+namespace hiv_malawi {
+
+// Test if the table reproduces the per-act and the cumulative probabilities
+// without any prevention modifiers.
+TEST(TransmissionTableTest, NoPrevention) {
+  SimParam sparam;
+  TransmissionTable table;
+  EXPECT_FALSE(table.IsBuilt());
+  table.Build(&sparam);
+  EXPECT_TRUE(table.IsBuilt());
+
+  EXPECT_FLOAT_EQ(sparam.infection_probability_acute_fm,
+                  table.GetPerActProbability(
+                      TransmissionDirection::kFemaleToMale, GemsState::kAcute,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kNoPrevention));
+  EXPECT_FLOAT_EQ(sparam.infection_probability_chronic_mf,
+                  table.GetPerActProbability(
+                      TransmissionDirection::kMaleToFemale, GemsState::kChronic,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kNoPrevention));
+  EXPECT_FLOAT_EQ(sparam.infection_probability_treated_mm,
+                  table.GetPerActProbability(
+                      TransmissionDirection::kMaleToMale, GemsState::kTreated,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kNoPrevention));
+
+  // Healthy agents cannot transmit and zero acts cannot transmit.
+  EXPECT_FLOAT_EQ(0.0,
+                  table.GetProbability(TransmissionDirection::kMaleToFemale,
+                                       GemsState::kHealthy,
+                                       PreventionModifier::kNoPrevention,
+                                       PreventionModifier::kNoPrevention, 10));
+  EXPECT_FLOAT_EQ(0.0, table.GetProbability(
+                           TransmissionDirection::kMaleToFemale,
+                           GemsState::kAcute, PreventionModifier::kNoPrevention,
+                           PreventionModifier::kNoPrevention, 0));
+
+  // Tabulated and non-tabulated number of acts.
+  for (int no_acts : {1, 5, 64, 100}) {
+    float expected =
+        1.0 - std::pow(1.0 - sparam.infection_probability_acute_mf, no_acts);
+    float actual = table.GetProbability(
+        TransmissionDirection::kMaleToFemale, GemsState::kAcute,
+        PreventionModifier::kNoPrevention, PreventionModifier::kNoPrevention,
+        no_acts);
+    EXPECT_NEAR(expected, actual, 1e-6);
+  }
+}
+
+// Test if the prevention modifiers reduce the per-act probability as expected.
+TEST(TransmissionTableTest, PreventionModifiers) {
+  SimParam sparam;
+  TransmissionTable table;
+  table.Build(&sparam);
+
+  float base = sparam.infection_probability_chronic_fm;
+
+  // PrEP protects the susceptible partner.
+  EXPECT_FLOAT_EQ(base * (1.0 - sparam.prep_efficacy),
+                  table.GetPerActProbability(
+                      TransmissionDirection::kFemaleToMale, GemsState::kChronic,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kPrEP));
+  EXPECT_FLOAT_EQ(base, table.GetPerActProbability(
+                            TransmissionDirection::kFemaleToMale,
+                            GemsState::kChronic, PreventionModifier::kPrEP,
+                            PreventionModifier::kNoPrevention));
+
+  // VMMC only protects susceptible males.
+  EXPECT_FLOAT_EQ(base * (1.0 - sparam.vmmc_efficacy),
+                  table.GetPerActProbability(
+                      TransmissionDirection::kFemaleToMale, GemsState::kChronic,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kVMMC));
+  EXPECT_FLOAT_EQ(sparam.infection_probability_chronic_mf,
+                  table.GetPerActProbability(
+                      TransmissionDirection::kMaleToFemale, GemsState::kChronic,
+                      PreventionModifier::kNoPrevention,
+                      PreventionModifier::kVMMC));
+
+  // Condoms are effective if either partner uses them, and modifiers combine
+  // multiplicatively.
+  EXPECT_FLOAT_EQ(base * (1.0 - sparam.condom_efficacy),
+                  table.GetPerActProbability(
+                      TransmissionDirection::kFemaleToMale, GemsState::kChronic,
+                      PreventionModifier::kCondom,
+                      PreventionModifier::kNoPrevention));
+  EXPECT_FLOAT_EQ(
+      base * (1.0 - sparam.condom_efficacy) * (1.0 - sparam.prep_efficacy) *
+          (1.0 - sparam.vmmc_efficacy),
+      table.GetPerActProbability(
+          TransmissionDirection::kFemaleToMale, GemsState::kChronic,
+          PreventionModifier::kCondom,
+          PreventionModifier::kPrEP | PreventionModifier::kVMMC));
+}
+
+}  // namespace hiv_malawi
+}  // namespace bdm
@@ -0,0 +1,58 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+// Merges the ensemble aggregates (SimParam::ensemble_file) of several workers.
+// Writes the mean, standard deviation, median, and 50% and 95% bands of each
+// series as CSV if the output ends with .csv, and the merged aggregate
+// otherwise (e.g. to merge the aggregates of several machines in a tree).
+//
+// Usage: ensemble-bands <output> <aggregate> ...
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ensemble-aggregator.h"
+
+using bdm::hiv_malawi::EnsembleAggregator;
+
+int main(int argc, const char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <output> <aggregate> ..."
+              << std::endl;
+    return 1;
+  }
+  EnsembleAggregator aggregator;
+  for (int i = 2; i < argc; i++) {
+    if (!aggregator.Read(argv[i])) {
+      std::cerr << "Error: cannot read " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+  std::string output = argv[1];
+  bool csv = output.size() >= 4 && output.compare(output.size() - 4, 4,
+                                                  ".csv") == 0;
+  bool ok = csv ? aggregator.WriteBands(
+                      output, EnsembleAggregator::GetBandQuantiles())
+                : aggregator.Write(output);
+  if (!ok) {
+    std::cerr << "Error: cannot write " << output << std::endl;
+    return 1;
+  }
+  for (const auto& id : aggregator.GetIds()) {
+    auto bands = aggregator.GetBands(id, {});
+    std::cout << id << " (" << bands.size() << " points, "
+              << (bands.empty() ? 0 : bands.front().count) << " replicates)"
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+// Compares the lookups of the casual mating phase (random compound category,
+// random agent of the category, read of the agent) for a vector per category
+// and for the pooled CategoryIndex, with and without huge pages. Reports the
+// time and, if the hardware counters are available, the dTLB load misses per
+// lookup.
+//
+// Usage: index-benchmark [agents] [categories] [lookups]
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "category-index.h"
+#include "huge-page-allocator.h"
+
+using bdm::hiv_malawi::CategoryIndex;
+using bdm::hiv_malawi::SetHugePagePolicy;
+
+namespace {
+
+// Stand-in for a Person, which is read after the lookup
+struct Agent {
+  uint64_t uid;
+  char state[248];
+};
+
+// dTLB load misses of this thread, if the hardware counters are available
+class DtlbCounter {
+ public:
+  DtlbCounter() {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+  ~DtlbCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool IsAvailable() const { return fd_ >= 0; }
+
+  void Start() {
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  uint64_t Stop() {
+    uint64_t count = 0;
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+    return count;
+  }
+
+ private:
+  int fd_;
+};
+
+template <typename Lookup>
+void Measure(const std::string& name, uint64_t no_lookups, Lookup lookup) {
+  DtlbCounter counter;
+  std::mt19937_64 rng(42);
+  uint64_t sum = 0;
+  counter.Start();
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < no_lookups; i++) {
+    sum += lookup(&rng);
+  }
+  auto stop = std::chrono::steady_clock::now();
+  uint64_t misses = counter.Stop();
+  double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+  std::cout << name << ": " << ns / no_lookups << " ns/lookup, ";
+  if (counter.IsAvailable()) {
+    std::cout << static_cast<double>(misses) / no_lookups
+              << " dTLB load misses/lookup";
+  } else {
+    std::cout << "dTLB counters not available";
+  }
+  std::cout << " (checksum " << sum << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  uint64_t no_agents = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+  uint64_t no_categories = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 768;
+  uint64_t no_lookups = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 2e7;
+
+  std::vector<Agent> agents(no_agents);
+  std::vector<uint32_t> categories(no_agents);
+  std::mt19937_64 rng(1);
+  for (uint64_t i = 0; i < no_agents; i++) {
+    agents[i].uid = i;
+    categories[i] = rng() % no_categories;
+  }
+  auto category = [&](std::mt19937_64* r) { return (*r)() % no_categories; };
+
+  {
+    // One vector per category, grown as the agents are added
+    std::vector<std::vector<Agent*>> index(no_categories);
+    for (uint64_t i = 0; i < no_agents; i++) {
+      index[categories[i]].push_back(&agents[i]);
+    }
+    Measure("vector per category", no_lookups, [&](std::mt19937_64* r) {
+      const auto& agents_of_category = index[category(r)];
+      return agents_of_category[(*r)() % agents_of_category.size()]->uid;
+    });
+  }
+
+  for (auto* policy : {"none", "transparent", "hugetlbfs"}) {
+    SetHugePagePolicy(policy);
+    CategoryIndex<Agent*> index;
+    index.Clear(no_categories);
+    for (uint64_t i = 0; i < no_agents; i++) {
+      index.AddAgent(&agents[i], categories[i]);
+    }
+    index.Finalize();
+    Measure(std::string("pooled, huge pages ") + policy, no_lookups,
+            [&](std::mt19937_64* r) {
+              auto agents_of_category = index[category(r)];
+              return agents_of_category
+                  .GetAgentAtIndex((*r)() % agents_of_category.GetNumAgents())
+                  ->uid;
+            });
+  }
+  return 0;
+}
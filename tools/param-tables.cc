@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+// Converts CSV and JSON parameter tables into the binary format that
+// SimParam::parameter_table_file expects.
+//
+// Usage: param-tables <output.bin> [<name>=<table.csv> | <params.json>] ...
+//
+// Table names must match the SimParam members they replace, e.g.
+//   param-tables tables.bin migration_matrix=migration.csv bdm.json
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "parameter-tables.h"
+
+using bdm::hiv_malawi::ParameterTable;
+using bdm::hiv_malawi::ParameterTables;
+
+int main(int argc, const char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <output.bin> [<name>=<table.csv> | <params.json>] ..."
+              << std::endl;
+    return 1;
+  }
+  std::vector<ParameterTable> tables;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    auto eq = arg.find('=');
+    bool ok;
+    if (eq != std::string::npos) {
+      tables.emplace_back();
+      ok = ParameterTables::ReadCsv(arg.substr(eq + 1), arg.substr(0, eq),
+                                    &tables.back());
+    } else {
+      ok = ParameterTables::ReadJson(arg, &tables);
+    }
+    if (!ok) {
+      std::cerr << "Error: cannot read " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (!ParameterTables::Write(argv[1], tables)) {
+    std::cerr << "Error: cannot write " << argv[1] << std::endl;
+    return 1;
+  }
+  for (auto& table : tables) {
+    std::cout << table.name << " (";
+    for (size_t d = 0; d < table.dims.size(); d++) {
+      std::cout << (d > 0 ? " x " : "") << table.dims[d];
+    }
+    std::cout << ")" << std::endl;
+  }
+  return 0;
+}
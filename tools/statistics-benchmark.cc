@@ -0,0 +1,130 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) 2021 CERN and the University of Geneva for the benefit of the
+// BioDynaMo collaboration. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+//
+// -----------------------------------------------------------------------------
+
+// Compares the computation of the hot statistics (see HotCounts) of one year
+// with one pass over the agents per counter, as separate collectors of the
+// TimeSeries, with a single fused pass, and from a snapshot of the hot columns
+// (pipelined statistics). Reports the time per year on a single thread.
+//
+// Usage: statistics-benchmark [agents] [years]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "statistics-pipeline.h"
+
+using bdm::hiv_malawi::GemsState;
+using bdm::hiv_malawi::HotCounts;
+using bdm::hiv_malawi::HotRow;
+using bdm::hiv_malawi::Sex;
+
+namespace {
+
+// Stand-in for a Person, with the attributes of the hot statistics
+struct Agent {
+  float age_;
+  int state_;
+  int sex_;
+  char other[244];
+
+  bool IsHealthy() const { return state_ == GemsState::kHealthy; }
+  bool IsAcute() const { return state_ == GemsState::kAcute; }
+  bool IsMale() const { return sex_ == Sex::kMale; }
+  bool IsFemale() const { return sex_ == Sex::kFemale; }
+};
+
+using Predicate = bool (*)(const Agent&);
+
+bool Is15To49(const Agent& a) { return a.age_ >= 15 && a.age_ < 50; }
+
+// The counters of the hot statistics, as separate collectors
+const Predicate kCounters[] = {
+    [](const Agent& a) { return a.IsAcute(); },
+    [](const Agent& a) { return !a.IsHealthy() && Is15To49(a); },
+    [](const Agent& a) { return Is15To49(a); },
+    [](const Agent& a) { return !a.IsHealthy() && a.IsFemale(); },
+    [](const Agent& a) { return a.IsFemale(); },
+    [](const Agent& a) {
+      return !a.IsHealthy() && a.IsFemale() && Is15To49(a);
+    },
+    [](const Agent& a) { return a.IsFemale() && Is15To49(a); },
+    [](const Agent& a) { return !a.IsHealthy() && a.IsMale(); },
+    [](const Agent& a) { return a.IsMale(); },
+    [](const Agent& a) { return !a.IsHealthy() && a.IsMale() && Is15To49(a); },
+    [](const Agent& a) { return a.IsMale() && Is15To49(a); }};
+
+template <typename Year>
+void Measure(const std::string& name, uint64_t no_years, Year year) {
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < no_years; i++) {
+    sum += year();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+  std::cout << name << ": " << ms / no_years << " ms/year (checksum " << sum
+            << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  uint64_t no_agents = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+  uint64_t no_years = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+  std::vector<Agent> agents(no_agents);
+  std::mt19937_64 rng(1);
+  for (auto& agent : agents) {
+    agent.age_ = static_cast<float>(rng() % 90);
+    agent.state_ = static_cast<int>(rng() % 5);
+    agent.sex_ = rng() % 2 == 0 ? Sex::kMale : Sex::kFemale;
+  }
+
+  Measure("one pass per counter", no_years, [&]() {
+    uint64_t total = 0;
+    for (auto counter : kCounters) {
+      uint64_t count = 0;
+      for (const auto& agent : agents) {
+        count += counter(agent);
+      }
+      total += count;
+    }
+    return total;
+  });
+
+  Measure("fused pass", no_years, [&]() {
+    HotCounts counts;
+    for (auto& agent : agents) {
+      counts.Add(agent);
+    }
+    return counts.acute + counts.men_15_49;
+  });
+
+  Measure("snapshot of the hot columns", no_years, [&]() {
+    std::vector<HotRow> rows;
+    rows.reserve(agents.size());
+    for (const auto& agent : agents) {
+      rows.push_back(HotRow::From(agent));
+    }
+    HotCounts counts;
+    for (const auto& row : rows) {
+      counts.Add(row);
+    }
+    return counts.acute + counts.men_15_49;
+  });
+  return 0;
+}